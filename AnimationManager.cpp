@@ -0,0 +1,619 @@
+///////////////////////////////////////////////////////////////////////////////
+// animationmanager.cpp
+// ============
+// keyframed curves driving the channels of scene graph nodes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AnimationManager.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define ANIMATIONMANAGER_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// the clock never jumps further than this in one frame, so
+	// a stall does not skip the animations ahead
+	const float g_MaxDeltaTime = 0.1f;
+
+	// frames between the evaluations of the nodes off the
+	// screen, and of those fewer pixels across than these
+	const int g_OffscreenInterval = 8;
+	const float g_SmallNodePixels = 8.0f;
+	const int g_SmallNodeInterval = 4;
+	const float g_MediumNodePixels = 32.0f;
+	const int g_MediumNodeInterval = 2;
+
+	// coefficients of the polynomial slerp of Eberly, "A Fast
+	// and Accurate Algorithm for Computing SLERP" (2011): the
+	// weights of the two quaternions are series in cos(theta)
+	// - 1, the last term scaled by mu to make up for the ones
+	// left out.  The weights are within 2e-5 of the exact ones
+	const float g_SlerpMu = 1.85298109240830f;
+	const float g_SlerpU[8] = {
+		1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9),
+		1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), g_SlerpMu / (8 * 17) };
+	const float g_SlerpV[8] = {
+		1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9,
+		5.0f / 11, 6.0f / 13, 7.0f / 15, g_SlerpMu * 8 / 17 };
+}
+
+/***********************************************************
+ *  AnimationManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AnimationManager::AnimationManager()
+{
+	m_bPlaying = false;
+	m_bUpdateLOD = true;
+	m_bDirty = true;
+	m_time = 0.0;
+	m_frameIndex = 0;
+	m_evaluateMilliseconds = 0.0;
+	m_evaluatedChannels = 0.0;
+	m_skippedChannels = 0.0;
+	m_evaluatedFrames = 0;
+}
+
+/***********************************************************
+ *  ~AnimationManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+AnimationManager::~AnimationManager()
+{
+	m_nodes.clear();
+	m_curves.clear();
+	for (int i = 0; i < ANIMATION_INTERPOLATION_COUNT; i++)
+	{
+		m_bindings[i].clear();
+	}
+}
+
+/***********************************************************
+ *  AddNode()
+ ***********************************************************/
+int AnimationManager::AddNode(int parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale, float radius)
+{
+	ANIMATION_NODE node;
+	node.parent = (parent < (int)m_nodes.size()) ? parent : -1;
+	node.radius = radius;
+	node.channels[ANIMATION_CHANNEL_TRANSLATION] = glm::vec4(translation, 0.0f);
+	node.channels[ANIMATION_CHANNEL_ROTATION] = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+	node.channels[ANIMATION_CHANNEL_SCALE] = glm::vec4(scale, 0.0f);
+	node.channels[ANIMATION_CHANNEL_PARAMETER] = glm::vec4(0.0f);
+	node.world = glm::mat4(1.0f);
+	node.updateInterval = 1;
+	m_nodes.push_back(node);
+	m_bDirty = true;
+	return((int)m_nodes.size() - 1);
+}
+
+/***********************************************************
+ *  AddCurve()
+ ***********************************************************/
+int AnimationManager::AddCurve(ANIMATION_INTERPOLATION interpolation, const std::vector<ANIMATION_KEY>& keys)
+{
+	if (keys.empty() == true)
+	{
+		return(-1);
+	}
+
+	ANIMATION_CURVE curve;
+	curve.interpolation = interpolation;
+	curve.firstKey = (int)m_keyTimes.size();
+	curve.keyCount = (int)keys.size();
+	curve.duration = keys.back().time - keys.front().time;
+	for (const ANIMATION_KEY& key : keys)
+	{
+		m_keyTimes.push_back(key.time);
+		m_keyValues.push_back(key.value);
+		m_keyInTangents.push_back(key.inTangent);
+		m_keyOutTangents.push_back(key.outTangent);
+	}
+	m_curves.push_back(curve);
+	return((int)m_curves.size() - 1);
+}
+
+/***********************************************************
+ *  BindCurve()
+ ***********************************************************/
+void AnimationManager::BindCurve(int node, ANIMATION_CHANNEL channel, int curve, float timeOffset, float speed)
+{
+	if ((node < 0) || (node >= (int)m_nodes.size()) || (curve < 0) || (curve >= (int)m_curves.size()))
+	{
+		return;
+	}
+
+	ANIMATION_BINDING binding;
+	binding.node = node;
+	binding.channel = channel;
+	binding.curve = curve;
+	binding.timeOffset = timeOffset;
+	binding.speed = speed;
+	binding.cursor = 0;
+	m_bindings[m_curves[curve].interpolation].push_back(binding);
+	m_bDirty = true;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for advancing the clock and
+ *  evaluating the bindings whose nodes are due this frame,
+ *  one batch per interpolation, then the world matrices of
+ *  every node.  While the clock is stopped nothing is
+ *  evaluated unless the nodes or bindings changed, and
+ *  then all of them are, so no node is left behind.
+ ***********************************************************/
+void AnimationManager::Update(float deltaTime, ViewManager* pViewManager)
+{
+	if (m_bPlaying == true)
+	{
+		m_time += std::min(std::max(deltaTime, 0.0f), g_MaxDeltaTime);
+	}
+	else if (m_bDirty == false)
+	{
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	bool bAll = m_bDirty;
+	UpdateIntervals(pViewManager);
+	int evaluated = 0;
+	int total = 0;
+	for (int i = 0; i < ANIMATION_INTERPOLATION_COUNT; i++)
+	{
+		evaluated += EvaluateBindings((ANIMATION_INTERPOLATION)i, bAll);
+		total += (int)m_bindings[i].size();
+	}
+	UpdateWorldMatrices();
+	m_bDirty = false;
+	m_frameIndex++;
+
+	if (total > 0)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		m_evaluateMilliseconds += elapsed.count();
+		m_evaluatedChannels += evaluated;
+		m_skippedChannels += total - evaluated;
+		m_evaluatedFrames++;
+	}
+}
+
+/***********************************************************
+ *  UpdateIntervals()
+ *
+ *  This method is used for picking how often each node is
+ *  evaluated from where its bounding sphere was last
+ *  frame: every frame on the screen, less often for few
+ *  pixels, and rarely off the screen, tested against the
+ *  planes of the view frustum (Gribb and Hartmann).
+ ***********************************************************/
+void AnimationManager::UpdateIntervals(ViewManager* pViewManager)
+{
+	if ((m_bUpdateLOD == false) || (NULL == pViewManager))
+	{
+		for (ANIMATION_NODE& node : m_nodes)
+		{
+			node.updateInterval = 1;
+		}
+		return;
+	}
+
+	glm::mat4 viewProjection = pViewManager->GetProjectionMatrix() * pViewManager->GetViewMatrix();
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+	glm::vec4 planes[6] = {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2] };
+	for (glm::vec4& plane : planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+	glm::vec3 cameraPosition = pViewManager->GetCameraPosition();
+
+	for (ANIMATION_NODE& node : m_nodes)
+	{
+		node.updateInterval = 1;
+		if (node.radius <= 0.0f)
+		{
+			continue;
+		}
+
+		glm::vec3 center = glm::vec3(node.world[3]);
+		float scale = std::max(glm::length(glm::vec3(node.world[0])), std::max(glm::length(glm::vec3(node.world[1])), glm::length(glm::vec3(node.world[2]))));
+		float radius = node.radius * scale;
+
+		bool bOutside = false;
+		for (const glm::vec4& plane : planes)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			{
+				bOutside = true;
+				break;
+			}
+		}
+		if (bOutside == true)
+		{
+			node.updateInterval = g_OffscreenInterval;
+			continue;
+		}
+
+		float distance = glm::length(center - cameraPosition);
+		if (distance <= radius)
+		{
+			continue;
+		}
+		float pixels = pViewManager->GetProjectedSize(2.0f * radius, distance);
+		if (pixels < g_SmallNodePixels)
+		{
+			node.updateInterval = g_SmallNodeInterval;
+		}
+		else if (pixels < g_MediumNodePixels)
+		{
+			node.updateInterval = g_MediumNodeInterval;
+		}
+	}
+}
+
+/***********************************************************
+ *  EvaluateBindings()
+ *
+ *  This method is used for evaluating the bindings of one
+ *  interpolation whose nodes are due this frame, or all of
+ *  them, and writing the results into their channels.
+ *  Nodes with the same interval are spread over its frames.
+ *  Returns how many were evaluated.
+ ***********************************************************/
+int AnimationManager::EvaluateBindings(ANIMATION_INTERPOLATION interpolation, bool bAll)
+{
+	std::vector<ANIMATION_BINDING>& bindings = m_bindings[interpolation];
+
+	m_batchBindings.clear();
+	for (int i = 0; i < (int)bindings.size(); i++)
+	{
+		const ANIMATION_NODE& node = m_nodes[bindings[i].node];
+		if ((bAll == true) || ((m_frameIndex + bindings[i].node) % node.updateInterval == 0))
+		{
+			m_batchBindings.push_back(i);
+		}
+	}
+	int laneCount = (int)m_batchBindings.size();
+	if (laneCount == 0)
+	{
+		return(0);
+	}
+
+	// the lanes past the last binding are evaluated from zeros
+	// and thrown away
+	size_t paddedCount = (size_t)((laneCount + 3) & ~3);
+	m_batchFraction.assign(paddedCount, 0.0f);
+	for (int c = 0; c < 4; c++)
+	{
+		m_batchP0[c].assign(paddedCount, 0.0f);
+		m_batchP1[c].assign(paddedCount, 0.0f);
+		m_batchM0[c].assign(paddedCount, 0.0f);
+		m_batchM1[c].assign(paddedCount, 0.0f);
+		m_batchResult[c].resize(paddedCount);
+	}
+	for (int lane = 0; lane < laneCount; lane++)
+	{
+		GatherKeys(bindings[m_batchBindings[lane]], lane);
+	}
+
+	switch (interpolation)
+	{
+	case ANIMATION_LINEAR:
+		EvaluateLinear((int)paddedCount);
+		break;
+	case ANIMATION_HERMITE:
+		EvaluateHermite((int)paddedCount);
+		break;
+	default:
+		EvaluateSlerp((int)paddedCount);
+		break;
+	}
+
+	for (int lane = 0; lane < laneCount; lane++)
+	{
+		const ANIMATION_BINDING& binding = bindings[m_batchBindings[lane]];
+		m_nodes[binding.node].channels[binding.channel] = glm::vec4(
+			m_batchResult[0][lane], m_batchResult[1][lane], m_batchResult[2][lane], m_batchResult[3][lane]);
+	}
+	return(laneCount);
+}
+
+/***********************************************************
+ *  GatherKeys()
+ *
+ *  This method is used for finding the keys around the
+ *  time of a binding on its looping curve and copying them
+ *  into a lane of the batch, with the fraction of the way
+ *  between them and the tangents scaled to the span.  The
+ *  search starts from the key found last time, so it only
+ *  steps forward a key or so a frame until the curve loops.
+ ***********************************************************/
+void AnimationManager::GatherKeys(ANIMATION_BINDING& binding, int lane)
+{
+	const ANIMATION_CURVE& curve = m_curves[binding.curve];
+	const int first = curve.firstKey;
+
+	float time = m_keyTimes[first];
+	if (curve.duration > 0.0f)
+	{
+		float local = (float)std::fmod(m_time * binding.speed + binding.timeOffset, (double)curve.duration);
+		if (local < 0.0f)
+		{
+			local += curve.duration;
+		}
+		time += local;
+	}
+
+	if ((binding.cursor >= curve.keyCount) || (m_keyTimes[first + binding.cursor] > time))
+	{
+		binding.cursor = 0;
+	}
+	while ((binding.cursor + 1 < curve.keyCount) && (m_keyTimes[first + binding.cursor + 1] <= time))
+	{
+		binding.cursor++;
+	}
+
+	int key0 = first + binding.cursor;
+	int key1 = (binding.cursor + 1 < curve.keyCount) ? key0 + 1 : key0;
+	float span = m_keyTimes[key1] - m_keyTimes[key0];
+	m_batchFraction[lane] = (span > 0.0f) ? std::min(std::max((time - m_keyTimes[key0]) / span, 0.0f), 1.0f) : 0.0f;
+	for (int c = 0; c < 4; c++)
+	{
+		m_batchP0[c][lane] = m_keyValues[key0][c];
+		m_batchP1[c][lane] = m_keyValues[key1][c];
+		m_batchM0[c][lane] = m_keyOutTangents[key0][c] * span;
+		m_batchM1[c][lane] = m_keyInTangents[key1][c] * span;
+	}
+}
+
+/***********************************************************
+ *  EvaluateLinear()
+ ***********************************************************/
+void AnimationManager::EvaluateLinear(int laneCount)
+{
+	for (int c = 0; c < 4; c++)
+	{
+		const float* p0 = m_batchP0[c].data();
+		const float* p1 = m_batchP1[c].data();
+		float* result = m_batchResult[c].data();
+#if defined(ANIMATIONMANAGER_SSE)
+		for (int i = 0; i < laneCount; i += 4)
+		{
+			__m128 s = _mm_loadu_ps(&m_batchFraction[i]);
+			__m128 a = _mm_loadu_ps(p0 + i);
+			_mm_storeu_ps(result + i, _mm_add_ps(a, _mm_mul_ps(s, _mm_sub_ps(_mm_loadu_ps(p1 + i), a))));
+		}
+#else
+		for (int i = 0; i < laneCount; i++)
+		{
+			result[i] = p0[i] + m_batchFraction[i] * (p1[i] - p0[i]);
+		}
+#endif
+	}
+}
+
+/***********************************************************
+ *  EvaluateHermite()
+ *
+ *  This method is used for evaluating the cubic Hermite
+ *  segments of the lanes; the four basis weights are worked
+ *  out once for all the components.
+ ***********************************************************/
+void AnimationManager::EvaluateHermite(int laneCount)
+{
+#if defined(ANIMATIONMANAGER_SSE)
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 three = _mm_set1_ps(3.0f);
+	for (int i = 0; i < laneCount; i += 4)
+	{
+		__m128 s = _mm_loadu_ps(&m_batchFraction[i]);
+		__m128 s2 = _mm_mul_ps(s, s);
+		__m128 s3 = _mm_mul_ps(s2, s);
+		// h00 = 2s^3 - 3s^2 + 1, h10 = s^3 - 2s^2 + s,
+		// h01 = 1 - h00, h11 = s^3 - s^2
+		__m128 h00 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(two, s3), _mm_mul_ps(three, s2)), one);
+		__m128 h10 = _mm_add_ps(_mm_sub_ps(s3, _mm_mul_ps(two, s2)), s);
+		__m128 h01 = _mm_sub_ps(one, h00);
+		__m128 h11 = _mm_sub_ps(s3, s2);
+		for (int c = 0; c < 4; c++)
+		{
+			__m128 value = _mm_mul_ps(h00, _mm_loadu_ps(&m_batchP0[c][i]));
+			value = _mm_add_ps(value, _mm_mul_ps(h10, _mm_loadu_ps(&m_batchM0[c][i])));
+			value = _mm_add_ps(value, _mm_mul_ps(h01, _mm_loadu_ps(&m_batchP1[c][i])));
+			value = _mm_add_ps(value, _mm_mul_ps(h11, _mm_loadu_ps(&m_batchM1[c][i])));
+			_mm_storeu_ps(&m_batchResult[c][i], value);
+		}
+	}
+#else
+	for (int i = 0; i < laneCount; i++)
+	{
+		float s = m_batchFraction[i];
+		float s2 = s * s;
+		float s3 = s2 * s;
+		float h00 = 2.0f * s3 - 3.0f * s2 + 1.0f;
+		float h10 = s3 - 2.0f * s2 + s;
+		float h01 = 1.0f - h00;
+		float h11 = s3 - s2;
+		for (int c = 0; c < 4; c++)
+		{
+			m_batchResult[c][i] = h00 * m_batchP0[c][i] + h10 * m_batchM0[c][i]
+				+ h01 * m_batchP1[c][i] + h11 * m_batchM1[c][i];
+		}
+	}
+#endif
+}
+
+/***********************************************************
+ *  EvaluateSlerp()
+ *
+ *  This method is used for evaluating the quaternion slerps
+ *  of the lanes with the polynomial of Eberly: the second
+ *  quaternion is negated when the two are more than half a
+ *  turn apart, so the shorter arc is taken, and both weights
+ *  come from nested multiply-adds on the cosine of the
+ *  angle between them.
+ ***********************************************************/
+void AnimationManager::EvaluateSlerp(int laneCount)
+{
+#if defined(ANIMATIONMANAGER_SSE)
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	for (int i = 0; i < laneCount; i += 4)
+	{
+		__m128 cosine = _mm_setzero_ps();
+		for (int c = 0; c < 4; c++)
+		{
+			cosine = _mm_add_ps(cosine, _mm_mul_ps(_mm_loadu_ps(&m_batchP0[c][i]), _mm_loadu_ps(&m_batchP1[c][i])));
+		}
+		__m128 sign = _mm_and_ps(cosine, signBit);
+		__m128 xm1 = _mm_sub_ps(_mm_andnot_ps(signBit, cosine), one);
+
+		__m128 t = _mm_loadu_ps(&m_batchFraction[i]);
+		__m128 d = _mm_sub_ps(one, t);
+		__m128 sqrT = _mm_mul_ps(t, t);
+		__m128 sqrD = _mm_mul_ps(d, d);
+		__m128 weightT = one;
+		__m128 weightD = one;
+		for (int k = 7; k >= 0; k--)
+		{
+			__m128 u = _mm_set1_ps(g_SlerpU[k]);
+			__m128 v = _mm_set1_ps(g_SlerpV[k]);
+			weightT = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, sqrT), v), xm1), weightT));
+			weightD = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, sqrD), v), xm1), weightD));
+		}
+		weightT = _mm_xor_ps(_mm_mul_ps(t, weightT), sign);
+		weightD = _mm_mul_ps(d, weightD);
+
+		for (int c = 0; c < 4; c++)
+		{
+			__m128 value = _mm_add_ps(_mm_mul_ps(weightD, _mm_loadu_ps(&m_batchP0[c][i])), _mm_mul_ps(weightT, _mm_loadu_ps(&m_batchP1[c][i])));
+			_mm_storeu_ps(&m_batchResult[c][i], value);
+		}
+	}
+#else
+	for (int i = 0; i < laneCount; i++)
+	{
+		float cosine = 0.0f;
+		for (int c = 0; c < 4; c++)
+		{
+			cosine += m_batchP0[c][i] * m_batchP1[c][i];
+		}
+		float sign = (cosine < 0.0f) ? -1.0f : 1.0f;
+		float xm1 = std::fabs(cosine) - 1.0f;
+
+		float t = m_batchFraction[i];
+		float d = 1.0f - t;
+		float weightT = 1.0f;
+		float weightD = 1.0f;
+		for (int k = 7; k >= 0; k--)
+		{
+			weightT = 1.0f + (g_SlerpU[k] * t * t - g_SlerpV[k]) * xm1 * weightT;
+			weightD = 1.0f + (g_SlerpU[k] * d * d - g_SlerpV[k]) * xm1 * weightD;
+		}
+		weightT *= sign * t;
+		weightD *= d;
+
+		for (int c = 0; c < 4; c++)
+		{
+			m_batchResult[c][i] = weightD * m_batchP0[c][i] + weightT * m_batchP1[c][i];
+		}
+	}
+#endif
+}
+
+/***********************************************************
+ *  UpdateWorldMatrices()
+ ***********************************************************/
+void AnimationManager::UpdateWorldMatrices()
+{
+	for (ANIMATION_NODE& node : m_nodes)
+	{
+		const glm::vec4& rotation = node.channels[ANIMATION_CHANNEL_ROTATION];
+		glm::mat4 local = glm::translate(glm::vec3(node.channels[ANIMATION_CHANNEL_TRANSLATION]))
+			* glm::mat4_cast(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z))
+			* glm::scale(glm::vec3(node.channels[ANIMATION_CHANNEL_SCALE]));
+		node.world = (node.parent >= 0) ? m_nodes[node.parent].world * local : local;
+	}
+}
+
+/***********************************************************
+ *  GetWorldMatrix()
+ ***********************************************************/
+glm::mat4 AnimationManager::GetWorldMatrix(int node) const
+{
+	if ((node < 0) || (node >= (int)m_nodes.size()))
+	{
+		return(glm::mat4(1.0f));
+	}
+	return(m_nodes[node].world);
+}
+
+/***********************************************************
+ *  GetParameter()
+ ***********************************************************/
+float AnimationManager::GetParameter(int node) const
+{
+	if ((node < 0) || (node >= (int)m_nodes.size()))
+	{
+		return(0.0f);
+	}
+	return(m_nodes[node].channels[ANIMATION_CHANNEL_PARAMETER].x);
+}
+
+/***********************************************************
+ *  GetEvaluateTime()
+ ***********************************************************/
+double AnimationManager::GetEvaluateTime() const
+{
+	if (m_evaluatedFrames == 0)
+	{
+		return(0.0);
+	}
+	return(m_evaluateMilliseconds / m_evaluatedFrames);
+}
+
+/***********************************************************
+ *  GetEvaluatedChannels()
+ ***********************************************************/
+double AnimationManager::GetEvaluatedChannels() const
+{
+	if (m_evaluatedFrames == 0)
+	{
+		return(0.0);
+	}
+	return(m_evaluatedChannels / m_evaluatedFrames);
+}
+
+/***********************************************************
+ *  GetSkippedChannels()
+ ***********************************************************/
+double AnimationManager::GetSkippedChannels() const
+{
+	if (m_evaluatedFrames == 0)
+	{
+		return(0.0);
+	}
+	return(m_skippedChannels / m_evaluatedFrames);
+}
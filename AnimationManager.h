@@ -0,0 +1,190 @@
+///////////////////////////////////////////////////////////////////////////////
+// animationmanager.h
+// ============
+// keyframed curves driving the channels of scene graph nodes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "ViewManager.h"
+
+#include <vector>
+
+/***********************************************************
+ *  AnimationManager
+ *
+ *  This class keeps a scene graph of animated nodes, each
+ *  with a translation, a rotation, a scale and a parameter
+ *  the scene reads for itself, such as the angle of a
+ *  hinge, and plays keyframed curves into those channels.
+ *  A curve is linear, cubic Hermite with the tangents of
+ *  its keys, or a quaternion slerp, and loops over its
+ *  keys; many channels can share one curve, each with its
+ *  own time offset and speed.
+ *
+ *  The curves are evaluated in batches: the bindings due
+ *  this frame are gathered by interpolation into arrays of
+ *  key values, and evaluated four channels at a time with
+ *  SSE where available.  The slerp uses a polynomial
+ *  (Eberly 2011) instead of the arc cosine and sines, so it
+ *  needs no scalar math per lane.
+ *
+ *  With the update rate LOD on, the nodes that are off the
+ *  screen or only a few pixels across are evaluated every
+ *  few frames instead of every frame, spread over the
+ *  frames by node, and keep their last pose in between.
+ *  Nodes without a bounding radius are always evaluated.
+ ***********************************************************/
+class AnimationManager
+{
+public:
+	// how a curve blends between its keys
+	enum ANIMATION_INTERPOLATION
+	{
+		ANIMATION_LINEAR = 0,
+		ANIMATION_HERMITE,
+		ANIMATION_SLERP,
+		ANIMATION_INTERPOLATION_COUNT
+	};
+
+	// the channels of a node a curve can drive; the rotation is
+	// a quaternion as x, y, z, w and the parameter is in x
+	enum ANIMATION_CHANNEL
+	{
+		ANIMATION_CHANNEL_TRANSLATION = 0,
+		ANIMATION_CHANNEL_ROTATION,
+		ANIMATION_CHANNEL_SCALE,
+		ANIMATION_CHANNEL_PARAMETER,
+		ANIMATION_CHANNEL_COUNT
+	};
+
+	// a key of a curve, the tangents are per second and only
+	// used by the Hermite curves
+	struct ANIMATION_KEY
+	{
+		float time;
+		glm::vec4 value;
+		glm::vec4 inTangent;
+		glm::vec4 outTangent;
+	};
+
+	// constructor
+	AnimationManager();
+	// destructor
+	~AnimationManager();
+
+	// add a node with its rest pose under a parent added before
+	// it, or -1 for none; the radius bounds it for the update
+	// rate LOD, 0 to always evaluate it.  Returns its index
+	int AddNode(int parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale, float radius = 0.0f);
+	// add a curve from keys sorted by time, returns its index or
+	// -1 when there are no keys
+	int AddCurve(ANIMATION_INTERPOLATION interpolation, const std::vector<ANIMATION_KEY>& keys);
+	// play a curve into a channel of a node, starting timeOffset
+	// seconds into it at speed times the clock
+	void BindCurve(int node, ANIMATION_CHANNEL channel, int curve, float timeOffset = 0.0f, float speed = 1.0f);
+
+	// start or stop the clock; the pose is kept while stopped,
+	// evaluated in full once so no node is left behind
+	void SetPlaying(bool bPlaying) { m_bPlaying = bPlaying; m_bDirty = true; }
+	bool GetPlaying() const { return(m_bPlaying); }
+	// evaluate the small and off screen nodes less often
+	void SetUpdateLOD(bool bEnabled) { m_bUpdateLOD = bEnabled; }
+
+	// advance the clock and evaluate the channels due this
+	// frame, seen from the camera of pViewManager
+	void Update(float deltaTime, ViewManager* pViewManager);
+
+	// the evaluated pose of a node
+	glm::mat4 GetWorldMatrix(int node) const;
+	float GetParameter(int node) const;
+
+	// average CPU time of the evaluation in milliseconds, and the
+	// channels evaluated and skipped by the update rate LOD, per
+	// frame that evaluated anything; 0 before one did
+	double GetEvaluateTime() const;
+	double GetEvaluatedChannels() const;
+	double GetSkippedChannels() const;
+
+private:
+	struct ANIMATION_NODE
+	{
+		int parent;
+		float radius;
+		glm::vec4 channels[ANIMATION_CHANNEL_COUNT];
+		glm::mat4 world;
+		// evaluated every this many frames
+		int updateInterval;
+	};
+
+	struct ANIMATION_CURVE
+	{
+		ANIMATION_INTERPOLATION interpolation;
+		int firstKey;
+		int keyCount;
+		float duration;
+	};
+
+	// a curve played into a channel of a node
+	struct ANIMATION_BINDING
+	{
+		int node;
+		ANIMATION_CHANNEL channel;
+		int curve;
+		float timeOffset;
+		float speed;
+		// the key the time was last found after
+		int cursor;
+	};
+
+	std::vector<ANIMATION_NODE> m_nodes;
+	std::vector<ANIMATION_CURVE> m_curves;
+	// the keys of all the curves
+	std::vector<float> m_keyTimes;
+	std::vector<glm::vec4> m_keyValues;
+	std::vector<glm::vec4> m_keyInTangents;
+	std::vector<glm::vec4> m_keyOutTangents;
+	// the bindings of each interpolation
+	std::vector<ANIMATION_BINDING> m_bindings[ANIMATION_INTERPOLATION_COUNT];
+
+	bool m_bPlaying;
+	bool m_bUpdateLOD;
+	// set when the pose must be evaluated in full
+	bool m_bDirty;
+	double m_time;
+	long long m_frameIndex;
+
+	// the key values of the bindings of one batch, one array per
+	// component padded to whole groups of four lanes
+	std::vector<int> m_batchBindings;
+	std::vector<float> m_batchFraction;
+	std::vector<float> m_batchP0[4];
+	std::vector<float> m_batchP1[4];
+	std::vector<float> m_batchM0[4];
+	std::vector<float> m_batchM1[4];
+	std::vector<float> m_batchResult[4];
+
+	// totals over the frames that evaluated anything
+	double m_evaluateMilliseconds;
+	double m_evaluatedChannels;
+	double m_skippedChannels;
+	int m_evaluatedFrames;
+
+	// pick how often each node is evaluated from the camera
+	void UpdateIntervals(ViewManager* pViewManager);
+	// gather the key values of the bindings of one interpolation
+	// that are due, evaluate them and write their channels
+	int EvaluateBindings(ANIMATION_INTERPOLATION interpolation, bool bAll);
+	// gather the keys around the time of a binding into a lane
+	void GatherKeys(ANIMATION_BINDING& binding, int lane);
+	// evaluate the gathered lanes
+	void EvaluateLinear(int laneCount);
+	void EvaluateHermite(int laneCount);
+	void EvaluateSlerp(int laneCount);
+	// work out the world matrices, parents first
+	void UpdateWorldMatrices();
+};
@@ -0,0 +1,698 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetio.cpp
+// ============
+// asynchronous asset file reads, batched through io_uring where available
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AssetIO.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// size of one read, and of each registered buffer
+	const uint32_t g_ChunkSize = 256 * 1024;
+	// number of registered buffers, which is also the number
+	// of reads in flight at the same time
+	const uint32_t g_RingBuffers = 16;
+	// files (or ranges) at least this large are read with O_DIRECT
+	const uint64_t g_DirectIOThreshold = 4 * 1024 * 1024;
+	// O_DIRECT offset, length and buffer alignment
+	const uint64_t g_DirectIOAlignment = 4096;
+	// files kept open on the ring at the same time
+	const size_t g_MaxOpenFiles = 32;
+	// request size meaning "to the end of the file"
+	const uint64_t g_WholeFile = ~0ull;
+}
+
+/***********************************************************
+ *  RING_STATE
+ *
+ *  The io_uring submission / completion rings mapped into
+ *  this process, and the registered read buffers.  Set up
+ *  with the raw system calls, so no extra library is needed.
+ ***********************************************************/
+#if defined(__linux__)
+struct AssetIO::RING_STATE
+{
+	int ringFD = -1;
+
+	// submission queue
+	void* sqMap = MAP_FAILED;
+	size_t sqMapSize = 0;
+	unsigned* sqTail = NULL;
+	unsigned* sqMask = NULL;
+	unsigned* sqArray = NULL;
+	io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+	size_t sqesSize = 0;
+
+	// completion queue
+	void* cqMap = MAP_FAILED;
+	size_t cqMapSize = 0;
+	unsigned* cqHead = NULL;
+	unsigned* cqTail = NULL;
+	unsigned* cqMask = NULL;
+	io_uring_cqe* cqes = NULL;
+
+	// read buffers, registered with the kernel when allowed
+	std::vector<unsigned char*> buffers;
+	bool bRegistered = false;
+
+	// entries queued but not yet taken by the kernel, and reads
+	// it took whose completion has not been popped
+	unsigned unsubmitted = 0;
+	unsigned inKernel = 0;
+
+	~RING_STATE()
+	{
+		if (bRegistered)
+		{
+			syscall(__NR_io_uring_register, ringFD, IORING_UNREGISTER_BUFFERS, NULL, 0);
+		}
+		for (unsigned char* buffer : buffers)
+		{
+			free(buffer);
+		}
+		if (sqes != MAP_FAILED)
+		{
+			munmap(sqes, sqesSize);
+		}
+		if ((cqMap != MAP_FAILED) && (cqMap != sqMap))
+		{
+			munmap(cqMap, cqMapSize);
+		}
+		if (sqMap != MAP_FAILED)
+		{
+			munmap(sqMap, sqMapSize);
+		}
+		if (ringFD >= 0)
+		{
+			close(ringFD);
+		}
+	}
+
+	// set up the rings, false if the kernel refuses
+	bool Create(unsigned entries)
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		ringFD = (int)syscall(__NR_io_uring_setup, entries, &params);
+		if (ringFD < 0)
+		{
+			return(false);
+		}
+
+		sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool bSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (bSingleMap)
+		{
+			sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+		}
+
+		sqMap = mmap(NULL, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_SQ_RING);
+		if (sqMap == MAP_FAILED)
+		{
+			return(false);
+		}
+		cqMap = bSingleMap ? sqMap : mmap(NULL, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_CQ_RING);
+		if (cqMap == MAP_FAILED)
+		{
+			return(false);
+		}
+		sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		sqes = (io_uring_sqe*)mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_SQES);
+		if (sqes == MAP_FAILED)
+		{
+			return(false);
+		}
+
+		char* sq = (char*)sqMap;
+		sqTail = (unsigned*)(sq + params.sq_off.tail);
+		sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+		sqArray = (unsigned*)(sq + params.sq_off.array);
+		char* cq = (char*)cqMap;
+		cqHead = (unsigned*)(cq + params.cq_off.head);
+		cqTail = (unsigned*)(cq + params.cq_off.tail);
+		cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+		cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+		// aligned buffers work for both buffered and O_DIRECT reads
+		std::vector<iovec> iovecs;
+		for (uint32_t i = 0; i < g_RingBuffers; i++)
+		{
+			unsigned char* buffer = (unsigned char*)aligned_alloc(g_DirectIOAlignment, g_ChunkSize);
+			if (NULL == buffer)
+			{
+				return(false);
+			}
+			buffers.push_back(buffer);
+			iovecs.push_back({ buffer, g_ChunkSize });
+		}
+		// pinning can fail on a low memlock limit, then the
+		// same buffers are used with plain reads
+		bRegistered = syscall(__NR_io_uring_register, ringFD, IORING_REGISTER_BUFFERS, iovecs.data(), (unsigned)iovecs.size()) == 0;
+
+		return(true);
+	}
+
+	// queue one read of a chunk into a buffer
+	void PrepareRead(int fd, uint32_t bufferIndex, uint64_t offset, uint32_t length)
+	{
+		unsigned tail = *sqTail;
+		unsigned index = tail & *sqMask;
+		io_uring_sqe* sqe = &sqes[index];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = bRegistered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+		sqe->fd = fd;
+		sqe->off = offset;
+		sqe->addr = (uint64_t)(uintptr_t)buffers[bufferIndex];
+		sqe->len = length;
+		sqe->buf_index = bRegistered ? (uint16_t)bufferIndex : 0;
+		sqe->user_data = bufferIndex;
+		sqArray[index] = index;
+		__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+		unsubmitted++;
+	}
+
+	// true when a completion is waiting to be popped
+	bool HasCompletion() const
+	{
+		return(*cqHead != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE));
+	}
+
+	// submit the queued reads and wait for at least one to finish.
+	// The kernel may take fewer entries than passed, the rest are
+	// submitted again.  When it is out of room (EAGAIN, EBUSY) with
+	// reads of its own still running, it returns once one of them
+	// finishes and the rest are submitted on the next call.  False
+	// when the ring is broken
+	bool SubmitAndWait()
+	{
+		bool bWaitOnly = false;
+		while (true)
+		{
+			long result = syscall(__NR_io_uring_enter, ringFD, bWaitOnly ? 0 : unsubmitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+			if (result < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				if (((errno == EAGAIN) || (errno == EBUSY)) && (inKernel > 0))
+				{
+					if (HasCompletion() || bWaitOnly)
+					{
+						return(HasCompletion());
+					}
+					bWaitOnly = true;
+					continue;
+				}
+				return(false);
+			}
+			if (bWaitOnly)
+			{
+				return(true);
+			}
+			unsubmitted -= (unsigned)result;
+			inKernel += (unsigned)result;
+			if (unsubmitted == 0)
+			{
+				return(true);
+			}
+			if (result == 0)
+			{
+				// nothing was taken, wait for a read to make room
+				if (inKernel == 0)
+				{
+					return(false);
+				}
+				bWaitOnly = true;
+			}
+		}
+	}
+
+	// wait for every read the kernel took and throw the results
+	// away, so the buffers are no longer written.  False if the
+	// kernel stopped answering first
+	bool Drain()
+	{
+		while (inKernel > 0)
+		{
+			uint64_t userData = 0;
+			int result = 0;
+			while (PopCompletion(userData, result) == true)
+			{
+			}
+			if (inKernel == 0)
+			{
+				break;
+			}
+			if ((syscall(__NR_io_uring_enter, ringFD, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) && (errno != EINTR))
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+
+	// get the next completion, false when there is none
+	bool PopCompletion(uint64_t& userData, int& result)
+	{
+		unsigned head = *cqHead;
+		if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+		{
+			return(false);
+		}
+		io_uring_cqe* cqe = &cqes[head & *cqMask];
+		userData = cqe->user_data;
+		result = cqe->res;
+		__atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+		inKernel--;
+		return(true);
+	}
+};
+#else
+struct AssetIO::RING_STATE
+{
+};
+#endif
+
+/***********************************************************
+ *  AssetIO()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AssetIO::AssetIO()
+{
+	m_pRing = NULL;
+	m_bStopIO = false;
+
+#if defined(__linux__)
+	RING_STATE* pRing = new RING_STATE();
+	if (pRing->Create(g_RingBuffers) == true)
+	{
+		m_pRing = pRing;
+	}
+	else
+	{
+		std::cout << "io_uring is not available, using blocking asset reads" << std::endl;
+		delete pRing;
+	}
+#endif
+
+	if (NULL != m_pRing)
+	{
+		m_ioThread = std::thread(&AssetIO::RingIOThread, this);
+	}
+	else
+	{
+		m_ioThread = std::thread(&AssetIO::BlockingIOThread, this);
+	}
+}
+
+/***********************************************************
+ *  ~AssetIO()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+AssetIO::~AssetIO()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopIO = true;
+	}
+	m_wakeIO.notify_all();
+	if (m_ioThread.joinable())
+	{
+		m_ioThread.join();
+	}
+	delete m_pRing;
+	m_pRing = NULL;
+}
+
+/***********************************************************
+ *  ReadAsync()
+ *
+ *  These methods are used for queueing a read.  The
+ *  callback runs on the I/O thread once the data is in
+ *  memory, so it should hand heavy work to another thread.
+ ***********************************************************/
+void AssetIO::ReadAsync(
+	const std::string& filename,
+	READ_CALLBACK onComplete)
+{
+	ReadAsync(filename, 0, g_WholeFile, onComplete);
+}
+
+void AssetIO::ReadAsync(
+	const std::string& filename,
+	uint64_t offset,
+	uint64_t size,
+	READ_CALLBACK onComplete)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back({ filename, offset, size, onComplete });
+	}
+	m_wakeIO.notify_all();
+}
+
+/***********************************************************
+ *  ReadFileRange()
+ *
+ *  This method is used for reading part of a file with
+ *  blocking calls.  A size of ~0 reads to the end.
+ ***********************************************************/
+bool AssetIO::ReadFileRange(
+	const std::string& filename,
+	uint64_t offset,
+	uint64_t size,
+	std::vector<unsigned char>& data)
+{
+	data.clear();
+
+	std::ifstream file(filename, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		return(false);
+	}
+	// ranges past the end of the file are cut short, as on the ring
+	file.seekg(0, std::ios::end);
+	uint64_t fileSize = (uint64_t)file.tellg();
+	if (fileSize < offset)
+	{
+		return(false);
+	}
+	size = std::min(size, fileSize - offset);
+
+	data.resize((size_t)size);
+	file.seekg((std::streamoff)offset);
+	file.read((char*)data.data(), (std::streamsize)size);
+	if (!file.good() && ((uint64_t)file.gcount() != size))
+	{
+		data.clear();
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  TakeRequests()
+ *
+ *  This method is used for moving every queued request to
+ *  the I/O thread.  It returns false once the object is
+ *  being destroyed and nothing is left in the queue.
+ ***********************************************************/
+bool AssetIO::TakeRequests(std::vector<READ_REQUEST>& requests, bool bWait)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (bWait)
+	{
+		m_wakeIO.wait(lock, [this] { return (m_bStopIO || !m_requests.empty()); });
+	}
+	if (m_requests.empty())
+	{
+		return(m_bStopIO == false);
+	}
+	for (READ_REQUEST& request : m_requests)
+	{
+		requests.push_back(std::move(request));
+	}
+	m_requests.clear();
+	return(true);
+}
+
+/***********************************************************
+ *  BlockingIOThread()
+ *
+ *  This method is the I/O thread when io_uring is not
+ *  available.  It reads the requests one at a time.
+ ***********************************************************/
+void AssetIO::BlockingIOThread()
+{
+	std::vector<READ_REQUEST> requests;
+	while (TakeRequests(requests, true) == true)
+	{
+		for (READ_REQUEST& request : requests)
+		{
+			std::vector<unsigned char> data;
+			ReadFileRange(request.filename, request.offset, request.size, data);
+			request.onComplete(data);
+		}
+		requests.clear();
+	}
+}
+
+/***********************************************************
+ *  RingIOThread()
+ *
+ *  This method is the I/O thread when io_uring is available.
+ *  Every file being read is split into chunk sized reads.
+ *  Each free buffer gets the next chunk (going round the
+ *  open files), all of them are submitted with one system
+ *  call, and finished chunks are copied out as they
+ *  complete.  A read the ring cannot finish, for example
+ *  O_DIRECT on a file system without support, is retried
+ *  with blocking calls.  If the ring itself fails, the reads
+ *  the kernel took are waited for and thrown away, the ring
+ *  is torn down and the thread carries on as the blocking
+ *  one.
+ ***********************************************************/
+void AssetIO::RingIOThread()
+{
+#if defined(__linux__)
+	// one file being read through the ring
+	struct OPEN_READ
+	{
+		READ_REQUEST request;
+		int fd;
+		uint64_t dataStart;		// first byte wanted
+		uint64_t dataSize;		// bytes wanted
+		uint64_t readEnd;		// end of the file range read
+		uint64_t nextOffset;	// next chunk to submit
+		int inFlight;
+		bool bFailed;
+		std::vector<unsigned char> data;
+	};
+	// what each buffer is currently reading
+	struct BUFFER_READ
+	{
+		OPEN_READ* pRead;
+		uint64_t offset;
+		uint32_t length;
+	};
+
+	std::deque<READ_REQUEST> waiting;
+	std::vector<std::unique_ptr<OPEN_READ>> active;
+	std::vector<BUFFER_READ> bufferReads(g_RingBuffers, { NULL, 0, 0 });
+	size_t nextActive = 0;
+	bool bStopping = false;
+
+	while (true)
+	{
+		// only block for new requests when there is nothing to do
+		std::vector<READ_REQUEST> incoming;
+		bool bIdle = active.empty() && waiting.empty();
+		if (TakeRequests(incoming, bIdle && !bStopping) == false)
+		{
+			bStopping = true;
+		}
+		for (READ_REQUEST& request : incoming)
+		{
+			waiting.push_back(std::move(request));
+		}
+		if (bStopping && active.empty() && waiting.empty())
+		{
+			return;
+		}
+
+		// open the next files
+		while ((active.size() < g_MaxOpenFiles) && !waiting.empty())
+		{
+			std::unique_ptr<OPEN_READ> pRead(new OPEN_READ());
+			pRead->request = std::move(waiting.front());
+			waiting.pop_front();
+			pRead->inFlight = 0;
+			pRead->bFailed = false;
+
+			struct stat fileInfo;
+			pRead->fd = open(pRead->request.filename.c_str(), O_RDONLY | O_CLOEXEC);
+			if ((pRead->fd < 0) || (fstat(pRead->fd, &fileInfo) != 0) || ((uint64_t)fileInfo.st_size < pRead->request.offset))
+			{
+				if (pRead->fd >= 0)
+				{
+					close(pRead->fd);
+				}
+				std::vector<unsigned char> none;
+				pRead->request.onComplete(none);
+				continue;
+			}
+
+			uint64_t fileSize = (uint64_t)fileInfo.st_size;
+			pRead->dataStart = pRead->request.offset;
+			pRead->dataSize = std::min(pRead->request.size, fileSize - pRead->dataStart);
+			pRead->nextOffset = pRead->dataStart;
+			pRead->readEnd = pRead->dataStart + pRead->dataSize;
+
+			// large reads skip the page cache, which needs aligned reads
+			if (pRead->dataSize >= g_DirectIOThreshold)
+			{
+				int directFD = open(pRead->request.filename.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+				if (directFD >= 0)
+				{
+					close(pRead->fd);
+					pRead->fd = directFD;
+					pRead->nextOffset = pRead->dataStart & ~(g_DirectIOAlignment - 1);
+					pRead->readEnd = (pRead->readEnd + g_DirectIOAlignment - 1) & ~(g_DirectIOAlignment - 1);
+				}
+			}
+
+			pRead->data.resize((size_t)pRead->dataSize);
+			active.push_back(std::move(pRead));
+		}
+
+		// give every free buffer the next chunk, round the open files
+		for (uint32_t buffer = 0; (buffer < g_RingBuffers) && !active.empty(); buffer++)
+		{
+			if (NULL != bufferReads[buffer].pRead)
+			{
+				continue;
+			}
+			OPEN_READ* pRead = NULL;
+			for (size_t tries = 0; (tries < active.size()) && (NULL == pRead); tries++)
+			{
+				OPEN_READ* pCandidate = active[(nextActive + tries) % active.size()].get();
+				if (!pCandidate->bFailed && (pCandidate->nextOffset < pCandidate->readEnd))
+				{
+					pRead = pCandidate;
+					nextActive = (nextActive + tries + 1) % active.size();
+				}
+			}
+			if (NULL == pRead)
+			{
+				break;
+			}
+
+			uint32_t length = (uint32_t)std::min<uint64_t>(g_ChunkSize, pRead->readEnd - pRead->nextOffset);
+			bufferReads[buffer] = { pRead, pRead->nextOffset, length };
+			m_pRing->PrepareRead(pRead->fd, buffer, pRead->nextOffset, length);
+			pRead->nextOffset += length;
+			pRead->inFlight++;
+		}
+
+		bool bAnyInFlight = false;
+		for (const BUFFER_READ& bufferRead : bufferReads)
+		{
+			bAnyInFlight = bAnyInFlight || (NULL != bufferRead.pRead);
+		}
+
+		if (bAnyInFlight)
+		{
+			if (m_pRing->SubmitAndWait() == false)
+			{
+				// the ring is broken: once the kernel is done with
+				// the buffers, finish everything with blocking reads.
+				// The kernel may still write the buffers of a ring
+				// that could not be drained, so that one is leaked
+				std::cout << "Asset I/O ring failed, reading with blocking calls" << std::endl;
+				RING_STATE* pRing = m_pRing;
+				m_pRing = NULL;
+				if (pRing->Drain() == true)
+				{
+					delete pRing;
+				}
+
+				for (std::unique_ptr<OPEN_READ>& pRead : active)
+				{
+					close(pRead->fd);
+					ReadFileRange(pRead->request.filename, pRead->request.offset, pRead->request.size, pRead->data);
+					pRead->request.onComplete(pRead->data);
+				}
+				active.clear();
+				for (READ_REQUEST& request : waiting)
+				{
+					std::vector<unsigned char> data;
+					ReadFileRange(request.filename, request.offset, request.size, data);
+					request.onComplete(data);
+				}
+				waiting.clear();
+				BlockingIOThread();
+				return;
+			}
+
+			uint64_t userData = 0;
+			int result = 0;
+			while (m_pRing->PopCompletion(userData, result) == true)
+			{
+				BUFFER_READ& bufferRead = bufferReads[(size_t)userData];
+				OPEN_READ* pRead = bufferRead.pRead;
+				if (NULL == pRead)
+				{
+					continue;
+				}
+				pRead->inFlight--;
+
+				// copy the part of the chunk inside the wanted range
+				uint64_t chunkEnd = bufferRead.offset + (uint64_t)std::max(result, 0);
+				uint64_t copyStart = std::max(bufferRead.offset, pRead->dataStart);
+				uint64_t copyEnd = std::min(chunkEnd, pRead->dataStart + pRead->dataSize);
+				if (result < 0)
+				{
+					pRead->bFailed = true;
+				}
+				else if (copyEnd > copyStart)
+				{
+					memcpy(
+						pRead->data.data() + (copyStart - pRead->dataStart),
+						m_pRing->buffers[(size_t)userData] + (copyStart - bufferRead.offset),
+						(size_t)(copyEnd - copyStart));
+				}
+				// a short read before the end of the range is retried the slow way
+				if ((result >= 0) && ((uint32_t)result < bufferRead.length) && (chunkEnd < pRead->dataStart + pRead->dataSize))
+				{
+					pRead->bFailed = true;
+				}
+				bufferRead = { NULL, 0, 0 };
+			}
+		}
+
+		// hand back every read with nothing left in flight
+		for (size_t i = 0; i < active.size();)
+		{
+			OPEN_READ* pRead = active[i].get();
+			bool bDone = (pRead->inFlight == 0) && (pRead->bFailed || (pRead->nextOffset >= pRead->readEnd));
+			if (!bDone)
+			{
+				i++;
+				continue;
+			}
+			close(pRead->fd);
+			if (pRead->bFailed)
+			{
+				ReadFileRange(pRead->request.filename, pRead->request.offset, pRead->request.size, pRead->data);
+			}
+			pRead->request.onComplete(pRead->data);
+			active.erase(active.begin() + i);
+		}
+	}
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetio.h
+// ============
+// asynchronous asset file reads, batched through io_uring where available
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  AssetIO
+ *
+ *  This class reads whole files, or byte ranges of packed
+ *  files, on its own I/O thread and calls back when the data
+ *  is in memory.  On Linux the reads are queued on an
+ *  io_uring: every request waiting at the same time goes out
+ *  in one submission, the reads land in registered (pinned)
+ *  buffers, and large files are opened with O_DIRECT so they
+ *  bypass the page cache.  Elsewhere, or when the kernel
+ *  refuses io_uring, the I/O thread reads with plain blocking
+ *  calls instead, behind the same API.
+ ***********************************************************/
+class AssetIO
+{
+public:
+	// constructor
+	AssetIO();
+	// destructor, waits for the reads already queued
+	~AssetIO();
+
+	// called on the I/O thread with the data, empty on failure
+	typedef std::function<void(std::vector<unsigned char>& data)> READ_CALLBACK;
+
+	// read a whole file
+	void ReadAsync(
+		const std::string& filename,
+		READ_CALLBACK onComplete);
+	// read size bytes starting at offset
+	void ReadAsync(
+		const std::string& filename,
+		uint64_t offset,
+		uint64_t size,
+		READ_CALLBACK onComplete);
+
+	// true when the reads go through io_uring
+	bool IsUsingIOUring() const { return (m_pRing != NULL); }
+
+	// synchronous read used when io_uring is not available
+	static bool ReadFileRange(
+		const std::string& filename,
+		uint64_t offset,
+		uint64_t size,
+		std::vector<unsigned char>& data);
+
+private:
+	// a queued read, size ~0 means the whole file
+	struct READ_REQUEST
+	{
+		std::string filename;
+		uint64_t offset;
+		uint64_t size;
+		READ_CALLBACK onComplete;
+	};
+
+	// io_uring state, only defined on Linux
+	struct RING_STATE;
+	RING_STATE* m_pRing;
+
+	std::thread m_ioThread;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeIO;
+	std::deque<READ_REQUEST> m_requests;
+	bool m_bStopIO;
+
+	// I/O thread main loops
+	void BlockingIOThread();
+	void RingIOThread();
+	// take every queued request, waiting for one when bWait is set
+	bool TakeRequests(std::vector<READ_REQUEST>& requests, bool bWait);
+};
\ No newline at end of file
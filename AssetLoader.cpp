@@ -0,0 +1,211 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetloader.cpp
+// ============
+// coroutine based asset loading: file reads and decoding on a worker pool,
+// GL uploads on the GL thread
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AssetLoader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+/***********************************************************
+ *  AssetLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AssetLoader::AssetLoader(AssetIO* pAssetIO, int workerCount)
+{
+	m_pAssetIO = pAssetIO;
+	m_bStopWorkers = false;
+	m_uploadsPerPump = 4;
+
+	if (workerCount <= 0)
+	{
+		// leave one hardware thread for the GL thread
+		workerCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+	}
+	for (int i = 0; i < workerCount; i++)
+	{
+		m_workers.push_back(std::thread(&AssetLoader::WorkerThread, this));
+	}
+}
+
+/***********************************************************
+ *  ~AssetLoader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_workMutex);
+		m_bStopWorkers = true;
+	}
+	m_workCondition.notify_all();
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+}
+
+/***********************************************************
+ *  DetachAssetIO()
+ *
+ *  This method is used for letting the asset I/O backend be
+ *  destroyed before the loader.  Once it returns no read is
+ *  queued on the backend any more; the reads it already has
+ *  still call back into the loader, so the backend must be
+ *  destroyed (which waits for them) before the loader is.
+ ***********************************************************/
+void AssetLoader::DetachAssetIO()
+{
+	std::lock_guard<std::mutex> lock(m_assetIOMutex);
+	m_pAssetIO = NULL;
+}
+
+/***********************************************************
+ *  WorkerThread()
+ *
+ *  This method is the main loop of the worker threads.  It
+ *  runs queued jobs until the loader is destroyed.
+ ***********************************************************/
+void AssetLoader::WorkerThread()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_workMutex);
+			m_workCondition.wait(lock, [this] { return (m_bStopWorkers || !m_workQueue.empty()); });
+			if (m_workQueue.empty())
+			{
+				return;
+			}
+			job = std::move(m_workQueue.front());
+			m_workQueue.pop_front();
+		}
+		job();
+	}
+}
+
+/***********************************************************
+ *  PostWork()
+ *
+ *  This method is used for queueing a job for the workers.
+ ***********************************************************/
+void AssetLoader::PostWork(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_workMutex);
+		m_workQueue.push_back(std::move(job));
+	}
+	m_workCondition.notify_one();
+}
+
+/***********************************************************
+ *  PostGLWork()
+ *
+ *  This method is used for queueing a suspended coroutine
+ *  to be resumed on the GL thread.
+ ***********************************************************/
+void AssetLoader::PostGLWork(std::coroutine_handle<> handle)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_glMutex);
+		m_glQueue.push_back(handle);
+	}
+	m_glCondition.notify_all();
+}
+
+/***********************************************************
+ *  WaitForGLWork()
+ *
+ *  This method is used for blocking the GL thread until a
+ *  coroutine is waiting for it or the root task finished.
+ ***********************************************************/
+void AssetLoader::WaitForGLWork(const std::atomic<bool>& bDone)
+{
+	std::unique_lock<std::mutex> lock(m_glMutex);
+	m_glCondition.wait(lock, [this, &bDone] { return (bDone || !m_glQueue.empty()); });
+}
+
+/***********************************************************
+ *  PumpGLThread()
+ *
+ *  This method is used for resuming the coroutines waiting
+ *  for the GL thread, at most m_uploadsPerPump of them, so
+ *  uploads can also be spread over frames.
+ ***********************************************************/
+void AssetLoader::PumpGLThread()
+{
+	for (int i = 0; i < m_uploadsPerPump; i++)
+	{
+		std::coroutine_handle<> handle;
+		{
+			std::lock_guard<std::mutex> lock(m_glMutex);
+			if (m_glQueue.empty())
+			{
+				return;
+			}
+			handle = m_glQueue.front();
+			m_glQueue.pop_front();
+		}
+		handle.resume();
+	}
+}
+
+/***********************************************************
+ *  READ_FILE_AWAITER::await_suspend()
+ *
+ *  Read the whole file, through the asset I/O backend when
+ *  there is one, then resume the waiting coroutine on a
+ *  worker.  A missing file gives empty data.
+ ***********************************************************/
+void AssetLoader::READ_FILE_AWAITER::await_suspend(std::coroutine_handle<> handle)
+{
+	{
+		std::lock_guard<std::mutex> lock(pLoader->m_assetIOMutex);
+		if (NULL != pLoader->m_pAssetIO)
+		{
+			AssetLoader* pOwner = pLoader;
+			pLoader->m_pAssetIO->ReadAsync(filename, [this, pOwner, handle](std::vector<unsigned char>& fileData)
+			{
+				// keep the I/O thread free, resume on the worker pool
+				data = std::move(fileData);
+				pOwner->PostWork([handle]() { handle.resume(); });
+			});
+			return;
+		}
+	}
+
+	pLoader->PostWork([this, handle]()
+	{
+		std::ifstream file(filename, std::ios::in | std::ios::binary);
+		if (file.is_open())
+		{
+			data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+		handle.resume();
+	});
+}
+
+/***********************************************************
+ *  WORKER_AWAITER::await_suspend()
+ ***********************************************************/
+void AssetLoader::WORKER_AWAITER::await_suspend(std::coroutine_handle<> handle)
+{
+	pLoader->PostWork([handle]() { handle.resume(); });
+}
+
+/***********************************************************
+ *  GL_THREAD_AWAITER::await_suspend()
+ ***********************************************************/
+void AssetLoader::GL_THREAD_AWAITER::await_suspend(std::coroutine_handle<> handle)
+{
+	pLoader->PostGLWork(handle);
+}
\ No newline at end of file
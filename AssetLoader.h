@@ -0,0 +1,296 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetloader.h
+// ============
+// coroutine based asset loading: file reads and decoding on a worker pool,
+// GL uploads on the GL thread
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "AssetIO.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/***********************************************************
+ *  AssetLoader
+ *
+ *  Each asset is loaded by a coroutine returning a Task<>.
+ *  Inside it, co_await ReadFile() reads a file on a worker
+ *  thread, co_await ResumeOnWorker() moves decoding onto the
+ *  worker pool and co_await ResumeOnGLThread() waits for an
+ *  upload slot on the GL thread.  Dependencies are written
+ *  as co_await on other tasks, or on WhenAll() to let many
+ *  of them run at the same time.
+ *
+ *  A coroutine resumes on whichever thread finished what it
+ *  was waiting for, so GL calls must always come right after
+ *  co_await ResumeOnGLThread().
+ ***********************************************************/
+class AssetLoader
+{
+public:
+	// constructor, file reads go through pAssetIO when passed,
+	// 0 workers picks one per spare hardware thread
+	AssetLoader(AssetIO* pAssetIO = NULL, int workerCount = 0);
+	// destructor
+	~AssetLoader();
+
+	// stop reading through the asset I/O backend, reads started
+	// after this run on the workers; call before destroying it
+	void DetachAssetIO();
+
+	/***********************************************************
+	 *  Task
+	 *
+	 *  A lazily started coroutine producing a value of type T.
+	 *  It starts when first awaited (or passed to Run()), and
+	 *  resumes its awaiter when it finishes.
+	 ***********************************************************/
+	template <typename T>
+	class Task
+	{
+	public:
+		struct promise_type
+		{
+			T value = T();
+			std::coroutine_handle<> continuation;
+
+			Task get_return_object()
+			{
+				return(Task(std::coroutine_handle<promise_type>::from_promise(*this)));
+			}
+			std::suspend_always initial_suspend() noexcept { return {}; }
+
+			// hand control straight back to the awaiting coroutine
+			struct FinalAwaiter
+			{
+				bool await_ready() noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+				{
+					std::coroutine_handle<> continuation = handle.promise().continuation;
+					if (continuation)
+					{
+						return(continuation);
+					}
+					return(std::noop_coroutine());
+				}
+				void await_resume() noexcept {}
+			};
+			FinalAwaiter final_suspend() noexcept { return {}; }
+
+			void return_value(T result) { value = std::move(result); }
+			void unhandled_exception() { std::abort(); }
+		};
+
+		Task() : m_handle(nullptr) {}
+		Task(Task&& other) noexcept : m_handle(other.m_handle) { other.m_handle = nullptr; }
+		Task& operator=(Task&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (m_handle)
+				{
+					m_handle.destroy();
+				}
+				m_handle = other.m_handle;
+				other.m_handle = nullptr;
+			}
+			return(*this);
+		}
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+		~Task()
+		{
+			if (m_handle)
+			{
+				m_handle.destroy();
+			}
+		}
+
+		// awaiting a task starts it and resumes when it is done
+		struct AWAITER
+		{
+			std::coroutine_handle<promise_type> handle;
+
+			bool await_ready() const noexcept { return (!handle || handle.done()); }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+			{
+				handle.promise().continuation = awaiting;
+				return(handle);
+			}
+			T await_resume() { return std::move(handle.promise().value); }
+		};
+		AWAITER operator co_await() const noexcept { return AWAITER{ m_handle }; }
+
+	private:
+		explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+		std::coroutine_handle<promise_type> m_handle;
+	};
+
+	// a coroutine that starts at once and frees itself when done
+	struct DETACHED_TASK
+	{
+		struct promise_type
+		{
+			DETACHED_TASK get_return_object() { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::abort(); }
+		};
+	};
+
+	// awaitable that reads a whole file on a worker thread
+	struct READ_FILE_AWAITER
+	{
+		AssetLoader* pLoader;
+		std::string filename;
+		std::vector<unsigned char> data;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		std::vector<unsigned char> await_resume() { return std::move(data); }
+	};
+
+	// awaitable that continues on a worker thread
+	struct WORKER_AWAITER
+	{
+		AssetLoader* pLoader;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const noexcept {}
+	};
+
+	// awaitable that continues on the GL thread in an upload slot
+	struct GL_THREAD_AWAITER
+	{
+		AssetLoader* pLoader;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const noexcept {}
+	};
+
+	// awaitable that runs several tasks at once and collects the results
+	template <typename T>
+	struct WHEN_ALL_AWAITER
+	{
+		std::vector<Task<T>>& tasks;
+		std::vector<T> results;
+		std::atomic<size_t> remaining;
+		std::coroutine_handle<> continuation;
+
+		WHEN_ALL_AWAITER(std::vector<Task<T>>& allTasks) : tasks(allTasks), results(allTasks.size()), remaining(0) {}
+
+		bool await_ready() const noexcept { return tasks.empty(); }
+		bool await_suspend(std::coroutine_handle<> handle)
+		{
+			// one extra count so nothing resumes us before every task is started
+			continuation = handle;
+			remaining = tasks.size() + 1;
+			for (size_t i = 0; i < tasks.size(); i++)
+			{
+				AwaitOne(i);
+			}
+			return(remaining.fetch_sub(1) != 1);
+		}
+		std::vector<T> await_resume() { return std::move(results); }
+
+	private:
+		DETACHED_TASK AwaitOne(size_t index)
+		{
+			results[index] = co_await tasks[index];
+			if (remaining.fetch_sub(1) == 1)
+			{
+				continuation.resume();
+			}
+		}
+	};
+
+	// read a file on a worker thread, resumes on that worker
+	READ_FILE_AWAITER ReadFile(std::string filename) { return READ_FILE_AWAITER{ this, std::move(filename), {} }; }
+	// continue the calling coroutine on the worker pool
+	WORKER_AWAITER ResumeOnWorker() { return WORKER_AWAITER{ this }; }
+	// continue the calling coroutine on the GL thread
+	GL_THREAD_AWAITER ResumeOnGLThread() { return GL_THREAD_AWAITER{ this }; }
+	// start every task and resume once they have all finished
+	template <typename T>
+	WHEN_ALL_AWAITER<T> WhenAll(std::vector<Task<T>>& tasks) { return WHEN_ALL_AWAITER<T>(tasks); }
+
+	/***********************************************************
+	 *  Run()
+	 *
+	 *  Start a task from the GL thread and service the GL
+	 *  thread queue until the task has finished.
+	 ***********************************************************/
+	template <typename T>
+	T Run(Task<T> task)
+	{
+		T result = T();
+		std::atomic<bool> bDone(false);
+		RunRoot(task, result, bDone);
+		while (bDone == false)
+		{
+			WaitForGLWork(bDone);
+			PumpGLThread();
+		}
+		return(result);
+	}
+
+	// resume up to the per-pump number of coroutines waiting for the GL thread
+	void PumpGLThread();
+	// the most GL uploads resumed by one PumpGLThread() call
+	void SetUploadsPerPump(int uploads) { m_uploadsPerPump = uploads; }
+
+private:
+	// asynchronous file reads, NULL to read on the workers,
+	// guarded by m_assetIOMutex
+	AssetIO* m_pAssetIO;
+	std::mutex m_assetIOMutex;
+
+	// worker pool
+	std::vector<std::thread> m_workers;
+	std::mutex m_workMutex;
+	std::condition_variable m_workCondition;
+	std::deque<std::function<void()>> m_workQueue;
+	bool m_bStopWorkers;
+
+	// coroutines waiting for the GL thread
+	std::mutex m_glMutex;
+	std::condition_variable m_glCondition;
+	std::deque<std::coroutine_handle<>> m_glQueue;
+	int m_uploadsPerPump;
+
+	// worker thread main loop
+	void WorkerThread();
+	// queue a job for the worker pool
+	void PostWork(std::function<void()> job);
+	// queue a coroutine for the GL thread
+	void PostGLWork(std::coroutine_handle<> handle);
+	// block until the GL queue has work or the root task is done
+	void WaitForGLWork(const std::atomic<bool>& bDone);
+
+	template <typename T>
+	DETACHED_TASK RunRoot(Task<T>& task, T& result, std::atomic<bool>& bDone)
+	{
+		result = co_await task;
+		{
+			std::lock_guard<std::mutex> lock(m_glMutex);
+			bDone = true;
+		}
+		m_glCondition.notify_all();
+	}
+};
\ No newline at end of file
@@ -0,0 +1,703 @@
+///////////////////////////////////////////////////////////////////////////////
+// deriveddatacache.cpp
+// ============
+// content-addressed on-disk cache for cooked asset data
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DerivedDataCache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	const char g_IndexMagic[4] = { 'D', 'D', 'C', 'I' };
+	const char g_EntryMagic[4] = { 'D', 'D', 'C', 'E' };
+	const uint32_t g_FormatVersion = 1;
+	// index slots, a power of two, kept at most 3/4 full
+	const uint32_t g_IndexCapacity = 16384;
+	const char* g_IndexFileName = "index.bin";
+	const char* g_EntryExtension = ".ddc";
+
+	// header in front of the data of every entry file
+	struct ENTRY_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t high;
+		uint64_t low;
+		uint64_t size;
+		uint64_t checksum;
+	};
+
+	// used to give every temporary file a distinct name
+	std::atomic<uint64_t> g_TempFileCounter(0);
+}
+
+// header of the index file
+struct DerivedDataCache::INDEX_HEADER
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t count;
+	uint64_t totalBytes;
+	uint64_t useClock;		// increases on every access, for LRU order
+	uint32_t bOpen;			// still set when the last run did not close the cache
+	uint32_t reserved[7];
+};
+
+// one slot of the index, a zero key marks an empty slot
+struct DerivedDataCache::INDEX_ENTRY
+{
+	uint64_t high;
+	uint64_t low;
+	uint64_t size;
+	uint64_t lastUse;
+};
+
+/***********************************************************
+ *  MAPPED_FILE
+ *
+ *  A file mapped read / write into memory, so index updates
+ *  are plain memory writes that the OS writes back.
+ ***********************************************************/
+#if defined(_WIN32)
+struct DerivedDataCache::MAPPED_FILE
+{
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	void* pData = NULL;
+	size_t size = 0;
+
+	bool Open(const std::string& path, size_t mapSize)
+	{
+		file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+			NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return(false);
+		}
+		// mapping a larger size than the file grows it
+		mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)mapSize >> 32), (DWORD)mapSize, NULL);
+		if (mapping == NULL)
+		{
+			return(false);
+		}
+		pData = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, mapSize);
+		size = mapSize;
+		return(pData != NULL);
+	}
+
+	void Flush()
+	{
+		if (pData != NULL)
+		{
+			FlushViewOfFile(pData, size);
+		}
+	}
+
+	~MAPPED_FILE()
+	{
+		if (pData != NULL)
+		{
+			UnmapViewOfFile(pData);
+		}
+		if (mapping != NULL)
+		{
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file);
+		}
+	}
+};
+#else
+struct DerivedDataCache::MAPPED_FILE
+{
+	int fd = -1;
+	void* pData = NULL;
+	size_t size = 0;
+
+	bool Open(const std::string& path, size_t mapSize)
+	{
+		fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd < 0)
+		{
+			return(false);
+		}
+		struct stat fileStat;
+		if ((fstat(fd, &fileStat) != 0) ||
+			(((size_t)fileStat.st_size != mapSize) && (ftruncate(fd, (off_t)mapSize) != 0)))
+		{
+			return(false);
+		}
+		void* pMapped = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (pMapped == MAP_FAILED)
+		{
+			return(false);
+		}
+		pData = pMapped;
+		size = mapSize;
+		return(true);
+	}
+
+	void Flush()
+	{
+		if (pData != NULL)
+		{
+			msync(pData, size, MS_SYNC);
+		}
+	}
+
+	~MAPPED_FILE()
+	{
+		if (pData != NULL)
+		{
+			munmap(pData, size);
+		}
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+};
+#endif
+
+/***********************************************************
+ *  DerivedDataCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DerivedDataCache::DerivedDataCache()
+{
+	m_pIndex = NULL;
+	m_pHeader = NULL;
+	m_pEntries = NULL;
+	m_maxBytes = 0;
+}
+
+/***********************************************************
+ *  ~DerivedDataCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DerivedDataCache::~DerivedDataCache()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Hash()
+ *
+ *  This method is used for hashing a byte range with the
+ *  64 bit MurmurHash2 (MurmurHash64A) function.
+ ***********************************************************/
+uint64_t DerivedDataCache::Hash(const void* data, size_t size, uint64_t seed)
+{
+	const uint64_t m = 0xc6a4a7935bd1e995ull;
+	const int r = 47;
+
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t h = seed ^ (size * m);
+
+	size_t blocks = size / 8;
+	for (size_t i = 0; i < blocks; i++)
+	{
+		uint64_t k;
+		memcpy(&k, bytes + i * 8, sizeof(k));
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+
+	const unsigned char* tail = bytes + blocks * 8;
+	switch (size & 7)
+	{
+	case 7: h ^= (uint64_t)tail[6] << 48; [[fallthrough]];
+	case 6: h ^= (uint64_t)tail[5] << 40; [[fallthrough]];
+	case 5: h ^= (uint64_t)tail[4] << 32; [[fallthrough]];
+	case 4: h ^= (uint64_t)tail[3] << 24; [[fallthrough]];
+	case 3: h ^= (uint64_t)tail[2] << 16; [[fallthrough]];
+	case 2: h ^= (uint64_t)tail[1] << 8; [[fallthrough]];
+	case 1: h ^= (uint64_t)tail[0];
+		h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return(h);
+}
+
+/***********************************************************
+ *  KeyBuilder()
+ *
+ *  The constructor for the key builder.  The two halves of
+ *  the key are hashed with different seeds.
+ ***********************************************************/
+DerivedDataCache::KeyBuilder::KeyBuilder(const char* cookerName, uint32_t cookerVersion)
+{
+	m_high = 0x9e3779b97f4a7c15ull;
+	m_low = 0xc2b2ae3d27d4eb4full;
+	Add(cookerName, strlen(cookerName));
+	AddValue(cookerVersion);
+}
+
+/***********************************************************
+ *  KeyBuilder::Add()
+ *
+ *  This method is used for folding more input bytes into
+ *  the key.  The length goes into the hash as well, so the
+ *  split between inputs is part of the key.
+ ***********************************************************/
+DerivedDataCache::KeyBuilder& DerivedDataCache::KeyBuilder::Add(const void* data, size_t size)
+{
+	m_high = Hash(data, size, m_high);
+	m_low = Hash(data, size, m_low ^ 0x165667b19e3779f9ull);
+	return(*this);
+}
+
+/***********************************************************
+ *  KeyBuilder::GetKey()
+ ***********************************************************/
+DerivedDataCache::CACHE_KEY DerivedDataCache::KeyBuilder::GetKey() const
+{
+	CACHE_KEY key = { m_high, m_low };
+	// the zero key marks empty index slots
+	if ((key.high == 0) && (key.low == 0))
+	{
+		key.low = 1;
+	}
+	return(key);
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for opening the cache in the passed
+ *  in directory and mapping its index.  An index that is
+ *  missing or from another format is started over, and one
+ *  left open by a crashed run is rebuilt from the entries.
+ ***********************************************************/
+bool DerivedDataCache::Open(const std::string& directory, uint64_t maxBytes)
+{
+	Close();
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	size_t indexSize = sizeof(INDEX_HEADER) + sizeof(INDEX_ENTRY) * g_IndexCapacity;
+	MAPPED_FILE* pIndex = new MAPPED_FILE();
+	if (pIndex->Open((std::filesystem::path(directory) / g_IndexFileName).string(), indexSize) == false)
+	{
+		std::cout << "Could not open the derived data cache in:" << directory << std::endl;
+		delete pIndex;
+		return(false);
+	}
+
+	m_pIndex = pIndex;
+	m_pHeader = (INDEX_HEADER*)pIndex->pData;
+	m_pEntries = (INDEX_ENTRY*)(m_pHeader + 1);
+	m_directory = directory;
+	m_maxBytes = maxBytes;
+
+	bool bValid = (memcmp(m_pHeader->magic, g_IndexMagic, 4) == 0) &&
+		(m_pHeader->version == g_FormatVersion) &&
+		(m_pHeader->capacity == g_IndexCapacity);
+	if ((bValid == false) || (m_pHeader->bOpen != 0))
+	{
+		RebuildIndex();
+	}
+	m_pHeader->bOpen = 1;
+	m_pIndex->Flush();
+
+	EvictEntries(CACHE_KEY{ 0, 0 });
+
+	std::cout << "Derived data cache:" << directory << ", entries:" << m_pHeader->count << ", bytes:" << m_pHeader->totalBytes << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for writing back the index and
+ *  unmapping it.
+ ***********************************************************/
+void DerivedDataCache::Close()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_pIndex == NULL)
+	{
+		return;
+	}
+
+	m_pHeader->bOpen = 0;
+	m_pIndex->Flush();
+	delete m_pIndex;
+	m_pIndex = NULL;
+	m_pHeader = NULL;
+	m_pEntries = NULL;
+}
+
+/***********************************************************
+ *  RebuildIndex()
+ *
+ *  This method is used for starting the index over from
+ *  the entry files found in the cache directory.  Each
+ *  entry file names its own key and size in its header.
+ ***********************************************************/
+void DerivedDataCache::RebuildIndex()
+{
+	memset(m_pHeader, 0, sizeof(INDEX_HEADER) + sizeof(INDEX_ENTRY) * g_IndexCapacity);
+	memcpy(m_pHeader->magic, g_IndexMagic, 4);
+	m_pHeader->version = g_FormatVersion;
+	m_pHeader->capacity = g_IndexCapacity;
+
+	std::error_code error;
+	for (auto it = std::filesystem::recursive_directory_iterator(m_directory, error);
+		it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+	{
+		if (error || !it->is_regular_file(error) || (it->path().extension() != g_EntryExtension))
+		{
+			continue;
+		}
+
+		ENTRY_HEADER header;
+		std::ifstream file(it->path(), std::ios::in | std::ios::binary);
+		file.read((char*)&header, sizeof(header));
+		if (file.good() &&
+			(memcmp(header.magic, g_EntryMagic, 4) == 0) &&
+			(header.version == g_FormatVersion) &&
+			(FindEntry(CACHE_KEY{ header.high, header.low }) == NULL) &&
+			(m_pHeader->count < g_IndexCapacity / 4 * 3))
+		{
+			InsertEntry(CACHE_KEY{ header.high, header.low }, header.size);
+		}
+	}
+}
+
+/***********************************************************
+ *  Get()
+ *
+ *  This method is used for reading a cached entry.  The
+ *  file is read and checked outside the lock; an entry file
+ *  the index did not know about (written by an older index)
+ *  is adopted, and a damaged one is deleted.  The size in
+ *  the header is checked against the file's length before
+ *  any memory is allocated for the data.
+ ***********************************************************/
+bool DerivedDataCache::Get(const CACHE_KEY& key, std::vector<unsigned char>& data)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_pIndex == NULL)
+		{
+			return(false);
+		}
+	}
+
+	std::string path = GetEntryPath(key);
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		INDEX_ENTRY* pEntry = (m_pIndex != NULL) ? FindEntry(key) : NULL;
+		if (pEntry != NULL)
+		{
+			RemoveEntry(pEntry);
+		}
+		return(false);
+	}
+
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	ENTRY_HEADER header;
+	file.read((char*)&header, sizeof(header));
+	bool bValid = file.good() &&
+		(memcmp(header.magic, g_EntryMagic, 4) == 0) &&
+		(header.version == g_FormatVersion) &&
+		(header.high == key.high) &&
+		(header.low == key.low) &&
+		(fileSize >= (std::streamoff)sizeof(header)) &&
+		(header.size == (uint64_t)(fileSize - (std::streamoff)sizeof(header)));
+	if (bValid)
+	{
+		data.resize((size_t)header.size);
+		file.read((char*)data.data(), data.size());
+		bValid = file.good() && (Hash(data.data(), data.size(), key.low) == header.checksum);
+	}
+	file.close();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_pIndex == NULL)
+	{
+		return(false);
+	}
+
+	INDEX_ENTRY* pEntry = FindEntry(key);
+	if (bValid == false)
+	{
+		std::cout << "Derived data cache entry is damaged:" << path << std::endl;
+		data.clear();
+		if (pEntry != NULL)
+		{
+			RemoveEntry(pEntry);
+		}
+		std::error_code error;
+		std::filesystem::remove(path, error);
+		return(false);
+	}
+
+	if (pEntry == NULL)
+	{
+		pEntry = InsertEntry(key, header.size);
+	}
+	pEntry->lastUse = ++m_pHeader->useClock;
+	EvictEntries(key);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Put()
+ *
+ *  This method is used for storing an entry.  The data is
+ *  written to a temporary file that is then renamed over
+ *  the entry's name, so readers see either the old entry,
+ *  the new one or none, never a partial file.
+ ***********************************************************/
+bool DerivedDataCache::Put(const CACHE_KEY& key, const void* data, size_t size)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_pIndex == NULL)
+		{
+			return(false);
+		}
+	}
+
+	std::filesystem::path path = GetEntryPath(key);
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+
+	std::filesystem::path tempPath = path;
+	tempPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) +
+		"." + std::to_string(g_TempFileCounter++) + ".tmp";
+
+	ENTRY_HEADER header;
+	memcpy(header.magic, g_EntryMagic, 4);
+	header.version = g_FormatVersion;
+	header.high = key.high;
+	header.low = key.low;
+	header.size = size;
+	header.checksum = Hash(data, size, key.low);
+
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)data, size);
+		file.close();
+		if (!file.good())
+		{
+			std::filesystem::remove(tempPath, error);
+			return(false);
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return(false);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_pIndex == NULL)
+	{
+		return(false);
+	}
+
+	INDEX_ENTRY* pEntry = FindEntry(key);
+	if (pEntry != NULL)
+	{
+		m_pHeader->totalBytes -= pEntry->size;
+		m_pHeader->totalBytes += size;
+		pEntry->size = size;
+	}
+	else
+	{
+		pEntry = InsertEntry(key, size);
+	}
+	pEntry->lastUse = ++m_pHeader->useClock;
+	EvictEntries(key);
+
+	return(true);
+}
+
+/***********************************************************
+ *  FindEntry()
+ *
+ *  This method is used for finding the index slot of a key
+ *  by linear probing, NULL when it is not in the index.
+ ***********************************************************/
+DerivedDataCache::INDEX_ENTRY* DerivedDataCache::FindEntry(const CACHE_KEY& key)
+{
+	uint32_t mask = g_IndexCapacity - 1;
+	for (uint32_t slot = (uint32_t)key.low & mask; ; slot = (slot + 1) & mask)
+	{
+		INDEX_ENTRY& entry = m_pEntries[slot];
+		if ((entry.high == 0) && (entry.low == 0))
+		{
+			return(NULL);
+		}
+		if ((entry.high == key.high) && (entry.low == key.low))
+		{
+			return(&entry);
+		}
+	}
+}
+
+/***********************************************************
+ *  InsertEntry()
+ *
+ *  This method is used for adding a key that is not in the
+ *  index yet.  Eviction keeps a quarter of the slots free,
+ *  so there is always an empty slot to probe to.
+ ***********************************************************/
+DerivedDataCache::INDEX_ENTRY* DerivedDataCache::InsertEntry(const CACHE_KEY& key, uint64_t size)
+{
+	uint32_t mask = g_IndexCapacity - 1;
+	uint32_t slot = (uint32_t)key.low & mask;
+	while ((m_pEntries[slot].high != 0) || (m_pEntries[slot].low != 0))
+	{
+		slot = (slot + 1) & mask;
+	}
+
+	INDEX_ENTRY& entry = m_pEntries[slot];
+	entry.high = key.high;
+	entry.low = key.low;
+	entry.size = size;
+	entry.lastUse = 0;
+	m_pHeader->count++;
+	m_pHeader->totalBytes += size;
+	return(&entry);
+}
+
+/***********************************************************
+ *  RemoveEntry()
+ *
+ *  This method is used for removing a slot from the index.
+ *  The entries after it in the probe run are shifted back,
+ *  so lookups never need tombstones.
+ ***********************************************************/
+void DerivedDataCache::RemoveEntry(INDEX_ENTRY* pEntry)
+{
+	uint32_t mask = g_IndexCapacity - 1;
+	uint32_t hole = (uint32_t)(pEntry - m_pEntries);
+	m_pHeader->count--;
+	m_pHeader->totalBytes -= pEntry->size;
+
+	for (uint32_t slot = (hole + 1) & mask; ; slot = (slot + 1) & mask)
+	{
+		INDEX_ENTRY& entry = m_pEntries[slot];
+		if ((entry.high == 0) && (entry.low == 0))
+		{
+			break;
+		}
+
+		// an entry can fill the hole unless its home slot lies
+		// (cyclically) after the hole and up to where it is now
+		uint32_t home = (uint32_t)entry.low & mask;
+		bool bStays = (hole <= slot) ? ((hole < home) && (home <= slot)) : ((hole < home) || (home <= slot));
+		if (bStays == false)
+		{
+			m_pEntries[hole] = entry;
+			hole = slot;
+		}
+	}
+
+	memset(&m_pEntries[hole], 0, sizeof(INDEX_ENTRY));
+}
+
+/***********************************************************
+ *  EvictEntries()
+ *
+ *  This method is used for deleting the least recently used
+ *  entries, except the passed in one, until the cache is
+ *  within its size budget and the index has room to spare.
+ ***********************************************************/
+void DerivedDataCache::EvictEntries(const CACHE_KEY& keep)
+{
+	while ((m_pHeader->totalBytes > m_maxBytes) || (m_pHeader->count > g_IndexCapacity / 4 * 3))
+	{
+		INDEX_ENTRY* pOldest = NULL;
+		for (uint32_t slot = 0; slot < g_IndexCapacity; slot++)
+		{
+			INDEX_ENTRY& entry = m_pEntries[slot];
+			if (((entry.high == 0) && (entry.low == 0)) ||
+				((entry.high == keep.high) && (entry.low == keep.low)))
+			{
+				continue;
+			}
+			if ((pOldest == NULL) || (entry.lastUse < pOldest->lastUse))
+			{
+				pOldest = &entry;
+			}
+		}
+		if (pOldest == NULL)
+		{
+			return;
+		}
+
+		std::error_code error;
+		std::filesystem::remove(GetEntryPath(CACHE_KEY{ pOldest->high, pOldest->low }), error);
+		RemoveEntry(pOldest);
+	}
+}
+
+/***********************************************************
+ *  GetEntryPath()
+ *
+ *  This method is used for getting the file of an entry:
+ *  the hex key, in a subdirectory named by its first byte
+ *  so no single directory grows too large.
+ ***********************************************************/
+std::string DerivedDataCache::GetEntryPath(const CACHE_KEY& key) const
+{
+	char name[40];
+	snprintf(name, sizeof(name), "%016llx%016llx", (unsigned long long)key.high, (unsigned long long)key.low);
+	std::filesystem::path path = std::filesystem::path(m_directory) / std::string(name, 2) / (std::string(name) + g_EntryExtension);
+	return(path.string());
+}
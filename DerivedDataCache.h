@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+// deriveddatacache.h
+// ============
+// content-addressed on-disk cache for cooked asset data
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/***********************************************************
+ *  DerivedDataCache
+ *
+ *  This class stores the results of expensive processing
+ *  (decoded textures, program binaries, proxy meshes) on
+ *  disk, keyed by a hash of everything the result was made
+ *  from: the input bytes, the cooker name and version and
+ *  its settings.  A changed input simply makes a new key,
+ *  so entries never have to be invalidated.
+ *
+ *  Every entry is its own file, written to a temporary name
+ *  and renamed into place, so a crash never leaves a torn
+ *  entry behind.  A memory-mapped index tracks the size and
+ *  last use of each entry, and the least recently used ones
+ *  are deleted once the cache grows past its size budget.
+ *  All methods are thread safe.
+ ***********************************************************/
+class DerivedDataCache
+{
+public:
+	// constructor
+	DerivedDataCache();
+	// destructor
+	~DerivedDataCache();
+
+	// 128 bit content hash naming one entry
+	struct CACHE_KEY
+	{
+		uint64_t high;
+		uint64_t low;
+	};
+
+	/***********************************************************
+	 *  KeyBuilder
+	 *
+	 *  Hashes the inputs of one cooking step into a key.  The
+	 *  cooker name and version come first, so bumping the
+	 *  version of a cooker retires all of its old entries.
+	 ***********************************************************/
+	class KeyBuilder
+	{
+	public:
+		KeyBuilder(const char* cookerName, uint32_t cookerVersion);
+
+		// add raw bytes, their length is hashed too
+		KeyBuilder& Add(const void* data, size_t size);
+		// add a string
+		KeyBuilder& Add(const std::string& text) { return Add(text.data(), text.size()); }
+		// add a plain value such as a setting
+		template <typename T>
+		KeyBuilder& AddValue(const T& value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "only plain values can be hashed");
+			return Add(&value, sizeof(T));
+		}
+
+		CACHE_KEY GetKey() const;
+
+	private:
+		uint64_t m_high;
+		uint64_t m_low;
+	};
+
+	// open (or create) the cache in a directory, bounded to maxBytes
+	bool Open(const std::string& directory, uint64_t maxBytes);
+	// flush the index and close the cache
+	void Close();
+	bool IsOpen() const { return (m_pIndex != NULL); }
+
+	// read an entry, false when it is not cached
+	bool Get(const CACHE_KEY& key, std::vector<unsigned char>& data);
+	// store an entry, replacing any older copy
+	bool Put(const CACHE_KEY& key, const void* data, size_t size);
+	bool Put(const CACHE_KEY& key, const std::vector<unsigned char>& data) { return Put(key, data.data(), data.size()); }
+
+	// 64 bit hash of a byte range
+	static uint64_t Hash(const void* data, size_t size, uint64_t seed);
+
+private:
+	// index file layout, shared with the mapped memory
+	struct INDEX_HEADER;
+	struct INDEX_ENTRY;
+
+	// the platform handles of the mapped index file
+	struct MAPPED_FILE;
+	MAPPED_FILE* m_pIndex;
+	INDEX_HEADER* m_pHeader;
+	INDEX_ENTRY* m_pEntries;
+
+	std::string m_directory;
+	uint64_t m_maxBytes;
+	std::mutex m_mutex;
+
+	// open addressed index lookups, called with m_mutex held
+	INDEX_ENTRY* FindEntry(const CACHE_KEY& key);
+	INDEX_ENTRY* InsertEntry(const CACHE_KEY& key, uint64_t size);
+	void RemoveEntry(INDEX_ENTRY* pEntry);
+	// delete the least recently used entries until within budget
+	void EvictEntries(const CACHE_KEY& keep);
+	// rebuild the index from the entry files after a crash
+	void RebuildIndex();
+	// the file holding an entry
+	std::string GetEntryPath(const CACHE_KEY& key) const;
+};
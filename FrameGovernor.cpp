@@ -0,0 +1,188 @@
+///////////////////////////////////////////////////////////////////////////////
+// framegovernor.cpp
+// ============
+// adjust the scalable quality settings at runtime to hold a frame time
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameGovernor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+// declaration of global variables
+namespace
+{
+	// lower a knob above target * (1 + g_LowerMargin)
+	const float g_LowerMargin = 0.05f;
+	// raise one below target * (1 - g_RaiseMargin)
+	const float g_RaiseMargin = 0.25f;
+	// frames the GPU times lag behind the CPU ones
+	const int g_GPULagFrames = 4;
+	// frames of headroom before a knob is first raised
+	const long long g_RaiseDelay = 120;
+	// the longest a knob waits to be raised, about a minute
+	const long long g_MaxRaiseDelay = 3840;
+}
+
+/***********************************************************
+ *  FrameGovernor()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameGovernor::FrameGovernor(FrameProfiler* pFrameProfiler)
+{
+	m_pFrameProfiler = pFrameProfiler;
+	m_targetFrameTime = 1000.0f / 60.0f;
+	m_bEnabled = true;
+	m_lastChange = 0;
+	m_headroomStart = -1;
+}
+
+/***********************************************************
+ *  AddKnob()
+ *
+ *  This method is used for adding a scalable setting.  It
+ *  starts at bestValue, which is never exceeded, so the
+ *  governor only trades quality down from the chosen tier.
+ ***********************************************************/
+void FrameGovernor::AddKnob(
+	const std::string& name,
+	int priority,
+	float bestValue,
+	float worstValue,
+	float step,
+	bool bHelpsCPU,
+	bool bHelpsGPU,
+	std::function<void(float)> apply)
+{
+	KNOB knob;
+	knob.name = name;
+	knob.priority = priority;
+	knob.bestValue = bestValue;
+	knob.worstValue = worstValue;
+	knob.step = std::abs(step);
+	knob.value = bestValue;
+	knob.bHelpsCPU = bHelpsCPU;
+	knob.bHelpsGPU = bHelpsGPU;
+	knob.apply = apply;
+	knob.raiseDelay = g_RaiseDelay;
+	knob.lastRaised = -1;
+	m_knobs.push_back(knob);
+}
+
+/***********************************************************
+ *  StepKnob()
+ *
+ *  This method is used for moving a knob one step, applying
+ *  the new value and logging the change.
+ ***********************************************************/
+void FrameGovernor::StepKnob(KNOB& knob, bool bLower, float frameTime, bool bCPUBound)
+{
+	float direction = (knob.worstValue > knob.bestValue) ? 1.0f : -1.0f;
+	float value = knob.value + (bLower ? direction : -direction) * knob.step;
+	knob.value = std::min(std::max(value, std::min(knob.bestValue, knob.worstValue)), std::max(knob.bestValue, knob.worstValue));
+	knob.apply(knob.value);
+
+	std::cout << "Governor: " << (bLower ? "lowered " : "raised ") << knob.name << " to " << knob.value
+		<< " (" << frameTime << " ms, " << (bCPUBound ? "CPU" : "GPU") << " bound)" << std::endl;
+
+	std::ostringstream arguments;
+	arguments << "\"knob\":\"" << knob.name << "\",\"value\":" << knob.value
+		<< ",\"direction\":\"" << (bLower ? "lower" : "raise") << "\""
+		<< ",\"cpu_ms\":" << m_pFrameProfiler->GetCPUTime()
+		<< ",\"gpu_ms\":" << m_pFrameProfiler->GetGPUTime()
+		<< ",\"target_ms\":" << m_targetFrameTime;
+	m_pFrameProfiler->TraceEvent("governor", arguments.str());
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for comparing the rolling frame time
+ *  (the slower of CPU and GPU) with the target, once the
+ *  profiler window only holds frames drawn since the last
+ *  change.  Over budget, the lowest priority knob that
+ *  helps the slower side goes down a step.  Well under
+ *  budget for long enough, the highest priority lowered
+ *  knob goes back up a step.
+ ***********************************************************/
+void FrameGovernor::Update()
+{
+	if ((m_bEnabled == false) || (m_knobs.size() == 0) || (NULL == m_pFrameProfiler))
+	{
+		return;
+	}
+
+	long long frame = m_pFrameProfiler->GetFrameCount();
+	int window = m_pFrameProfiler->GetWindowFrames();
+	if (frame % window == 0)
+	{
+		m_pFrameProfiler->TraceFrameTimes();
+	}
+	if (frame - m_lastChange < window + g_GPULagFrames)
+	{
+		return;
+	}
+
+	float cpuTime = m_pFrameProfiler->GetCPUTime();
+	float gpuTime = m_pFrameProfiler->GetGPUTime();
+	float frameTime = std::max(cpuTime, gpuTime);
+	bool bCPUBound = (cpuTime > gpuTime);
+
+	if (frameTime > m_targetFrameTime * (1.0f + g_LowerMargin))
+	{
+		m_headroomStart = -1;
+
+		KNOB* pKnob = NULL;
+		for (KNOB& knob : m_knobs)
+		{
+			bool bHelps = bCPUBound ? knob.bHelpsCPU : knob.bHelpsGPU;
+			if ((bHelps == true) && (knob.value != knob.worstValue) &&
+				((NULL == pKnob) || (knob.priority < pKnob->priority)))
+			{
+				pKnob = &knob;
+			}
+		}
+		if (NULL != pKnob)
+		{
+			// raised too soon, wait longer next time
+			if ((pKnob->lastRaised >= 0) && (frame - pKnob->lastRaised < pKnob->raiseDelay))
+			{
+				pKnob->raiseDelay = std::min(pKnob->raiseDelay * 2, g_MaxRaiseDelay);
+			}
+			StepKnob(*pKnob, true, frameTime, bCPUBound);
+			m_lastChange = frame;
+		}
+	}
+	else if (frameTime < m_targetFrameTime * (1.0f - g_RaiseMargin))
+	{
+		if (m_headroomStart < 0)
+		{
+			m_headroomStart = frame;
+		}
+
+		KNOB* pKnob = NULL;
+		for (KNOB& knob : m_knobs)
+		{
+			if ((knob.value != knob.bestValue) && (frame - m_headroomStart >= knob.raiseDelay) &&
+				((NULL == pKnob) || (knob.priority > pKnob->priority)))
+			{
+				pKnob = &knob;
+			}
+		}
+		if (NULL != pKnob)
+		{
+			StepKnob(*pKnob, false, frameTime, bCPUBound);
+			pKnob->lastRaised = frame;
+			m_lastChange = frame;
+			m_headroomStart = -1;
+		}
+	}
+	else
+	{
+		m_headroomStart = -1;
+	}
+}
@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////////
+// framegovernor.h
+// ============
+// adjust the scalable quality settings at runtime to hold a frame time
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FrameProfiler.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  FrameGovernor
+ *
+ *  This class watches the rolling CPU and GPU frame times
+ *  of the profiler and steps scalable settings ("knobs")
+ *  down when the frame is over budget, and back up when
+ *  there is room to spare.  Only knobs that help the slower
+ *  side are moved: a CPU bound frame does not lower the
+ *  render scale.  Knobs with the lowest priority are
+ *  lowered first and raised last.
+ *
+ *  Hysteresis keeps it from oscillating: a knob is lowered
+ *  when the frame is slightly over the target, but only
+ *  raised after the frame has been well under it for a
+ *  while, and each change waits until the rolling times
+ *  reflect the last one.  A knob that had to be lowered
+ *  again soon after being raised waits twice as long
+ *  before the next raise.  Every change is written to the
+ *  trace and the console.
+ ***********************************************************/
+class FrameGovernor
+{
+public:
+	// constructor
+	FrameGovernor(FrameProfiler* pFrameProfiler);
+
+	// add a knob that moves from bestValue toward worstValue
+	// in steps, apply is called with every new value
+	void AddKnob(
+		const std::string& name,
+		int priority,
+		float bestValue,
+		float worstValue,
+		float step,
+		bool bHelpsCPU,
+		bool bHelpsGPU,
+		std::function<void(float)> apply);
+
+	// check the frame times and adjust a knob, once per frame
+	void Update();
+
+	// the frame time to hold, 16.7 ms by default
+	void SetTargetFrameTime(float milliseconds) { m_targetFrameTime = milliseconds; }
+	void SetEnabled(bool bEnabled) { m_bEnabled = bEnabled; }
+
+private:
+	struct KNOB
+	{
+		std::string name;
+		int priority;
+		float bestValue;
+		float worstValue;
+		float step;
+		float value;
+		bool bHelpsCPU;
+		bool bHelpsGPU;
+		std::function<void(float)> apply;
+		// frames of headroom needed before raising it again
+		long long raiseDelay;
+		// frame of the last raise, -1 if never
+		long long lastRaised;
+	};
+
+	FrameProfiler* m_pFrameProfiler;
+	std::vector<KNOB> m_knobs;
+	float m_targetFrameTime;
+	bool m_bEnabled;
+
+	// frame of the last change, the times are stale until a
+	// full profiler window has passed
+	long long m_lastChange;
+	// first frame of the current run of headroom, -1 if none
+	long long m_headroomStart;
+
+	// move a knob one step, toward worstValue when lowering
+	void StepKnob(KNOB& knob, bool bLower, float frameTime, bool bCPUBound);
+};
@@ -0,0 +1,204 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameprofiler.cpp
+// ============
+// rolling CPU and GPU frame times, and a trace file of timed events
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameProfiler.h"
+
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// frames the GPU timer results may lag behind
+	const int g_QueriesInFlight = 4;
+}
+
+/***********************************************************
+ *  FrameProfiler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameProfiler::FrameProfiler(int windowFrames)
+{
+	m_windowFrames = std::max(1, windowFrames);
+	m_frameCount = 0;
+	m_cpuTimes.assign(m_windowFrames, 0.0f);
+	m_gpuTimes.assign(m_windowFrames, 0.0f);
+	m_cpuSamples = 0;
+	m_gpuSamples = 0;
+	m_cpuAverage = 0.0f;
+	m_gpuAverage = 0.0f;
+	m_startTime = std::chrono::steady_clock::now();
+	m_frameStart = m_startTime;
+	m_queryIndex = 0;
+	m_bFirstTraceEvent = true;
+}
+
+/***********************************************************
+ *  ~FrameProfiler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameProfiler::~FrameProfiler()
+{
+	CloseTrace();
+	if (m_queries.size() > 0)
+	{
+		glDeleteQueries((GLsizei)m_queries.size(), m_queries.data());
+		m_queries.clear();
+	}
+}
+
+/***********************************************************
+ *  AddSample()
+ *
+ *  This method is used for adding a frame time to a rolling
+ *  window and returning the average of the window.
+ ***********************************************************/
+float FrameProfiler::AddSample(std::vector<float>& times, int& samples, float milliseconds)
+{
+	times[samples % m_windowFrames] = milliseconds;
+	samples++;
+
+	int count = std::min(samples, m_windowFrames);
+	float total = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		total += times[i];
+	}
+	return(total / count);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting the CPU clock and the
+ *  GPU timer of a frame.  The timer query of the frame that
+ *  used the same ring slot is read first, if the GPU has
+ *  finished it; otherwise that sample is skipped rather
+ *  than waited for.
+ ***********************************************************/
+void FrameProfiler::BeginFrame()
+{
+	if (m_queries.size() == 0)
+	{
+		m_queries.resize(g_QueriesInFlight);
+		m_queryPending.assign(g_QueriesInFlight, false);
+		glGenQueries(g_QueriesInFlight, m_queries.data());
+	}
+
+	GLuint query = m_queries[m_queryIndex];
+	if (m_queryPending[m_queryIndex] == true)
+	{
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_TRUE)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+			m_gpuAverage = AddSample(m_gpuTimes, m_gpuSamples, (float)(nanoseconds / 1.0e6));
+		}
+		m_queryPending[m_queryIndex] = false;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	m_frameStart = std::chrono::steady_clock::now();
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for stopping the CPU clock and the
+ *  GPU timer of a frame.
+ ***********************************************************/
+void FrameProfiler::EndFrame()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	m_queryPending[m_queryIndex] = true;
+	m_queryIndex = (m_queryIndex + 1) % g_QueriesInFlight;
+
+	std::chrono::duration<float, std::milli> cpuTime = std::chrono::steady_clock::now() - m_frameStart;
+	m_cpuAverage = AddSample(m_cpuTimes, m_cpuSamples, cpuTime.count());
+	m_frameCount++;
+}
+
+/***********************************************************
+ *  GetTimestamp()
+ ***********************************************************/
+long long FrameProfiler::GetTimestamp() const
+{
+	return(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_startTime).count());
+}
+
+/***********************************************************
+ *  OpenTrace()
+ *
+ *  This method is used for creating the trace file.  The
+ *  events form one JSON array that CloseTrace() closes.
+ ***********************************************************/
+bool FrameProfiler::OpenTrace(const std::string& filename)
+{
+	CloseTrace();
+	m_traceFile.open(filename, std::ios::out | std::ios::trunc);
+	if (m_traceFile.is_open() == false)
+	{
+		return(false);
+	}
+	m_traceFile << "[";
+	m_bFirstTraceEvent = true;
+	return(true);
+}
+
+/***********************************************************
+ *  CloseTrace()
+ ***********************************************************/
+void FrameProfiler::CloseTrace()
+{
+	if (m_traceFile.is_open() == true)
+	{
+		m_traceFile << "\n]\n";
+		m_traceFile.close();
+	}
+}
+
+/***********************************************************
+ *  TraceEvent()
+ *
+ *  This method is used for writing an instant event, with
+ *  its arguments as the body of a JSON object, such as
+ *  "\"knob\":\"render scale\",\"value\":0.75".
+ ***********************************************************/
+void FrameProfiler::TraceEvent(const std::string& name, const std::string& arguments)
+{
+	if (m_traceFile.is_open() == false)
+	{
+		return;
+	}
+	m_traceFile << (m_bFirstTraceEvent ? "\n" : ",\n");
+	m_traceFile << "{\"name\":\"" << name << "\",\"ph\":\"i\",\"s\":\"g\",\"ts\":" << GetTimestamp()
+		<< ",\"pid\":1,\"tid\":1,\"args\":{" << arguments << "}}";
+	m_bFirstTraceEvent = false;
+	m_traceFile.flush();
+}
+
+/***********************************************************
+ *  TraceFrameTimes()
+ *
+ *  This method is used for writing the rolling CPU and GPU
+ *  frame times as a counter, drawn as a graph by the trace
+ *  viewer.
+ ***********************************************************/
+void FrameProfiler::TraceFrameTimes()
+{
+	if (m_traceFile.is_open() == false)
+	{
+		return;
+	}
+	m_traceFile << (m_bFirstTraceEvent ? "\n" : ",\n");
+	m_traceFile << "{\"name\":\"frame time\",\"ph\":\"C\",\"ts\":" << GetTimestamp()
+		<< ",\"pid\":1,\"args\":{\"cpu_ms\":" << m_cpuAverage << ",\"gpu_ms\":" << m_gpuAverage << "}}";
+	m_bFirstTraceEvent = false;
+}
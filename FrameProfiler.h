@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameprofiler.h
+// ============
+// rolling CPU and GPU frame times, and a trace file of timed events
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  FrameProfiler
+ *
+ *  This class measures every frame on the CPU (from
+ *  BeginFrame() to EndFrame(), so without the wait in the
+ *  buffer swap) and on the GPU with a timer query.  GPU
+ *  results are read a few frames later, once they are
+ *  available, so the profiler never stalls the pipeline.
+ *  Both are averaged over the last frames.
+ *
+ *  Events can be written to a trace file in the Chrome
+ *  trace event format, to be opened in chrome://tracing or
+ *  Perfetto.
+ ***********************************************************/
+class FrameProfiler
+{
+public:
+	// constructor, averaging over the last windowFrames frames
+	FrameProfiler(int windowFrames = 30);
+	// destructor
+	~FrameProfiler();
+
+	// mark the start and the end of the work of one frame
+	void BeginFrame();
+	void EndFrame();
+
+	// rolling average frame times in milliseconds
+	float GetCPUTime() const { return m_cpuAverage; }
+	float GetGPUTime() const { return m_gpuAverage; }
+	// frames measured so far
+	long long GetFrameCount() const { return m_frameCount; }
+	int GetWindowFrames() const { return m_windowFrames; }
+
+	// start writing trace events to a file
+	bool OpenTrace(const std::string& filename);
+	// finish the trace file
+	void CloseTrace();
+	// write an instant event with its arguments, given as a JSON object body
+	void TraceEvent(const std::string& name, const std::string& arguments);
+	// write the current rolling frame times as a counter event
+	void TraceFrameTimes();
+
+private:
+	int m_windowFrames;
+	long long m_frameCount;
+
+	// recent frame times and their averages
+	std::vector<float> m_cpuTimes;
+	std::vector<float> m_gpuTimes;
+	int m_cpuSamples;
+	int m_gpuSamples;
+	float m_cpuAverage;
+	float m_gpuAverage;
+
+	// CPU time of the current frame
+	std::chrono::steady_clock::time_point m_startTime;
+	std::chrono::steady_clock::time_point m_frameStart;
+
+	// ring of timer queries, one per frame in flight
+	std::vector<GLuint> m_queries;
+	std::vector<bool> m_queryPending;
+	int m_queryIndex;
+
+	// trace output
+	std::ofstream m_traceFile;
+	bool m_bFirstTraceEvent;
+
+	// add a sample to a rolling window and return the new average
+	float AddSample(std::vector<float>& times, int& samples, float milliseconds);
+	// microseconds since the profiler was created, for trace timestamps
+	long long GetTimestamp() const;
+};
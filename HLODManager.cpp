@@ -0,0 +1,577 @@
+///////////////////////////////////////////////////////////////////////////////
+// hlodmanager.cpp
+// ============
+// build and select hierarchical LOD proxies for clustered static objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HLODManager.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <tuple>
+
+// declaration of global variables
+namespace
+{
+	const int g_FloatsPerVertex = 8;	// position, normal, uv
+	const int g_AtlasTileSize = 64;		// pixels per atlas tile
+	const int g_AtlasGutter = 4;		// mip-safe border around each tile
+	const int g_AtlasMaxLevel = 2;		// mips that keep a gutter of at least 1 pixel
+	const int g_MaxLevels = 8;			// maximum depth of the hierarchy
+	const uint32_t g_ProxyCookVersion = 1;	// bump when the simplification changes
+	const uint32_t g_AtlasCookVersion = 1;	// bump when the atlas mips change
+}
+
+/***********************************************************
+ *  HLODManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+HLODManager::HLODManager(ShapeMeshes* pShapeMeshes, DerivedDataCache* pDerivedDataCache)
+{
+	m_pShapeMeshes = pShapeMeshes;
+	m_pDerivedDataCache = pDerivedDataCache;
+	m_atlasTextureID = 0;
+	m_atlasSize = 0;
+	m_leafClusterSize = 4.0f;
+	m_errorRatio = 1.0f / 16.0f;
+	m_maxScreenError = 2.0f;
+}
+
+/***********************************************************
+ *  ~HLODManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+HLODManager::~HLODManager()
+{
+	Clear();
+	m_pShapeMeshes = NULL;
+	m_pDerivedDataCache = NULL;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for freeing the atlas texture and
+ *  forgetting the cluster hierarchy.  The proxy meshes are
+ *  owned by the shape meshes object.
+ ***********************************************************/
+void HLODManager::Clear()
+{
+	if (m_atlasTextureID != 0)
+	{
+		glDeleteTextures(1, &m_atlasTextureID);
+		m_atlasTextureID = 0;
+	}
+	m_atlasChain = MipGenerator::MIP_CHAIN();
+	m_nodes.clear();
+	m_rootNodes.clear();
+	m_sourceTiles.clear();
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for grouping the passed in static
+ *  objects into clusters on a grid, then grouping those
+ *  clusters on a grid twice as coarse, until one level has
+ *  a single cluster.  Each cluster gets a proxy mesh whose
+ *  simplification error grows with the cell size.  The
+ *  proxy meshes are added to the shape meshes object, which
+ *  cannot free them one by one, so the hierarchy is only
+ *  built once.
+ ***********************************************************/
+void HLODManager::Build(const std::vector<HLOD_SOURCE>& sources)
+{
+	if (m_nodes.size() > 0)
+	{
+		std::cout << "HLOD: the hierarchy is already built, its proxy meshes cannot be replaced" << std::endl;
+		return;
+	}
+	Clear();
+	if (sources.size() == 0)
+	{
+		return;
+	}
+
+	BuildAtlas(sources);
+
+	// start with one leaf node per source object
+	std::vector<int> level;
+	for (int i = 0; i < (int)sources.size(); i++)
+	{
+		HLOD_NODE node;
+		node.boundsMin = glm::vec3(1.0e30f);
+		node.boundsMax = glm::vec3(-1.0e30f);
+		for (size_t v = 0; v + 2 < sources[i].triangles.size(); v += g_FloatsPerVertex)
+		{
+			glm::vec3 p(sources[i].triangles[v], sources[i].triangles[v + 1], sources[i].triangles[v + 2]);
+			node.boundsMin = glm::min(node.boundsMin, p);
+			node.boundsMax = glm::max(node.boundsMax, p);
+		}
+		node.geometricError = 0.0f;
+		node.proxyMesh = -1;
+		node.objects.push_back(i);
+		m_nodes.push_back(node);
+		level.push_back((int)m_nodes.size() - 1);
+	}
+
+	// merge the nodes of each level by grid cell until a single root remains
+	float cellSize = m_leafClusterSize;
+	for (int depth = 0; (depth < g_MaxLevels) && (level.size() > 1); depth++)
+	{
+		std::map<std::tuple<int, int, int>, std::vector<int>> cells;
+		for (int nodeIndex : level)
+		{
+			glm::vec3 center = (m_nodes[nodeIndex].boundsMin + m_nodes[nodeIndex].boundsMax) * 0.5f;
+			glm::ivec3 cell = glm::ivec3(glm::floor(center / cellSize));
+			cells[std::make_tuple(cell.x, cell.y, cell.z)].push_back(nodeIndex);
+		}
+
+		std::vector<int> nextLevel;
+		for (auto& cell : cells)
+		{
+			HLOD_NODE parent;
+			parent.boundsMin = glm::vec3(1.0e30f);
+			parent.boundsMax = glm::vec3(-1.0e30f);
+			parent.geometricError = cellSize * m_errorRatio;
+			parent.proxyMesh = -1;
+			for (int child : cell.second)
+			{
+				parent.boundsMin = glm::min(parent.boundsMin, m_nodes[child].boundsMin);
+				parent.boundsMax = glm::max(parent.boundsMax, m_nodes[child].boundsMax);
+				parent.objects.insert(parent.objects.end(), m_nodes[child].objects.begin(), m_nodes[child].objects.end());
+				parent.children.push_back(child);
+			}
+			parent.proxyMesh = BuildProxyMesh(sources, parent);
+			m_nodes.push_back(parent);
+			nextLevel.push_back((int)m_nodes.size() - 1);
+		}
+
+		level = nextLevel;
+		cellSize *= 2.0f;
+	}
+
+	m_rootNodes = level;
+
+	// report the objects by their scene index from now on
+	for (HLOD_NODE& node : m_nodes)
+	{
+		for (int& object : node.objects)
+		{
+			object = sources[object].objectIndex;
+		}
+	}
+
+	std::cout << "HLOD: built " << m_nodes.size() - sources.size() << " clusters for " << sources.size() << " objects" << std::endl;
+}
+
+/***********************************************************
+ *  BuildAtlas()
+ *
+ *  This method is used for packing a downsampled copy of
+ *  every distinct texture (or a flat tile for every distinct
+ *  untextured color) into one image.  A texture is baked
+ *  repeated as many times as its objects scale their UVs,
+ *  so the whole UV range of an object maps onto its tile
+ *  the way it maps onto the texture.  Each tile is padded
+ *  with a gutter of clamped edge texels so the first mips do
+ *  not bleed between tiles.  The mips are built once with
+ *  the mip generator and kept in the derived data cache;
+ *  the caller uploads the chain.
+ ***********************************************************/
+void HLODManager::BuildAtlas(const std::vector<HLOD_SOURCE>& sources)
+{
+	std::map<std::tuple<GLuint, float, float, float, float, bool, int, int, int>, int> tileIndices;
+	std::vector<GLuint> tileTextures;
+	std::vector<glm::vec4> tileRects;
+	std::vector<glm::vec2> tileScales;
+	std::vector<bool> tileRepeats;
+	std::vector<glm::ivec3> tileColors;
+	std::vector<int> sourceTile(sources.size());
+
+	// find the distinct tiles, images that share a texture
+	// atlas are told apart by where they are in it
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		glm::ivec3 color = glm::ivec3(glm::clamp(glm::vec3(sources[i].color), 0.0f, 1.0f) * 255.0f);
+		glm::vec4 rect = glm::vec4(0.0f);
+		glm::vec2 scale = glm::vec2(1.0f);
+		bool bRepeat = false;
+		if (sources[i].textureID != 0)
+		{
+			color = glm::ivec3(0);
+			rect = sources[i].textureRect;
+			scale = glm::max(glm::abs(sources[i].UVscale), glm::vec2(0.001f));
+			bRepeat = sources[i].bRepeat;
+		}
+		auto key = std::make_tuple(sources[i].textureID, rect.x, rect.y, scale.x, scale.y, bRepeat, color.r, color.g, color.b);
+		auto found = tileIndices.find(key);
+		if (found == tileIndices.end())
+		{
+			found = tileIndices.insert(std::make_pair(key, (int)tileIndices.size())).first;
+			tileTextures.push_back(sources[i].textureID);
+			tileRects.push_back(rect);
+			tileScales.push_back(scale);
+			tileRepeats.push_back(bRepeat);
+			tileColors.push_back(color);
+		}
+		sourceTile[i] = found->second;
+	}
+
+	int columns = (int)std::ceil(std::sqrt((float)tileIndices.size()));
+	m_atlasSize = columns * g_AtlasTileSize;
+	std::vector<unsigned char> atlas(m_atlasSize * m_atlasSize * 4, 255);
+
+	// fill each tile
+	const int inner = g_AtlasTileSize - 2 * g_AtlasGutter;
+	for (int tile = 0; tile < (int)tileTextures.size(); tile++)
+	{
+		GLuint textureID = tileTextures[tile];
+		glm::vec4 rect = tileRects[tile];
+		glm::vec2 scale = tileScales[tile];
+		int originX = (tile % columns) * g_AtlasTileSize;
+		int originY = (tile / columns) * g_AtlasTileSize;
+
+		std::vector<unsigned char> texels;
+		int width = 1;
+		int height = 1;
+		if (textureID != 0)
+		{
+			// read back the smallest mip where each repeat of the
+			// image is still larger than its share of the tile
+			glBindTexture(GL_TEXTURE_2D, textureID);
+			int mipLevel = 0;
+			int maxLevel = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+			while ((mipLevel < maxLevel) &&
+				((int)((width >> (mipLevel + 1)) * rect.z * scale.x) >= inner) &&
+				((int)((height >> (mipLevel + 1)) * rect.w * scale.y) >= inner))
+			{
+				mipLevel++;
+			}
+			width = std::max(1, width >> mipLevel);
+			height = std::max(1, height >> mipLevel);
+			texels.resize(width * height * 4);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glGetTexImage(GL_TEXTURE_2D, mipLevel, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+		else
+		{
+			glm::ivec3 color = tileColors[tile];
+			texels = { (unsigned char)color.r, (unsigned char)color.g, (unsigned char)color.b, 255 };
+		}
+
+		// resample into the tile at the scaled UVs, wrapped or
+		// clamped like the scene shader does, and clamp the gutter
+		// to the edge texels
+		for (int y = 0; y < g_AtlasTileSize; y++)
+		{
+			for (int x = 0; x < g_AtlasTileSize; x++)
+			{
+				float u = glm::clamp((x - g_AtlasGutter + 0.5f) / inner, 0.0f, 1.0f) * scale.x;
+				float v = glm::clamp((y - g_AtlasGutter + 0.5f) / inner, 0.0f, 1.0f) * scale.y;
+				if (tileRepeats[tile] == true)
+				{
+					u -= std::floor(u);
+					v -= std::floor(v);
+				}
+				else
+				{
+					u = std::min(u, 1.0f);
+					v = std::min(v, 1.0f);
+				}
+				int srcX = std::min(width - 1, (int)((rect.x + u * rect.z) * width));
+				int srcY = std::min(height - 1, (int)((rect.y + v * rect.w) * height));
+				const unsigned char* src = &texels[(srcY * width + srcX) * 4];
+				unsigned char* dst = &atlas[((originY + y) * m_atlasSize + originX + x) * 4];
+				std::copy(src, src + 4, dst);
+			}
+		}
+	}
+
+	m_sourceTiles.resize(sources.size());
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		m_sourceTiles[i] = glm::ivec2((sourceTile[i] % columns) * g_AtlasTileSize, (sourceTile[i] / columns) * g_AtlasTileSize);
+	}
+
+	// the mips are filtered in linear light like the scene
+	// textures, down to the last level whose tiles still have a
+	// gutter, and cached by the contents of the atlas
+	m_atlasChain = MipGenerator::MIP_CHAIN();
+	m_atlasChain.colorChannels = 4;
+	size_t chainSize = MipGenerator::GetLevelLayout(m_atlasSize, m_atlasSize, 4, m_atlasChain.levels);
+	size_t levelCount = std::min(m_atlasChain.levels.size(), (size_t)g_AtlasMaxLevel + 1);
+	size_t keptSize = (levelCount < m_atlasChain.levels.size()) ? m_atlasChain.levels[levelCount].offset : chainSize;
+
+	DerivedDataCache::CACHE_KEY cookedKey = DerivedDataCache::KeyBuilder("HLODAtlas", g_AtlasCookVersion)
+		.AddValue(m_atlasSize)
+		.AddValue(g_AtlasMaxLevel)
+		.Add(atlas.data(), atlas.size())
+		.GetKey();
+	std::vector<unsigned char> cooked;
+	if ((NULL != m_pDerivedDataCache) && m_pDerivedDataCache->Get(cookedKey, cooked) && (cooked.size() == keptSize))
+	{
+		m_atlasChain.pixels.swap(cooked);
+	}
+	else
+	{
+		MipGenerator mipGenerator;
+		mipGenerator.SetWrap(false);
+		mipGenerator.Generate(atlas.data(), m_atlasSize, m_atlasSize, 4, m_atlasChain);
+		m_atlasChain.pixels.resize(keptSize);
+		if (NULL != m_pDerivedDataCache)
+		{
+			m_pDerivedDataCache->Put(cookedKey, m_atlasChain.pixels);
+		}
+	}
+	m_atlasChain.levels.resize(levelCount);
+}
+
+/***********************************************************
+ *  SetAtlasTextureID()
+ ***********************************************************/
+void HLODManager::SetAtlasTextureID(GLuint textureID)
+{
+	if ((m_atlasTextureID != 0) && (m_atlasTextureID != textureID))
+	{
+		glDeleteTextures(1, &m_atlasTextureID);
+	}
+	m_atlasTextureID = textureID;
+	m_atlasChain = MipGenerator::MIP_CHAIN();
+}
+
+/***********************************************************
+ *  BuildProxyMesh()
+ *
+ *  This method is used for merging the triangles of every
+ *  object in the cluster and simplifying the result by
+ *  vertex clustering: all vertices that fall in the same
+ *  grid cell (of the cluster's error size) and use the same
+ *  atlas tile collapse into one, and triangles that become
+ *  degenerate are dropped.
+ ***********************************************************/
+int HLODManager::BuildProxyMesh(
+	const std::vector<HLOD_SOURCE>& sources,
+	HLOD_NODE& node)
+{
+	struct CLUSTER_VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 uv;
+		int count;
+	};
+
+	// the proxy is lit with the material covering most of the cluster
+	std::map<std::string, size_t> materialUse;
+	for (int sourceIndex : node.objects)
+	{
+		materialUse[sources[sourceIndex].materialTag] += sources[sourceIndex].triangles.size();
+	}
+	size_t mostUsed = 0;
+	for (auto& material : materialUse)
+	{
+		if (material.second > mostUsed)
+		{
+			mostUsed = material.second;
+			node.materialTag = material.first;
+		}
+	}
+
+	const float inner = (float)(g_AtlasTileSize - 2 * g_AtlasGutter);
+	const float cellSize = std::max(node.geometricError, 1.0e-4f);
+
+	std::vector<GLfloat> verts;
+	std::vector<GLuint> indices;
+
+	// the proxy depends only on the member triangles, their
+	// atlas tiles and the simplification cell size
+	DerivedDataCache::KeyBuilder keyBuilder("HLODProxy", g_ProxyCookVersion);
+	keyBuilder.AddValue(cellSize).AddValue(m_atlasSize).AddValue(g_AtlasTileSize).AddValue(g_AtlasGutter);
+	for (int sourceIndex : node.objects)
+	{
+		keyBuilder.Add(sources[sourceIndex].triangles.data(), sources[sourceIndex].triangles.size() * sizeof(GLfloat));
+		keyBuilder.AddValue(m_sourceTiles[sourceIndex]);
+	}
+	DerivedDataCache::CACHE_KEY cookedKey = keyBuilder.GetKey();
+
+	std::vector<unsigned char> cooked;
+	if ((NULL != m_pDerivedDataCache) && m_pDerivedDataCache->Get(cookedKey, cooked) && (cooked.size() >= sizeof(uint32_t) * 2))
+	{
+		uint32_t counts[2];
+		memcpy(counts, cooked.data(), sizeof(counts));
+		if (cooked.size() == sizeof(counts) + counts[0] * sizeof(GLfloat) + counts[1] * sizeof(GLuint))
+		{
+			verts.resize(counts[0]);
+			indices.resize(counts[1]);
+			memcpy(verts.data(), cooked.data() + sizeof(counts), verts.size() * sizeof(GLfloat));
+			memcpy(indices.data(), cooked.data() + sizeof(counts) + verts.size() * sizeof(GLfloat), indices.size() * sizeof(GLuint));
+			return((indices.size() > 0) ? m_pShapeMeshes->LoadCustomMesh(verts, indices) : -1);
+		}
+	}
+
+	std::map<std::tuple<int, int, int, int>, GLuint> vertexIndices;
+	std::vector<CLUSTER_VERTEX> clusterVertices;
+	std::set<std::array<GLuint, 3>> usedTriangles;
+
+	for (int sourceIndex : node.objects)
+	{
+		const HLOD_SOURCE& source = sources[sourceIndex];
+		glm::vec2 tileOrigin = glm::vec2(m_sourceTiles[sourceIndex]) + glm::vec2((float)g_AtlasGutter);
+		int tileKey = m_sourceTiles[sourceIndex].y * m_atlasSize + m_sourceTiles[sourceIndex].x;
+
+		for (size_t t = 0; t + 3 * g_FloatsPerVertex <= source.triangles.size(); t += 3 * g_FloatsPerVertex)
+		{
+			std::array<GLuint, 3> triangle;
+			for (int k = 0; k < 3; k++)
+			{
+				const GLfloat* v = &source.triangles[t + k * g_FloatsPerVertex];
+				glm::vec3 position(v[0], v[1], v[2]);
+				glm::ivec3 cell = glm::ivec3(glm::floor(position / cellSize));
+				auto key = std::make_tuple(cell.x, cell.y, cell.z, tileKey);
+
+				auto found = vertexIndices.find(key);
+				if (found == vertexIndices.end())
+				{
+					found = vertexIndices.insert(std::make_pair(key, (GLuint)clusterVertices.size())).first;
+					clusterVertices.push_back({ glm::vec3(0.0f), glm::vec3(0.0f), glm::vec2(0.0f), 0 });
+				}
+
+				// the tile holds the texture as the object repeats it,
+				// so the object's UVs map once over the tile
+				glm::vec2 uv = (tileOrigin + glm::clamp(glm::vec2(v[6], v[7]), 0.0f, 1.0f) * inner) / (float)m_atlasSize;
+
+				CLUSTER_VERTEX& merged = clusterVertices[found->second];
+				merged.position += position;
+				merged.normal += glm::vec3(v[3], v[4], v[5]);
+				merged.uv += uv;
+				merged.count++;
+				triangle[k] = found->second;
+			}
+
+			// drop collapsed and duplicated triangles
+			if ((triangle[0] == triangle[1]) || (triangle[1] == triangle[2]) || (triangle[0] == triangle[2]))
+			{
+				continue;
+			}
+			std::array<GLuint, 3> sorted = triangle;
+			std::sort(sorted.begin(), sorted.end());
+			if (usedTriangles.insert(sorted).second == false)
+			{
+				continue;
+			}
+			indices.insert(indices.end(), triangle.begin(), triangle.end());
+		}
+	}
+
+	if (indices.size() > 0)
+	{
+		verts.reserve(clusterVertices.size() * g_FloatsPerVertex);
+		for (const CLUSTER_VERTEX& merged : clusterVertices)
+		{
+			glm::vec3 position = merged.position / (float)merged.count;
+			glm::vec3 normal = merged.normal;
+			normal = (glm::length(normal) > 1.0e-6f) ? glm::normalize(normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+			glm::vec2 uv = merged.uv / (float)merged.count;
+			verts.insert(verts.end(), { position.x, position.y, position.z, normal.x, normal.y, normal.z, uv.x, uv.y });
+		}
+	}
+
+	// store the result, an empty proxy included, for the next run
+	if (NULL != m_pDerivedDataCache)
+	{
+		uint32_t counts[2] = { (uint32_t)verts.size(), (uint32_t)indices.size() };
+		cooked.resize(sizeof(counts) + verts.size() * sizeof(GLfloat) + indices.size() * sizeof(GLuint));
+		memcpy(cooked.data(), counts, sizeof(counts));
+		memcpy(cooked.data() + sizeof(counts), verts.data(), verts.size() * sizeof(GLfloat));
+		memcpy(cooked.data() + sizeof(counts) + verts.size() * sizeof(GLfloat), indices.data(), indices.size() * sizeof(GLuint));
+		m_pDerivedDataCache->Put(cookedKey, cooked);
+	}
+
+	if (indices.size() == 0)
+	{
+		return(-1);
+	}
+
+	return(m_pShapeMeshes->LoadCustomMesh(verts, indices));
+}
+
+/***********************************************************
+ *  SelectProxies()
+ *
+ *  This method is used for walking the hierarchy from the
+ *  roots.  A cluster is drawn as its proxy when the proxy
+ *  error projects to no more than the allowed number of
+ *  pixels, otherwise its children are visited.
+ ***********************************************************/
+void HLODManager::SelectProxies(
+	ViewManager* pViewManager,
+	std::vector<int>& proxyNodes,
+	std::vector<bool>& hiddenObjects)
+{
+	proxyNodes.clear();
+	if (NULL == pViewManager)
+	{
+		return;
+	}
+
+	for (int root : m_rootNodes)
+	{
+		SelectNode(root, pViewManager, proxyNodes, hiddenObjects);
+	}
+}
+
+/***********************************************************
+ *  SelectNode()
+ *
+ *  This method is used for testing one cluster against the
+ *  allowed screen error.
+ ***********************************************************/
+void HLODManager::SelectNode(
+	int nodeIndex,
+	ViewManager* pViewManager,
+	std::vector<int>& proxyNodes,
+	std::vector<bool>& hiddenObjects)
+{
+	const HLOD_NODE& node = m_nodes[nodeIndex];
+	if (node.children.size() == 0)
+	{
+		return;
+	}
+
+	// distance from the camera to the cluster bounds
+	glm::vec3 cameraPosition = pViewManager->GetCameraPosition();
+	glm::vec3 nearest = glm::clamp(cameraPosition, node.boundsMin, node.boundsMax);
+	float distance = glm::length(cameraPosition - nearest);
+
+	if ((node.proxyMesh >= 0) && (distance > 0.0f) &&
+		(pViewManager->GetProjectedSize(node.geometricError, distance) <= m_maxScreenError))
+	{
+		proxyNodes.push_back(nodeIndex);
+		for (int object : node.objects)
+		{
+			if (object < (int)hiddenObjects.size())
+			{
+				hiddenObjects[object] = true;
+			}
+		}
+		return;
+	}
+
+	for (int child : node.children)
+	{
+		SelectNode(child, pViewManager, proxyNodes, hiddenObjects);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+// hlodmanager.h
+// ============
+// build and select hierarchical LOD proxies for clustered static objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "DerivedDataCache.h"
+#include "MipGenerator.h"
+#include "ShapeMeshes.h"
+#include "ViewManager.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  HLODManager
+ *
+ *  This class groups nearby static objects into a hierarchy
+ *  of spatial clusters and bakes one merged, simplified
+ *  proxy mesh per cluster.  All proxies share one texture
+ *  atlas so a whole cluster draws with a single call.
+ ***********************************************************/
+class HLODManager
+{
+public:
+	// constructor, proxy meshes are cached in pDerivedDataCache when passed
+	HLODManager(ShapeMeshes* pShapeMeshes, DerivedDataCache* pDerivedDataCache = NULL);
+	// destructor
+	~HLODManager();
+
+	// a static object handed to the builder
+	struct HLOD_SOURCE
+	{
+		int objectIndex;				// index of the object in the scene
+		std::vector<GLfloat> triangles;	// world space triangle list (pos, normal, uv)
+		GLuint textureID;				// 0 when the object is untextured
+		glm::vec4 textureRect;			// UV offset and size of the image in the texture
+		glm::vec2 UVscale;				// times the image repeats over the object's UVs
+		bool bRepeat;					// repeat the image past its edges, or clamp
+		glm::vec4 color;				// flat color used when untextured
+		std::string materialTag;
+	};
+
+	// a cluster in the hierarchy
+	struct HLOD_NODE
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		float geometricError;			// world space error of the proxy
+		int proxyMesh;					// custom mesh index, -1 if none
+		std::string materialTag;		// dominant material of the cluster
+		std::vector<int> children;		// child clusters
+		std::vector<int> objects;		// every object below this cluster
+	};
+
+	// build the cluster hierarchy, the proxy meshes and the atlas,
+	// once: the proxy meshes stay with the shape meshes object
+	void Build(const std::vector<HLOD_SOURCE>& sources);
+	// free the atlas texture and forget the cluster hierarchy
+	void Clear();
+
+	// pick the clusters that can be drawn as proxies for the
+	// current view, and flag the objects they replace
+	void SelectProxies(
+		ViewManager* pViewManager,
+		std::vector<int>& proxyNodes,
+		std::vector<bool>& hiddenObjects);
+
+	const HLOD_NODE& GetNode(int nodeIndex) const { return m_nodes[nodeIndex]; }
+	GLuint GetAtlasTextureID() const { return m_atlasTextureID; }
+	// the cooked mips of the atlas, to be uploaded by the caller
+	const MipGenerator::MIP_CHAIN& GetAtlasChain() const { return m_atlasChain; }
+	// the texture uploaded from the atlas chain, freed by Clear();
+	// the chain is released once the texture is set
+	void SetAtlasTextureID(GLuint textureID);
+
+	// the largest allowed proxy error, in pixels
+	void SetMaxScreenError(float pixels) { m_maxScreenError = pixels; }
+
+private:
+	// pointer to the shape meshes object that owns the proxy meshes
+	ShapeMeshes* m_pShapeMeshes;
+	// cache of the simplified proxy meshes, may be NULL
+	DerivedDataCache* m_pDerivedDataCache;
+	// all the clusters, the roots are listed in m_rootNodes
+	std::vector<HLOD_NODE> m_nodes;
+	std::vector<int> m_rootNodes;
+	// shared texture atlas for every proxy, and its mips until
+	// they are uploaded
+	GLuint m_atlasTextureID;
+	MipGenerator::MIP_CHAIN m_atlasChain;
+	int m_atlasSize;
+	// atlas tile origin (in pixels) per source object
+	std::vector<glm::ivec2> m_sourceTiles;
+
+	// edge length of the leaf cluster cells
+	float m_leafClusterSize;
+	// proxy error relative to the cluster cell size
+	float m_errorRatio;
+	// the largest allowed proxy error, in pixels
+	float m_maxScreenError;
+
+	// pack every distinct texture / color into the atlas
+	void BuildAtlas(const std::vector<HLOD_SOURCE>& sources);
+	// merge and simplify the objects of a cluster into one mesh
+	int BuildProxyMesh(
+		const std::vector<HLOD_SOURCE>& sources,
+		HLOD_NODE& node);
+	// walk the hierarchy and select proxies
+	void SelectNode(
+		int nodeIndex,
+		ViewManager* pViewManager,
+		std::vector<int>& proxyNodes,
+		std::vector<bool>& hiddenObjects);
+};
\ No newline at end of file
@@ -0,0 +1,584 @@
+///////////////////////////////////////////////////////////////////////////////
+// ltctable.cpp
+// ============
+// fitted linearly transformed cosine tables for GGX area lights
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LTCTable.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// bump when the BRDF, the fit or the table layout changes
+	const uint32_t g_LTCTableVersion = 1;
+	// the error of a fit is integrated over g_FitSamples^2 directions
+	const int g_FitSamples = 32;
+	// smallest GGX alpha fitted, a mirror cannot be
+	const float g_MinAlpha = 0.00001f;
+	const float g_Pi = 3.14159265f;
+
+	/***********************************************************
+	 *  GGX_BRDF
+	 *
+	 *  The GGX microfacet BRDF with height correlated Smith
+	 *  shadowing, times the cosine of the light direction and
+	 *  without Fresnel, in the frame of the surface normal.
+	 ***********************************************************/
+	struct GGX_BRDF
+	{
+		static float Lambda(float alpha, float cosTheta)
+		{
+			if (cosTheta >= 1.0f)
+			{
+				return(0.0f);
+			}
+			float a = 1.0f / alpha / std::tan(std::acos(cosTheta));
+			return(0.5f * (-1.0f + std::sqrt(1.0f + 1.0f / (a * a))));
+		}
+
+		// the BRDF times cos(L), and the pdf of Sample() for L
+		static float Eval(const glm::vec3& V, const glm::vec3& L, float alpha, float& pdf)
+		{
+			if (V.z <= 0.0f)
+			{
+				pdf = 0.0f;
+				return(0.0f);
+			}
+
+			float lambdaV = Lambda(alpha, V.z);
+			float G2 = 0.0f;
+			if (L.z > 0.0f)
+			{
+				G2 = 1.0f / (1.0f + lambdaV + Lambda(alpha, L.z));
+			}
+
+			glm::vec3 H = glm::normalize(V + L);
+			float slopeX = H.x / H.z;
+			float slopeY = H.y / H.z;
+			float D = 1.0f / (1.0f + (slopeX * slopeX + slopeY * slopeY) / alpha / alpha);
+			D = D * D / (g_Pi * alpha * alpha * H.z * H.z * H.z * H.z);
+
+			pdf = std::abs(D * H.z / 4.0f / glm::dot(V, H));
+			return(D * G2 / 4.0f / V.z);
+		}
+
+		// a light direction reflected about a sampled microfacet normal
+		static glm::vec3 Sample(const glm::vec3& V, float alpha, float U1, float U2)
+		{
+			float phi = 2.0f * g_Pi * U1;
+			float r = alpha * std::sqrt(U2 / (1.0f - U2));
+			glm::vec3 N = glm::normalize(glm::vec3(r * std::cos(phi), r * std::sin(phi), 1.0f));
+			return(-V + 2.0f * N * glm::dot(N, V));
+		}
+	};
+
+	/***********************************************************
+	 *  LTC
+	 *
+	 *  A clamped cosine transformed by M = [X Y Z] * [m11 0 m13;
+	 *  0 m22 0; 0 0 1], where Z is the average direction of the
+	 *  lobe, and scaled by its integral.
+	 ***********************************************************/
+	struct LTC
+	{
+		float magnitude = 1.0f;
+		float fresnel = 1.0f;
+		float m11 = 1.0f;
+		float m22 = 1.0f;
+		float m13 = 0.0f;
+		glm::vec3 X = glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 Y = glm::vec3(0.0f, 1.0f, 0.0f);
+		glm::vec3 Z = glm::vec3(0.0f, 0.0f, 1.0f);
+
+		glm::mat3 M = glm::mat3(1.0f);
+		glm::mat3 invM = glm::mat3(1.0f);
+		float detM = 1.0f;
+
+		void Update()
+		{
+			M = glm::mat3(X, Y, Z) * glm::mat3(glm::vec3(m11, 0.0f, 0.0f), glm::vec3(0.0f, m22, 0.0f), glm::vec3(m13, 0.0f, 1.0f));
+			invM = glm::inverse(M);
+			detM = std::abs(glm::determinant(M));
+		}
+
+		float Eval(const glm::vec3& L) const
+		{
+			glm::vec3 original = glm::normalize(invM * L);
+			float length = glm::length(M * original);
+			float jacobian = detM / (length * length * length);
+			float D = std::max(0.0f, original.z) / g_Pi;
+			return(magnitude * D / jacobian);
+		}
+
+		glm::vec3 Sample(float U1, float U2) const
+		{
+			float theta = std::acos(std::sqrt(U1));
+			float phi = 2.0f * g_Pi * U2;
+			glm::vec3 L = glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+			return(glm::normalize(M * L));
+		}
+	};
+
+	/***********************************************************
+	 *  ComputeAverageTerms()
+	 *
+	 *  Integrate the BRDF lobe for a view direction: its
+	 *  magnitude, the part scaled by Schlick's (1 - V.H)^5,
+	 *  and its average direction in the plane of incidence.
+	 ***********************************************************/
+	void ComputeAverageTerms(const glm::vec3& V, float alpha, float& magnitude, float& fresnel, glm::vec3& averageDirection)
+	{
+		magnitude = 0.0f;
+		fresnel = 0.0f;
+		averageDirection = glm::vec3(0.0f);
+
+		for (int j = 0; j < g_FitSamples; j++)
+		{
+			for (int i = 0; i < g_FitSamples; i++)
+			{
+				float U1 = (i + 0.5f) / g_FitSamples;
+				float U2 = (j + 0.5f) / g_FitSamples;
+				glm::vec3 L = GGX_BRDF::Sample(V, alpha, U1, U2);
+				float pdf = 0.0f;
+				float value = GGX_BRDF::Eval(V, L, alpha, pdf);
+				if (pdf > 0.0f)
+				{
+					float weight = value / pdf;
+					glm::vec3 H = glm::normalize(V + L);
+					magnitude += weight;
+					fresnel += weight * std::pow(1.0f - std::max(glm::dot(V, H), 0.0f), 5.0f);
+					averageDirection += weight * L;
+				}
+			}
+		}
+		magnitude /= (float)(g_FitSamples * g_FitSamples);
+		fresnel /= (float)(g_FitSamples * g_FitSamples);
+
+		// the lobe is symmetric about the plane of incidence
+		averageDirection.y = 0.0f;
+		averageDirection = glm::normalize(averageDirection);
+	}
+
+	/***********************************************************
+	 *  ComputeError()
+	 *
+	 *  The cubed difference between the LTC and the BRDF,
+	 *  integrated with multiple importance sampling of both.
+	 ***********************************************************/
+	float ComputeError(const LTC& ltc, const glm::vec3& V, float alpha)
+	{
+		double error = 0.0;
+		for (int j = 0; j < g_FitSamples; j++)
+		{
+			for (int i = 0; i < g_FitSamples; i++)
+			{
+				float U1 = (i + 0.5f) / g_FitSamples;
+				float U2 = (j + 0.5f) / g_FitSamples;
+				glm::vec3 directions[2] = { ltc.Sample(U1, U2), GGX_BRDF::Sample(V, alpha, U1, U2) };
+				for (const glm::vec3& L : directions)
+				{
+					float pdfBRDF = 0.0f;
+					float valueBRDF = GGX_BRDF::Eval(V, L, alpha, pdfBRDF);
+					float valueLTC = ltc.Eval(L);
+					float pdfLTC = valueLTC / ltc.magnitude;
+					double difference = std::abs(valueBRDF - valueLTC);
+					if (pdfLTC + pdfBRDF > 0.0f)
+					{
+						error += difference * difference * difference / (pdfLTC + pdfBRDF);
+					}
+				}
+			}
+		}
+		return((float)(error / (g_FitSamples * g_FitSamples)));
+	}
+
+	/***********************************************************
+	 *  SetParameters()
+	 *
+	 *  Apply the searched parameters to the LTC, an isotropic
+	 *  one only uses the first.
+	 ***********************************************************/
+	void SetParameters(LTC& ltc, const float* parameters, bool bIsotropic)
+	{
+		ltc.m11 = std::max(parameters[0], 1e-7f);
+		ltc.m22 = bIsotropic ? ltc.m11 : std::max(parameters[1], 1e-7f);
+		ltc.m13 = bIsotropic ? 0.0f : parameters[2];
+		ltc.Update();
+	}
+
+	/***********************************************************
+	 *  FitLTC()
+	 *
+	 *  Search m11, m22 and m13 with the Nelder-Mead simplex,
+	 *  starting from the current values of the LTC.
+	 ***********************************************************/
+	void FitLTC(LTC& ltc, const glm::vec3& V, float alpha, bool bIsotropic)
+	{
+		const int dimensions = 3;
+		const int maxIterations = 100;
+		const float delta = 0.05f;
+		const float tolerance = 1e-5f;
+
+		float simplex[dimensions + 1][dimensions];
+		float values[dimensions + 1];
+		auto evaluate = [&](const float* parameters)
+		{
+			SetParameters(ltc, parameters, bIsotropic);
+			return(ComputeError(ltc, V, alpha));
+		};
+
+		float start[dimensions] = { ltc.m11, ltc.m22, ltc.m13 };
+		for (int p = 0; p <= dimensions; p++)
+		{
+			std::memcpy(simplex[p], start, sizeof(start));
+			if (p > 0)
+			{
+				simplex[p][p - 1] += delta;
+			}
+			values[p] = evaluate(simplex[p]);
+		}
+
+		int best = 0;
+		for (int iteration = 0; iteration < maxIterations; iteration++)
+		{
+			// the best, the worst and the second worst points
+			best = 0;
+			int worst = 0;
+			for (int p = 1; p <= dimensions; p++)
+			{
+				best = (values[p] < values[best]) ? p : best;
+				worst = (values[p] > values[worst]) ? p : worst;
+			}
+			int secondWorst = (worst == 0) ? 1 : 0;
+			for (int p = 0; p <= dimensions; p++)
+			{
+				secondWorst = ((p != worst) && (values[p] > values[secondWorst])) ? p : secondWorst;
+			}
+
+			float low = std::abs(values[best]);
+			float high = std::abs(values[worst]);
+			if (2.0f * std::abs(low - high) < (low + high) * tolerance)
+			{
+				break;
+			}
+
+			// centroid of all points but the worst
+			float centroid[dimensions] = {};
+			for (int p = 0; p <= dimensions; p++)
+			{
+				if (p == worst)
+				{
+					continue;
+				}
+				for (int d = 0; d < dimensions; d++)
+				{
+					centroid[d] += simplex[p][d] / dimensions;
+				}
+			}
+
+			auto along = [&](float scale, float* point)
+			{
+				for (int d = 0; d < dimensions; d++)
+				{
+					point[d] = centroid[d] + scale * (centroid[d] - simplex[worst][d]);
+				}
+				return(evaluate(point));
+			};
+
+			float reflected[dimensions];
+			float reflectedValue = along(1.0f, reflected);
+			if (reflectedValue < values[secondWorst])
+			{
+				float expanded[dimensions];
+				float expandedValue = (reflectedValue < values[best]) ? along(2.0f, expanded) : reflectedValue;
+				bool bExpand = (expandedValue < reflectedValue);
+				std::memcpy(simplex[worst], bExpand ? expanded : reflected, sizeof(reflected));
+				values[worst] = bExpand ? expandedValue : reflectedValue;
+				continue;
+			}
+
+			float contracted[dimensions];
+			float contractedValue = along(-0.5f, contracted);
+			if (contractedValue < values[worst])
+			{
+				std::memcpy(simplex[worst], contracted, sizeof(contracted));
+				values[worst] = contractedValue;
+				continue;
+			}
+
+			// shrink toward the best point
+			for (int p = 0; p <= dimensions; p++)
+			{
+				if (p == best)
+				{
+					continue;
+				}
+				for (int d = 0; d < dimensions; d++)
+				{
+					simplex[p][d] = simplex[best][d] + 0.5f * (simplex[p][d] - simplex[best][d]);
+				}
+				values[p] = evaluate(simplex[p]);
+			}
+		}
+
+		for (int p = 1; p <= dimensions; p++)
+		{
+			best = (values[p] < values[best]) ? p : best;
+		}
+		SetParameters(ltc, simplex[best], bIsotropic);
+	}
+
+	/***********************************************************
+	 *  FitEntry()
+	 *
+	 *  Fit the LTC of one roughness and view angle.  At normal
+	 *  incidence the lobe is isotropic; away from it the LTC
+	 *  is turned toward the average direction of the lobe.
+	 *  The values of ltc are the start of the search.
+	 ***********************************************************/
+	void FitEntry(LTC& ltc, int size, int roughnessIndex, int angleIndex)
+	{
+		float x = angleIndex / (float)(size - 1);
+		float theta = std::min(1.57f, std::acos(1.0f - x * x));
+		glm::vec3 V = glm::vec3(std::sin(theta), 0.0f, std::cos(theta));
+		float roughness = roughnessIndex / (float)(size - 1);
+		float alpha = std::max(roughness * roughness, g_MinAlpha);
+
+		glm::vec3 averageDirection;
+		ComputeAverageTerms(V, alpha, ltc.magnitude, ltc.fresnel, averageDirection);
+
+		bool bIsotropic = (angleIndex == 0);
+		if (bIsotropic == true)
+		{
+			ltc.X = glm::vec3(1.0f, 0.0f, 0.0f);
+			ltc.Y = glm::vec3(0.0f, 1.0f, 0.0f);
+			ltc.Z = glm::vec3(0.0f, 0.0f, 1.0f);
+			ltc.m13 = 0.0f;
+		}
+		else
+		{
+			ltc.X = glm::vec3(averageDirection.z, 0.0f, -averageDirection.x);
+			ltc.Y = glm::vec3(0.0f, 1.0f, 0.0f);
+			ltc.Z = averageDirection;
+		}
+		ltc.Update();
+
+		FitLTC(ltc, V, alpha, bIsotropic);
+	}
+}
+
+/***********************************************************
+ *  LTCTable()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LTCTable::LTCTable(DerivedDataCache* pDerivedDataCache)
+{
+	m_pDerivedDataCache = pDerivedDataCache;
+	m_matrixTexture = 0;
+	m_amplitudeTexture = 0;
+	m_bFitDone = false;
+	m_bCancelFit = false;
+}
+
+/***********************************************************
+ *  ~LTCTable()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LTCTable::~LTCTable()
+{
+	// a fit still running is abandoned
+	m_bCancelFit = true;
+	if (m_fitThread.joinable())
+	{
+		m_fitThread.join();
+	}
+	GLuint textures[2] = { m_matrixTexture, m_amplitudeTexture };
+	glDeleteTextures(2, textures);
+	m_matrixTexture = 0;
+	m_amplitudeTexture = 0;
+	m_pDerivedDataCache = NULL;
+}
+
+/***********************************************************
+ *  Fit()
+ *
+ *  This method is used for fitting the whole table, from
+ *  the roughest lobe to the sharpest so every fit starts
+ *  from a close neighbour.  The normal incidence column is
+ *  fitted first, then the rows of the other view angles
+ *  are spread over threads.  The inverse matrices are
+ *  stored divided by their middle element, which leaves
+ *  four values per entry.
+ ***********************************************************/
+bool LTCTable::Fit(int size, std::vector<float>& matrices, std::vector<float>& amplitudes, const std::atomic<bool>& bCancel)
+{
+	std::vector<LTC> fits(size * size);
+
+	LTC ltc;
+	for (int a = size - 1; (a >= 0) && (bCancel == false); a--)
+	{
+		FitEntry(ltc, size, a, 0);
+		fits[a] = ltc;
+	}
+
+	std::atomic<int> nextRow(size - 1);
+	auto fitRows = [&]()
+	{
+		for (int a = nextRow--; (a >= 0) && (bCancel == false); a = nextRow--)
+		{
+			LTC rowLTC = fits[a];
+			for (int t = 1; (t < size) && (bCancel == false); t++)
+			{
+				FitEntry(rowLTC, size, a, t);
+				fits[a + t * size] = rowLTC;
+			}
+		}
+	};
+	int threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threadCount; i++)
+	{
+		workers.push_back(std::thread(fitRows));
+	}
+	fitRows();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	if (bCancel == true)
+	{
+		return(false);
+	}
+
+	matrices.resize(size * size * 4);
+	amplitudes.resize(size * size * 2);
+	for (int i = 0; i < size * size; i++)
+	{
+		glm::mat3 M = fits[i].M;
+		// the fit only uses the plane of incidence
+		M[0][1] = 0.0f;
+		M[1][0] = 0.0f;
+		M[2][1] = 0.0f;
+		M[1][2] = 0.0f;
+		glm::mat3 invM = glm::inverse(M);
+		invM /= invM[1][1];
+
+		matrices[i * 4 + 0] = invM[0][0];
+		matrices[i * 4 + 1] = invM[0][2];
+		matrices[i * 4 + 2] = invM[2][0];
+		matrices[i * 4 + 3] = invM[2][2];
+		amplitudes[i * 2 + 0] = fits[i].magnitude;
+		amplitudes[i * 2 + 1] = fits[i].fresnel;
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  GetCacheKey()
+ ***********************************************************/
+DerivedDataCache::CACHE_KEY LTCTable::GetCacheKey() const
+{
+	return(DerivedDataCache::KeyBuilder("LTCTable", g_LTCTableVersion)
+		.AddValue((int32_t)TABLE_SIZE)
+		.AddValue((int32_t)g_FitSamples)
+		.GetKey());
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for uploading the tables from the
+ *  cache.  Without a cached copy the fit is started on a
+ *  background thread, which takes a while, and Update()
+ *  uploads and caches the result when it is done.
+ ***********************************************************/
+void LTCTable::Create()
+{
+	const int entries = TABLE_SIZE * TABLE_SIZE;
+	size_t matrixBytes = entries * 4 * sizeof(float);
+	size_t amplitudeBytes = entries * 2 * sizeof(float);
+
+	std::vector<unsigned char> cached;
+	if ((NULL != m_pDerivedDataCache) && m_pDerivedDataCache->Get(GetCacheKey(), cached) &&
+		(cached.size() == matrixBytes + amplitudeBytes))
+	{
+		m_matrices.resize(entries * 4);
+		m_amplitudes.resize(entries * 2);
+		std::memcpy(m_matrices.data(), cached.data(), matrixBytes);
+		std::memcpy(m_amplitudes.data(), cached.data() + matrixBytes, amplitudeBytes);
+		Upload();
+		return;
+	}
+
+	std::cout << "Fitting the " << TABLE_SIZE << "x" << TABLE_SIZE << " LTC area light tables in the background" << std::endl;
+	m_fitThread = std::thread([this]()
+	{
+		if (Fit(TABLE_SIZE, m_matrices, m_amplitudes, m_bCancelFit) == true)
+		{
+			m_bFitDone = true;
+		}
+	});
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for checking on the background fit
+ *  and uploading and caching its tables once it is done.
+ ***********************************************************/
+bool LTCTable::Update()
+{
+	if ((m_bFitDone == false) || (m_matrixTexture != 0))
+	{
+		return(false);
+	}
+
+	m_fitThread.join();
+	Upload();
+	std::cout << "LTC area light tables ready" << std::endl;
+
+	if (NULL != m_pDerivedDataCache)
+	{
+		std::vector<unsigned char> cached(m_matrices.size() * sizeof(float) + m_amplitudes.size() * sizeof(float));
+		std::memcpy(cached.data(), m_matrices.data(), m_matrices.size() * sizeof(float));
+		std::memcpy(cached.data() + m_matrices.size() * sizeof(float), m_amplitudes.data(), m_amplitudes.size() * sizeof(float));
+		m_pDerivedDataCache->Put(GetCacheKey(), cached);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for creating the float textures of
+ *  the tables, filtered linearly between entries.
+ ***********************************************************/
+void LTCTable::Upload()
+{
+	const int size = TABLE_SIZE;
+	GLuint textures[2] = { 0, 0 };
+	glCreateTextures(GL_TEXTURE_2D, 2, textures);
+	glTextureStorage2D(textures[0], 1, GL_RGBA32F, size, size);
+	glTextureSubImage2D(textures[0], 0, 0, 0, size, size, GL_RGBA, GL_FLOAT, m_matrices.data());
+	glTextureStorage2D(textures[1], 1, GL_RG32F, size, size);
+	glTextureSubImage2D(textures[1], 0, 0, 0, size, size, GL_RG, GL_FLOAT, m_amplitudes.data());
+	for (GLuint texture : textures)
+	{
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	m_matrixTexture = textures[0];
+	m_amplitudeTexture = textures[1];
+}
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// ltctable.h
+// ============
+// fitted linearly transformed cosine tables for GGX area lights
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "DerivedDataCache.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  LTCTable
+ *
+ *  This class builds the lookup tables of linearly
+ *  transformed cosines (Heitz et al. 2016).  For every GGX
+ *  roughness and view angle, a 3x3 matrix turns a clamped
+ *  cosine into the shape of the specular lobe, so the light
+ *  of a polygon is the closed form integral of a cosine over
+ *  the polygon transformed by the inverse matrix.  A second
+ *  table holds the integral of the lobe and its Schlick
+ *  Fresnel part.
+ *
+ *  The matrices are fitted on the CPU with a Nelder-Mead
+ *  search on the first run, on a background thread so the
+ *  scene starts at once, and cached after that.
+ ***********************************************************/
+class LTCTable
+{
+public:
+	// constructor, the fitted tables are cached in pDerivedDataCache when passed
+	LTCTable(DerivedDataCache* pDerivedDataCache = NULL);
+	// destructor
+	~LTCTable();
+
+	// entries per side, indexed by roughness and sqrt(1 - cos(view angle))
+	static const int TABLE_SIZE = 64;
+
+	// upload the tables from the cache, or start fitting them
+	void Create();
+	// upload the tables once the fit has finished, once per frame;
+	// true on the frame they become ready
+	bool Update();
+	bool IsReady() const { return(m_matrixTexture != 0); }
+
+	// the inverse matrices as (m00, m02, m20, m22), with m11 = 1
+	GLuint GetMatrixTexture() const { return m_matrixTexture; }
+	// the lobe integral and its Fresnel part
+	GLuint GetAmplitudeTexture() const { return m_amplitudeTexture; }
+
+	// fit size x size entries, 4 floats per matrix and 2 per
+	// amplitude; false when bCancel was set before the end
+	static bool Fit(int size, std::vector<float>& matrices, std::vector<float>& amplitudes, const std::atomic<bool>& bCancel);
+
+private:
+	// cache of the fitted tables, may be NULL
+	DerivedDataCache* m_pDerivedDataCache;
+
+	GLuint m_matrixTexture;
+	GLuint m_amplitudeTexture;
+
+	// background fit and its results
+	std::thread m_fitThread;
+	std::atomic<bool> m_bFitDone;
+	std::atomic<bool> m_bCancelFit;
+	std::vector<float> m_matrices;
+	std::vector<float> m_amplitudes;
+
+	// the cache key of the tables
+	DerivedDataCache::CACHE_KEY GetCacheKey() const;
+	// create the textures from m_matrices and m_amplitudes
+	void Upload();
+};
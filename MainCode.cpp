@@ -1,5 +1,8 @@
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <algorithm>        // std::min
+#include <cstring>          // strcmp
+#include <sstream>          // trace event arguments
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -13,6 +16,10 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "DerivedDataCache.h"
+#include "QualityManager.h"
+#include "FrameProfiler.h"
+#include "FrameGovernor.h"
 
 // Namespace for declaring global variables
 namespace
@@ -29,12 +36,26 @@ namespace
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// on-disk cache of cooked data (program binaries, decoded textures, proxies)
+	DerivedDataCache* g_DerivedDataCache = nullptr;
+	const char* const DERIVED_DATA_DIRECTORY = "DerivedDataCache";
+	const uint64_t DERIVED_DATA_MAX_BYTES = 512ull * 1024 * 1024;
+	// rolling frame times and the trace of the governor's changes
+	FrameProfiler* g_FrameProfiler = nullptr;
+	const char* const FRAME_TRACE_FILE = "frame_trace.json";
+	// keeps the frame time on target by scaling the quality settings
+	FrameGovernor* g_FrameGovernor = nullptr;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+void ProcessRenderPathKey();
+void ReportRayShadowTimes();
+void ReportShadingLODSavings();
+void ProcessAnimationKey();
+void ReportAnimationTimes();
 
 
 /***********************************************************
@@ -45,6 +66,17 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// --stress adds a field of small high polygon objects to the scene,
+	// for comparing the render paths
+	bool bStressTest = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--stress") == 0)
+		{
+			bStressTest = true;
+		}
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -66,20 +98,86 @@ int main(int argc, char* argv[])
 		return(EXIT_FAILURE);
 	}
 
-	// load the shader code from the external GLSL files
+	// open the derived data cache shared by the shader and asset cookers,
+	// the application still runs (uncached) if it cannot be opened
+	g_DerivedDataCache = new DerivedDataCache();
+	if (g_DerivedDataCache->Open(DERIVED_DATA_DIRECTORY, DERIVED_DATA_MAX_BYTES) == true)
+	{
+		g_ShaderManager->m_pDerivedDataCache = g_DerivedDataCache;
+	}
+
+	// pick the quality tier for this GPU, benchmarked on the first run
+	// and cached per renderer after that
+	QualityManager* pQualityManager = new QualityManager(
+		g_DerivedDataCache->IsOpen() ? g_DerivedDataCache : NULL);
+	QualityManager::QUALITY_TIER qualityTier = pQualityManager->DetectTier(
+		g_ViewManager->GetWindowWidth(),
+		g_ViewManager->GetWindowHeight());
+	delete pQualityManager;
+	const QualityManager::QUALITY_SETTINGS& quality = QualityManager::GetSettings(qualityTier);
+	g_ViewManager->SetRenderQuality(quality.resolutionScale, quality.msaaSamples);
+
+	// load the shader code from the external GLSL files, with the
+	// vertex inputs generated from the shape mesh vertex layout
 	g_ShaderManager->LoadShaders(
 		"../../Utilities/shaders/vertexShader.glsl",
-		"../../Utilities/shaders/fragmentShader.glsl");
+		"../../Utilities/shaders/fragmentShader.glsl",
+		ShapeMeshes::VertexLayout::GLSLDeclaration());
 	g_ShaderManager->use();
 
 	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager = new SceneManager(g_ShaderManager, g_ViewManager,
+		g_DerivedDataCache->IsOpen() ? g_DerivedDataCache : NULL);
+	g_SceneManager->SetQualitySettings(quality);
+	g_SceneManager->SetStressTest(bStressTest);
 	g_SceneManager->PrepareScene();
 
+	// from here on, trade quality below the tier for frame time when
+	// the load goes up; the HLOD switch distance goes first, then the
+	// render scale, then the lights, the voxel indirect light and the
+	// distance field shadows
+	g_FrameProfiler = new FrameProfiler();
+	g_FrameProfiler->OpenTrace(FRAME_TRACE_FILE);
+	g_FrameGovernor = new FrameGovernor(g_FrameProfiler);
+	int msaaSamples = quality.msaaSamples;
+	g_FrameGovernor->AddKnob("lod screen error", 0,
+		quality.lodScreenError, 16.0f, 2.0f, true, true,
+		[](float value) { g_SceneManager->SetLODScreenError(value); });
+	g_FrameGovernor->AddKnob("shading lod", 0,
+		1.0f, 4.0f, 0.5f, false, true,
+		[](float value) { g_SceneManager->SetShadingLODScale(value); });
+	g_FrameGovernor->AddKnob("render scale", 1,
+		quality.resolutionScale, std::min(quality.resolutionScale, 0.5f), 0.125f, false, true,
+		[msaaSamples](float value) { g_ViewManager->SetRenderQuality(value, msaaSamples); });
+	g_FrameGovernor->AddKnob("light count", 2,
+		(float)quality.lightCount, 1.0f, 1.0f, false, true,
+		[](float value) { g_SceneManager->SetLightCount((int)value); });
+	if (quality.bVoxelGI == true)
+	{
+		g_FrameGovernor->AddKnob("voxel gi", 3,
+			1.0f, 0.0f, 1.0f, true, true,
+			[](float value) { g_SceneManager->SetVoxelGI(value > 0.5f); });
+	}
+	if ((quality.shadowResolution > 0) || (quality.bSSAO == true))
+	{
+		bool bShadows = (quality.shadowResolution > 0);
+		bool bOcclusion = quality.bSSAO;
+		g_FrameGovernor->AddKnob("sdf shadows", 3,
+			1.0f, 0.0f, 1.0f, false, true,
+			[bShadows, bOcclusion](float value) { g_SceneManager->SetSDFShadows(bShadows && (value > 0.5f), bOcclusion && (value > 0.5f)); });
+	}
+	// the stress test compares the render paths at fixed settings
+	g_FrameGovernor->SetEnabled(bStressTest == false);
+
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
+		g_FrameProfiler->BeginFrame();
+
+		// draw into the scaled scene target, when there is one
+		g_ViewManager->BeginSceneFrame();
+
 		// Enable z-depth
 		glEnable(GL_DEPTH_TEST);
 
@@ -93,6 +191,14 @@ int main(int argc, char* argv[])
 		// refresh the 3D scene
 		g_SceneManager->RenderScene();
 
+		// copy the scene target into the window
+		g_ViewManager->EndSceneFrame();
+
+		// adjust the quality to the measured frame times
+		g_FrameProfiler->EndFrame();
+		g_FrameGovernor->Update();
+		ProcessRenderPathKey();
+		ProcessAnimationKey();
 
 		// Flips the the back buffer with the front buffer every frame.
 		glfwSwapBuffers(g_Window);
@@ -100,8 +206,21 @@ int main(int argc, char* argv[])
 		// query the latest GLFW events
 		glfwPollEvents();
 	}
+	ReportRayShadowTimes();
+	ReportShadingLODSavings();
+	ReportAnimationTimes();
 
 	// clear the allocated manager objects from memory
+	if (NULL != g_FrameGovernor)
+	{
+		delete g_FrameGovernor;
+		g_FrameGovernor = NULL;
+	}
+	if (NULL != g_FrameProfiler)
+	{
+		delete g_FrameProfiler;
+		g_FrameProfiler = NULL;
+	}
 	if (NULL != g_SceneManager)
 	{
 		delete g_SceneManager;
@@ -117,6 +236,11 @@ int main(int argc, char* argv[])
 		delete g_ShaderManager;
 		g_ShaderManager = NULL;
 	}
+	if (NULL != g_DerivedDataCache)
+	{
+		delete g_DerivedDataCache;
+		g_DerivedDataCache = NULL;
+	}
 
 	// Terminates the program successfully
 	exit(EXIT_SUCCESS); 
@@ -174,4 +298,149 @@ bool InitializeGLEW()
 	std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << "\n" << std::endl;
 
 	return(true);
+}
+
+/***********************************************************
+ *	ProcessRenderPathKey()
+ *
+ *  This function is used to switch between shading the
+ *  objects as they are drawn and the visibility buffer
+ *  with the V key.  The frame times of the path being left
+ *  are written to the trace and the console, so the two
+ *  can be compared on the same view.
+ ***********************************************************/
+void ProcessRenderPathKey()
+{
+	static bool bKeyPressed = false;
+
+	if (glfwGetKey(g_Window, GLFW_KEY_V) == GLFW_RELEASE)
+	{
+		bKeyPressed = false;
+		return;
+	}
+	if (bKeyPressed == true)
+	{
+		return;
+	}
+	bKeyPressed = true;
+
+	bool bVisibilityBuffer = g_SceneManager->GetVisibilityBuffer();
+	const char* pathName = bVisibilityBuffer ? "visibility buffer" : "forward";
+	std::cout << "Render path " << pathName << ": " << g_FrameProfiler->GetCPUTime() << " ms CPU, "
+		<< g_FrameProfiler->GetGPUTime() << " ms GPU" << std::endl;
+
+	std::ostringstream arguments;
+	arguments << "\"path\":\"" << pathName << "\""
+		<< ",\"cpu_ms\":" << g_FrameProfiler->GetCPUTime()
+		<< ",\"gpu_ms\":" << g_FrameProfiler->GetGPUTime();
+	g_FrameProfiler->TraceEvent("render path", arguments.str());
+
+	g_SceneManager->SetVisibilityBuffer(bVisibilityBuffer == false);
+}
+
+/***********************************************************
+ *	ReportRayShadowTimes()
+ *
+ *  This function is used to write the GPU time the ray
+ *  traced shadows took with each number of lights casting
+ *  them to the trace and the console, so their cost can be
+ *  compared as the light count goes up.  Counts that were
+ *  never traced are left out.
+ ***********************************************************/
+void ReportRayShadowTimes()
+{
+	for (int lightCount = 0; lightCount <= TOTAL_LIGHTS; lightCount++)
+	{
+		float milliseconds = g_SceneManager->GetRayShadowTime(lightCount);
+		if (milliseconds <= 0.0f)
+		{
+			continue;
+		}
+		std::cout << "Ray traced shadows, " << lightCount << " lights: " << milliseconds << " ms GPU" << std::endl;
+
+		std::ostringstream arguments;
+		arguments << "\"lights\":" << lightCount << ",\"gpu_ms\":" << milliseconds;
+		g_FrameProfiler->TraceEvent("ray shadows", arguments.str());
+	}
+}
+
+/***********************************************************
+ *	ReportShadingLODSavings()
+ *
+ *  This function is used to write the fragments lit per
+ *  pixel, per vertex and flat in the measured frames, and
+ *  the fragment ALU cycles the cheaper lighting is
+ *  estimated to have saved per frame, to the trace and the
+ *  console.  Nothing is written when no frame was measured.
+ ***********************************************************/
+void ReportShadingLODSavings()
+{
+	double fragments[3] = { 0.0, 0.0, 0.0 };
+	double savedCycles = 0.0;
+	g_SceneManager->GetShadingLODSavings(fragments, savedCycles);
+	if (fragments[0] + fragments[1] + fragments[2] <= 0.0)
+	{
+		return;
+	}
+	std::cout << "Shading LOD, fragments per frame: " << fragments[0] << " per pixel, "
+		<< fragments[1] << " per vertex, " << fragments[2] << " flat; "
+		<< savedCycles << " fragment ALU cycles saved (estimated)" << std::endl;
+
+	std::ostringstream arguments;
+	arguments << "\"full_fragments\":" << fragments[0] << ",\"vertex_fragments\":" << fragments[1]
+		<< ",\"flat_fragments\":" << fragments[2] << ",\"saved_cycles\":" << savedCycles;
+	g_FrameProfiler->TraceEvent("shading lod", arguments.str());
+}
+
+/***********************************************************
+ *	ProcessAnimationKey()
+ *
+ *  This function is used to play or pause the keyframed
+ *  animations of the scene with the K key.
+ ***********************************************************/
+void ProcessAnimationKey()
+{
+	static bool bKeyPressed = false;
+
+	if (glfwGetKey(g_Window, GLFW_KEY_K) == GLFW_RELEASE)
+	{
+		bKeyPressed = false;
+		return;
+	}
+	if (bKeyPressed == true)
+	{
+		return;
+	}
+	bKeyPressed = true;
+
+	bool bPlaying = (g_SceneManager->GetAnimationPlaying() == false);
+	g_SceneManager->SetAnimationPlaying(bPlaying);
+	std::cout << "Animations " << (bPlaying ? "playing" : "paused") << std::endl;
+}
+
+/***********************************************************
+ *	ReportAnimationTimes()
+ *
+ *  This function is used to write the CPU time of the
+ *  batched curve evaluation per frame, with the channels
+ *  it evaluated and the ones the update rate LOD skipped,
+ *  to the trace and the console.  Nothing is written when
+ *  nothing was evaluated.
+ ***********************************************************/
+void ReportAnimationTimes()
+{
+	double milliseconds = 0.0;
+	double evaluated = 0.0;
+	double skipped = 0.0;
+	g_SceneManager->GetAnimationStats(milliseconds, evaluated, skipped);
+	if (evaluated <= 0.0)
+	{
+		return;
+	}
+	std::cout << "Animation: " << milliseconds << " ms CPU per frame, "
+		<< evaluated << " channels evaluated, " << skipped << " skipped" << std::endl;
+
+	std::ostringstream arguments;
+	arguments << "\"cpu_ms\":" << milliseconds << ",\"evaluated\":" << evaluated << ",\"skipped\":" << skipped;
+	g_FrameProfiler->TraceEvent("animation", arguments.str());
 }
\ No newline at end of file
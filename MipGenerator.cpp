@@ -0,0 +1,497 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipgenerator.cpp
+// ============
+// gamma-correct mipmap chain generation for cooked textures
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define MIPGENERATOR_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// entries in the linear to sRGB table
+	const int g_LinearTableSize = 16384;
+	// destination rows per band before a level is split over threads
+	const int g_MinBandRows = 32;
+
+	/***********************************************************
+	 *  SRGB_TABLES
+	 *
+	 *  Lookup tables for decoding 8 bit sRGB to linear light
+	 *  and for encoding linear light back to 8 bit sRGB.
+	 ***********************************************************/
+	struct SRGB_TABLES
+	{
+		float toLinear[256];
+		unsigned char toSRGB[g_LinearTableSize];
+
+		SRGB_TABLES()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float c = i / 255.0f;
+				toLinear[i] = (c <= 0.04045f) ? (c / 12.92f) : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (int i = 0; i < g_LinearTableSize; i++)
+			{
+				float c = (float)i / (g_LinearTableSize - 1);
+				float s = (c <= 0.0031308f) ? (c * 12.92f) : (1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f);
+				toSRGB[i] = (unsigned char)std::min(255.0f, s * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const SRGB_TABLES& GetSRGBTables()
+	{
+		static const SRGB_TABLES tables;
+		return(tables);
+	}
+
+	unsigned char EncodeLinear(float value)
+	{
+		return((unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f));
+	}
+
+	unsigned char EncodeSRGB(float value)
+	{
+		int index = (int)(std::min(std::max(value, 0.0f), 1.0f) * (g_LinearTableSize - 1) + 0.5f);
+		return(GetSRGBTables().toSRGB[index]);
+	}
+
+	// modified Bessel function of the first kind, order 0
+	double BesselI0(double x)
+	{
+		double sum = 1.0;
+		double term = 1.0;
+		for (int k = 1; k < 64; k++)
+		{
+			term *= (x * 0.5 / k) * (x * 0.5 / k);
+			sum += term;
+			if (term < sum * 1.0e-12)
+			{
+				break;
+			}
+		}
+		return(sum);
+	}
+
+	// the fraction of texels whose scaled alpha passes the cutoff
+	float AlphaCoverage(const std::vector<float>& texels, int alphaIndex, float scale, float cutoff)
+	{
+		size_t passed = 0;
+		size_t count = texels.size() / 4;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (std::min(1.0f, texels[i * 4 + alphaIndex] * scale) > cutoff)
+			{
+				passed++;
+			}
+		}
+		return((float)passed / (float)count);
+	}
+}
+
+/***********************************************************
+ *  MipGenerator()
+ *
+ *  The constructor for the class.  The filter is the Kaiser
+ *  windowed sinc with a radius of 3 and alpha of 4.
+ ***********************************************************/
+MipGenerator::MipGenerator()
+{
+	m_filterRadius = 3.0f;
+	m_kaiserAlpha = 4.0f;
+	m_bSRGB = true;
+	m_bWrap = true;
+	m_alphaCutoff = -1.0f;
+	m_threadCount = 0;
+}
+
+/***********************************************************
+ *  GetLevelCount()
+ ***********************************************************/
+int MipGenerator::GetLevelCount(int width, int height)
+{
+	int levels = 1;
+	while ((width > 1) || (height > 1))
+	{
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+		levels++;
+	}
+	return(levels);
+}
+
+/***********************************************************
+ *  GetLevelLayout()
+ *
+ *  This method is used for getting the size and offset of
+ *  every level of a tightly packed chain, and returns the
+ *  total size in bytes.
+ ***********************************************************/
+size_t MipGenerator::GetLevelLayout(
+	int width,
+	int height,
+	int colorChannels,
+	std::vector<MIP_LEVEL>& levels)
+{
+	levels.clear();
+	size_t offset = 0;
+	int levelCount = GetLevelCount(width, height);
+	for (int i = 0; i < levelCount; i++)
+	{
+		levels.push_back({ width, height, offset });
+		offset += (size_t)width * height * colorChannels;
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	return(offset);
+}
+
+/***********************************************************
+ *  FilterWeight()
+ *
+ *  This method is used for evaluating the Kaiser windowed
+ *  sinc filter at a distance in destination texels.
+ ***********************************************************/
+float MipGenerator::FilterWeight(float x) const
+{
+	x = std::fabs(x);
+	if (x >= m_filterRadius)
+	{
+		return(0.0f);
+	}
+
+	const double pi = 3.14159265358979323846;
+	double sinc = (x < 1.0e-6f) ? 1.0 : std::sin(pi * x) / (pi * x);
+	double t = x / m_filterRadius;
+	double window = BesselI0(m_kaiserAlpha * std::sqrt(1.0 - t * t)) / BesselI0(m_kaiserAlpha);
+	return((float)(sinc * window));
+}
+
+/***********************************************************
+ *  BuildTaps()
+ *
+ *  This method is used for working out, for every texel of
+ *  a destination row (or column), which source texels the
+ *  filter covers and with what normalized weights.  The
+ *  source wraps around, matching the repeat addressing the
+ *  scene textures are sampled with, unless wrapping is off
+ *  and the edge texels are repeated instead.
+ ***********************************************************/
+void MipGenerator::BuildTaps(int srcSize, int dstSize, FILTER_TAPS& taps) const
+{
+	if (srcSize == dstSize)
+	{
+		taps.tapCount = 1;
+		taps.indices.resize(dstSize);
+		taps.weights.assign(dstSize, 1.0f);
+		for (int i = 0; i < dstSize; i++)
+		{
+			taps.indices[i] = i;
+		}
+		return;
+	}
+
+	float scale = (float)srcSize / (float)dstSize;
+	float support = m_filterRadius * scale;
+	taps.tapCount = (int)std::ceil(support * 2.0f) + 1;
+	taps.indices.resize(dstSize * taps.tapCount);
+	taps.weights.resize(dstSize * taps.tapCount);
+
+	// halving an even size puts every texel at the same phase,
+	// so the weights are only worked out when the phase changes
+	float lastPhase = -1.0f;
+	std::vector<float> phaseWeights(taps.tapCount);
+	for (int i = 0; i < dstSize; i++)
+	{
+		float center = (i + 0.5f) * scale;
+		int first = (int)std::floor(center - support);
+		float phase = center - first;
+		if (phase != lastPhase)
+		{
+			float sum = 0.0f;
+			for (int t = 0; t < taps.tapCount; t++)
+			{
+				phaseWeights[t] = FilterWeight((t + 0.5f - phase) / scale);
+				sum += phaseWeights[t];
+			}
+			for (int t = 0; t < taps.tapCount; t++)
+			{
+				phaseWeights[t] /= sum;
+			}
+			lastPhase = phase;
+		}
+
+		for (int t = 0; t < taps.tapCount; t++)
+		{
+			int j = first + t;
+			if (m_bWrap == true)
+			{
+				j = ((j % srcSize) + srcSize) % srcSize;
+			}
+			else
+			{
+				j = std::min(std::max(j, 0), srcSize - 1);
+			}
+			taps.indices[i * taps.tapCount + t] = j;
+			taps.weights[i * taps.tapCount + t] = phaseWeights[t];
+		}
+	}
+}
+
+/***********************************************************
+ *  FilterBand()
+ *
+ *  This method is used for filtering the destination rows
+ *  firstRow to lastRow (exclusive) of a level.  The source
+ *  rows the band needs are first filtered horizontally into
+ *  a band-local buffer, then the vertical filter combines
+ *  them.  Texels are 4 floats, so each filter step is one
+ *  SIMD multiply-add per texel.
+ ***********************************************************/
+void MipGenerator::FilterBand(
+	const float* source,
+	int sourceWidth,
+	int sourceHeight,
+	const FILTER_TAPS& columnTaps,
+	const FILTER_TAPS& rowTaps,
+	float* destination,
+	int destinationWidth,
+	int firstRow,
+	int lastRow)
+{
+	// find the source rows covered by the band
+	std::vector<int> rowSlots(sourceHeight, -1);
+	int slotCount = 0;
+	for (int y = firstRow; y < lastRow; y++)
+	{
+		for (int t = 0; t < rowTaps.tapCount; t++)
+		{
+			int row = rowTaps.indices[y * rowTaps.tapCount + t];
+			if ((rowTaps.weights[y * rowTaps.tapCount + t] != 0.0f) && (rowSlots[row] < 0))
+			{
+				rowSlots[row] = slotCount++;
+			}
+		}
+	}
+
+	// horizontal pass over those rows
+	const size_t rowFloats = (size_t)destinationWidth * 4;
+	std::vector<float> filteredRows(slotCount * rowFloats);
+	for (int row = 0; row < sourceHeight; row++)
+	{
+		if (rowSlots[row] < 0)
+		{
+			continue;
+		}
+		const float* sourceRow = source + (size_t)row * sourceWidth * 4;
+		float* filtered = &filteredRows[rowSlots[row] * rowFloats];
+		for (int x = 0; x < destinationWidth; x++)
+		{
+			const int* indices = &columnTaps.indices[x * columnTaps.tapCount];
+			const float* weights = &columnTaps.weights[x * columnTaps.tapCount];
+#if defined(MIPGENERATOR_SSE)
+			__m128 sum = _mm_setzero_ps();
+			for (int t = 0; t < columnTaps.tapCount; t++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(sourceRow + indices[t] * 4)));
+			}
+			_mm_storeu_ps(filtered + x * 4, sum);
+#else
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int t = 0; t < columnTaps.tapCount; t++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					sum[c] += weights[t] * sourceRow[indices[t] * 4 + c];
+				}
+			}
+			memcpy(filtered + x * 4, sum, sizeof(sum));
+#endif
+		}
+	}
+
+	// vertical pass, clamped to the displayable range
+	for (int y = firstRow; y < lastRow; y++)
+	{
+		float* destinationRow = destination + y * rowFloats;
+		std::fill(destinationRow, destinationRow + rowFloats, 0.0f);
+		for (int t = 0; t < rowTaps.tapCount; t++)
+		{
+			float weight = rowTaps.weights[y * rowTaps.tapCount + t];
+			if (weight == 0.0f)
+			{
+				continue;
+			}
+			const float* filtered = &filteredRows[rowSlots[rowTaps.indices[y * rowTaps.tapCount + t]] * rowFloats];
+#if defined(MIPGENERATOR_SSE)
+			__m128 weights = _mm_set1_ps(weight);
+			for (size_t i = 0; i < rowFloats; i += 4)
+			{
+				_mm_storeu_ps(destinationRow + i, _mm_add_ps(_mm_loadu_ps(destinationRow + i), _mm_mul_ps(weights, _mm_loadu_ps(filtered + i))));
+			}
+#else
+			for (size_t i = 0; i < rowFloats; i++)
+			{
+				destinationRow[i] += weight * filtered[i];
+			}
+#endif
+		}
+
+#if defined(MIPGENERATOR_SSE)
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		for (size_t i = 0; i < rowFloats; i += 4)
+		{
+			_mm_storeu_ps(destinationRow + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(destinationRow + i), zero), one));
+		}
+#else
+		for (size_t i = 0; i < rowFloats; i++)
+		{
+			destinationRow[i] = std::min(std::max(destinationRow[i], 0.0f), 1.0f);
+		}
+#endif
+	}
+}
+
+/***********************************************************
+ *  Generate()
+ *
+ *  This method is used for building the mip chain of an
+ *  image.  The levels are filtered from each other in
+ *  floating point, so rounding to 8 bits happens only once
+ *  per level, when it is written to the chain.
+ ***********************************************************/
+bool MipGenerator::Generate(
+	const unsigned char* image,
+	int width,
+	int height,
+	int colorChannels,
+	MIP_CHAIN& chain)
+{
+	if ((image == NULL) || (width <= 0) || (height <= 0) || (colorChannels < 1) || (colorChannels > 4))
+	{
+		return(false);
+	}
+
+	chain.colorChannels = colorChannels;
+	chain.pixels.resize(GetLevelLayout(width, height, colorChannels, chain.levels));
+	memcpy(chain.pixels.data(), image, (size_t)width * height * colorChannels);
+
+	// two and four channel images carry alpha in the last channel
+	const bool bHasAlpha = ((colorChannels == 2) || (colorChannels == 4));
+	const int alphaIndex = colorChannels - 1;
+	const int colorCount = bHasAlpha ? colorChannels - 1 : colorChannels;
+	const SRGB_TABLES& tables = GetSRGBTables();
+
+	// decode level 0 into linear 4 float texels
+	std::vector<float> current((size_t)width * height * 4, 0.0f);
+	for (size_t i = 0; i < (size_t)width * height; i++)
+	{
+		for (int c = 0; c < colorChannels; c++)
+		{
+			unsigned char value = image[i * colorChannels + c];
+			current[i * 4 + c] = ((c < colorCount) && m_bSRGB) ? tables.toLinear[value] : value / 255.0f;
+		}
+	}
+
+	// an image that passes the test everywhere or nowhere keeps
+	// that coverage without any scale
+	bool bKeepCoverage = bHasAlpha && (m_alphaCutoff >= 0.0f);
+	const float coverage = bKeepCoverage ? AlphaCoverage(current, alphaIndex, 1.0f, m_alphaCutoff) : 0.0f;
+	bKeepCoverage = bKeepCoverage && (coverage > 0.0f) && (coverage < 1.0f);
+
+	int threadCount = (m_threadCount > 0) ? m_threadCount : (int)std::thread::hardware_concurrency();
+	threadCount = std::max(1, threadCount);
+
+	std::vector<float> next;
+	FILTER_TAPS columnTaps;
+	FILTER_TAPS rowTaps;
+	for (size_t level = 1; level < chain.levels.size(); level++)
+	{
+		const MIP_LEVEL& source = chain.levels[level - 1];
+		const MIP_LEVEL& destination = chain.levels[level];
+		BuildTaps(source.width, destination.width, columnTaps);
+		BuildTaps(source.height, destination.height, rowTaps);
+		next.assign((size_t)destination.width * destination.height * 4, 0.0f);
+
+		// split the rows into bands, one per thread
+		int bandCount = std::min(threadCount, std::max(1, destination.height / g_MinBandRows));
+		int bandRows = (destination.height + bandCount - 1) / bandCount;
+		std::vector<std::thread> workers;
+		for (int band = 1; band < bandCount; band++)
+		{
+			int firstRow = band * bandRows;
+			int lastRow = std::min(destination.height, firstRow + bandRows);
+			if (firstRow < lastRow)
+			{
+				workers.push_back(std::thread(&MipGenerator::FilterBand,
+					current.data(), source.width, source.height, std::cref(columnTaps), std::cref(rowTaps),
+					next.data(), destination.width, firstRow, lastRow));
+			}
+		}
+		FilterBand(current.data(), source.width, source.height, columnTaps, rowTaps,
+			next.data(), destination.width, 0, std::min(destination.height, bandRows));
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+
+		// find the alpha scale that keeps the alpha test coverage
+		float alphaScale = 1.0f;
+		if (bKeepCoverage)
+		{
+			float low = 0.0f;
+			float high = 4.0f;
+			for (int step = 0; step < 16; step++)
+			{
+				float middle = (low + high) * 0.5f;
+				if (AlphaCoverage(next, alphaIndex, middle, m_alphaCutoff) < coverage)
+				{
+					low = middle;
+				}
+				else
+				{
+					high = middle;
+				}
+			}
+			alphaScale = (low + high) * 0.5f;
+		}
+
+		// encode the level, the next one is filtered from the floats
+		unsigned char* pixels = chain.pixels.data() + destination.offset;
+		size_t texelCount = (size_t)destination.width * destination.height;
+		for (size_t i = 0; i < texelCount; i++)
+		{
+			for (int c = 0; c < colorChannels; c++)
+			{
+				float value = next[i * 4 + c];
+				if (c < colorCount)
+				{
+					pixels[i * colorChannels + c] = m_bSRGB ? EncodeSRGB(value) : EncodeLinear(value);
+				}
+				else
+				{
+					pixels[i * colorChannels + c] = EncodeLinear(value * alphaScale);
+				}
+			}
+		}
+
+		current.swap(next);
+	}
+
+	return(true);
+}
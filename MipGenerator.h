@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipgenerator.h
+// ============
+// gamma-correct mipmap chain generation for cooked textures
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  MipGenerator
+ *
+ *  This class builds the full mipmap chain of an 8 bit
+ *  image on the CPU, so textures can be cooked once instead
+ *  of calling glGenerateMipmap on every launch.  Each level
+ *  is filtered from the one above with a separable Kaiser
+ *  windowed sinc, in linear light: sRGB color channels are
+ *  decoded before filtering and encoded again afterwards.
+ *  The rows of a level are split into bands filtered on
+ *  separate threads, and each band works on four channels
+ *  at a time with SSE where available.
+ *
+ *  For images with alpha, the alpha of every level is
+ *  scaled so the fraction of texels passing the alpha test
+ *  stays the same as in the full size image, so cut-out
+ *  textures do not thin out in the distance.
+ ***********************************************************/
+class MipGenerator
+{
+public:
+	// constructor
+	MipGenerator();
+
+	// one level of a mip chain
+	struct MIP_LEVEL
+	{
+		int width;
+		int height;
+		size_t offset;		// byte offset of the level in the pixels
+	};
+
+	// every level of an image, tightly packed one after another
+	struct MIP_CHAIN
+	{
+		int colorChannels;
+		std::vector<MIP_LEVEL> levels;
+		std::vector<unsigned char> pixels;
+	};
+
+	// build the chain down to 1x1, level 0 is a copy of the image
+	bool Generate(
+		const unsigned char* image,
+		int width,
+		int height,
+		int colorChannels,
+		MIP_CHAIN& chain);
+
+	// the number of levels down to 1x1
+	static int GetLevelCount(int width, int height);
+	// the size and offset of every level, returns the total bytes
+	static size_t GetLevelLayout(
+		int width,
+		int height,
+		int colorChannels,
+		std::vector<MIP_LEVEL>& levels);
+
+	// treat the color channels as sRGB encoded (the default)
+	void SetSRGB(bool bSRGB) { m_bSRGB = bSRGB; }
+	// wrap the filter around the edges (the default), or clamp to them
+	void SetWrap(bool bWrap) { m_bWrap = bWrap; }
+	// alpha test reference kept by the coverage correction, for the
+	// textures of alpha tested materials only; < 0 disables it (the
+	// default)
+	void SetAlphaCutoff(float cutoff) { m_alphaCutoff = cutoff; }
+	// the most threads used for one level, 0 for one per hardware thread
+	void SetThreadCount(int threads) { m_threadCount = threads; }
+
+private:
+	// filter radius in destination texels, and window shape
+	float m_filterRadius;
+	float m_kaiserAlpha;
+	bool m_bSRGB;
+	bool m_bWrap;
+	float m_alphaCutoff;
+	int m_threadCount;
+
+	// per destination texel source indices and weights of a 1D resample
+	struct FILTER_TAPS
+	{
+		int tapCount;
+		std::vector<int> indices;
+		std::vector<float> weights;
+	};
+
+	// the windowed sinc at x (in destination texels)
+	float FilterWeight(float x) const;
+	// the wrapped (or clamped) taps resampling srcSize texels to dstSize
+	void BuildTaps(int srcSize, int dstSize, FILTER_TAPS& taps) const;
+	// filter one band of destination rows
+	static void FilterBand(
+		const float* source,
+		int sourceWidth,
+		int sourceHeight,
+		const FILTER_TAPS& columnTaps,
+		const FILTER_TAPS& rowTaps,
+		float* destination,
+		int destinationWidth,
+		int firstRow,
+		int lastRow);
+};
@@ -0,0 +1,287 @@
+///////////////////////////////////////////////////////////////////////////////
+// primitivetables.h
+// ============
+// compile-time generation of the vertex and index tables for the
+// cone, cylinder, tapered cylinder and sphere primitives
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+// a fused multiply-add rounds once where the compiler's constant
+// evaluation rounds twice, so contraction is off for the generators
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#elif defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/***********************************************************
+ *  PrimitiveTables
+ *
+ *  The generators below are constexpr, so the tables they
+ *  return are built by the compiler and stored as constant
+ *  data.  The same functions can be called at runtime and
+ *  produce the same bits, since only IEEE +, -, * and / are
+ *  used (the trig and square root are evaluated by series)
+ *  and fusing a multiply and add into one rounding is
+ *  turned off below.  ShapeMeshes compares the two in debug
+ *  builds.
+ *
+ *  Every vertex is 8 floats: position, normal, texture
+ *  coordinates, matching the shader memory layout.
+ ***********************************************************/
+namespace PrimitiveTables
+{
+	constexpr int FloatsPerVertex = 8;
+	constexpr double Pi = 3.14159265358979323846;
+
+	/***********************************************************
+	 *  Sin() / Cos() / Sqrt()
+	 *
+	 *  constexpr replacements for the <cmath> functions.
+	 ***********************************************************/
+	constexpr double Sin(double x)
+	{
+		// reduce into [-pi/2, pi/2] and sum the Taylor series
+		while (x > Pi) x -= 2.0 * Pi;
+		while (x < -Pi) x += 2.0 * Pi;
+		if (x > Pi / 2.0) x = Pi - x;
+		if (x < -Pi / 2.0) x = -Pi - x;
+		double term = x;
+		double sum = x;
+		for (int n = 1; n < 12; n++)
+		{
+			term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+			sum += term;
+		}
+		return(sum);
+	}
+
+	constexpr double Cos(double x)
+	{
+		return(Sin(x + Pi / 2.0));
+	}
+
+	constexpr double Sqrt(double x)
+	{
+		if (x <= 0.0)
+		{
+			return(0.0);
+		}
+		double guess = (x > 1.0) ? x : 1.0;
+		for (int i = 0; i < 64; i++)
+		{
+			guess = 0.5 * (guess + x / guess);
+		}
+		return(guess);
+	}
+
+	/***********************************************************
+	 *  SetVertex()
+	 *
+	 *  Write one interleaved vertex into a table.
+	 ***********************************************************/
+	template <std::size_t N>
+	constexpr void SetVertex(
+		std::array<float, N>& verts, int index,
+		double px, double py, double pz,
+		double nx, double ny, double nz,
+		double u, double v)
+	{
+		const int base = index * FloatsPerVertex;
+		verts[base + 0] = (float)px;
+		verts[base + 1] = (float)py;
+		verts[base + 2] = (float)pz;
+		verts[base + 3] = (float)nx;
+		verts[base + 4] = (float)ny;
+		verts[base + 5] = (float)nz;
+		verts[base + 6] = (float)u;
+		verts[base + 7] = (float)v;
+	}
+
+	/***********************************************************
+	 *  ConeTable
+	 *
+	 *  A unit cone with its base on y = 0 and its apex at
+	 *  y = 1.  The base is drawn as a triangle fan and the
+	 *  sides as a strip of (rim, apex, next rim) triplets.
+	 ***********************************************************/
+	template <int Segments>
+	struct ConeTable
+	{
+		static_assert(Segments >= 3, "a cone needs at least 3 segments");
+
+		static constexpr int BottomFirst = 0;
+		static constexpr int BottomCount = Segments;
+		static constexpr int SidesFirst = BottomFirst + BottomCount;
+		static constexpr int SidesCount = Segments * 3;
+		static constexpr int VertexCount = SidesFirst + SidesCount;
+
+		std::array<float, VertexCount * FloatsPerVertex> verts;
+	};
+
+	template <int Segments>
+	constexpr ConeTable<Segments> GenerateCone()
+	{
+		ConeTable<Segments> table = {};
+		const double step = 2.0 * Pi / Segments;
+		// the sides lean at 45 degrees for a unit radius and height
+		const double slope = 1.0 / Sqrt(2.0);
+
+		for (int i = 0; i < Segments; i++)
+		{
+			double x = Cos(i * step);
+			double z = -Sin(i * step);
+			SetVertex(table.verts, table.BottomFirst + i, x, 0.0, z, 0.0, -1.0, 0.0, 0.5 + 0.5 * z, 0.5 + 0.5 * x);
+		}
+
+		for (int i = 0; i < Segments; i++)
+		{
+			double x0 = Cos(i * step);
+			double z0 = -Sin(i * step);
+			double x1 = Cos((i + 1) * step);
+			double z1 = -Sin((i + 1) * step);
+			// flat normal through the middle of the segment
+			double xm = Cos((i + 0.5) * step) * slope;
+			double zm = -Sin((i + 0.5) * step) * slope;
+			const int first = table.SidesFirst + i * 3;
+			SetVertex(table.verts, first + 0, x0, 0.0, z0, xm, slope, zm, 0.5 + 0.5 * x0, 0.5 - 0.5 * z0);
+			SetVertex(table.verts, first + 1, 0.0, 1.0, 0.0, xm, slope, zm, 0.5, 0.5);
+			SetVertex(table.verts, first + 2, x1, 0.0, z1, xm, slope, zm, 0.5 + 0.5 * x1, 0.5 - 0.5 * z1);
+		}
+
+		return(table);
+	}
+
+	/***********************************************************
+	 *  CylinderTable
+	 *
+	 *  A cylinder with a unit radius base on y = 0 and a top
+	 *  of the passed in radius on y = 1.  The caps are drawn
+	 *  as triangle fans and the sides as one strip.
+	 ***********************************************************/
+	template <int Segments>
+	struct CylinderTable
+	{
+		static_assert(Segments >= 3, "a cylinder needs at least 3 segments");
+
+		static constexpr int BottomFirst = 0;
+		static constexpr int BottomCount = Segments;
+		static constexpr int TopFirst = BottomFirst + BottomCount;
+		static constexpr int TopCount = Segments;
+		static constexpr int SidesFirst = TopFirst + TopCount;
+		static constexpr int SidesCount = (Segments + 1) * 2;
+		static constexpr int VertexCount = SidesFirst + SidesCount;
+
+		std::array<float, VertexCount * FloatsPerVertex> verts;
+	};
+
+	template <int Segments>
+	constexpr CylinderTable<Segments> GenerateCylinder(double topRadius = 1.0)
+	{
+		CylinderTable<Segments> table = {};
+		const double step = 2.0 * Pi / Segments;
+		// the side normals tilt up by the taper
+		const double taper = 1.0 - topRadius;
+		const double normalLength = Sqrt(1.0 + taper * taper);
+
+		for (int i = 0; i < Segments; i++)
+		{
+			double x = Cos(i * step);
+			double z = -Sin(i * step);
+			SetVertex(table.verts, table.BottomFirst + i, x, 0.0, z, 0.0, -1.0, 0.0, 0.5 + 0.5 * z, 0.5 + 0.5 * x);
+			SetVertex(table.verts, table.TopFirst + i, x * topRadius, 1.0, z * topRadius, 0.0, 1.0, 0.0, 0.5 + 0.5 * z, 0.5 + 0.5 * x);
+		}
+
+		// the seam is repeated so the texture wraps once around
+		for (int i = 0; i <= Segments; i++)
+		{
+			double x = Cos(i * step);
+			double z = -Sin(i * step);
+			double u = (double)i / Segments;
+			const int first = table.SidesFirst + i * 2;
+			SetVertex(table.verts, first + 0, x * topRadius, 1.0, z * topRadius, x / normalLength, taper / normalLength, z / normalLength, u, 1.0);
+			SetVertex(table.verts, first + 1, x, 0.0, z, x / normalLength, taper / normalLength, z / normalLength, u, 0.0);
+		}
+
+		return(table);
+	}
+
+	/***********************************************************
+	 *  SphereTable
+	 *
+	 *  A unit sphere built from stacks (top to bottom) and
+	 *  slices, drawn as an indexed triangle list.  The indices
+	 *  run from the top stack down, so the first half of them
+	 *  is the upper hemisphere when the stack count is even.
+	 ***********************************************************/
+	template <int Stacks, int Slices>
+	struct SphereTable
+	{
+		static_assert(Stacks >= 2 && Slices >= 3, "a sphere needs at least 2 stacks and 3 slices");
+
+		static constexpr int VertexCount = (Stacks + 1) * (Slices + 1);
+		static constexpr int IndexCount = Stacks * Slices * 6;
+
+		std::array<float, VertexCount * FloatsPerVertex> verts;
+		std::array<unsigned int, IndexCount> indices;
+	};
+
+	template <int Stacks, int Slices>
+	constexpr SphereTable<Stacks, Slices> GenerateSphere()
+	{
+		SphereTable<Stacks, Slices> table = {};
+
+		// every stack shares the same slice directions
+		std::array<double, Slices + 1> sliceSin = {};
+		std::array<double, Slices + 1> sliceCos = {};
+		for (int slice = 0; slice <= Slices; slice++)
+		{
+			sliceSin[slice] = Sin(2.0 * Pi * slice / Slices);
+			sliceCos[slice] = Cos(2.0 * Pi * slice / Slices);
+		}
+
+		for (int stack = 0; stack <= Stacks; stack++)
+		{
+			double polar = Pi * stack / Stacks;
+			double y = Cos(polar);
+			double ring = Sin(polar);
+			for (int slice = 0; slice <= Slices; slice++)
+			{
+				double x = ring * sliceSin[slice];
+				double z = ring * sliceCos[slice];
+				SetVertex(table.verts, stack * (Slices + 1) + slice, x, y, z, x, y, z,
+					(double)slice / Slices, 1.0 - (double)stack / Stacks);
+			}
+		}
+
+		int index = 0;
+		for (int stack = 0; stack < Stacks; stack++)
+		{
+			for (int slice = 0; slice < Slices; slice++)
+			{
+				unsigned int topLeft = stack * (Slices + 1) + slice;
+				unsigned int bottomLeft = topLeft + Slices + 1;
+				table.indices[index++] = topLeft;
+				table.indices[index++] = bottomLeft;
+				table.indices[index++] = topLeft + 1;
+				table.indices[index++] = topLeft + 1;
+				table.indices[index++] = bottomLeft;
+				table.indices[index++] = bottomLeft + 1;
+			}
+		}
+
+		return(table);
+	}
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
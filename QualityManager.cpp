@@ -0,0 +1,333 @@
+///////////////////////////////////////////////////////////////////////////////
+// qualitymanager.cpp
+// ============
+// quality presets and the calibration benchmark that picks one for the GPU
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "QualityManager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// declaration of global variables
+namespace
+{
+	// the presets, from TIER_LOW to TIER_ULTRA
+	const QualityManager::QUALITY_SETTINGS g_QualityPresets[QualityManager::TIER_COUNT] = {
+		// name      scale  mip bias  decode  lod error  shadows  lights  msaa  ssao   ssr    voxel gi
+		{ "low",     0.5f,  1.0f,     4,      8.0f,      0,       1,      1,    false, false, false },
+		{ "medium",  0.75f, 0.5f,     2,      4.0f,      1024,    2,      1,    false, true,  false },
+		{ "high",    1.0f,  0.0f,     1,      2.0f,      2048,    4,      4,    true,  true,  true },
+		{ "ultra",   1.0f,  0.0f,     1,      1.0f,      4096,    4,      8,    true,  true,  true }
+	};
+
+	// bump when the benchmark or the presets change
+	const uint32_t g_CalibrationVersion = 3;
+	// full screen layers drawn per benchmark frame, about the
+	// overdraw of the scene
+	const int g_BenchmarkOverdraw = 3;
+	const int g_BenchmarkWarmupFrames = 3;
+	const int g_BenchmarkFrames = 10;
+	// share of the target frame time the benchmark may take,
+	// the rest is left for everything it does not model
+	const float g_BenchmarkBudget = 0.5f;
+
+	// one triangle covering the screen at the layer depth
+	const char* g_BenchmarkVertexShader =
+		"#version 440 core\n"
+		"uniform float layerDepth;\n"
+		"out vec2 screenPosition;\n"
+		"void main()\n"
+		"{\n"
+		"   screenPosition = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;\n"
+		"   gl_Position = vec4(screenPosition, layerDepth, 1.0);\n"
+		"}\n";
+
+	// Phong lighting like the scene shader, per light
+	const char* g_BenchmarkFragmentShader =
+		"#version 440 core\n"
+		"in vec2 screenPosition;\n"
+		"out vec4 outFragmentColor;\n"
+		"uniform int lightCount;\n"
+		"void main()\n"
+		"{\n"
+		"   vec3 position = vec3(screenPosition * 5.0, 0.0);\n"
+		"   vec3 normal = normalize(vec3(sin(screenPosition * 31.0), 1.0));\n"
+		"   vec3 viewDirection = normalize(vec3(0.0, 5.0, 12.0) - position);\n"
+		"   vec3 color = vec3(0.0);\n"
+		"   for (int i = 0; i < lightCount; i++)\n"
+		"   {\n"
+		"      vec3 lightPosition = vec3(cos(float(i) * 1.7) * 6.0, 4.0, sin(float(i) * 1.7) * 6.0);\n"
+		"      vec3 lightDirection = normalize(lightPosition - position);\n"
+		"      float diffuse = max(dot(normal, lightDirection), 0.0);\n"
+		"      float specular = pow(max(dot(viewDirection, reflect(-lightDirection, normal)), 0.0), 32.0);\n"
+		"      color += vec3(0.1) + diffuse * vec3(0.7) + specular * vec3(0.5);\n"
+		"   }\n"
+		"   outFragmentColor = vec4(color, 1.0);\n"
+		"}\n";
+
+	/***********************************************************
+	 *  CompileShader()
+	 *
+	 *  Compile one benchmark shader, 0 on error.
+	 ***********************************************************/
+	GLuint CompileShader(GLenum type, const char* source)
+	{
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+
+		GLint result = GL_FALSE;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
+		if (result != GL_TRUE)
+		{
+			char message[1024] = { 0 };
+			glGetShaderInfoLog(shader, sizeof(message), NULL, message);
+			std::cout << "Quality: benchmark shader failed to compile: " << message << std::endl;
+			glDeleteShader(shader);
+			return(0);
+		}
+		return(shader);
+	}
+}
+
+/***********************************************************
+ *  QualityManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+QualityManager::QualityManager(DerivedDataCache* pDerivedDataCache)
+{
+	m_pDerivedDataCache = pDerivedDataCache;
+	m_targetFrameTime = 1000.0f / 60.0f;
+	m_benchmarkProgram = 0;
+	m_benchmarkVAO = 0;
+}
+
+/***********************************************************
+ *  ~QualityManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+QualityManager::~QualityManager()
+{
+	DestroyBenchmark();
+	m_pDerivedDataCache = NULL;
+}
+
+/***********************************************************
+ *  GetSettings()
+ *
+ *  This method is used for getting the preset settings of a
+ *  quality tier.
+ ***********************************************************/
+const QualityManager::QUALITY_SETTINGS& QualityManager::GetSettings(QUALITY_TIER tier)
+{
+	int index = std::min(std::max((int)tier, 0), (int)TIER_COUNT - 1);
+	return(g_QualityPresets[index]);
+}
+
+/***********************************************************
+ *  CreateBenchmark()
+ *
+ *  This method is used for compiling the benchmark shader
+ *  program.  The full screen triangles are made from
+ *  gl_VertexID, so the vertex array has no buffers.
+ ***********************************************************/
+bool QualityManager::CreateBenchmark()
+{
+	GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, g_BenchmarkVertexShader);
+	GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, g_BenchmarkFragmentShader);
+	if ((vertexShader == 0) || (fragmentShader == 0))
+	{
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return(false);
+	}
+
+	m_benchmarkProgram = glCreateProgram();
+	glAttachShader(m_benchmarkProgram, vertexShader);
+	glAttachShader(m_benchmarkProgram, fragmentShader);
+	glLinkProgram(m_benchmarkProgram);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	GLint result = GL_FALSE;
+	glGetProgramiv(m_benchmarkProgram, GL_LINK_STATUS, &result);
+	if (result != GL_TRUE)
+	{
+		std::cout << "Quality: benchmark program failed to link" << std::endl;
+		DestroyBenchmark();
+		return(false);
+	}
+
+	glCreateVertexArrays(1, &m_benchmarkVAO);
+	return(true);
+}
+
+/***********************************************************
+ *  DestroyBenchmark()
+ *
+ *  This method is used for freeing the benchmark program.
+ ***********************************************************/
+void QualityManager::DestroyBenchmark()
+{
+	if (m_benchmarkProgram != 0)
+	{
+		glDeleteProgram(m_benchmarkProgram);
+		m_benchmarkProgram = 0;
+	}
+	if (m_benchmarkVAO != 0)
+	{
+		glDeleteVertexArrays(1, &m_benchmarkVAO);
+		m_benchmarkVAO = 0;
+	}
+}
+
+/***********************************************************
+ *  MeasureTier()
+ *
+ *  This method is used for timing the benchmark with the
+ *  render size, sample count and light count of a tier.
+ *  Each frame clears an offscreen target and shades a few
+ *  full screen layers, each in front of the last so every
+ *  layer passes the depth test.  A timer query around the
+ *  frames gives the GPU time, which is returned per frame
+ *  in milliseconds.
+ ***********************************************************/
+float QualityManager::MeasureTier(QUALITY_TIER tier, int windowWidth, int windowHeight)
+{
+	const QUALITY_SETTINGS& settings = GetSettings(tier);
+	int width = std::max(1, (int)(windowWidth * settings.resolutionScale + 0.5f));
+	int height = std::max(1, (int)(windowHeight * settings.resolutionScale + 0.5f));
+	GLint maxSamples = 1;
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+	int samples = std::min(settings.msaaSamples, (int)maxSamples);
+
+	GLuint renderbuffers[2] = { 0, 0 };
+	GLuint framebuffer = 0;
+	glCreateRenderbuffers(2, renderbuffers);
+	glNamedRenderbufferStorageMultisample(renderbuffers[0], (samples > 1) ? samples : 0, GL_RGBA8, width, height);
+	glNamedRenderbufferStorageMultisample(renderbuffers[1], (samples > 1) ? samples : 0, GL_DEPTH_COMPONENT24, width, height);
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+	float milliseconds = -1.0f;
+	if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, width, height);
+		glEnable(GL_DEPTH_TEST);
+		glUseProgram(m_benchmarkProgram);
+		glBindVertexArray(m_benchmarkVAO);
+		glUniform1i(glGetUniformLocation(m_benchmarkProgram, "lightCount"), settings.lightCount);
+		GLint layerDepth = glGetUniformLocation(m_benchmarkProgram, "layerDepth");
+
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		for (int frame = 0; frame < g_BenchmarkWarmupFrames + g_BenchmarkFrames; frame++)
+		{
+			if (frame == g_BenchmarkWarmupFrames)
+			{
+				glBeginQuery(GL_TIME_ELAPSED, query);
+			}
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			for (int layer = 0; layer < g_BenchmarkOverdraw; layer++)
+			{
+				glUniform1f(layerDepth, 0.5f - 0.1f * layer);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+			}
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+		glDeleteQueries(1, &query);
+		milliseconds = (float)(nanoseconds / 1.0e6) / g_BenchmarkFrames;
+
+		glBindVertexArray(0);
+		glUseProgram(0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, windowWidth, windowHeight);
+	}
+
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(2, renderbuffers);
+
+	return(milliseconds);
+}
+
+/***********************************************************
+ *  DetectTier()
+ *
+ *  This method is used for picking the highest tier whose
+ *  benchmark frame fits in its share of the target frame
+ *  time.  The tiers are measured from low up, stopping at
+ *  the first that is too slow, so slow hardware does not
+ *  sit through the expensive tiers.  The result is stored
+ *  in the derived data cache under the GPU and driver, the
+ *  window size and the target frame time.
+ ***********************************************************/
+QualityManager::QUALITY_TIER QualityManager::DetectTier(int windowWidth, int windowHeight)
+{
+	std::string vendor = (const char*)glGetString(GL_VENDOR);
+	std::string renderer = (const char*)glGetString(GL_RENDERER);
+	std::string version = (const char*)glGetString(GL_VERSION);
+
+	DerivedDataCache::CACHE_KEY calibrationKey = DerivedDataCache::KeyBuilder("QualityCalibration", g_CalibrationVersion)
+		.Add(vendor)
+		.Add(renderer)
+		.Add(version)
+		.AddValue(windowWidth)
+		.AddValue(windowHeight)
+		.AddValue(m_targetFrameTime)
+		.GetKey();
+
+	std::vector<unsigned char> cached;
+	if ((NULL != m_pDerivedDataCache) && m_pDerivedDataCache->Get(calibrationKey, cached) &&
+		(cached.size() == sizeof(int32_t)))
+	{
+		int32_t cachedTier = 0;
+		memcpy(&cachedTier, cached.data(), sizeof(cachedTier));
+		if ((cachedTier >= 0) && (cachedTier < TIER_COUNT))
+		{
+			std::cout << "Quality: " << GetSettings((QUALITY_TIER)cachedTier).name << " (calibrated for " << renderer << ")" << std::endl;
+			return((QUALITY_TIER)cachedTier);
+		}
+	}
+
+	// without the benchmark, fall back to the middle of the range
+	if (CreateBenchmark() == false)
+	{
+		return(TIER_MEDIUM);
+	}
+
+	QUALITY_TIER tier = TIER_LOW;
+	float budget = m_targetFrameTime * g_BenchmarkBudget;
+	for (int candidate = TIER_LOW; candidate < TIER_COUNT; candidate++)
+	{
+		float milliseconds = MeasureTier((QUALITY_TIER)candidate, windowWidth, windowHeight);
+		std::cout << "Quality: " << GetSettings((QUALITY_TIER)candidate).name << " benchmark " << milliseconds << " ms (budget " << budget << " ms)" << std::endl;
+		if ((milliseconds < 0.0f) || (milliseconds > budget))
+		{
+			break;
+		}
+		tier = (QUALITY_TIER)candidate;
+	}
+	DestroyBenchmark();
+
+	std::cout << "Quality: " << GetSettings(tier).name << " (calibrated for " << renderer << ")" << std::endl;
+
+	if (NULL != m_pDerivedDataCache)
+	{
+		int32_t storedTier = tier;
+		m_pDerivedDataCache->Put(calibrationKey, &storedTier, sizeof(storedTier));
+	}
+
+	return(tier);
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// qualitymanager.h
+// ============
+// quality presets and the calibration benchmark that picks one for the GPU
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "DerivedDataCache.h"
+
+/***********************************************************
+ *  QualityManager
+ *
+ *  This class holds the quality presets, from low to ultra,
+ *  and picks the one the GPU can run at the target frame
+ *  time.  On the first run a short benchmark draws a few
+ *  layers of lit full screen triangles with the resolution,
+ *  anti-aliasing and light count of each tier, and keeps
+ *  the highest tier that fits the budget.  The result is
+ *  cached per GL vendor, renderer and driver version, so the
+ *  benchmark only runs again on other hardware.
+ ***********************************************************/
+class QualityManager
+{
+public:
+	// constructor, the calibration result is cached in pDerivedDataCache when passed
+	QualityManager(DerivedDataCache* pDerivedDataCache = NULL);
+	// destructor
+	~QualityManager();
+
+	enum QUALITY_TIER
+	{
+		TIER_LOW = 0,
+		TIER_MEDIUM,
+		TIER_HIGH,
+		TIER_ULTRA,
+		TIER_COUNT
+	};
+
+	// the settings of one tier
+	struct QUALITY_SETTINGS
+	{
+		const char* name;
+		float resolutionScale;		// scene size relative to the window
+		float textureMipBias;		// added to the texture mip level, > 0 is blurrier
+		int textureDecodeScale;		// jpeg textures are decoded at 1/n size
+		float lodScreenError;		// HLOD proxy error allowed, in pixels
+		int shadowResolution;		// shadow map size, 0 for no shadows; any
+									// other size turns on the ray traced and
+									// distance field ones
+		int lightCount;				// lights shaded per pixel
+		int msaaSamples;			// anti-aliasing samples, 1 for none
+		bool bSSAO;					// ambient occlusion, from the distance fields
+									// of the primitive shapes
+		bool bSSR;					// screen space reflections
+		bool bVoxelGI;				// voxel cone traced indirect light
+	};
+
+	// the preset settings of a tier
+	static const QUALITY_SETTINGS& GetSettings(QUALITY_TIER tier);
+
+	// pick the best tier for a window of the given size, from the
+	// cache or by running the benchmark
+	QUALITY_TIER DetectTier(int windowWidth, int windowHeight);
+
+	// the frame time to hold, 16.7 ms by default
+	void SetTargetFrameTime(float milliseconds) { m_targetFrameTime = milliseconds; }
+
+private:
+	// cache of the calibration result, may be NULL
+	DerivedDataCache* m_pDerivedDataCache;
+	float m_targetFrameTime;
+
+	// benchmark shader program and its empty vertex array
+	GLuint m_benchmarkProgram;
+	GLuint m_benchmarkVAO;
+
+	// compile the benchmark shaders, false on error
+	bool CreateBenchmark();
+	// free the benchmark shaders
+	void DestroyBenchmark();
+	// GPU milliseconds of one benchmark frame with the settings of a tier
+	float MeasureTier(QUALITY_TIER tier, int windowWidth, int windowHeight);
+};
@@ -0,0 +1,707 @@
+///////////////////////////////////////////////////////////////////////////////
+// rayshadowmanager.cpp
+// ============
+// shadows of the first lights, ray traced per pixel through a BVH on the GPU
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RayShadowManager.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+#include <numeric>
+
+// declaration of global variables
+namespace
+{
+	const char* g_TransformComputeShader = "../../Utilities/shaders/rayShadowTransformComputeShader.glsl";
+	const char* g_RefitComputeShader = "../../Utilities/shaders/rayShadowRefitComputeShader.glsl";
+	const char* g_TraceComputeShader = "../../Utilities/shaders/rayShadowTraceComputeShader.glsl";
+
+	// the scene shader reads the result on the unit after the voxel
+	// clipmap; the trace reads the depth and the history on the next
+	// ones and writes image units 0 and 1
+	const GLuint g_ShadowTextureUnit = 35;
+	const GLuint g_DepthTextureUnit = 36;
+	const GLuint g_HistoryShadowUnit = 37;
+	const GLuint g_HistoryDistanceUnit = 38;
+	const GLuint g_ShadowImageUnit = 0;
+	const GLuint g_DistanceImageUnit = 1;
+	const char* g_ShadowTextureName = "rayShadowTexture";
+
+	// one light per channel of the result
+	const int g_MaxShadowLights = TOTAL_LIGHTS;
+
+	// the tree: leaves are made at this many triangles or fewer,
+	// and at up to g_MaxLeafTriangles when splitting costs more;
+	// no deeper than the trace shader's stack holds
+	const int g_LeafTriangles = 4;
+	const int g_MaxLeafTriangles = 16;
+	const int g_MaxTreeDepth = 30;
+	const int g_SplitBins = 16;
+	// triangles of all the shadow casters, one dispatch of the
+	// transform at most
+	const size_t g_MaxTriangles = 1u << 21;
+
+	// radius of the disk the rays aim at around a light, the share
+	// of a frame in the history and how far, relative to its
+	// distance, a surface may be from the one seen there last frame
+	const float g_LightRadius = 0.1f;
+	const float g_HistoryBlend = 0.1f;
+	const float g_HistoryTolerance = 0.05f;
+
+	// traces measured in flight, and how fast the averages follow
+	const int g_TimerFrames = 4;
+	const float g_TimeSmoothing = 0.1f;
+
+	float BoxArea(glm::vec3 boxMin, glm::vec3 boxMax)
+	{
+		glm::vec3 extent = glm::max(boxMax - boxMin, glm::vec3(0.0f));
+		return(2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x));
+	}
+}
+
+/***********************************************************
+ *  RayShadowManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RayShadowManager::RayShadowManager(ShapeMeshes* pShapeMeshes, DerivedDataCache* pDerivedDataCache)
+{
+	m_pShapeMeshes = pShapeMeshes;
+	m_pTransformShader = new ShaderManager();
+	m_pTransformShader->m_programID = 0;
+	m_pTransformShader->m_pDerivedDataCache = pDerivedDataCache;
+	m_pRefitShader = new ShaderManager();
+	m_pRefitShader->m_programID = 0;
+	m_pRefitShader->m_pDerivedDataCache = pDerivedDataCache;
+	m_pTraceShader = new ShaderManager();
+	m_pTraceShader->m_programID = 0;
+	m_pTraceShader->m_pDerivedDataCache = pDerivedDataCache;
+	m_bShadersLoaded = false;
+	m_bEnabled = false;
+	m_lightCount = g_MaxShadowLights;
+	m_triangleCount = 0;
+	m_objectBuffer = 0;
+	m_triangleBuffer = 0;
+	m_nodeBuffer = 0;
+	m_sourceBuffer = 0;
+	m_shadowTextures[0] = m_shadowTextures[1] = 0;
+	m_distanceTextures[0] = m_distanceTextures[1] = 0;
+	m_current = 0;
+	m_width = 0;
+	m_height = 0;
+	m_bHistoryValid = false;
+	m_previousViewProjection = glm::mat4(1.0f);
+	m_previousCameraPosition = glm::vec3(0.0f);
+	m_frameIndex = 0;
+	m_timerIndex = 0;
+	m_traceTimes.assign(g_MaxShadowLights + 1, 0.0f);
+}
+
+/***********************************************************
+ *  ~RayShadowManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RayShadowManager::~RayShadowManager()
+{
+	DestroyTargets();
+	glDeleteBuffers(1, &m_objectBuffer);
+	glDeleteBuffers(1, &m_triangleBuffer);
+	glDeleteBuffers(1, &m_nodeBuffer);
+	glDeleteBuffers(1, &m_sourceBuffer);
+	m_objectBuffer = 0;
+	m_triangleBuffer = 0;
+	m_nodeBuffer = 0;
+	m_sourceBuffer = 0;
+	for (TIMER_QUERY& timer : m_timers)
+	{
+		glDeleteQueries(2, timer.queries);
+	}
+	m_timers.clear();
+	ShaderManager* shaders[] = { m_pTransformShader, m_pRefitShader, m_pTraceShader };
+	for (ShaderManager* pShader : shaders)
+	{
+		if (pShader->m_programID != 0)
+		{
+			glDeleteProgram(pShader->m_programID);
+		}
+		delete pShader;
+	}
+	m_pTransformShader = NULL;
+	m_pRefitShader = NULL;
+	m_pTraceShader = NULL;
+	m_pShapeMeshes = NULL;
+}
+
+/***********************************************************
+ *  SetSamplers()
+ *
+ *  This method is used for pointing the shadow sampler of
+ *  the program in use at its unit.
+ ***********************************************************/
+void RayShadowManager::SetSamplers(ShaderManager* pShader)
+{
+	pShader->setSampler2DValue(g_ShadowTextureName, g_ShadowTextureUnit);
+}
+
+/***********************************************************
+ *  SetEnabled()
+ ***********************************************************/
+void RayShadowManager::SetEnabled(bool bEnabled)
+{
+	m_bEnabled = bEnabled;
+	m_bHistoryValid = false;
+}
+
+/***********************************************************
+ *  AddObject()
+ ***********************************************************/
+void RayShadowManager::AddObject(const glm::mat4& model, int poolMesh)
+{
+	if ((m_bEnabled == false) || (poolMesh < 0))
+	{
+		return;
+	}
+
+	RAY_SHADOW_OBJECT_BLOCK object = RAY_SHADOW_OBJECT_BLOCK();
+	object.model = model;
+	object.poolMesh = (GLuint)poolMesh;
+	m_frameObjects.push_back(object);
+}
+
+/***********************************************************
+ *  LoadShaders()
+ *
+ *  This method is used for loading the three compute
+ *  programs the first time the shadows are traced.  If any
+ *  fails the scene is shaded without them.  The units the
+ *  trace program samples never change, so they are set
+ *  once here.
+ ***********************************************************/
+bool RayShadowManager::LoadShaders()
+{
+	if (m_bShadersLoaded == false)
+	{
+		m_bShadersLoaded = true;
+		m_pTransformShader->LoadComputeShader(g_TransformComputeShader, VertexPool::GLSLDeclaration());
+		m_pRefitShader->LoadComputeShader(g_RefitComputeShader);
+		m_pTraceShader->LoadComputeShader(g_TraceComputeShader);
+		if ((m_pTransformShader->m_programID == 0) || (m_pRefitShader->m_programID == 0) || (m_pTraceShader->m_programID == 0))
+		{
+			std::cout << "Could not load the ray traced shadow shaders, shadows are off" << std::endl;
+			glDeleteProgram(m_pTraceShader->m_programID);
+			m_pTraceShader->m_programID = 0;
+		}
+		else
+		{
+			m_pTraceShader->use();
+			m_pTraceShader->setSampler2DValue("sceneDepth", g_DepthTextureUnit);
+			m_pTraceShader->setSampler2DValue("historyShadow", g_HistoryShadowUnit);
+			m_pTraceShader->setSampler2DValue("historyDistance", g_HistoryDistanceUnit);
+			glCreateBuffers(1, &m_objectBuffer);
+			glCreateBuffers(1, &m_triangleBuffer);
+			glCreateBuffers(1, &m_nodeBuffer);
+			glCreateBuffers(1, &m_sourceBuffer);
+			m_timers.resize(g_TimerFrames);
+			for (TIMER_QUERY& timer : m_timers)
+			{
+				glCreateQueries(GL_TIMESTAMP, 2, timer.queries);
+				timer.lightCount = 0;
+				timer.bPending = false;
+			}
+		}
+	}
+	return(m_pTraceShader->m_programID != 0);
+}
+
+/***********************************************************
+ *  CreateTargets()
+ *
+ *  This method is used for creating the two results and
+ *  surface distances the traces alternate between.  The
+ *  history starts over.
+ ***********************************************************/
+void RayShadowManager::CreateTargets(int width, int height)
+{
+	DestroyTargets();
+	m_width = width;
+	m_height = height;
+
+	glCreateTextures(GL_TEXTURE_2D, 2, m_shadowTextures);
+	glCreateTextures(GL_TEXTURE_2D, 2, m_distanceTextures);
+	for (int index = 0; index < 2; index++)
+	{
+		glTextureStorage2D(m_shadowTextures[index], 1, GL_RGBA16F, width, height);
+		glTextureStorage2D(m_distanceTextures[index], 1, GL_R32F, width, height);
+		GLuint textures[] = { m_shadowTextures[index], m_distanceTextures[index] };
+		for (GLuint texture : textures)
+		{
+			glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+	}
+	m_current = 0;
+	m_bHistoryValid = false;
+}
+
+/***********************************************************
+ *  DestroyTargets()
+ ***********************************************************/
+void RayShadowManager::DestroyTargets()
+{
+	if (m_shadowTextures[0] != 0)
+	{
+		glDeleteTextures(2, m_shadowTextures);
+		glDeleteTextures(2, m_distanceTextures);
+		m_shadowTextures[0] = m_shadowTextures[1] = 0;
+		m_distanceTextures[0] = m_distanceTextures[1] = 0;
+	}
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  Trace()
+ *
+ *  This method is used for bringing the tree up to date
+ *  with the objects of the frame and tracing the shadows.
+ *  A different list of objects or meshes builds the tree
+ *  again, moved objects only refit it, and a still scene
+ *  leaves it alone.  The result is left bound to the unit
+ *  the scene shader reads it from.
+ ***********************************************************/
+bool RayShadowManager::Trace(ViewManager* pViewManager)
+{
+	if ((m_bEnabled == false) || (NULL == pViewManager) || (pViewManager->GetSceneFramebuffer() == 0)
+		|| (pViewManager->GetSceneSamples() > 1) || (m_pShapeMeshes->GetVertexPool() == NULL)
+		|| (LoadShaders() == false))
+	{
+		m_frameObjects.clear();
+		return(false);
+	}
+
+	ReadTimers();
+	TIMER_QUERY& timer = m_timers[m_timerIndex];
+	bool bTimed = (timer.bPending == false);
+	if (bTimed == true)
+	{
+		glQueryCounter(timer.queries[0], GL_TIMESTAMP);
+	}
+
+	bool bRebuild = (m_frameObjects.size() != m_objects.size());
+	bool bMoved = false;
+	for (size_t index = 0; (bRebuild == false) && (index < m_frameObjects.size()); index++)
+	{
+		bRebuild = (m_frameObjects[index].poolMesh != m_objects[index].poolMesh);
+		bMoved = bMoved || (m_frameObjects[index].model != m_objects[index].model);
+	}
+	if (bRebuild == true)
+	{
+		m_objects.swap(m_frameObjects);
+		BuildTree();
+	}
+	else if (bMoved == true)
+	{
+		m_objects.swap(m_frameObjects);
+		glNamedBufferSubData(m_objectBuffer, 0, m_objects.size() * sizeof(RAY_SHADOW_OBJECT_BLOCK), m_objects.data());
+		TransformTriangles();
+		RefitTree();
+	}
+	m_frameObjects.clear();
+
+	if (m_triangleCount == 0)
+	{
+		return(false);
+	}
+
+	int width = pViewManager->GetSceneWidth();
+	int height = pViewManager->GetSceneHeight();
+	if ((m_shadowTextures[0] == 0) || (width != m_width) || (height != m_height))
+	{
+		CreateTargets(width, height);
+	}
+	int previous = m_current;
+	m_current = 1 - m_current;
+
+	glm::mat4 viewProjection = pViewManager->GetProjectionMatrix() * pViewManager->GetViewMatrix();
+	glm::vec3 cameraPosition = pViewManager->GetCameraPosition();
+	int shadowLights = std::max(0, std::min(m_lightCount, g_MaxShadowLights));
+
+	m_pTraceShader->use();
+	m_pTraceShader->setIVec2Value("sceneSize", width, height);
+	m_pTraceShader->setMat4Value("inverseViewProjection", glm::inverse(viewProjection));
+	m_pTraceShader->setVec3Value("cameraPosition", cameraPosition);
+	m_pTraceShader->setMat4Value("previousViewProjection", m_previousViewProjection);
+	m_pTraceShader->setVec3Value("previousCameraPosition", m_previousCameraPosition);
+	m_pTraceShader->setBoolValue("bHistoryValid", m_bHistoryValid);
+	m_pTraceShader->setFloatValue("historyBlend", g_HistoryBlend);
+	m_pTraceShader->setFloatValue("historyTolerance", g_HistoryTolerance);
+	m_pTraceShader->setIntValue("shadowLightCount", shadowLights);
+	m_pTraceShader->setFloatValue("lightRadius", g_LightRadius);
+	m_pTraceShader->setUIntValue("frameIndex", m_frameIndex);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAY_SHADOW_TRIANGLE_BINDING, m_triangleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAY_SHADOW_NODE_BINDING, m_nodeBuffer);
+	glBindTextureUnit(g_DepthTextureUnit, pViewManager->GetSceneDepthTexture());
+	glBindTextureUnit(g_HistoryShadowUnit, m_shadowTextures[previous]);
+	glBindTextureUnit(g_HistoryDistanceUnit, m_distanceTextures[previous]);
+	glBindImageTexture(g_ShadowImageUnit, m_shadowTextures[m_current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	glBindImageTexture(g_DistanceImageUnit, m_distanceTextures[m_current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glDispatchCompute((GLuint)(width + 7) / 8, (GLuint)(height + 7) / 8, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	glBindTextureUnit(g_ShadowTextureUnit, m_shadowTextures[m_current]);
+
+	if (bTimed == true)
+	{
+		glQueryCounter(timer.queries[1], GL_TIMESTAMP);
+		timer.lightCount = shadowLights;
+		timer.bPending = true;
+		m_timerIndex = (m_timerIndex + 1) % (int)m_timers.size();
+	}
+
+	m_previousViewProjection = viewProjection;
+	m_previousCameraPosition = cameraPosition;
+	m_bHistoryValid = true;
+	m_frameIndex++;
+	return(true);
+}
+
+/***********************************************************
+ *  GetTraceTime()
+ ***********************************************************/
+float RayShadowManager::GetTraceTime(int lightCount) const
+{
+	if ((lightCount < 0) || (lightCount >= (int)m_traceTimes.size()))
+	{
+		return(0.0f);
+	}
+	return(m_traceTimes[lightCount]);
+}
+
+/***********************************************************
+ *  BuildTree()
+ *
+ *  This method is used for listing every triangle of the
+ *  objects, transforming them into world space and reading
+ *  them back to build the tree over them.  The triangles
+ *  are then transformed again in the order of the leaves,
+ *  so a leaf is one range of them, and the nodes are laid
+ *  out a level at a time for the refit.  Reading back
+ *  waits for the GPU, which only happens when the objects
+ *  themselves change.
+ ***********************************************************/
+void RayShadowManager::BuildTree()
+{
+	VertexPool* pVertexPool = m_pShapeMeshes->GetVertexPool();
+
+	m_sources.clear();
+	m_levelFirsts.clear();
+	m_levelCounts.clear();
+	for (size_t object = 0; object < m_objects.size(); object++)
+	{
+		GLuint triangles = pVertexPool->GetIndexCount((int)m_objects[object].poolMesh) / 3;
+		if (m_sources.size() + triangles > g_MaxTriangles)
+		{
+			std::cout << "Too many triangles for the ray traced shadows, "
+				<< (m_objects.size() - object) << " objects cast none" << std::endl;
+			break;
+		}
+		for (GLuint triangle = 0; triangle < triangles; triangle++)
+		{
+			m_sources.push_back(glm::uvec2((GLuint)object, triangle));
+		}
+	}
+	m_triangleCount = (GLuint)m_sources.size();
+	if (m_triangleCount == 0)
+	{
+		return;
+	}
+
+	glNamedBufferData(m_objectBuffer, m_objects.size() * sizeof(RAY_SHADOW_OBJECT_BLOCK), m_objects.data(), GL_DYNAMIC_DRAW);
+	glNamedBufferData(m_sourceBuffer, m_sources.size() * sizeof(glm::uvec2), m_sources.data(), GL_STATIC_DRAW);
+	glNamedBufferData(m_triangleBuffer, (size_t)m_triangleCount * 9 * sizeof(GLfloat), NULL, GL_DYNAMIC_COPY);
+	TransformTriangles();
+
+	std::vector<GLfloat> corners((size_t)m_triangleCount * 9);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glGetNamedBufferSubData(m_triangleBuffer, 0, corners.size() * sizeof(GLfloat), corners.data());
+
+	std::vector<glm::vec3> centers(m_triangleCount);
+	std::vector<glm::vec3> mins(m_triangleCount);
+	std::vector<glm::vec3> maxs(m_triangleCount);
+	for (GLuint triangle = 0; triangle < m_triangleCount; triangle++)
+	{
+		const GLfloat* corner = &corners[(size_t)triangle * 9];
+		glm::vec3 p0(corner[0], corner[1], corner[2]);
+		glm::vec3 p1(corner[3], corner[4], corner[5]);
+		glm::vec3 p2(corner[6], corner[7], corner[8]);
+		mins[triangle] = glm::min(p0, glm::min(p1, p2));
+		maxs[triangle] = glm::max(p0, glm::max(p1, p2));
+		centers[triangle] = (mins[triangle] + maxs[triangle]) * 0.5f;
+	}
+
+	std::vector<GLuint> order(m_triangleCount);
+	std::iota(order.begin(), order.end(), 0u);
+	std::vector<BUILD_NODE> nodes;
+	int root = BuildNode(nodes, order, centers, mins, maxs, 0, (int)m_triangleCount, 0);
+
+	// breadth first, so every level is one range and the two
+	// children of a node are side by side
+	std::vector<int> layout(1, root);
+	std::vector<BVH_NODE_BLOCK> blocks;
+	size_t levelFirst = 0;
+	while (levelFirst < layout.size())
+	{
+		size_t levelEnd = layout.size();
+		m_levelFirsts.push_back((GLuint)levelFirst);
+		m_levelCounts.push_back((GLuint)(levelEnd - levelFirst));
+		for (size_t index = levelFirst; index < levelEnd; index++)
+		{
+			const BUILD_NODE& node = nodes[layout[index]];
+			BVH_NODE_BLOCK block = BVH_NODE_BLOCK();
+			block.boundsMin = node.boundsMin;
+			block.boundsMax = node.boundsMax;
+			if (node.count > 0)
+			{
+				block.first = (GLuint)node.first;
+				block.count = (GLuint)node.count;
+			}
+			else
+			{
+				block.first = (GLuint)layout.size();
+				block.count = 0;
+				layout.push_back(node.children[0]);
+				layout.push_back(node.children[1]);
+			}
+			blocks.push_back(block);
+		}
+		levelFirst = levelEnd;
+	}
+
+	std::vector<glm::uvec2> sources(m_triangleCount);
+	for (GLuint index = 0; index < m_triangleCount; index++)
+	{
+		sources[index] = m_sources[order[index]];
+	}
+	m_sources.swap(sources);
+	glNamedBufferData(m_sourceBuffer, m_sources.size() * sizeof(glm::uvec2), m_sources.data(), GL_STATIC_DRAW);
+	glNamedBufferData(m_nodeBuffer, blocks.size() * sizeof(BVH_NODE_BLOCK), blocks.data(), GL_DYNAMIC_COPY);
+	TransformTriangles();
+
+	std::cout << "Built the shadow BVH: " << m_triangleCount << " triangles, " << blocks.size()
+		<< " nodes, " << m_levelFirsts.size() << " levels" << std::endl;
+}
+
+/***********************************************************
+ *  BuildNode()
+ *
+ *  This method is used for building the subtree over a
+ *  range of the triangle order.  The centers are sorted
+ *  into bins along the longest axis of their box and the
+ *  range is split at the bin boundary with the lowest
+ *  surface area cost, or made a leaf when that costs more
+ *  than not splitting.  Ranges the bins cannot separate
+ *  are split at the median.
+ ***********************************************************/
+int RayShadowManager::BuildNode(
+	std::vector<BUILD_NODE>& nodes,
+	std::vector<GLuint>& order,
+	const std::vector<glm::vec3>& centers,
+	const std::vector<glm::vec3>& mins,
+	const std::vector<glm::vec3>& maxs,
+	int first,
+	int count,
+	int depth)
+{
+	BUILD_NODE node;
+	node.boundsMin = glm::vec3(FLT_MAX);
+	node.boundsMax = glm::vec3(-FLT_MAX);
+	node.children[0] = node.children[1] = -1;
+	node.first = first;
+	node.count = count;
+	glm::vec3 centerMin = glm::vec3(FLT_MAX);
+	glm::vec3 centerMax = glm::vec3(-FLT_MAX);
+	for (int index = first; index < first + count; index++)
+	{
+		GLuint triangle = order[index];
+		node.boundsMin = glm::min(node.boundsMin, mins[triangle]);
+		node.boundsMax = glm::max(node.boundsMax, maxs[triangle]);
+		centerMin = glm::min(centerMin, centers[triangle]);
+		centerMax = glm::max(centerMax, centers[triangle]);
+	}
+	int nodeIndex = (int)nodes.size();
+	nodes.push_back(node);
+
+	if ((count <= g_LeafTriangles) || (depth >= g_MaxTreeDepth))
+	{
+		return(nodeIndex);
+	}
+
+	glm::vec3 centerExtent = centerMax - centerMin;
+	int axis = 0;
+	if (centerExtent.y > centerExtent[axis])
+	{
+		axis = 1;
+	}
+	if (centerExtent.z > centerExtent[axis])
+	{
+		axis = 2;
+	}
+
+	int middle = first + count / 2;
+	if (centerExtent[axis] > 0.0f)
+	{
+		// the triangles of every bin and the box around them
+		float binScale = (float)g_SplitBins / centerExtent[axis];
+		auto binOf = [&](GLuint triangle)
+		{
+			int bin = (int)((centers[triangle][axis] - centerMin[axis]) * binScale);
+			return(std::min(bin, g_SplitBins - 1));
+		};
+		int binCounts[g_SplitBins] = {};
+		glm::vec3 binMins[g_SplitBins];
+		glm::vec3 binMaxs[g_SplitBins];
+		for (int bin = 0; bin < g_SplitBins; bin++)
+		{
+			binMins[bin] = glm::vec3(FLT_MAX);
+			binMaxs[bin] = glm::vec3(-FLT_MAX);
+		}
+		for (int index = first; index < first + count; index++)
+		{
+			GLuint triangle = order[index];
+			int bin = binOf(triangle);
+			binCounts[bin]++;
+			binMins[bin] = glm::min(binMins[bin], mins[triangle]);
+			binMaxs[bin] = glm::max(binMaxs[bin], maxs[triangle]);
+		}
+
+		// cost of the split before each bin, from both sides
+		float leftCosts[g_SplitBins] = {};
+		glm::vec3 sweepMin = glm::vec3(FLT_MAX);
+		glm::vec3 sweepMax = glm::vec3(-FLT_MAX);
+		int sweepCount = 0;
+		for (int bin = 0; bin < g_SplitBins - 1; bin++)
+		{
+			sweepMin = glm::min(sweepMin, binMins[bin]);
+			sweepMax = glm::max(sweepMax, binMaxs[bin]);
+			sweepCount += binCounts[bin];
+			leftCosts[bin + 1] = BoxArea(sweepMin, sweepMax) * (float)sweepCount;
+		}
+		float bestCost = FLT_MAX;
+		int bestSplit = 0;
+		sweepMin = glm::vec3(FLT_MAX);
+		sweepMax = glm::vec3(-FLT_MAX);
+		sweepCount = 0;
+		for (int bin = g_SplitBins - 1; bin > 0; bin--)
+		{
+			sweepMin = glm::min(sweepMin, binMins[bin]);
+			sweepMax = glm::max(sweepMax, binMaxs[bin]);
+			sweepCount += binCounts[bin];
+			float cost = leftCosts[bin] + BoxArea(sweepMin, sweepMax) * (float)sweepCount;
+			if ((sweepCount > 0) && (sweepCount < count) && (cost < bestCost))
+			{
+				bestCost = cost;
+				bestSplit = bin;
+			}
+		}
+
+		float leafCost = BoxArea(node.boundsMin, node.boundsMax) * (float)count;
+		if ((bestCost >= leafCost) && (count <= g_MaxLeafTriangles))
+		{
+			return(nodeIndex);
+		}
+		if (bestSplit > 0)
+		{
+			middle = (int)(std::partition(order.begin() + first, order.begin() + first + count,
+				[&](GLuint triangle) { return(binOf(triangle) < bestSplit); }) - order.begin());
+		}
+	}
+	if ((middle <= first) || (middle >= first + count))
+	{
+		middle = first + count / 2;
+		std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count,
+			[&](GLuint a, GLuint b) { return(centers[a][axis] < centers[b][axis]); });
+	}
+
+	int left = BuildNode(nodes, order, centers, mins, maxs, first, middle - first, depth + 1);
+	int right = BuildNode(nodes, order, centers, mins, maxs, middle, first + count - middle, depth + 1);
+	nodes[nodeIndex].children[0] = left;
+	nodes[nodeIndex].children[1] = right;
+	nodes[nodeIndex].count = 0;
+	return(nodeIndex);
+}
+
+/***********************************************************
+ *  TransformTriangles()
+ ***********************************************************/
+void RayShadowManager::TransformTriangles()
+{
+	m_pTransformShader->use();
+	m_pTransformShader->setUIntValue("triangleCount", m_triangleCount);
+	m_pShapeMeshes->GetVertexPool()->Bind();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAY_SHADOW_OBJECT_BINDING, m_objectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAY_SHADOW_TRIANGLE_BINDING, m_triangleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAY_SHADOW_SOURCE_BINDING, m_sourceBuffer);
+	glDispatchCompute((m_triangleCount + 63) / 64, 1, 1);
+	glBindVertexArray(0);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+/***********************************************************
+ *  RefitTree()
+ *
+ *  This method is used for fitting the boxes around the
+ *  triangles where they are now.  A level's boxes are
+ *  made from the level below, so each level is one
+ *  dispatch after the one before it is written.
+ ***********************************************************/
+void RayShadowManager::RefitTree()
+{
+	m_pRefitShader->use();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAY_SHADOW_TRIANGLE_BINDING, m_triangleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAY_SHADOW_NODE_BINDING, m_nodeBuffer);
+	for (int level = (int)m_levelFirsts.size() - 1; level >= 0; level--)
+	{
+		m_pRefitShader->setUIntValue("levelFirst", m_levelFirsts[level]);
+		m_pRefitShader->setUIntValue("levelCount", m_levelCounts[level]);
+		glDispatchCompute((m_levelCounts[level] + 63) / 64, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+}
+
+/***********************************************************
+ *  ReadTimers()
+ *
+ *  This method is used for adding the GPU time of the
+ *  traces whose time stamps are available to the average
+ *  of their number of lights, without waiting for the
+ *  others.
+ ***********************************************************/
+void RayShadowManager::ReadTimers()
+{
+	for (TIMER_QUERY& timer : m_timers)
+	{
+		if (timer.bPending == false)
+		{
+			continue;
+		}
+		GLint available = 0;
+		glGetQueryObjectiv(timer.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0)
+		{
+			continue;
+		}
+		GLuint64 start = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(timer.queries[0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(timer.queries[1], GL_QUERY_RESULT, &end);
+		float milliseconds = (float)((double)(end - start) / 1.0e6);
+		float& average = m_traceTimes[timer.lightCount];
+		average = (average == 0.0f) ? milliseconds : average + (milliseconds - average) * g_TimeSmoothing;
+		timer.bPending = false;
+	}
+}
@@ -0,0 +1,180 @@
+///////////////////////////////////////////////////////////////////////////////
+// rayshadowmanager.h
+// ============
+// shadows of the first lights, ray traced per pixel through a BVH on the GPU
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "ShaderManager.h"
+#include "ShapeMeshes.h"
+#include "VertexPool.h"
+#include "ViewManager.h"
+#include "UniformBlocks.h"
+
+#include <vector>
+
+/***********************************************************
+ *  RayShadowManager
+ *
+ *  This class traces one shadow ray per pixel toward each
+ *  of the first lights, from the surfaces in the scene
+ *  depth, in a compute shader.  The triangles of the opaque
+ *  objects are pulled from the vertex pool into world space
+ *  in one storage buffer, and a bounding volume hierarchy
+ *  over them in another, with two children per inner node
+ *  and up to a few triangles per leaf.
+ *
+ *  The tree is built on the CPU, with the surface area
+ *  heuristic, only when the objects or their meshes change:
+ *  their triangles are read back once for it and then kept
+ *  in the order of the leaves.  When objects only move the
+ *  triangles are transformed again on the GPU and the
+ *  boxes refitted from the deepest level up, one dispatch
+ *  per level; nodes are stored level by level with the two
+ *  children of a node side by side.  The tree stays the
+ *  shape it was built in, so it gets looser, never wrong,
+ *  as objects move apart.
+ *
+ *  Every frame each ray aims at another random point of a
+ *  small disk around its light, and the result is blended
+ *  into the last frame's, reprojected and kept where the
+ *  same surface is seen, which averages into soft shadows.
+ *  The scene shader reads the visibility of a light from
+ *  one channel of the result at its pixel, so the shadows
+ *  apply where the depth is drawn before the shading: the
+ *  resolve pass of the visibility buffer.
+ ***********************************************************/
+class RayShadowManager
+{
+public:
+	// constructor, the meshes are read from the vertex pool of
+	// pShapeMeshes and the program binaries are cached in
+	// pDerivedDataCache when passed
+	RayShadowManager(ShapeMeshes* pShapeMeshes, DerivedDataCache* pDerivedDataCache = NULL);
+	// destructor
+	~RayShadowManager();
+
+	// point the shadow sampler of a program at its unit
+	void SetSamplers(ShaderManager* pShader);
+
+	// turn the shadows on or off; the history is dropped
+	void SetEnabled(bool bEnabled);
+	bool GetEnabled() const { return(m_bEnabled); }
+	// the lights shaded per pixel, the first of which cast shadows
+	void SetLightCount(int lightCount) { m_lightCount = lightCount; }
+
+	// forget the objects added for the last frame
+	void BeginFrame() { m_frameObjects.clear(); }
+	// add an opaque object drawn this frame; objects without a
+	// vertex pool mesh cast no shadow
+	void AddObject(const glm::mat4& model, int poolMesh);
+	// bring the BVH up to date with the objects added since the
+	// last trace and trace the shadows of the surfaces in the
+	// scene depth; false when nothing was traced and the scene
+	// shader must not read the result.  The caller makes its
+	// shader program current again afterwards
+	bool Trace(ViewManager* pViewManager);
+
+	// average GPU time of Trace() in milliseconds with the given
+	// number of lights casting shadows, 0 before it was measured
+	float GetTraceTime(int lightCount) const;
+
+private:
+	// a node while the tree is built
+	struct BUILD_NODE
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		int children[2];
+		// the range of the build order a leaf holds
+		int first;
+		int count;
+	};
+
+	// GPU time stamps of a trace, read when they are available
+	struct TIMER_QUERY
+	{
+		GLuint queries[2];
+		int lightCount;
+		bool bPending;
+	};
+
+	ShapeMeshes* m_pShapeMeshes;
+
+	// transform, refit and trace programs
+	ShaderManager* m_pTransformShader;
+	ShaderManager* m_pRefitShader;
+	ShaderManager* m_pTraceShader;
+	bool m_bShadersLoaded;
+	bool m_bEnabled;
+	int m_lightCount;
+
+	// the objects added for the next trace, and the ones the
+	// triangles were last transformed with
+	std::vector<RAY_SHADOW_OBJECT_BLOCK> m_frameObjects;
+	std::vector<RAY_SHADOW_OBJECT_BLOCK> m_objects;
+
+	// object and mesh triangle of every triangle, in leaf order,
+	// and the first node and node count of every level
+	std::vector<glm::uvec2> m_sources;
+	std::vector<GLuint> m_levelFirsts;
+	std::vector<GLuint> m_levelCounts;
+	GLuint m_triangleCount;
+
+	GLuint m_objectBuffer;
+	GLuint m_triangleBuffer;
+	GLuint m_nodeBuffer;
+	GLuint m_sourceBuffer;
+
+	// the result and the surface distances, this frame's and
+	// the last one's, swapped every trace
+	GLuint m_shadowTextures[2];
+	GLuint m_distanceTextures[2];
+	int m_current;
+	int m_width;
+	int m_height;
+	bool m_bHistoryValid;
+	glm::mat4 m_previousViewProjection;
+	glm::vec3 m_previousCameraPosition;
+	GLuint m_frameIndex;
+
+	// timer queries of the last traces and the averages per
+	// number of lights
+	std::vector<TIMER_QUERY> m_timers;
+	int m_timerIndex;
+	std::vector<float> m_traceTimes;
+
+	// load the programs, false if any failed
+	bool LoadShaders();
+	// create the result textures at the scene target size
+	void CreateTargets(int width, int height);
+	// free the result textures
+	void DestroyTargets();
+	// gather every triangle of the objects, read them back and
+	// build the tree over them
+	void BuildTree();
+	// split the triangles order[first, first + count) into a
+	// subtree, returning its root
+	int BuildNode(
+		std::vector<BUILD_NODE>& nodes,
+		std::vector<GLuint>& order,
+		const std::vector<glm::vec3>& centers,
+		const std::vector<glm::vec3>& mins,
+		const std::vector<glm::vec3>& maxs,
+		int first,
+		int count,
+		int depth);
+	// write the triangles of the objects into world space, in the
+	// order of m_sources
+	void TransformTriangles();
+	// fit the boxes of every level, the deepest first
+	void RefitTree();
+	// read the timer queries that are ready
+	void ReadTimers();
+};
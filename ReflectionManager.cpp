@@ -0,0 +1,450 @@
+///////////////////////////////////////////////////////////////////////////////
+// reflectionmanager.cpp
+// ============
+// hierarchical depth screen space reflections and the environment probe
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ReflectionManager.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	const char* g_FullscreenVertexShader = "../../Utilities/shaders/fullscreenVertexShader.glsl";
+	const char* g_HiZFragmentShader = "../../Utilities/shaders/hiZFragmentShader.glsl";
+	const char* g_TraceFragmentShader = "../../Utilities/shaders/ssrTraceFragmentShader.glsl";
+	const char* g_ResolveFragmentShader = "../../Utilities/shaders/ssrResolveFragmentShader.glsl";
+	const char* g_CompositeFragmentShader = "../../Utilities/shaders/ssrCompositeFragmentShader.glsl";
+
+	// the reflection samplers use the units after the scene
+	// textures, the transparency targets and the area light tables
+	const GLuint g_HiZTextureUnit = 22;
+	const GLuint g_SurfaceTextureUnit = 23;
+	const GLuint g_SurfaceTextureMSUnit = 24;
+	const GLuint g_SceneColorTextureUnit = 25;
+	const GLuint g_SceneColorTextureMSUnit = 26;
+	const GLuint g_ProbeTextureUnit = 27;
+	const GLuint g_TraceTextureUnit = 28;
+	const GLuint g_HistoryTextureUnit = 29;
+
+	// size of a face of the environment probe
+	const int g_ProbeSize = 128;
+
+	/***********************************************************
+	 *  LoadProgram()
+	 *
+	 *  Load one full screen pass, false on error.
+	 ***********************************************************/
+	bool LoadProgram(ShaderManager* pShader, const char* fragmentShader)
+	{
+		pShader->LoadShaders(g_FullscreenVertexShader, fragmentShader);
+		return(pShader->m_programID != 0);
+	}
+
+	/***********************************************************
+	 *  DeleteProgram()
+	 ***********************************************************/
+	void DeleteProgram(ShaderManager* pShader)
+	{
+		if (pShader->m_programID != 0)
+		{
+			glDeleteProgram(pShader->m_programID);
+		}
+		delete pShader;
+	}
+
+	/***********************************************************
+	 *  NewShader()
+	 ***********************************************************/
+	ShaderManager* NewShader(DerivedDataCache* pDerivedDataCache)
+	{
+		ShaderManager* pShader = new ShaderManager();
+		pShader->m_programID = 0;
+		pShader->m_pDerivedDataCache = pDerivedDataCache;
+		return(pShader);
+	}
+}
+
+/***********************************************************
+ *  ReflectionManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ReflectionManager::ReflectionManager(DerivedDataCache* pDerivedDataCache)
+{
+	m_pHiZShader = NewShader(pDerivedDataCache);
+	m_pTraceShader = NewShader(pDerivedDataCache);
+	m_pResolveShader = NewShader(pDerivedDataCache);
+	m_pCompositeShader = NewShader(pDerivedDataCache);
+	m_fullscreenVAO = 0;
+	m_bShadersLoaded = false;
+	m_probeFramebuffer = 0;
+	m_probeTexture = 0;
+	m_probeDepth = 0;
+	m_probeLevels = 1;
+	m_framebuffer = 0;
+	m_hiZTexture = 0;
+	m_traceTexture = 0;
+	m_historyTextures[0] = 0;
+	m_historyTextures[1] = 0;
+	m_historyIndex = 0;
+	m_hiZLevels = 0;
+	m_width = 0;
+	m_height = 0;
+	m_previousViewProjection = glm::mat4(1.0f);
+	m_bHistoryValid = false;
+	m_frameIndex = 0;
+}
+
+/***********************************************************
+ *  ~ReflectionManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ReflectionManager::~ReflectionManager()
+{
+	DestroyTargets();
+	if (m_probeFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_probeFramebuffer);
+		m_probeFramebuffer = 0;
+	}
+	glDeleteTextures(1, &m_probeTexture);
+	glDeleteRenderbuffers(1, &m_probeDepth);
+	m_probeTexture = 0;
+	m_probeDepth = 0;
+	if (m_fullscreenVAO != 0)
+	{
+		glDeleteVertexArrays(1, &m_fullscreenVAO);
+		m_fullscreenVAO = 0;
+	}
+	DeleteProgram(m_pHiZShader);
+	DeleteProgram(m_pTraceShader);
+	DeleteProgram(m_pResolveShader);
+	DeleteProgram(m_pCompositeShader);
+	m_pHiZShader = NULL;
+	m_pTraceShader = NULL;
+	m_pResolveShader = NULL;
+	m_pCompositeShader = NULL;
+}
+
+/***********************************************************
+ *  LoadShaders()
+ *
+ *  This method is used for loading the programs of the
+ *  passes the first time reflections are drawn.  If any of
+ *  them fails the reflections stay off.
+ ***********************************************************/
+bool ReflectionManager::LoadShaders()
+{
+	if (m_bShadersLoaded == false)
+	{
+		m_bShadersLoaded = true;
+		bool bLoaded = LoadProgram(m_pHiZShader, g_HiZFragmentShader);
+		bLoaded = LoadProgram(m_pTraceShader, g_TraceFragmentShader) && bLoaded;
+		bLoaded = LoadProgram(m_pResolveShader, g_ResolveFragmentShader) && bLoaded;
+		bLoaded = LoadProgram(m_pCompositeShader, g_CompositeFragmentShader) && bLoaded;
+		if (bLoaded == false)
+		{
+			std::cout << "Could not load the reflection shaders, reflections are off" << std::endl;
+			glDeleteProgram(m_pCompositeShader->m_programID);
+			m_pCompositeShader->m_programID = 0;
+		}
+		glCreateVertexArrays(1, &m_fullscreenVAO);
+	}
+	return(m_pCompositeShader->m_programID != 0);
+}
+
+/***********************************************************
+ *  BeginProbeFace()
+ *
+ *  This method is used for preparing a face of the cube map
+ *  the scene is captured into, creating it on the first
+ *  face.  The face is cleared like the scene and drawn with
+ *  a 90 degree view along the face's axis.
+ ***********************************************************/
+bool ReflectionManager::BeginProbeFace(int face, glm::vec3 position, glm::mat4& view, glm::mat4& projection)
+{
+	if (m_probeFramebuffer == 0)
+	{
+		m_probeLevels = 1;
+		while ((g_ProbeSize >> m_probeLevels) > 0)
+		{
+			m_probeLevels++;
+		}
+		glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &m_probeTexture);
+		glTextureStorage2D(m_probeTexture, m_probeLevels, GL_RGBA16F, g_ProbeSize, g_ProbeSize);
+		glTextureParameteri(m_probeTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(m_probeTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(m_probeTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_probeTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+		glCreateRenderbuffers(1, &m_probeDepth);
+		glNamedRenderbufferStorage(m_probeDepth, GL_DEPTH_COMPONENT24, g_ProbeSize, g_ProbeSize);
+		glCreateFramebuffers(1, &m_probeFramebuffer);
+		glNamedFramebufferRenderbuffer(m_probeFramebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_probeDepth);
+	}
+
+	// a cube face is a layer of the cube map
+	glNamedFramebufferTextureLayer(m_probeFramebuffer, GL_COLOR_ATTACHMENT0, m_probeTexture, 0, face);
+	if (glCheckNamedFramebufferStatus(m_probeFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Could not create the environment probe" << std::endl;
+		return(false);
+	}
+
+	// the axes and up vectors of the faces +X, -X, +Y, -Y, +Z, -Z
+	const glm::vec3 axes[6] = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+	const glm::vec3 ups[6] = {
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+	view = glm::lookAt(position, position + axes[face], ups[face]);
+	projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_probeFramebuffer);
+	glViewport(0, 0, g_ProbeSize, g_ProbeSize);
+	glEnable(GL_DEPTH_TEST);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	return(true);
+}
+
+/***********************************************************
+ *  EndProbeCapture()
+ *
+ *  This method is used for building the mips of the probe,
+ *  which the rough surfaces read as a blurred environment.
+ ***********************************************************/
+void ReflectionManager::EndProbeCapture()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (m_probeTexture != 0)
+	{
+		glGenerateTextureMipmap(m_probeTexture);
+	}
+}
+
+/***********************************************************
+ *  CreateTargets()
+ *
+ *  This method is used for creating the half resolution
+ *  targets.  The depth pyramid halves down to one texel,
+ *  rounding down, and the histories are filtered since
+ *  they are read at reprojected positions.
+ ***********************************************************/
+void ReflectionManager::CreateTargets(int sceneWidth, int sceneHeight)
+{
+	DestroyTargets();
+
+	m_width = std::max(1, sceneWidth / 2);
+	m_height = std::max(1, sceneHeight / 2);
+	m_hiZLevels = 1;
+	while ((std::max(m_width, m_height) >> m_hiZLevels) > 0)
+	{
+		m_hiZLevels++;
+	}
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_hiZTexture);
+	glTextureStorage2D(m_hiZTexture, m_hiZLevels, GL_R32F, m_width, m_height);
+	glTextureParameteri(m_hiZTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(m_hiZTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_traceTexture);
+	glTextureStorage2D(m_traceTexture, 1, GL_RGBA16F, m_width, m_height);
+	glCreateTextures(GL_TEXTURE_2D, 2, m_historyTextures);
+	for (int i = 0; i < 2; i++)
+	{
+		glTextureStorage2D(m_historyTextures[i], 1, GL_RGBA16F, m_width, m_height);
+		glTextureParameteri(m_historyTextures[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(m_historyTextures[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(m_historyTextures[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_historyTextures[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	glCreateFramebuffers(1, &m_framebuffer);
+	m_bHistoryValid = false;
+}
+
+/***********************************************************
+ *  DestroyTargets()
+ ***********************************************************/
+void ReflectionManager::DestroyTargets()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	GLuint textures[4] = { m_hiZTexture, m_traceTexture, m_historyTextures[0], m_historyTextures[1] };
+	glDeleteTextures(4, textures);
+	m_hiZTexture = 0;
+	m_traceTexture = 0;
+	m_historyTextures[0] = 0;
+	m_historyTextures[1] = 0;
+	m_hiZLevels = 0;
+	m_width = 0;
+	m_height = 0;
+	m_bHistoryValid = false;
+}
+
+/***********************************************************
+ *  DrawPass()
+ *
+ *  This method is used for drawing one full screen triangle
+ *  with the current program into a level of a texture.
+ ***********************************************************/
+void ReflectionManager::DrawPass(GLuint texture, int level, int width, int height)
+{
+	glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, texture, level);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, width, height);
+	glBindVertexArray(m_fullscreenVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  BuildHiZ()
+ *
+ *  This method is used for reducing the scene depth into
+ *  the pyramid, level by level.  While a level is drawn the
+ *  texture only exposes the level above it, so reading and
+ *  writing the same texture is not a feedback loop.
+ ***********************************************************/
+void ReflectionManager::BuildHiZ(ViewManager* pViewManager)
+{
+	bool bMultisample = (pViewManager->GetSceneSamples() > 1);
+
+	m_pHiZShader->use();
+	m_pHiZShader->setBoolValue("bMultisample", bMultisample);
+	m_pHiZShader->setSampler2DValue("depthTexture", g_SurfaceTextureUnit);
+	m_pHiZShader->setSampler2DValue("depthTextureMS", g_SurfaceTextureMSUnit);
+	m_pHiZShader->setSampler2DValue("hiZTexture", g_HiZTextureUnit);
+	glBindTextureUnit(bMultisample ? g_SurfaceTextureMSUnit : g_SurfaceTextureUnit, pViewManager->GetSceneDepthTexture());
+	glBindTextureUnit(g_HiZTextureUnit, m_hiZTexture);
+
+	int sourceWidth = pViewManager->GetSceneWidth();
+	int sourceHeight = pViewManager->GetSceneHeight();
+	for (int level = 0; level < m_hiZLevels; level++)
+	{
+		int width = std::max(1, m_width >> level);
+		int height = std::max(1, m_height >> level);
+		m_pHiZShader->setBoolValue("bFromScene", level == 0);
+		m_pHiZShader->setVec2Value("sourceSize", (float)sourceWidth, (float)sourceHeight);
+		m_pHiZShader->setVec2Value("targetSize", (float)width, (float)height);
+		if (level > 0)
+		{
+			glTextureParameteri(m_hiZTexture, GL_TEXTURE_BASE_LEVEL, level - 1);
+			glTextureParameteri(m_hiZTexture, GL_TEXTURE_MAX_LEVEL, level - 1);
+		}
+		DrawPass(m_hiZTexture, level, width, height);
+		sourceWidth = width;
+		sourceHeight = height;
+	}
+	glTextureParameteri(m_hiZTexture, GL_TEXTURE_BASE_LEVEL, 0);
+	glTextureParameteri(m_hiZTexture, GL_TEXTURE_MAX_LEVEL, m_hiZLevels - 1);
+}
+
+/***********************************************************
+ *  ApplyReflections()
+ *
+ *  This method is used for the reflection passes: the depth
+ *  pyramid, the ray trace into the current frame's target,
+ *  the temporal resolve into the next history, and the
+ *  composite that adds the history over the scene target.
+ *  The history is dropped when the targets change size.
+ ***********************************************************/
+void ReflectionManager::ApplyReflections(ViewManager* pViewManager)
+{
+	if ((NULL == pViewManager) || (pViewManager->GetSceneFramebuffer() == 0) ||
+		(m_probeTexture == 0) || (LoadShaders() == false))
+	{
+		return;
+	}
+
+	int sceneWidth = pViewManager->GetSceneWidth();
+	int sceneHeight = pViewManager->GetSceneHeight();
+	if ((m_framebuffer == 0) || (std::max(1, sceneWidth / 2) != m_width) || (std::max(1, sceneHeight / 2) != m_height))
+	{
+		CreateTargets(sceneWidth, sceneHeight);
+	}
+
+	glm::mat4 view = pViewManager->GetViewMatrix();
+	glm::mat4 projection = pViewManager->GetProjectionMatrix();
+	glm::mat4 viewProjection = projection * view;
+	bool bMultisample = (pViewManager->GetSceneSamples() > 1);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	BuildHiZ(pViewManager);
+
+	// one ray per pixel
+	m_pTraceShader->use();
+	m_pTraceShader->setSampler2DValue("hiZTexture", g_HiZTextureUnit);
+	m_pTraceShader->setVec2Value("hiZSize", (float)m_width, (float)m_height);
+	m_pTraceShader->setIntValue("hiZLevels", m_hiZLevels);
+	m_pTraceShader->setBoolValue("bMultisample", bMultisample);
+	m_pTraceShader->setSampler2DValue("surfaceTexture", g_SurfaceTextureUnit);
+	m_pTraceShader->setSampler2DValue("surfaceTextureMS", g_SurfaceTextureMSUnit);
+	m_pTraceShader->setSampler2DValue("sceneColorTexture", g_SceneColorTextureUnit);
+	m_pTraceShader->setSampler2DValue("sceneColorTextureMS", g_SceneColorTextureMSUnit);
+	m_pTraceShader->setVec2Value("sceneSize", (float)sceneWidth, (float)sceneHeight);
+	m_pTraceShader->setSampler2DValue("probeTexture", g_ProbeTextureUnit);
+	m_pTraceShader->setFloatValue("probeLevels", (float)m_probeLevels);
+	m_pTraceShader->setMat4Value("view", view);
+	m_pTraceShader->setMat4Value("projection", projection);
+	m_pTraceShader->setMat4Value("inverseView", glm::inverse(view));
+	m_pTraceShader->setMat4Value("inverseProjection", glm::inverse(projection));
+	m_pTraceShader->setIntValue("frameIndex", m_frameIndex);
+	glBindTextureUnit(bMultisample ? g_SurfaceTextureMSUnit : g_SurfaceTextureUnit, pViewManager->GetSceneSurfaceTexture());
+	glBindTextureUnit(bMultisample ? g_SceneColorTextureMSUnit : g_SceneColorTextureUnit, pViewManager->GetSceneColorTexture());
+	glBindTextureUnit(g_ProbeTextureUnit, m_probeTexture);
+	DrawPass(m_traceTexture, 0, m_width, m_height);
+
+	// averaged with the reprojected history
+	int nextHistory = 1 - m_historyIndex;
+	m_pResolveShader->use();
+	m_pResolveShader->setSampler2DValue("traceTexture", g_TraceTextureUnit);
+	m_pResolveShader->setSampler2DValue("historyTexture", g_HistoryTextureUnit);
+	m_pResolveShader->setSampler2DValue("hiZTexture", g_HiZTextureUnit);
+	m_pResolveShader->setBoolValue("bHistoryValid", m_bHistoryValid);
+	m_pResolveShader->setMat4Value("inverseViewProjection", glm::inverse(viewProjection));
+	m_pResolveShader->setMat4Value("previousViewProjection", m_previousViewProjection);
+	glBindTextureUnit(g_TraceTextureUnit, m_traceTexture);
+	glBindTextureUnit(g_HistoryTextureUnit, m_historyTextures[m_historyIndex]);
+	DrawPass(m_historyTextures[nextHistory], 0, m_width, m_height);
+
+	// added over the scene
+	glBindFramebuffer(GL_FRAMEBUFFER, pViewManager->GetSceneFramebuffer());
+	glViewport(0, 0, sceneWidth, sceneHeight);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	m_pCompositeShader->use();
+	m_pCompositeShader->setSampler2DValue("reflectionTexture", g_HistoryTextureUnit);
+	m_pCompositeShader->setVec2Value("sceneSize", (float)sceneWidth, (float)sceneHeight);
+	glBindTextureUnit(g_HistoryTextureUnit, m_historyTextures[nextHistory]);
+	glBindVertexArray(m_fullscreenVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	m_historyIndex = nextHistory;
+	m_previousViewProjection = viewProjection;
+	m_bHistoryValid = true;
+	m_frameIndex++;
+
+	// back to the opaque render state set up by the view manager
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_DEPTH_TEST);
+	glDisablei(GL_BLEND, 2);
+}
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+// reflectionmanager.h
+// ============
+// hierarchical depth screen space reflections and the environment probe
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "ShaderManager.h"
+#include "ViewManager.h"
+
+/***********************************************************
+ *  ReflectionManager
+ *
+ *  This class adds glossy reflections to the opaque
+ *  surfaces of the scene target.  The scene shader writes
+ *  the normal, reflectance and roughness of every surface
+ *  smoother than its material's cutoff; the others are
+ *  skipped.  The scene depth is reduced into a pyramid of
+ *  nearest depths at half resolution, and one ray per half
+ *  resolution pixel skips through it, sampling the GGX lobe
+ *  with a pattern that changes every frame.  Rays that
+ *  leave the screen or find nothing take the environment
+ *  probe, a cube map of the scene captured once.  The rays
+ *  are averaged over the frames in a reprojected history,
+ *  which is then added over the scene.
+ ***********************************************************/
+class ReflectionManager
+{
+public:
+	// constructor, the program binaries are cached in
+	// pDerivedDataCache when passed
+	ReflectionManager(DerivedDataCache* pDerivedDataCache = NULL);
+	// destructor
+	~ReflectionManager();
+
+	// bind one face of the environment probe at position and get the
+	// view and projection to draw the scene into it with; false when
+	// the probe cannot be created
+	bool BeginProbeFace(int face, glm::vec3 position, glm::mat4& view, glm::mat4& projection);
+	// build the blurred mips of the probe and unbind it
+	void EndProbeCapture();
+
+	// trace the reflections of the opaque surfaces drawn so far and
+	// add them to the scene target; the caller makes its own shader
+	// program current again afterwards
+	void ApplyReflections(ViewManager* pViewManager);
+
+private:
+	// shader programs of the passes and their empty vertex array
+	ShaderManager* m_pHiZShader;
+	ShaderManager* m_pTraceShader;
+	ShaderManager* m_pResolveShader;
+	ShaderManager* m_pCompositeShader;
+	GLuint m_fullscreenVAO;
+	bool m_bShadersLoaded;
+
+	// environment probe
+	GLuint m_probeFramebuffer;
+	GLuint m_probeTexture;
+	GLuint m_probeDepth;
+	int m_probeLevels;
+
+	// half resolution targets: the depth pyramid, this frame's
+	// rays and two histories used in turn
+	GLuint m_framebuffer;
+	GLuint m_hiZTexture;
+	GLuint m_traceTexture;
+	GLuint m_historyTextures[2];
+	int m_historyIndex;
+	int m_hiZLevels;
+	int m_width;
+	int m_height;
+
+	// the view projection the history was drawn with
+	glm::mat4 m_previousViewProjection;
+	bool m_bHistoryValid;
+	int m_frameIndex;
+
+	// load the pass programs, false if any failed
+	bool LoadShaders();
+	// create the targets at half of the scene target size
+	void CreateTargets(int sceneWidth, int sceneHeight);
+	// free the targets
+	void DestroyTargets();
+	// reduce the scene depth into the pyramid
+	void BuildHiZ(ViewManager* pViewManager);
+	// draw a full screen triangle into a level of a texture
+	void DrawPass(GLuint texture, int level, int width, int height);
+};
@@ -0,0 +1,328 @@
+///////////////////////////////////////////////////////////////////////////////
+// sdfshadowmanager.cpp
+// ============
+// soft shadows and ambient occlusion from the analytic distance fields of the
+// primitive shapes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SDFShadowManager.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// cells along the longest side of the grid
+	const int g_GridCells = 32;
+	// cell ranges and primitive lists together, in words
+	const size_t g_MaxGridWords = 1u << 22;
+
+	// how sharp the penumbra is (the shadow cone is about
+	// 1 / g_ShadowSoftness wide) and how far the rays march;
+	// the occlusion is sampled this far along the normal
+	const float g_ShadowSoftness = 8.0f;
+	const float g_ShadowDistance = 8.0f;
+	const float g_OcclusionDistance = 0.5f;
+
+	// the corners of the box a shape mesh fits in
+	void ShapeBounds(ShapeMeshes::ShapeType shape, float tubeRadius, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		switch (shape)
+		{
+		case ShapeMeshes::SHAPE_CONE:
+		case ShapeMeshes::SHAPE_CYLINDER:
+		case ShapeMeshes::SHAPE_TAPERED_CYLINDER:
+			boundsMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+			boundsMax = glm::vec3(1.0f, 1.0f, 1.0f);
+			break;
+		case ShapeMeshes::SHAPE_PLANE:
+			boundsMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+			boundsMax = glm::vec3(1.0f, 0.0f, 1.0f);
+			break;
+		case ShapeMeshes::SHAPE_SPHERE:
+			boundsMin = glm::vec3(-1.0f);
+			boundsMax = glm::vec3(1.0f);
+			break;
+		case ShapeMeshes::SHAPE_TORUS:
+			boundsMin = glm::vec3(-1.0f - tubeRadius, -1.0f - tubeRadius, -tubeRadius);
+			boundsMax = glm::vec3(1.0f + tubeRadius, 1.0f + tubeRadius, tubeRadius);
+			break;
+		default:
+			boundsMin = glm::vec3(-0.5f);
+			boundsMax = glm::vec3(0.5f);
+			break;
+		}
+	}
+}
+
+/***********************************************************
+ *  SDFShadowManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SDFShadowManager::SDFShadowManager(ShapeMeshes* pShapeMeshes)
+{
+	m_pShapeMeshes = pShapeMeshes;
+	m_bShadows = false;
+	m_bOcclusion = false;
+	m_bGridValid = false;
+	m_shadowUBO = 0;
+	m_primitiveBuffer = 0;
+	m_gridBuffer = 0;
+	m_block = SDF_SHADOW_BLOCK();
+	m_block.sdfShadowSoftness = g_ShadowSoftness;
+	m_block.sdfShadowDistance = g_ShadowDistance;
+	m_block.sdfOcclusionDistance = g_OcclusionDistance;
+	// a distance past the reach is only known to be at least the
+	// reach, and the rays give up on the shadow where the cone
+	// would be narrower than that
+	m_block.sdfReach = std::max(g_ShadowDistance / g_ShadowSoftness, g_OcclusionDistance);
+	m_block.sdfCellSize = 1.0f;
+}
+
+/***********************************************************
+ *  ~SDFShadowManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SDFShadowManager::~SDFShadowManager()
+{
+	glDeleteBuffers(1, &m_shadowUBO);
+	m_shadowUBO = 0;
+	glDeleteBuffers(1, &m_primitiveBuffer);
+	m_primitiveBuffer = 0;
+	glDeleteBuffers(1, &m_gridBuffer);
+	m_gridBuffer = 0;
+	m_pShapeMeshes = NULL;
+}
+
+/***********************************************************
+ *  CreateUniformBlock()
+ *
+ *  This method is used for creating the uniform buffer of
+ *  the grid placement and attaching it to its binding
+ *  point.  It starts with the shadows off, so the scene
+ *  shader reads a valid block before there is a grid.
+ ***********************************************************/
+void SDFShadowManager::CreateUniformBlock()
+{
+	if (m_shadowUBO == 0)
+	{
+		glCreateBuffers(1, &m_shadowUBO);
+		glNamedBufferStorage(m_shadowUBO, sizeof(SDF_SHADOW_BLOCK), &m_block, GL_DYNAMIC_STORAGE_BIT);
+		glBindBufferBase(GL_UNIFORM_BUFFER, SDF_SHADOW_BLOCK_BINDING, m_shadowUBO);
+	}
+}
+
+/***********************************************************
+ *  SetEnabled()
+ *
+ *  This method is used for turning the shadows and the
+ *  ambient occlusion on or off.  The grid is dropped while
+ *  both are off, since the primitives are not collected
+ *  then.
+ ***********************************************************/
+void SDFShadowManager::SetEnabled(bool bShadows, bool bOcclusion)
+{
+	m_bShadows = bShadows;
+	m_bOcclusion = bOcclusion;
+	if (GetEnabled() == false)
+	{
+		m_framePrimitives.clear();
+		m_primitives.clear();
+		m_bGridValid = false;
+	}
+	UploadBlock();
+}
+
+/***********************************************************
+ *  AddPrimitive()
+ ***********************************************************/
+void SDFShadowManager::AddPrimitive(ShapeMeshes::ShapeType shape, const glm::mat4& model)
+{
+	if (GetEnabled() == false)
+	{
+		return;
+	}
+
+	PRIMITIVE primitive;
+	primitive.shape = shape;
+	primitive.model = model;
+	m_framePrimitives.push_back(primitive);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for bringing the grid up to date
+ *  with the primitives of the last frame, so the objects
+ *  of this one are shaded with it.  Most frames add the
+ *  same primitives as the one before and nothing is done.
+ *  Returns true when the grid was rebuilt.
+ ***********************************************************/
+bool SDFShadowManager::Update()
+{
+	if (GetEnabled() == false)
+	{
+		return(false);
+	}
+
+	bool bRebuilt = false;
+	if (m_framePrimitives != m_primitives)
+	{
+		m_primitives.swap(m_framePrimitives);
+		BuildGrid();
+		UploadBlock();
+		bRebuilt = true;
+	}
+	m_framePrimitives.clear();
+	return(bRebuilt);
+}
+
+/***********************************************************
+ *  BuildGrid()
+ *
+ *  This method is used for sorting the primitives into the
+ *  grid.  The grid covers the boxes of the primitives
+ *  grown by the reach, so any point outside it is farther
+ *  than the reach from all of them, and a cell lists every
+ *  primitive whose grown box overlaps it.  The lists are
+ *  packed after the first index and count of every cell,
+ *  counted first so each gets its place in one pass.
+ ***********************************************************/
+void SDFShadowManager::BuildGrid()
+{
+	m_bGridValid = false;
+	if (m_primitives.empty() == true)
+	{
+		return;
+	}
+
+	float tubeRadius = m_pShapeMeshes->GetTorusTubeRadius();
+	float reach = m_block.sdfReach;
+	std::vector<SDF_PRIMITIVE_BLOCK> blocks(m_primitives.size());
+	std::vector<glm::vec3> primitiveMins(m_primitives.size());
+	std::vector<glm::vec3> primitiveMaxs(m_primitives.size());
+	glm::vec3 gridMin(FLT_MAX);
+	glm::vec3 gridMax(-FLT_MAX);
+	for (size_t i = 0; i < m_primitives.size(); i++)
+	{
+		const PRIMITIVE& primitive = m_primitives[i];
+		SDF_PRIMITIVE_BLOCK& block = blocks[i];
+		block = SDF_PRIMITIVE_BLOCK();
+		block.worldToLocal = glm::inverse(primitive.model);
+		block.shape = (GLuint)primitive.shape;
+		// the models scale along their axes, so the shortest axis
+		// is the most a local distance can shrink by
+		block.scale = std::min(glm::length(glm::vec3(primitive.model[0])),
+			std::min(glm::length(glm::vec3(primitive.model[1])), glm::length(glm::vec3(primitive.model[2]))));
+		block.parameter = tubeRadius;
+
+		glm::vec3 localMin;
+		glm::vec3 localMax;
+		ShapeBounds(primitive.shape, tubeRadius, localMin, localMax);
+		glm::vec3 worldMin(FLT_MAX);
+		glm::vec3 worldMax(-FLT_MAX);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 local((corner & 1) ? localMax.x : localMin.x, (corner & 2) ? localMax.y : localMin.y, (corner & 4) ? localMax.z : localMin.z);
+			glm::vec3 world = glm::vec3(primitive.model * glm::vec4(local, 1.0f));
+			worldMin = glm::min(worldMin, world);
+			worldMax = glm::max(worldMax, world);
+		}
+		primitiveMins[i] = worldMin - glm::vec3(reach);
+		primitiveMaxs[i] = worldMax + glm::vec3(reach);
+		gridMin = glm::min(gridMin, primitiveMins[i]);
+		gridMax = glm::max(gridMax, primitiveMaxs[i]);
+	}
+
+	glm::vec3 extent = gridMax - gridMin;
+	float cellSize = std::max(std::max(extent.x, std::max(extent.y, extent.z)) / (float)g_GridCells, 1e-3f);
+	glm::ivec3 gridSize = glm::clamp(glm::ivec3(glm::ceil(extent / cellSize)), glm::ivec3(1), glm::ivec3(g_GridCells));
+	size_t cellCount = (size_t)gridSize.x * gridSize.y * gridSize.z;
+
+	// the cells a primitive's grown box overlaps
+	std::vector<glm::ivec3> firstCells(m_primitives.size());
+	std::vector<glm::ivec3> lastCells(m_primitives.size());
+	std::vector<GLuint> grid(cellCount * 2, 0);
+	for (size_t i = 0; i < m_primitives.size(); i++)
+	{
+		firstCells[i] = glm::clamp(glm::ivec3(glm::floor((primitiveMins[i] - gridMin) / cellSize)), glm::ivec3(0), gridSize - 1);
+		lastCells[i] = glm::clamp(glm::ivec3(glm::floor((primitiveMaxs[i] - gridMin) / cellSize)), glm::ivec3(0), gridSize - 1);
+		for (int z = firstCells[i].z; z <= lastCells[i].z; z++)
+		{
+			for (int y = firstCells[i].y; y <= lastCells[i].y; y++)
+			{
+				for (int x = firstCells[i].x; x <= lastCells[i].x; x++)
+				{
+					grid[(x + gridSize.x * (y + gridSize.y * z)) * 2 + 1]++;
+				}
+			}
+		}
+	}
+
+	size_t words = cellCount * 2;
+	for (size_t cell = 0; cell < cellCount; cell++)
+	{
+		grid[cell * 2] = (GLuint)words;
+		words += grid[cell * 2 + 1];
+		grid[cell * 2 + 1] = 0;
+	}
+	if (words > g_MaxGridWords)
+	{
+		std::cout << "Too many primitives for the SDF grid (" << words << " words), SDF shadows are off" << std::endl;
+		return;
+	}
+
+	grid.resize(words);
+	for (size_t i = 0; i < m_primitives.size(); i++)
+	{
+		for (int z = firstCells[i].z; z <= lastCells[i].z; z++)
+		{
+			for (int y = firstCells[i].y; y <= lastCells[i].y; y++)
+			{
+				for (int x = firstCells[i].x; x <= lastCells[i].x; x++)
+				{
+					size_t cell = x + gridSize.x * (y + gridSize.y * z);
+					grid[grid[cell * 2] + grid[cell * 2 + 1]++] = (GLuint)i;
+				}
+			}
+		}
+	}
+
+	if (m_primitiveBuffer == 0)
+	{
+		glCreateBuffers(1, &m_primitiveBuffer);
+		glCreateBuffers(1, &m_gridBuffer);
+	}
+	glNamedBufferData(m_primitiveBuffer, blocks.size() * sizeof(SDF_PRIMITIVE_BLOCK), blocks.data(), GL_DYNAMIC_DRAW);
+	glNamedBufferData(m_gridBuffer, grid.size() * sizeof(GLuint), grid.data(), GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SDF_PRIMITIVE_BINDING, m_primitiveBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SDF_GRID_BINDING, m_gridBuffer);
+
+	m_block.sdfGridOrigin = gridMin;
+	m_block.sdfCellSize = cellSize;
+	m_block.sdfGridSize = gridSize;
+	m_bGridValid = true;
+}
+
+/***********************************************************
+ *  UploadBlock()
+ *
+ *  This method is used for copying the grid placement into
+ *  the uniform buffer.  The shadows and occlusion are only
+ *  on while there is a grid to read.
+ ***********************************************************/
+void SDFShadowManager::UploadBlock()
+{
+	m_block.bSDFShadows = (m_bShadows == true) && (m_bGridValid == true);
+	m_block.bSDFOcclusion = (m_bOcclusion == true) && (m_bGridValid == true);
+	if (m_shadowUBO != 0)
+	{
+		glNamedBufferSubData(m_shadowUBO, 0, sizeof(SDF_SHADOW_BLOCK), &m_block);
+	}
+}
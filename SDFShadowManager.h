@@ -0,0 +1,97 @@
+///////////////////////////////////////////////////////////////////////////////
+// sdfshadowmanager.h
+// ============
+// soft shadows and ambient occlusion from the analytic distance fields of the
+// primitive shapes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "ShapeMeshes.h"
+#include "UniformBlocks.h"
+
+#include <vector>
+
+/***********************************************************
+ *  SDFShadowManager
+ *
+ *  This class hands the opaque primitive shapes of the
+ *  scene to the scene shader as signed distance fields: a
+ *  box, sphere, cylinder and so on has an exact distance
+ *  function, so the shader gets each shape's type and the
+ *  inverse of its model matrix instead of a voxelized
+ *  field, and evaluates the distances where it needs them.
+ *
+ *  The primitives are sorted into a coarse grid over the
+ *  scene, each cell listing the ones nearer to it than the
+ *  reach, so a distance only looks at the primitives close
+ *  by and anything farther reads as the reach.  The shader
+ *  marches a ray toward each light through these distances
+ *  and keeps the narrowest cone around it that stays clear
+ *  for a soft shadow, and compares the distances a short
+ *  way along the normal with how far they were sampled for
+ *  the ambient occlusion.
+ *
+ *  The grid is rebuilt on the CPU only when the primitives
+ *  added in a frame are not the ones of the grid.
+ ***********************************************************/
+class SDFShadowManager
+{
+public:
+	// constructor, the torus tube radius is read from pShapeMeshes
+	SDFShadowManager(ShapeMeshes* pShapeMeshes);
+	// destructor
+	~SDFShadowManager();
+
+	// create the uniform buffer and attach it to its binding point
+	void CreateUniformBlock();
+
+	// turn the shadows and the ambient occlusion on or off
+	void SetEnabled(bool bShadows, bool bOcclusion);
+	bool GetEnabled() const { return((m_bShadows == true) || (m_bOcclusion == true)); }
+
+	// add an opaque primitive drawn this frame
+	void AddPrimitive(ShapeMeshes::ShapeType shape, const glm::mat4& model);
+	// rebuild the grid if the primitives added since the last
+	// update differ from the ones in it, and forget them; true
+	// when it was rebuilt
+	bool Update();
+
+private:
+	// a primitive as it was drawn
+	struct PRIMITIVE
+	{
+		ShapeMeshes::ShapeType shape;
+		glm::mat4 model;
+
+		bool operator==(const PRIMITIVE& other) const
+		{
+			return((shape == other.shape) && (model == other.model));
+		}
+	};
+
+	ShapeMeshes* m_pShapeMeshes;
+	bool m_bShadows;
+	bool m_bOcclusion;
+
+	// the primitives added for the next update, and the ones
+	// the grid was built from
+	std::vector<PRIMITIVE> m_framePrimitives;
+	std::vector<PRIMITIVE> m_primitives;
+	bool m_bGridValid;
+
+	GLuint m_shadowUBO;
+	GLuint m_primitiveBuffer;
+	GLuint m_gridBuffer;
+	SDF_SHADOW_BLOCK m_block;
+
+	// sort m_primitives into the grid and upload both
+	void BuildGrid();
+	// copy the grid placement and switches into the uniform buffer
+	void UploadBlock();
+};
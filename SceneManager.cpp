@@ -8,6 +8,18 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
+#include "HLODManager.h"
+#include "StreamingManager.h"
+#include "TextureAtlas.h"
+#include "TransparencyManager.h"
+#include "LTCTable.h"
+#include "ReflectionManager.h"
+#include "VisibilityManager.h"
+#include "VoxelGIManager.h"
+#include "RayShadowManager.h"
+#include "SDFShadowManager.h"
+#include "ShadingLODManager.h"
+#include "AnimationManager.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -16,14 +28,85 @@
 
 #include <glm/gtx/transform.hpp>
 
+#include <cstring>
+
 // declaration of global variables
 namespace
 {
 	const char* g_ModelName = "model";
+	const char* g_ViewName = "view";
+	const char* g_ProjectionName = "projection";
+	const char* g_ViewPositionName = "viewPosition";
 	const char* g_ColorValueName = "objectColor";
 	const char* g_TextureValueName = "objectTexture";
 	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_RayShadowsName = "bRayShadows";
+	const char* g_AtlasRectName = "atlasRect";
+	const char* g_AtlasRepeatName = "bAtlasRepeat";
+	const char* g_TextureMipBiasName = "textureMipBias";
+	const char* g_LightCountName = "lightCount";
+	const char* g_ShadingLevelName = "shadingLevel";
+	const char* g_FlatLightName = "flatLight";
+	const char* g_WeightedBlendName = "bWeightedBlend";
+	const char* g_LTCMatrixTextureName = "ltcMatrixTexture";
+	const char* g_LTCAmplitudeTextureName = "ltcAmplitudeTexture";
+
+	// the area light tables use the units after the scene
+	// textures and the transparency targets
+	const GLuint g_LTCMatrixTextureUnit = 20;
+	const GLuint g_LTCAmplitudeTextureUnit = 21;
+
+	// the voxels of textured objects take the texture as a mid grey,
+	// tinted by the material
+	const float g_VoxelTextureAlbedo = 0.5f;
+
+	// the environment probe is captured above the middle of the desk
+	const glm::vec3 g_ProbePosition = glm::vec3(0.0f, 3.0f, 0.0f);
+
+	// the stress test field: spheres and tori behind the desk
+	const int g_StressGridColumns = 48;
+	const int g_StressGridRows = 24;
+	const float g_StressGridSpacing = 1.0f;
+	const glm::vec3 g_StressGridCenter = glm::vec3(0.0f, 0.2f, -18.0f);
+	const char* g_StressMaterials[] = { "steel", "plastic", "darkplastic", "gold", "burntsand", "wood" };
+	// the stress test objects turn once in this many seconds and
+	// bob up and down this high
+	const float g_StressSpinPeriod = 6.0f;
+	const float g_StressBobPeriod = 2.0f;
+	const float g_StressBobHeight = 0.15f;
+	// bounds the spheres and tori of the stress test before scaling
+	const float g_StressObjectRadius = 1.5f;
+
+	// a key with flat tangents, so a Hermite curve eases in and
+	// out of it
+	AnimationManager::ANIMATION_KEY AnimationKey(float time, const glm::vec4& value)
+	{
+		AnimationManager::ANIMATION_KEY key;
+		key.time = time;
+		key.value = value;
+		key.inTangent = glm::vec4(0.0f);
+		key.outTangent = glm::vec4(0.0f);
+		return(key);
+	}
+
+	// chunked scene file streamed around the camera
+	const char* g_WorldSceneFile = "../../Utilities/scenes/world.scene";
+
+	// bump when the cooked texture format, its decoding or the mip filter changes
+	const uint32_t g_TextureCookVersion = 3;
+	const char* g_TextureDecoder = "stb_image 2.28";
+
+	// scene textures up to this size are packed in the shared atlas
+	const int g_AtlasMaxImageSize = 1024;
+
+	// cooked texture: width, height and channels, then every mip level
+	struct COOKED_TEXTURE_HEADER
+	{
+		int32_t width;
+		int32_t height;
+		int32_t colorChannels;
+	};
 }
 
 /***********************************************************
@@ -31,10 +114,56 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager* pShaderManager)
+SceneManager::SceneManager(
+	ShaderManager* pShaderManager,
+	ViewManager* pViewManager,
+	DerivedDataCache* pDerivedDataCache)
 {
 	m_pShaderManager = pShaderManager;
+	m_pViewManager = pViewManager;
+	m_pDerivedDataCache = pDerivedDataCache;
 	m_basicMeshes = new ShapeMeshes();
+	m_loadedTextures = 0;
+	m_textureDecodeScale = 1;
+
+	m_currentObject.shape = ShapeMeshes::SHAPE_BOX;
+	m_currentObject.model = glm::mat4(1.0f);
+	m_currentObject.bUseTexture = false;
+	m_currentObject.UVscale = glm::vec2(1.0f, 1.0f);
+	m_currentObject.color = glm::vec4(1.0f);
+	m_bCaptureScene = false;
+	m_drawIndex = 0;
+
+	m_pHLODManager = new HLODManager(m_basicMeshes, m_pDerivedDataCache);
+	m_bUseHLOD = true;
+	m_pAssetIO = new AssetIO();
+	m_pStreamingManager = new StreamingManager(m_pAssetIO);
+	m_pAssetLoader = new AssetLoader(m_pAssetIO);
+	m_pTransparencyManager = new TransparencyManager(m_pDerivedDataCache);
+	m_pReflectionManager = new ReflectionManager(m_pDerivedDataCache);
+	m_bReflections = true;
+	m_pVisibilityManager = new VisibilityManager(m_basicMeshes, m_pDerivedDataCache);
+	m_bVisibilityBuffer = false;
+	m_bVisibilityFrame = false;
+	m_pVisibilityManager->SetShadingCache(true);
+	m_bStressTest = false;
+	m_pVoxelGIManager = new VoxelGIManager(m_basicMeshes, m_pDerivedDataCache);
+	m_pRayShadowManager = new RayShadowManager(m_basicMeshes, m_pDerivedDataCache);
+	m_pSDFShadowManager = new SDFShadowManager(m_basicMeshes);
+	m_pShadingLODManager = new ShadingLODManager();
+	m_currentMaterial = MATERIAL_BLOCK();
+	m_pAnimationManager = new AnimationManager();
+	m_lampLowerArmNode = -1;
+	m_lampUpperArmNode = -1;
+	m_lampNeckNode = -1;
+	m_laptopLidNode = -1;
+	m_materialUBO = 0;
+	m_lightingUBO = 0;
+	m_lighting = LIGHTING_BLOCK();
+	m_areaLightingUBO = 0;
+	m_areaLighting = AREA_LIGHTING_BLOCK();
+	m_areaLightCount = 0;
+	m_pLTCTable = new LTCTable(m_pDerivedDataCache);
 }
 
 /***********************************************************
@@ -45,82 +174,481 @@ SceneManager::SceneManager(ShaderManager* pShaderManager)
 SceneManager::~SceneManager()
 {
 	m_pShaderManager = NULL;
+	m_pViewManager = NULL;
+	m_pDerivedDataCache = NULL;
+	// the streaming manager waits for its own reads; the reads
+	// the loader queued call back into it, so the I/O backend is
+	// detached and drained first
+	delete m_pStreamingManager;
+	m_pStreamingManager = NULL;
+	m_pAssetLoader->DetachAssetIO();
+	delete m_pAssetIO;
+	m_pAssetIO = NULL;
+	delete m_pAssetLoader;
+	m_pAssetLoader = NULL;
+	delete m_pHLODManager;
+	m_pHLODManager = NULL;
+	delete m_pTransparencyManager;
+	m_pTransparencyManager = NULL;
+	delete m_pReflectionManager;
+	m_pReflectionManager = NULL;
+	delete m_pVisibilityManager;
+	m_pVisibilityManager = NULL;
+	delete m_pVoxelGIManager;
+	m_pVoxelGIManager = NULL;
+	delete m_pRayShadowManager;
+	m_pRayShadowManager = NULL;
+	delete m_pSDFShadowManager;
+	m_pSDFShadowManager = NULL;
+	delete m_pShadingLODManager;
+	m_pShadingLODManager = NULL;
+	delete m_pAnimationManager;
+	m_pAnimationManager = NULL;
+	if (m_materialUBO != 0)
+	{
+		glDeleteBuffers(1, &m_materialUBO);
+		m_materialUBO = 0;
+	}
+	if (m_lightingUBO != 0)
+	{
+		glDeleteBuffers(1, &m_lightingUBO);
+		m_lightingUBO = 0;
+	}
+	if (m_areaLightingUBO != 0)
+	{
+		glDeleteBuffers(1, &m_areaLightingUBO);
+		m_areaLightingUBO = 0;
+	}
+	delete m_pLTCTable;
+	m_pLTCTable = NULL;
+	m_basicMeshes->DestroyCustomMeshes();
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
 }
 
 /***********************************************************
- *  CreateGLTexture()
+ *  SetQualitySettings()
  *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  This method is used for applying the settings of a
+ *  quality tier that the scene controls: the texture decode
+ *  size and mip bias, the HLOD switch distance, the
+ *  number of lights shaded, the reflections, the voxel
+ *  indirect light and the shadows.  There are no shadow
+ *  maps, so the tiers that ask for shadows get the ray
+ *  traced ones, and the distance field ones where those
+ *  are not traced; the ambient occlusion comes from the
+ *  distance fields too.
  ***********************************************************/
-bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
+void SceneManager::SetQualitySettings(const QualityManager::QUALITY_SETTINGS& settings)
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
+	m_textureDecodeScale = settings.textureDecodeScale;
+	m_bReflections = settings.bSSR;
+	SetVoxelGI(settings.bVoxelGI);
+	SetRayShadows(settings.shadowResolution > 0);
+	SetSDFShadows(settings.shadowResolution > 0, settings.bSSAO);
+	SetLODScreenError(settings.lodScreenError);
+	SetLightCount(settings.lightCount);
 
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setFloatValue(g_TextureMipBiasName, settings.textureMipBias);
+	}
+}
+
+/***********************************************************
+ *  SetLODScreenError()
+ *
+ *  This method is used for setting the error, in pixels, an
+ *  HLOD proxy may show before the objects it replaces are
+ *  drawn instead.
+ ***********************************************************/
+void SceneManager::SetLODScreenError(float pixels)
+{
+	m_pHLODManager->SetMaxScreenError(pixels);
+}
+
+/***********************************************************
+ *  SetLightCount()
+ *
+ *  This method is used for setting how many of the light
+ *  sources the shader evaluates per pixel.
+ ***********************************************************/
+void SceneManager::SetLightCount(int lightCount)
+{
+	m_pRayShadowManager->SetLightCount(lightCount);
+	m_pShadingLODManager->SetLightCount(lightCount);
+	m_pVisibilityManager->InvalidateShadingCache();
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setIntValue(g_LightCountName, lightCount);
+	}
+}
+
+/***********************************************************
+ *  SetVoxelGI()
+ *
+ *  This method is used for turning the voxel indirect light
+ *  on or off.  The clipmap is kept while it is off and
+ *  caught up with the scene when it comes back.
+ ***********************************************************/
+void SceneManager::SetVoxelGI(bool bEnabled)
+{
+	m_pVoxelGIManager->SetEnabled(bEnabled);
+	m_pVisibilityManager->InvalidateShadingCache();
+}
+
+/***********************************************************
+ *  SetRayShadows()
+ *
+ *  This method is used for turning the ray traced shadows
+ *  on or off.  They are traced in the frames drawn through
+ *  the visibility buffer.
+ ***********************************************************/
+void SceneManager::SetRayShadows(bool bEnabled)
+{
+	m_pRayShadowManager->SetEnabled(bEnabled);
+}
+
+/***********************************************************
+ *  SetSDFShadows()
+ *
+ *  This method is used for turning the soft shadows and the
+ *  ambient occlusion from the distance fields of the
+ *  primitive shapes on or off.  The shadows stand in for
+ *  the ray traced ones in the frames that do not trace
+ *  them.
+ ***********************************************************/
+void SceneManager::SetSDFShadows(bool bShadows, bool bOcclusion)
+{
+	m_pSDFShadowManager->SetEnabled(bShadows, bOcclusion);
+	m_pVisibilityManager->InvalidateShadingCache();
+}
+
+/***********************************************************
+ *  SetShadingCache()
+ *
+ *  This method is used for turning the texture space cache
+ *  of the view independent shading of the objects that
+ *  stay put on or off.  It is used in the frames drawn
+ *  through the visibility buffer.
+ ***********************************************************/
+void SceneManager::SetShadingCache(bool bEnabled)
+{
+	m_pVisibilityManager->SetShadingCache(bEnabled);
+}
+
+/***********************************************************
+ *  SetShadingLODScale()
+ *
+ *  This method is used for scaling the sizes on the screen
+ *  at which the objects drawn the usual way are lit per
+ *  vertex and with one color instead of per pixel.
+ ***********************************************************/
+void SceneManager::SetShadingLODScale(float scale)
+{
+	m_pShadingLODManager->SetScale(scale);
+}
+
+/***********************************************************
+ *  GetShadingLODSavings()
+ ***********************************************************/
+void SceneManager::GetShadingLODSavings(double fragments[3], double& savedCycles) const
+{
+	fragments[0] = m_pShadingLODManager->GetFragmentsPerFrame(ShadingLODManager::SHADING_LEVEL_FULL);
+	fragments[1] = m_pShadingLODManager->GetFragmentsPerFrame(ShadingLODManager::SHADING_LEVEL_VERTEX);
+	fragments[2] = m_pShadingLODManager->GetFragmentsPerFrame(ShadingLODManager::SHADING_LEVEL_FLAT);
+	savedCycles = m_pShadingLODManager->GetSavedCyclesPerFrame();
+}
+
+/***********************************************************
+ *  SetAnimationPlaying()
+ ***********************************************************/
+void SceneManager::SetAnimationPlaying(bool bPlaying)
+{
+	m_pAnimationManager->SetPlaying(bPlaying);
+}
+
+/***********************************************************
+ *  GetAnimationPlaying()
+ ***********************************************************/
+bool SceneManager::GetAnimationPlaying() const
+{
+	return(m_pAnimationManager->GetPlaying());
+}
+
+/***********************************************************
+ *  SetAnimationLOD()
+ ***********************************************************/
+void SceneManager::SetAnimationLOD(bool bEnabled)
+{
+	m_pAnimationManager->SetUpdateLOD(bEnabled);
+}
+
+/***********************************************************
+ *  GetAnimationStats()
+ ***********************************************************/
+void SceneManager::GetAnimationStats(double& milliseconds, double& evaluated, double& skipped) const
+{
+	milliseconds = m_pAnimationManager->GetEvaluateTime();
+	evaluated = m_pAnimationManager->GetEvaluatedChannels();
+	skipped = m_pAnimationManager->GetSkippedChannels();
+}
 
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
+/***********************************************************
+ *  GetRayShadowTime()
+ ***********************************************************/
+float SceneManager::GetRayShadowTime(int lightCount) const
+{
+	return(m_pRayShadowManager->GetTraceTime(lightCount));
+}
 
-	// if the image was successfully read from the image file
-	if (image)
+/***********************************************************
+ *  UploadGLTexture()
+ *
+ *  This method is used for creating an OpenGL texture from
+ *  a cooked mip chain and configuring the texture mapping
+ *  parameters.  Every level is uploaded as it was cooked,
+ *  so no mipmaps are generated at runtime.  It returns the
+ *  new texture ID, or 0 for an unsupported image format.
+ ***********************************************************/
+GLuint SceneManager::UploadGLTexture(const MipGenerator::MIP_CHAIN& chain)
+{
+	GLuint textureID = 0;
+
+	if (((chain.colorChannels != 3) && (chain.colorChannels != 4)) || (chain.levels.size() == 0))
 	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
+		std::cout << "Not implemented to handle image with " << chain.colorChannels << " channels" << std::endl;
+		return 0;
+	}
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
 
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters, sampling between the cooked mipmaps
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)chain.levels.size() - 1);
 
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// the small levels have rows that are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t level = 0; level < chain.levels.size(); level++)
+	{
+		const MipGenerator::MIP_LEVEL& mip = chain.levels[level];
+		const unsigned char* pixels = chain.pixels.data() + mip.offset;
 
 		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+		if (chain.colorChannels == 3)
+			glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGB8, mip.width, mip.height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
 		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
 		else
+			glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA8, mip.width, mip.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+
+	return textureID;
+}
+
+/***********************************************************
+ *  CookTextureAsync()
+ *
+ *  This coroutine is used for loading one texture image:
+ *  the file is read and decoded, and its mips built, on the
+ *  loader's worker threads.  It finishes on the GL thread
+ *  and leaves creating the texture to the caller.
+ ***********************************************************/
+AssetLoader::Task<MipGenerator::MIP_CHAIN> SceneManager::CookTextureAsync(std::string filename)
+{
+	// ReadFile resumes on the worker that read the file, so
+	// the decode below also runs off the GL thread
+	std::vector<unsigned char> fileData = co_await m_pAssetLoader->ReadFile(filename);
+
+	// the cooked mip chain is keyed by the file contents and
+	// the decoder settings, so a warm start skips the decode
+	// and the mip generation
+	DerivedDataCache::CACHE_KEY cookedKey = DerivedDataCache::KeyBuilder("Texture", g_TextureCookVersion)
+		.Add(fileData.data(), fileData.size())
+		.Add(std::string(g_TextureDecoder))
+		.AddValue((int32_t)1)		// flipped vertically on load
+		.AddValue((int32_t)m_textureDecodeScale)	// jpeg decode scale
+		.GetKey();
+
+	COOKED_TEXTURE_HEADER header = { 0, 0, 0 };
+	MipGenerator::MIP_CHAIN chain;
+	std::vector<unsigned char> cooked;
+	bool bCached = false;
+	if ((fileData.size() > 0) && (NULL != m_pDerivedDataCache) &&
+		m_pDerivedDataCache->Get(cookedKey, cooked) &&
+		(cooked.size() >= sizeof(header)))
+	{
+		memcpy(&header, cooked.data(), sizeof(header));
+		size_t chainSize = MipGenerator::GetLevelLayout(header.width, header.height, header.colorChannels, chain.levels);
+		if (cooked.size() == sizeof(header) + chainSize)
 		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
+			chain.colorChannels = header.colorChannels;
+			chain.pixels.assign(cooked.begin() + sizeof(header), cooked.end());
+			bCached = true;
 		}
+	}
 
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
+	// cook: decode the image and build its mip chain
+	if ((bCached == false) && (fileData.size() > 0))
+	{
+		chain.levels.clear();
+		unsigned char* image = stbi_load_from_memory(
+			fileData.data(),
+			(int)fileData.size(),
+			&header.width,
+			&header.height,
+			&header.colorChannels,
+			0);
+		if (NULL != image)
+		{
+			MipGenerator mipGenerator;
+			mipGenerator.Generate(image, header.width, header.height, header.colorChannels, chain);
+			stbi_image_free(image);
+
+			if (NULL != m_pDerivedDataCache)
+			{
+				cooked.resize(sizeof(header) + chain.pixels.size());
+				memcpy(cooked.data(), &header, sizeof(header));
+				memcpy(cooked.data() + sizeof(header), chain.pixels.data(), chain.pixels.size());
+				m_pDerivedDataCache->Put(cookedKey, cooked);
+			}
+		}
+	}
 
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+	co_await m_pAssetLoader->ResumeOnGLThread();
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+	if (chain.levels.size() == 0)
+	{
+		std::cout << "Could not load image:" << filename << std::endl;
+		co_return chain;
+	}
+
+	std::cout << "Successfully loaded image:" << filename << ", width:" << header.width << ", height:" << header.height << ", channels:" << header.colorChannels << (bCached ? " (cached)" : "") << std::endl;
+
+	co_return chain;
+}
+
+/***********************************************************
+ *  LoadSceneTexturesAsync()
+ *
+ *  This coroutine is used for loading all the scene
+ *  textures at the same time, then registering them in the
+ *  listed order once every one of them has finished.  The
+ *  small textures are packed into one atlas on a worker, so
+ *  they all share a single texture unit; the shader wraps
+ *  the UVs of the repeating ones inside their region.
+ ***********************************************************/
+AssetLoader::Task<bool> SceneManager::LoadSceneTexturesAsync()
+{
+	struct TEXTURE_FILE
+	{
+		const char* filename;
+		const char* tag;
+		bool bRepeat;
+	};
+	const TEXTURE_FILE textureFiles[] = {
+		{ "../../Utilities/textures/stainless.jpg", "stainless", true },
+		{ "../../Utilities/textures/gold-seamless-texture.jpg", "gold", true },
+		{ "../../Utilities/textures/wood_cherry_seamless.jpg", "wood", true },
+		{ "../../Utilities/textures/plastic_blue_seamless.jpg", "plastic", true },
+		{ "../../Utilities/textures/plastic_dark_seamless.jpg", "darkplastic", true }
+	};
+
+	// the flip flag and jpeg scale are global in stb_image, so
+	// set them before any worker starts decoding
+	stbi_set_flip_vertically_on_load(true);
+	stbi_set_jpeg_scale_denominator(m_textureDecodeScale);
+
+	std::vector<AssetLoader::Task<MipGenerator::MIP_CHAIN>> textureTasks;
+	for (const TEXTURE_FILE& textureFile : textureFiles)
+	{
+		textureTasks.push_back(CookTextureAsync(textureFile.filename));
+	}
+	std::vector<MipGenerator::MIP_CHAIN> chains = co_await m_pAssetLoader->WhenAll(textureTasks);
+
+	// pack the small textures on a worker
+	co_await m_pAssetLoader->ResumeOnWorker();
+
+	TextureAtlas atlas;
+	MipGenerator::MIP_CHAIN atlasChain;
+	std::vector<int> atlasRegions(chains.size(), -1);
+	for (size_t i = 0; i < chains.size(); i++)
+	{
+		if ((chains[i].levels.size() > 0) &&
+			(chains[i].levels[0].width <= g_AtlasMaxImageSize) &&
+			(chains[i].levels[0].height <= g_AtlasMaxImageSize))
+		{
+			atlasRegions[i] = atlas.AddImage(chains[i], textureFiles[i].bRepeat);
+		}
+	}
+	// an atlas of one texture saves nothing
+	if ((atlas.GetImageCount() >= 2) && atlas.Build(atlasChain))
+	{
+		for (size_t i = 0; i < chains.size(); i++)
+		{
+			if (atlasRegions[i] >= 0)
+			{
+				chains[i] = MipGenerator::MIP_CHAIN();
+			}
+		}
+	}
+	else
+	{
+		atlasRegions.assign(chains.size(), -1);
+	}
 
-		return true;
+	co_await m_pAssetLoader->ResumeOnGLThread();
+
+	GLuint atlasID = 0;
+	if (atlasChain.levels.size() > 0)
+	{
+		atlasID = UploadGLTexture(atlasChain);
+		std::cout << "Packed " << atlas.GetImageCount() << " textures into a " << atlas.GetWidth() << "x" << atlas.GetHeight() << " atlas" << std::endl;
 	}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	bool bAllLoaded = true;
+	for (size_t i = 0; i < chains.size(); i++)
+	{
+		if (m_loadedTextures >= 16)
+		{
+			bAllLoaded = false;
+			continue;
+		}
 
-	// Error loading the image
-	return false;
+		TEXTURE_INFO& texture = m_textureIDs[m_loadedTextures];
+		if (atlasRegions[i] >= 0)
+		{
+			const TextureAtlas::ATLAS_REGION& region = atlas.GetRegion(atlasRegions[i]);
+			texture.ID = atlasID;
+			texture.atlasRect = glm::vec4(
+				(float)region.x / atlas.GetWidth(),
+				(float)region.y / atlas.GetHeight(),
+				(float)region.width / atlas.GetWidth(),
+				(float)region.height / atlas.GetHeight());
+		}
+		else
+		{
+			texture.ID = (chains[i].levels.size() > 0) ? UploadGLTexture(chains[i]) : 0;
+			texture.atlasRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		}
+		if (texture.ID == 0)
+		{
+			bAllLoaded = false;
+			continue;
+		}
+		texture.tag = textureFiles[i].tag;
+		texture.bRepeat = textureFiles[i].bRepeat;
+		m_loadedTextures++;
+	}
+
+	co_return bAllLoaded;
 }
 
 /***********************************************************
@@ -128,11 +656,17 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
  *
  *  This method is used for binding the loaded textures to
  *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  Textures packed in the same atlas share the slot of the
+ *  first one.
  ***********************************************************/
 void SceneManager::BindGLTextures()
 {
 	for (int i = 0; i < m_loadedTextures; i++)
 	{
+		if (FindTextureSlot(m_textureIDs[i].tag) != i)
+		{
+			continue;
+		}
 		// bind textures on corresponding texture units
 		glActiveTexture(GL_TEXTURE0 + i);
 		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
@@ -148,219 +682,1052 @@ void SceneManager::BindGLTextures()
 void SceneManager::DestroyGLTextures()
 {
 	for (int i = 0; i < m_loadedTextures; i++) {
-		glDeleteTextures(1, &m_textureIDs[i].ID);
+		// an atlas is deleted once, with the first texture in it
+		if (FindTextureSlot(m_textureIDs[i].tag) == i)
+			glDeleteTextures(1, &m_textureIDs[i].ID);
+	}
+}
+
+/***********************************************************
+ *  FindTextureID()
+ *
+ *  This method is used for getting an ID for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureID(std::string tag)
+{
+	int textureID = -1;
+	int index = 0;
+	bool bFound = false;
+
+	while ((index < m_loadedTextures) && (bFound == false))
+	{
+		if (m_textureIDs[index].tag.compare(tag) == 0)
+		{
+			textureID = m_textureIDs[index].ID;
+			bFound = true;
+		}
+		else
+			index++;
+	}
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  FindTextureSlot()
+ *
+ *  This method is used for getting a slot index for the previously
+ *  loaded texture bitmap associated with the passed in tag.  For
+ *  a texture packed in an atlas this is the slot of the first
+ *  texture sharing the atlas.
+ ***********************************************************/
+int SceneManager::FindTextureSlot(std::string tag)
+{
+	int textureSlot = -1;
+	int index = 0;
+	bool bFound = false;
+
+	while ((index < m_loadedTextures) && (bFound == false))
+	{
+		if (m_textureIDs[index].tag.compare(tag) == 0)
+		{
+			textureSlot = index;
+			bFound = true;
+		}
+		else
+			index++;
+	}
+
+	// textures packed in one atlas share the slot of the first of them
+	if (bFound == true)
+	{
+		for (index = 0; index < textureSlot; index++)
+		{
+			if (m_textureIDs[index].ID == m_textureIDs[textureSlot].ID)
+			{
+				textureSlot = index;
+				break;
+			}
+		}
+	}
+
+	return(textureSlot);
+}
+
+/***********************************************************
+ *  FindTextureInfo()
+ *
+ *  This method is used for getting the texture ID and atlas
+ *  region of the previously loaded texture associated with
+ *  the passed in tag.
+ ***********************************************************/
+bool SceneManager::FindTextureInfo(std::string tag, TEXTURE_INFO& texture)
+{
+	for (int index = 0; index < m_loadedTextures; index++)
+	{
+		if (m_textureIDs[index].tag.compare(tag) == 0)
+		{
+			texture = m_textureIDs[index];
+			return(true);
+		}
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *  FindMaterial()
+ *
+ *  This method is used for getting a material from the previously
+ *  defined materials list that is associated with the passed in tag.
+ ***********************************************************/
+bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+{
+	if (m_objectMaterials.size() == 0)
+	{
+		return(false);
+	}
+
+	int index = 0;
+	bool bFound = false;
+	while ((index < m_objectMaterials.size()) && (bFound == false))
+	{
+		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		{
+			bFound = true;
+			material.ambientColor = m_objectMaterials[index].ambientColor;
+			material.ambientStrength = m_objectMaterials[index].ambientStrength;
+			material.diffuseColor = m_objectMaterials[index].diffuseColor;
+			material.specularColor = m_objectMaterials[index].specularColor;
+			material.shininess = m_objectMaterials[index].shininess;
+			material.reflectionCutoff = m_objectMaterials[index].reflectionCutoff;
+		}
+		else
+		{
+			index++;
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting the transform buffer
+ *  using the passed in transformation values.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	// variables for this method
+	glm::mat4 modelView;
+	glm::mat4 scale;
+	glm::mat4 rotationX;
+	glm::mat4 rotationY;
+	glm::mat4 rotationZ;
+	glm::mat4 translation;
+
+	// set the scale value in the transform buffer
+	scale = glm::scale(scaleXYZ);
+	// set the rotation values in the transform buffer
+	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
+	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
+	// set the translation value in the transform buffer
+	translation = glm::translate(positionXYZ);
+
+	modelView = translation * rotationX * rotationY * rotationZ * scale;
+	m_currentObject.model = modelView;
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+	}
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting a model matrix worked
+ *  out elsewhere, such as the world matrix of an animated
+ *  node, into the transform buffer.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	const glm::mat4& model)
+{
+	m_currentObject.model = model;
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setMat4Value(g_ModelName, model);
+	}
+}
+
+/***********************************************************
+ *  SetShaderColor()
+ *
+ *  This method is used for setting the passed in color
+ *  into the shader for the next draw command
+ ***********************************************************/
+void SceneManager::SetShaderColor(
+	float redColorValue,
+	float greenColorValue,
+	float blueColorValue,
+	float alphaValue)
+{
+	// variables for this method
+	glm::vec4 currentColor;
+
+	currentColor.r = redColorValue;
+	currentColor.g = greenColorValue;
+	currentColor.b = blueColorValue;
+	currentColor.a = alphaValue;
+
+	m_currentObject.bUseTexture = false;
+	m_currentObject.color = currentColor;
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setIntValue(g_UseTextureName, false);
+		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+	}
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed in ID into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	std::string textureTag)
+{
+	m_currentObject.bUseTexture = true;
+	m_currentObject.textureTag = textureTag;
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setIntValue(g_UseTextureName, true);
+
+		int textureID = -1;
+		textureID = FindTextureSlot(textureTag);
+		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+
+		// where the image is in its texture, for atlas textures
+		TEXTURE_INFO texture;
+		texture.atlasRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		texture.bRepeat = true;
+		FindTextureInfo(textureTag, texture);
+		m_pShaderManager->setVec4Value(g_AtlasRectName, texture.atlasRect);
+		m_pShaderManager->setIntValue(g_AtlasRepeatName, texture.bRepeat);
+	}
+}
+
+/***********************************************************
+ *  SetTextureUVScale()
+ *
+ *  This method is used for setting the texture UV scale
+ *  values into the shader.
+ ***********************************************************/
+void SceneManager::SetTextureUVScale(float u, float v)
+{
+	m_currentObject.UVscale = glm::vec2(u, v);
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+	}
+}
+
+/***********************************************************
+ *  CreateUniformBlocks()
+ *
+ *  This method is used for creating the uniform buffers for
+ *  the material, lighting and voxel clipmap blocks, attaching
+ *  them to their binding points, and checking the C++ block
+ *  layouts against the linked shader program.
+ ***********************************************************/
+void SceneManager::CreateUniformBlocks()
+{
+	if (m_materialUBO == 0)
+	{
+		glCreateBuffers(1, &m_materialUBO);
+		glNamedBufferStorage(m_materialUBO, sizeof(MATERIAL_BLOCK), NULL, GL_DYNAMIC_STORAGE_BIT);
+		glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, m_materialUBO);
+	}
+	if (m_lightingUBO == 0)
+	{
+		glCreateBuffers(1, &m_lightingUBO);
+		glNamedBufferStorage(m_lightingUBO, sizeof(LIGHTING_BLOCK), &m_lighting, GL_DYNAMIC_STORAGE_BIT);
+		glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTING_BLOCK_BINDING, m_lightingUBO);
+	}
+	if (m_areaLightingUBO == 0)
+	{
+		glCreateBuffers(1, &m_areaLightingUBO);
+		glNamedBufferStorage(m_areaLightingUBO, sizeof(AREA_LIGHTING_BLOCK), &m_areaLighting, GL_DYNAMIC_STORAGE_BIT);
+		glBindBufferBase(GL_UNIFORM_BUFFER, AREA_LIGHTING_BLOCK_BINDING, m_areaLightingUBO);
+	}
+	m_pVoxelGIManager->CreateUniformBlock();
+	m_pSDFShadowManager->CreateUniformBlock();
+
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+
+	// the offsets the shader compiler chose must be the ones
+	// the static_asserts in UniformBlocks.h checked
+	std::vector<ShaderManager::BLOCK_MEMBER> members = {
+		{ "material.ambientColor", (GLint)offsetof(MATERIAL_BLOCK, ambientColor) },
+		{ "material.ambientStrength", (GLint)offsetof(MATERIAL_BLOCK, ambientStrength) },
+		{ "material.diffuseColor", (GLint)offsetof(MATERIAL_BLOCK, diffuseColor) },
+		{ "material.reflectionCutoff", (GLint)offsetof(MATERIAL_BLOCK, reflectionCutoff) },
+		{ "material.specularColor", (GLint)offsetof(MATERIAL_BLOCK, specularColor) },
+		{ "material.shininess", (GLint)offsetof(MATERIAL_BLOCK, shininess) } };
+	bool bMaterialOK = m_pShaderManager->CheckUniformBlock(
+		"MaterialBlock", MATERIAL_BLOCK_BINDING, sizeof(MATERIAL_BLOCK), members);
+
+	members.clear();
+	for (int i = 0; i < TOTAL_LIGHTS; i++)
+	{
+		std::string light = "lightSources[" + std::to_string(i) + "].";
+		GLint base = (GLint)(i * sizeof(LIGHT_SOURCE_BLOCK));
+		members.push_back({ light + "position", base + (GLint)offsetof(LIGHT_SOURCE_BLOCK, position) });
+		members.push_back({ light + "ambientColor", base + (GLint)offsetof(LIGHT_SOURCE_BLOCK, ambientColor) });
+		members.push_back({ light + "diffuseColor", base + (GLint)offsetof(LIGHT_SOURCE_BLOCK, diffuseColor) });
+		members.push_back({ light + "specularColor", base + (GLint)offsetof(LIGHT_SOURCE_BLOCK, specularColor) });
+		members.push_back({ light + "focalStrength", base + (GLint)offsetof(LIGHT_SOURCE_BLOCK, focalStrength) });
+		members.push_back({ light + "specularIntensity", base + (GLint)offsetof(LIGHT_SOURCE_BLOCK, specularIntensity) });
+	}
+	bool bLightingOK = m_pShaderManager->CheckUniformBlock(
+		"LightingBlock", LIGHTING_BLOCK_BINDING, sizeof(LIGHTING_BLOCK), members);
+
+	members.clear();
+	for (int i = 0; i < TOTAL_AREA_LIGHTS; i++)
+	{
+		std::string light = "areaLights[" + std::to_string(i) + "].";
+		GLint base = (GLint)(i * sizeof(AREA_LIGHT_BLOCK));
+		members.push_back({ light + "center", base + (GLint)offsetof(AREA_LIGHT_BLOCK, center) });
+		members.push_back({ light + "type", base + (GLint)offsetof(AREA_LIGHT_BLOCK, type) });
+		members.push_back({ light + "right", base + (GLint)offsetof(AREA_LIGHT_BLOCK, right) });
+		members.push_back({ light + "bTwoSided", base + (GLint)offsetof(AREA_LIGHT_BLOCK, bTwoSided) });
+		members.push_back({ light + "up", base + (GLint)offsetof(AREA_LIGHT_BLOCK, up) });
+		members.push_back({ light + "color", base + (GLint)offsetof(AREA_LIGHT_BLOCK, color) });
+		members.push_back({ light + "intensity", base + (GLint)offsetof(AREA_LIGHT_BLOCK, intensity) });
+	}
+	members.push_back({ "areaLightCount", (GLint)offsetof(AREA_LIGHTING_BLOCK, areaLightCount) });
+	bool bAreaLightingOK = m_pShaderManager->CheckUniformBlock(
+		"AreaLightingBlock", AREA_LIGHTING_BLOCK_BINDING, sizeof(AREA_LIGHTING_BLOCK), members);
+
+	members = {
+		{ "voxelLevelOrigins[0]", (GLint)offsetof(VOXEL_GI_BLOCK, voxelLevelOrigins) },
+		{ "bVoxelGI", (GLint)offsetof(VOXEL_GI_BLOCK, bVoxelGI) },
+		{ "voxelResolution", (GLint)offsetof(VOXEL_GI_BLOCK, voxelResolution) },
+		{ "voxelDiffuseStrength", (GLint)offsetof(VOXEL_GI_BLOCK, voxelDiffuseStrength) },
+		{ "voxelSpecularStrength", (GLint)offsetof(VOXEL_GI_BLOCK, voxelSpecularStrength) } };
+	bool bVoxelGIOK = m_pShaderManager->CheckUniformBlock(
+		"VoxelGIBlock", VOXEL_GI_BLOCK_BINDING, sizeof(VOXEL_GI_BLOCK), members);
+
+	members = {
+		{ "sdfGridOrigin", (GLint)offsetof(SDF_SHADOW_BLOCK, sdfGridOrigin) },
+		{ "sdfCellSize", (GLint)offsetof(SDF_SHADOW_BLOCK, sdfCellSize) },
+		{ "sdfGridSize", (GLint)offsetof(SDF_SHADOW_BLOCK, sdfGridSize) },
+		{ "sdfReach", (GLint)offsetof(SDF_SHADOW_BLOCK, sdfReach) },
+		{ "bSDFShadows", (GLint)offsetof(SDF_SHADOW_BLOCK, bSDFShadows) },
+		{ "bSDFOcclusion", (GLint)offsetof(SDF_SHADOW_BLOCK, bSDFOcclusion) },
+		{ "sdfShadowSoftness", (GLint)offsetof(SDF_SHADOW_BLOCK, sdfShadowSoftness) },
+		{ "sdfShadowDistance", (GLint)offsetof(SDF_SHADOW_BLOCK, sdfShadowDistance) },
+		{ "sdfOcclusionDistance", (GLint)offsetof(SDF_SHADOW_BLOCK, sdfOcclusionDistance) } };
+	bool bSDFShadowOK = m_pShaderManager->CheckUniformBlock(
+		"SDFShadowBlock", SDF_SHADOW_BLOCK_BINDING, sizeof(SDF_SHADOW_BLOCK), members);
+
+	if ((bMaterialOK == false) || (bLightingOK == false) || (bAreaLightingOK == false) || (bVoxelGIOK == false) || (bSDFShadowOK == false))
+	{
+		std::cout << "Uniform block layouts do not match the shader program" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  UploadLights()
+ *
+ *  This method is used for copying the light sources into
+ *  the lighting uniform buffer in one update.  The shading
+ *  cached with the old lights is stale.
+ ***********************************************************/
+void SceneManager::UploadLights()
+{
+	if (m_lightingUBO != 0)
+	{
+		glNamedBufferSubData(m_lightingUBO, 0, sizeof(LIGHTING_BLOCK), &m_lighting);
+	}
+	m_pVisibilityManager->InvalidateShadingCache();
+}
+
+/***********************************************************
+ *  CreateAreaLightTables()
+ *
+ *  This method is used for loading the LTC tables of the
+ *  area lights.  On the first run they are fitted in the
+ *  background, and the area lights stay dark until
+ *  BeginRenderObjects() sees them ready.
+ ***********************************************************/
+void SceneManager::CreateAreaLightTables()
+{
+	m_pLTCTable->Create();
+	if (m_pLTCTable->IsReady() == true)
+	{
+		BindAreaLightTables();
+		UploadAreaLights();
+	}
+}
+
+/***********************************************************
+ *  BindAreaLightTables()
+ ***********************************************************/
+void SceneManager::BindAreaLightTables()
+{
+	glBindTextureUnit(g_LTCMatrixTextureUnit, m_pLTCTable->GetMatrixTexture());
+	glBindTextureUnit(g_LTCAmplitudeTextureUnit, m_pLTCTable->GetAmplitudeTexture());
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setSampler2DValue(g_LTCMatrixTextureName, g_LTCMatrixTextureUnit);
+		m_pShaderManager->setSampler2DValue(g_LTCAmplitudeTextureName, g_LTCAmplitudeTextureUnit);
+	}
+}
+
+/***********************************************************
+ *  UploadAreaLights()
+ *
+ *  This method is used for copying the area lights into
+ *  their uniform buffer in one update.
+ ***********************************************************/
+void SceneManager::UploadAreaLights()
+{
+	m_areaLighting.areaLightCount = m_pLTCTable->IsReady() ? m_areaLightCount : 0;
+	if (m_areaLightingUBO != 0)
+	{
+		glNamedBufferSubData(m_areaLightingUBO, 0, sizeof(AREA_LIGHTING_BLOCK), &m_areaLighting);
+	}
+	m_pVisibilityManager->InvalidateShadingCache();
+}
+
+/***********************************************************
+ *  SetAreaLight()
+ *
+ *  This method is used for placing a rectangle or disk
+ *  light.  It can be called every frame to follow an
+ *  object; the buffer is only updated when it changes.
+ ***********************************************************/
+void SceneManager::SetAreaLight(
+	int index,
+	GLint type,
+	glm::vec3 center,
+	glm::vec3 right,
+	glm::vec3 up,
+	glm::vec3 color,
+	float intensity,
+	bool bTwoSided)
+{
+	if ((index < 0) || (index >= TOTAL_AREA_LIGHTS))
+	{
+		return;
+	}
+
+	AREA_LIGHT_BLOCK light = AREA_LIGHT_BLOCK();
+	light.center = center;
+	light.type = type;
+	light.right = right;
+	light.bTwoSided = bTwoSided;
+	light.up = up;
+	light.color = color;
+	light.intensity = intensity;
+
+	if ((index < m_areaLightCount) && (memcmp(&light, &m_areaLighting.areaLights[index], sizeof(light)) == 0))
+	{
+		return;
+	}
+	m_areaLighting.areaLights[index] = light;
+	m_areaLightCount = std::max(m_areaLightCount, index + 1);
+	UploadAreaLights();
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for passing the material values
+ *  into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	std::string materialTag)
+{
+	m_currentObject.materialTag = materialTag;
+
+	if (m_objectMaterials.size() > 0)
+	{
+		OBJECT_MATERIAL material;
+		bool bReturn = false;
+
+		bReturn = FindMaterial(materialTag, material);
+		if ((bReturn == true) && (m_materialUBO != 0))
+		{
+			MATERIAL_BLOCK block = MATERIAL_BLOCK();
+			block.ambientColor = material.ambientColor;
+			block.ambientStrength = material.ambientStrength;
+			block.diffuseColor = material.diffuseColor;
+			block.specularColor = material.specularColor;
+			block.shininess = material.shininess;
+			block.reflectionCutoff = material.reflectionCutoff;
+			glNamedBufferSubData(m_materialUBO, 0, sizeof(MATERIAL_BLOCK), &block);
+			m_currentMaterial = block;
+		}
+	}
+}
+
+/***********************************************************
+ *  DrawShape()
+ *
+ *  This method is used for drawing a basic shape with the
+ *  shader settings that are currently set.  While the scene
+ *  is being captured the draw is only recorded, objects
+ *  replaced by an HLOD proxy this frame are skipped, and
+ *  translucent objects are kept for the transparency pass.
+ *  The voxel clipmap and the ray traced shadows get every
+ *  opaque object, including the ones a proxy stands in for.
+ ***********************************************************/
+void SceneManager::DrawShape(
+	ShapeMeshes::ShapeType shape)
+{
+	int objectIndex = m_drawIndex++;
+
+	if (m_bCaptureScene == true)
+	{
+		m_currentObject.shape = shape;
+		m_sceneObjects.push_back(m_currentObject);
+		return;
+	}
+
+	m_currentObject.shape = shape;
+	bool bTransparent = IsTransparent(m_currentObject);
+	if (bTransparent == false)
+	{
+		AddVoxelObject(m_currentObject, m_basicMeshes->GetShapePoolMesh(shape));
+		m_pRayShadowManager->AddObject(m_currentObject.model, m_basicMeshes->GetShapePoolMesh(shape));
+		m_pSDFShadowManager->AddPrimitive(shape, m_currentObject.model);
+	}
+
+	if ((objectIndex < (int)m_hiddenObjects.size()) && (m_hiddenObjects[objectIndex] == true))
+	{
+		return;
+	}
+
+	if (bTransparent == true)
+	{
+		m_transparentObjects.push_back(m_currentObject);
+		return;
+	}
+
+	if ((m_bVisibilityFrame == true) && (AddVisibilityDraw(m_currentObject, m_basicMeshes->GetShapePoolMesh(shape)) == true))
+	{
+		return;
+	}
+
+	DrawShadedShape(shape, m_currentObject.model);
+}
+
+/***********************************************************
+ *  DrawSceneObject()
+ *
+ *  This method is used for setting the shader settings that
+ *  were recorded for an object and drawing its shape.
+ ***********************************************************/
+void SceneManager::DrawSceneObject(
+	const SCENE_OBJECT& object)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+
+	m_currentObject.model = object.model;
+	m_pShaderManager->setMat4Value(g_ModelName, object.model);
+	if (object.bUseTexture == true)
+	{
+		SetShaderTexture(object.textureTag);
+	}
+	else
+	{
+		SetShaderColor(object.color.r, object.color.g, object.color.b, object.color.a);
 	}
+	SetTextureUVScale(object.UVscale.x, object.UVscale.y);
+	SetShaderMaterial(object.materialTag);
+	DrawShadedShape(object.shape, object.model);
 }
 
 /***********************************************************
- *  FindTextureID()
+ *  DrawShadedShape()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for drawing a basic shape lit per
+ *  pixel, per vertex or with one color, picked from the
+ *  size of its mesh on the screen, with the level and the
+ *  color passed into the shader before the draw.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+void SceneManager::DrawShadedShape(
+	ShapeMeshes::ShapeType shape,
+	const glm::mat4& model)
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
+	glm::vec3 boundsMin = glm::vec3(-1.0f);
+	glm::vec3 boundsMax = glm::vec3(1.0f);
+	m_basicMeshes->GetVertexPool()->GetMeshBounds(m_basicMeshes->GetShapePoolMesh(shape), boundsMin, boundsMax);
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	ShadingLODManager::SHADING_LEVEL level = ShadingLODManager::SHADING_LEVEL_FULL;
+	if (NULL != m_pShaderManager)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
+		level = m_pShadingLODManager->SelectLevel(model, boundsMin, boundsMax);
+		m_pShaderManager->setIntValue(g_ShadingLevelName, level);
+		if (level == ShadingLODManager::SHADING_LEVEL_FLAT)
 		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
+			m_pShaderManager->setVec3Value(g_FlatLightName, m_pShadingLODManager->CalcFlatLight(m_lighting, m_currentMaterial, model));
 		}
-		else
-			index++;
 	}
 
-	return(textureID);
+	m_pShadingLODManager->BeginDraw(level);
+	m_basicMeshes->DrawShapeMesh(shape);
+	m_pShadingLODManager->EndDraw();
 }
 
 /***********************************************************
- *  FindTextureSlot()
+ *  AddVisibilityDraw()
  *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for handing an opaque object to the
+ *  visibility pass, with the material and texture settings
+ *  its draw would have set resolved into one record.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+bool SceneManager::AddVisibilityDraw(
+	const SCENE_OBJECT& object,
+	int poolMesh)
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
+	VISIBILITY_DRAW_BLOCK draw = VISIBILITY_DRAW_BLOCK();
+	draw.model = object.model;
+	draw.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(object.model))));
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	OBJECT_MATERIAL material = OBJECT_MATERIAL();
+	if (FindMaterial(object.materialTag, material) == true)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
+		draw.material.ambientColor = material.ambientColor;
+		draw.material.ambientStrength = material.ambientStrength;
+		draw.material.diffuseColor = material.diffuseColor;
+		draw.material.specularColor = material.specularColor;
+		draw.material.shininess = material.shininess;
+		draw.material.reflectionCutoff = material.reflectionCutoff;
 	}
 
-	return(textureSlot);
+	draw.color = object.color;
+	draw.UVscale = object.UVscale;
+	draw.textureSlot = -1;
+	draw.atlasRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	draw.bAtlasRepeat = true;
+	if (object.bUseTexture == true)
+	{
+		draw.textureSlot = FindTextureSlot(object.textureTag);
+		TEXTURE_INFO texture;
+		texture.atlasRect = draw.atlasRect;
+		texture.bRepeat = true;
+		FindTextureInfo(object.textureTag, texture);
+		draw.atlasRect = texture.atlasRect;
+		draw.bAtlasRepeat = texture.bRepeat;
+	}
+
+	return(m_pVisibilityManager->AddDraw(poolMesh, draw));
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  AddVoxelObject()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for handing an opaque object to the
+ *  voxel clipmap with the color its voxels reflect: the
+ *  material's diffuse color times the object color, or a
+ *  mid grey for a texture.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+void SceneManager::AddVoxelObject(
+	const SCENE_OBJECT& object,
+	int poolMesh)
 {
-	if (m_objectMaterials.size() == 0)
+	if (m_pVoxelGIManager->GetEnabled() == false)
 	{
-		return(false);
+		return;
 	}
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+	VoxelGIManager::VOXEL_OBJECT voxelObject;
+	voxelObject.model = object.model;
+	voxelObject.poolMesh = poolMesh;
+	voxelObject.albedo = (object.bUseTexture == true) ? glm::vec3(g_VoxelTextureAlbedo) : glm::vec3(object.color);
+
+	OBJECT_MATERIAL material = OBJECT_MATERIAL();
+	if (FindMaterial(object.materialTag, material) == true)
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
-		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
-		}
-		else
-		{
-			index++;
-		}
+		voxelObject.albedo *= material.diffuseColor;
 	}
+	m_pVoxelGIManager->AddObject(voxelObject);
+}
 
-	return(true);
+/***********************************************************
+ *  IsTransparent()
+ *
+ *  This method is used for checking whether an object is
+ *  translucent.  Only flat colors carry an alpha, textured
+ *  objects are opaque.
+ ***********************************************************/
+bool SceneManager::IsTransparent(
+	const SCENE_OBJECT& object)
+{
+	return((object.bUseTexture == false) && (object.color.a < 1.0f));
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  DrawTransparentObjects()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for drawing the translucent objects
+ *  kept this frame, in any order, through the weighted
+ *  blended transparency targets.  Without a scene target to
+ *  share the depth of, they are blended in draw order
+ *  without writing depth, so at least none of them is cut
+ *  out by another.
  ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ)
+void SceneManager::DrawTransparentObjects()
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
+	if ((m_transparentObjects.size() == 0) || (NULL == m_pShaderManager))
+	{
+		return;
+	}
 
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
+	bool bWeightedBlend = m_pTransparencyManager->BeginTransparency(m_pViewManager);
+	m_pShaderManager->use();
+	if (bWeightedBlend == true)
+	{
+		m_pShaderManager->setIntValue(g_WeightedBlendName, true);
+	}
+	else
+	{
+		glDepthMask(GL_FALSE);
+	}
 
-	modelView = translation * rotationX * rotationY * rotationZ * scale;
+	for (const SCENE_OBJECT& object : m_transparentObjects)
+	{
+		DrawSceneObject(object);
+	}
+	m_transparentObjects.clear();
 
-	if (NULL != m_pShaderManager)
+	if (bWeightedBlend == true)
 	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+		m_pShaderManager->setIntValue(g_WeightedBlendName, false);
+		m_pTransparencyManager->EndTransparency(m_pViewManager);
+		m_pShaderManager->use();
+	}
+	else
+	{
+		glDepthMask(GL_TRUE);
 	}
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  CaptureSceneObjects()
  *
- *  This method is used for setting the passed in color
- *  into the shader for the next draw command
+ *  This method is used for running RenderScene() once
+ *  without drawing, to record every object with its
+ *  transform, texture and material.
  ***********************************************************/
-void SceneManager::SetShaderColor(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue,
-	float alphaValue)
+void SceneManager::CaptureSceneObjects()
 {
-	// variables for this method
-	glm::vec4 currentColor;
+	m_sceneObjects.clear();
+	m_bCaptureScene = true;
+	RenderScene();
+	m_bCaptureScene = false;
+}
 
-	currentColor.r = redColorValue;
-	currentColor.g = greenColorValue;
-	currentColor.b = blueColorValue;
-	currentColor.a = alphaValue;
+/***********************************************************
+ *  BuildHLOD()
+ *
+ *  This method is used for transforming the recorded
+ *  objects into world space and handing them to the HLOD
+ *  builder.  The proxy atlas is registered as a regular
+ *  scene texture so proxies are drawn like any object.
+ ***********************************************************/
+void SceneManager::BuildHLOD()
+{
+	std::vector<HLODManager::HLOD_SOURCE> sources;
+	std::vector<GLfloat> triangles;
 
-	if (NULL != m_pShaderManager)
+	for (int i = 0; i < (int)m_sceneObjects.size(); i++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+		const SCENE_OBJECT& object = m_sceneObjects[i];
+		// a proxy is opaque, translucent objects stay as they are
+		if (IsTransparent(object) == true)
+		{
+			continue;
+		}
+		if (m_basicMeshes->GetShapeTriangles(object.shape, triangles) == false)
+		{
+			continue;
+		}
+
+		HLODManager::HLOD_SOURCE source;
+		source.objectIndex = i;
+		source.textureID = 0;
+		source.textureRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		source.UVscale = object.UVscale;
+		source.bRepeat = true;
+		source.color = object.color;
+		source.materialTag = object.materialTag;
+		if (object.bUseTexture == true)
+		{
+			TEXTURE_INFO texture;
+			if (FindTextureInfo(object.textureTag, texture) == true)
+			{
+				source.textureID = texture.ID;
+				source.textureRect = texture.atlasRect;
+				source.bRepeat = texture.bRepeat;
+			}
+		}
+
+		// move the vertices and normals into world space
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(object.model)));
+		for (size_t v = 0; v + 8 <= triangles.size(); v += 8)
+		{
+			glm::vec3 position = glm::vec3(object.model * glm::vec4(triangles[v], triangles[v + 1], triangles[v + 2], 1.0f));
+			glm::vec3 normal = normalMatrix * glm::vec3(triangles[v + 3], triangles[v + 4], triangles[v + 5]);
+			if (glm::length(normal) > 0.0f)
+			{
+				normal = glm::normalize(normal);
+			}
+			triangles[v] = position.x;
+			triangles[v + 1] = position.y;
+			triangles[v + 2] = position.z;
+			triangles[v + 3] = normal.x;
+			triangles[v + 4] = normal.y;
+			triangles[v + 5] = normal.z;
+		}
+		source.triangles = triangles;
+		sources.push_back(source);
+	}
+
+	m_pHLODManager->Build(sources);
+	if (m_pHLODManager->GetAtlasChain().levels.size() > 0)
+	{
+		m_pHLODManager->SetAtlasTextureID(UploadGLTexture(m_pHLODManager->GetAtlasChain()));
+	}
+
+	if ((m_pHLODManager->GetAtlasTextureID() != 0) && (m_loadedTextures < 16))
+	{
+		m_textureIDs[m_loadedTextures].ID = m_pHLODManager->GetAtlasTextureID();
+		m_textureIDs[m_loadedTextures].tag = "hlodatlas";
+		m_textureIDs[m_loadedTextures].atlasRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		m_textureIDs[m_loadedTextures].bRepeat = false;
+		m_loadedTextures++;
+		BindGLTextures();
 	}
 }
 
 /***********************************************************
- *  SetShaderTexture()
+ *  CaptureEnvironmentProbe()
  *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
+ *  This method is used for drawing the recorded opaque
+ *  objects into the six faces of the environment probe,
+ *  which the reflections fall back to.  The camera settings
+ *  of the shader are set again by the next frame.
  ***********************************************************/
-void SceneManager::SetShaderTexture(
-	std::string textureTag)
+void SceneManager::CaptureEnvironmentProbe()
 {
-	if (NULL != m_pShaderManager)
+	if (NULL == m_pShaderManager)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		return;
+	}
 
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+	// the levels are picked for the camera, the probe sees
+	// everything lit in full
+	bool bShadingLOD = m_pShadingLODManager->GetEnabled();
+	m_pShadingLODManager->SetEnabled(false);
+
+	m_pShaderManager->use();
+	m_pShaderManager->setVec3Value(g_ViewPositionName, g_ProbePosition);
+	for (int face = 0; face < 6; face++)
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		if (m_pReflectionManager->BeginProbeFace(face, g_ProbePosition, view, projection) == false)
+		{
+			break;
+		}
+		m_pShaderManager->setMat4Value(g_ViewName, view);
+		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
+		for (const SCENE_OBJECT& object : m_sceneObjects)
+		{
+			if (IsTransparent(object) == false)
+			{
+				DrawSceneObject(object);
+			}
+		}
 	}
+	m_pShadingLODManager->SetEnabled(bShadingLOD);
+	m_pReflectionManager->EndProbeCapture();
 }
 
 /***********************************************************
- *  SetTextureUVScale()
+ *  BeginRenderObjects()
  *
- *  This method is used for setting the texture UV scale
- *  values into the shader.
+ *  This method is used for choosing which clusters are
+ *  drawn as HLOD proxies this frame, before RenderScene()
+ *  draws its objects.  The voxel clipmap is brought up to
+ *  date with the objects of the last frame first, so the
+ *  objects of this one are lit from it, and so is the grid
+ *  of the distance field shadows.
  ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
+void SceneManager::BeginRenderObjects()
 {
-	if (NULL != m_pShaderManager)
+	m_drawIndex = 0;
+	m_proxyNodes.clear();
+	m_transparentObjects.clear();
+
+	// the area lights come on once their tables are fitted
+	if ((m_bCaptureScene == false) && (m_pLTCTable->Update() == true))
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		BindAreaLightTables();
+		UploadAreaLights();
+	}
+
+	if ((m_bCaptureScene == false) && (NULL != m_pViewManager) && (m_pVoxelGIManager->GetEnabled() == true))
+	{
+		m_pVoxelGIManager->Update(m_pViewManager, m_lighting, m_areaLighting);
+		m_pViewManager->BeginSceneFrame();
+		m_pShaderManager->use();
+	}
+	// the cached shadows and occlusion were of the old grid
+	if ((m_bCaptureScene == false) && (m_pSDFShadowManager->Update() == true))
+	{
+		m_pVisibilityManager->InvalidateShadingCache();
+	}
+	m_hiddenObjects.assign(m_sceneObjects.size(), false);
+	m_pRayShadowManager->BeginFrame();
+	if (m_bCaptureScene == false)
+	{
+		m_pShadingLODManager->BeginFrame(m_pViewManager);
+		if (NULL != m_pViewManager)
+		{
+			m_pAnimationManager->Update(m_pViewManager->GetFrameDeltaTime(), m_pViewManager);
+		}
+	}
+
+	m_bVisibilityFrame = (m_bCaptureScene == false) && (m_bVisibilityBuffer == true)
+		&& (m_pVisibilityManager->BeginFrame(m_pViewManager) == true);
+
+	if ((m_bCaptureScene == false) && (m_bUseHLOD == true))
+	{
+		m_pHLODManager->SelectProxies(m_pViewManager, m_proxyNodes, m_hiddenObjects);
+	}
+
+	// load and release the streamed cells for the camera
+	if ((m_bCaptureScene == false) && (NULL != m_pViewManager))
+	{
+		m_pStreamingManager->Update(m_pViewManager->GetCameraPosition(), m_pViewManager->GetCameraVelocity());
 	}
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  EndRenderObjects()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for drawing the objects of the
+ *  streamed cells, and the HLOD proxies that replace the
+ *  hidden objects, one draw per cluster.  The proxies go
+ *  through the visibility buffer too, from their compressed
+ *  vertex pool meshes, and the translucent objects kept from
+ *  all of them are drawn last.
  ***********************************************************/
-void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+void SceneManager::EndRenderObjects()
 {
-	if (m_objectMaterials.size() > 0)
+	if (m_bCaptureScene == true)
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+		return;
+	}
 
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
+	for (auto& cell : m_pStreamingManager->GetResidentCells())
+	{
+		for (const SCENE_OBJECT& object : cell.second)
+		{
+			if (IsTransparent(object) == true)
+			{
+				m_transparentObjects.push_back(object);
+				continue;
+			}
+			AddVoxelObject(object, m_basicMeshes->GetShapePoolMesh(object.shape));
+			m_pRayShadowManager->AddObject(object.model, m_basicMeshes->GetShapePoolMesh(object.shape));
+			m_pSDFShadowManager->AddPrimitive(object.shape, object.model);
+			if ((m_bVisibilityFrame == false) || (AddVisibilityDraw(object, m_basicMeshes->GetShapePoolMesh(object.shape)) == false))
+			{
+				DrawSceneObject(object);
+			}
+		}
+	}
+
+	std::vector<int> forwardProxies;
+	for (int nodeIndex : m_proxyNodes)
+	{
+		const HLODManager::HLOD_NODE& node = m_pHLODManager->GetNode(nodeIndex);
+
+		// proxy vertices are already in world space
+		SCENE_OBJECT proxy = SCENE_OBJECT();
+		proxy.model = glm::mat4(1.0f);
+		proxy.bUseTexture = true;
+		proxy.textureTag = "hlodatlas";
+		proxy.UVscale = glm::vec2(1.0f);
+		proxy.color = glm::vec4(1.0f);
+		proxy.materialTag = node.materialTag;
+		if ((m_bVisibilityFrame == false) || (AddVisibilityDraw(proxy, m_basicMeshes->GetCustomMeshPoolMesh(node.proxyMesh)) == false))
 		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+			forwardProxies.push_back(nodeIndex);
 		}
 	}
+
+	// the shadows are traced from the depth of the visibility
+	// pass, before its pixels are shaded; the objects drawn the
+	// usual way are shaded without them
+	if ((m_bVisibilityFrame == true) && (m_pVisibilityManager->DrawVisibilityPass(m_pViewManager) == true))
+	{
+		bool bRayShadows = m_pRayShadowManager->Trace(m_pViewManager);
+		m_pShaderManager->use();
+		m_pShaderManager->setBoolValue(g_RayShadowsName, bRayShadows);
+		m_pVisibilityManager->ResolvePass(m_pViewManager, m_pShaderManager);
+		m_pShaderManager->use();
+		m_pShaderManager->setBoolValue(g_RayShadowsName, false);
+	}
+	m_bVisibilityFrame = false;
+
+	// the proxies stand in for far away objects already
+	m_pShaderManager->setIntValue(g_ShadingLevelName, ShadingLODManager::SHADING_LEVEL_FULL);
+	for (int nodeIndex : forwardProxies)
+	{
+		const HLODManager::HLOD_NODE& node = m_pHLODManager->GetNode(nodeIndex);
+
+		SetTransformations(glm::vec3(1.0f), 0, 0, 0, glm::vec3(0.0f));
+		SetShaderTexture("hlodatlas");
+		SetTextureUVScale(1.0f, 1.0f);
+		SetShaderMaterial(node.materialTag);
+		m_basicMeshes->DrawCustomMesh(node.proxyMesh);
+	}
+
+	// the reflections see the opaque objects only, the
+	// translucent ones are blended over them
+	if (m_bReflections == true)
+	{
+		m_pReflectionManager->ApplyReflections(m_pViewManager);
+		m_pShaderManager->use();
+	}
+
+	DrawTransparentObjects();
 }
 
 /**************************************************************/
@@ -372,23 +1739,27 @@ void SceneManager::SetShaderMaterial(
 
 // NEW: SetupLights function
 void SceneManager::SetupLights() {
+	m_lighting = LIGHTING_BLOCK();
+
 	// Light Source 0 (main light - dim it a bit)
-	m_pShaderManager->setVec3Value("lightSources[0].ambientColor", glm::vec3(0.2f));
-	m_pShaderManager->setVec3Value("lightSources[0].diffuseColor", glm::vec3(0.7f));  // was 0.5
-	m_pShaderManager->setVec3Value("lightSources[0].specularColor", glm::vec3(0.9f)); // was 0.6
-	m_pShaderManager->setFloatValue("lightSources[0].specularIntensity", 0.5f);
+	m_lighting.lightSources[0].ambientColor = glm::vec3(0.2f);
+	m_lighting.lightSources[0].diffuseColor = glm::vec3(0.7f);  // was 0.5
+	m_lighting.lightSources[0].specularColor = glm::vec3(0.9f); // was 0.6
+	m_lighting.lightSources[0].specularIntensity = 0.5f;
 
 	// Light Source 1 (secondary - subtle fill light)
-	m_pShaderManager->setVec3Value("lightSources[1].ambientColor", glm::vec3(0.05f));
-	m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", glm::vec3(0.25f));
-	m_pShaderManager->setVec3Value("lightSources[1].specularColor", glm::vec3(0.3f));
-	m_pShaderManager->setFloatValue("lightSources[1].specularIntensity", 0.2f);
+	m_lighting.lightSources[1].ambientColor = glm::vec3(0.05f);
+	m_lighting.lightSources[1].diffuseColor = glm::vec3(0.25f);
+	m_lighting.lightSources[1].specularColor = glm::vec3(0.3f);
+	m_lighting.lightSources[1].specularIntensity = 0.2f;
 
 	// Light Source 2 (warm reddish lamp glow)
-	m_pShaderManager->setVec3Value("lightSources[2].ambientColor", glm::vec3(0.1f, 0.05f, 0.05f));
-	m_pShaderManager->setVec3Value("lightSources[2].diffuseColor", glm::vec3(0.9f, 0.3f, 0.3f));
-	m_pShaderManager->setVec3Value("lightSources[2].specularColor", glm::vec3(1.0f, 0.5f, 0.5f));
-	m_pShaderManager->setFloatValue("lightSources[2].specularIntensity", 0.6f);
+	m_lighting.lightSources[2].ambientColor = glm::vec3(0.1f, 0.05f, 0.05f);
+	m_lighting.lightSources[2].diffuseColor = glm::vec3(0.9f, 0.3f, 0.3f);
+	m_lighting.lightSources[2].specularColor = glm::vec3(1.0f, 0.5f, 0.5f);
+	m_lighting.lightSources[2].specularIntensity = 0.6f;
+
+	UploadLights();
 
 	// Make sure lighting is enabled in your shader
 	m_pShaderManager->setIntValue("bUseLighting", true);
@@ -404,6 +1775,7 @@ void SceneManager::SetupMaterials() {
 		glm::vec3(0.7f),
 		glm::vec3(1.0f),
 		64.0f,
+		0.6f,
 		"steel"
 	};
 
@@ -413,6 +1785,7 @@ void SceneManager::SetupMaterials() {
 		glm::vec3(0.5f),
 		glm::vec3(0.3f),
 		8.0f,
+		0.0f,
 		"plastic"
 	};
 
@@ -422,6 +1795,7 @@ void SceneManager::SetupMaterials() {
 		glm::vec3(0.2f),
 		glm::vec3(0.2f),
 		4.0f,
+		0.0f,
 		"darkplastic"
 	};
 
@@ -431,6 +1805,7 @@ void SceneManager::SetupMaterials() {
 		glm::vec3(0.6f),
 		glm::vec3(1.0f),
 		64.0f,
+		0.6f,
 		"gold"
 	};
 
@@ -440,14 +1815,112 @@ void SceneManager::SetupMaterials() {
 		glm::vec3(0.45f),
 		glm::vec3(0.2f),
 		8.0f,
+		0.0f,
 		"burntsand"
 	};
 
+	// varnished desk top, glossy enough for dim reflections
+	OBJECT_MATERIAL wood = {
+		0.1f,
+		glm::vec3(0.2f),
+		glm::vec3(0.45f),
+		glm::vec3(0.3f),
+		16.0f,
+		0.7f,
+		"wood"
+	};
+
 	m_objectMaterials.push_back(steel);
 	m_objectMaterials.push_back(plastic);
 	m_objectMaterials.push_back(darkplastic);
 	m_objectMaterials.push_back(gold);
 	m_objectMaterials.push_back(burntsand);
+	m_objectMaterials.push_back(wood);
+}
+
+/***********************************************************
+ *  SetupAnimations()
+ *
+ *  This method is used for keying the hinges of the lamp
+ *  and the laptop lid, in degrees, and the turning and
+ *  bobbing of the stress test objects.  The first key of
+ *  each hinge is the pose the scene was modeled in, which
+ *  it keeps while the animations are paused.
+ ***********************************************************/
+void SceneManager::SetupAnimations()
+{
+	const glm::quat identity = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+	// the lamp nods down and back up
+	m_lampLowerArmNode = m_pAnimationManager->AddNode(-1, glm::vec3(0.0f), identity, glm::vec3(1.0f));
+	m_lampUpperArmNode = m_pAnimationManager->AddNode(-1, glm::vec3(0.0f), identity, glm::vec3(1.0f));
+	m_lampNeckNode = m_pAnimationManager->AddNode(-1, glm::vec3(0.0f), identity, glm::vec3(1.0f));
+	int lowerArmCurve = m_pAnimationManager->AddCurve(AnimationManager::ANIMATION_HERMITE, {
+		AnimationKey(0.0f, glm::vec4(-50.0f)), AnimationKey(5.0f, glm::vec4(-38.0f)), AnimationKey(10.0f, glm::vec4(-50.0f)) });
+	int upperArmCurve = m_pAnimationManager->AddCurve(AnimationManager::ANIMATION_HERMITE, {
+		AnimationKey(0.0f, glm::vec4(-25.0f)), AnimationKey(5.0f, glm::vec4(-35.0f)), AnimationKey(10.0f, glm::vec4(-25.0f)) });
+	int neckCurve = m_pAnimationManager->AddCurve(AnimationManager::ANIMATION_HERMITE, {
+		AnimationKey(0.0f, glm::vec4(-50.0f)), AnimationKey(5.0f, glm::vec4(-62.0f)), AnimationKey(10.0f, glm::vec4(-50.0f)) });
+	m_pAnimationManager->BindCurve(m_lampLowerArmNode, AnimationManager::ANIMATION_CHANNEL_PARAMETER, lowerArmCurve);
+	m_pAnimationManager->BindCurve(m_lampUpperArmNode, AnimationManager::ANIMATION_CHANNEL_PARAMETER, upperArmCurve);
+	m_pAnimationManager->BindCurve(m_lampNeckNode, AnimationManager::ANIMATION_CHANNEL_PARAMETER, neckCurve);
+
+	// the laptop opens, stays open and closes again
+	m_laptopLidNode = m_pAnimationManager->AddNode(-1, glm::vec3(0.0f), identity, glm::vec3(1.0f));
+	int lidCurve = m_pAnimationManager->AddCurve(AnimationManager::ANIMATION_LINEAR, {
+		AnimationKey(0.0f, glm::vec4(0.0f)), AnimationKey(3.0f, glm::vec4(0.0f)),
+		AnimationKey(6.0f, glm::vec4(105.0f)), AnimationKey(12.0f, glm::vec4(105.0f)),
+		AnimationKey(15.0f, glm::vec4(0.0f)) });
+	m_pAnimationManager->BindCurve(m_laptopLidNode, AnimationManager::ANIMATION_CHANNEL_PARAMETER, lidCurve);
+
+	if (m_bStressTest == true)
+	{
+		// every object hangs from a node at its place in the
+		// grid, and turns about its own y axis a third of a turn
+		// per key, after the tori are laid flat, from the angle it
+		// was placed at
+		std::vector<AnimationManager::ANIMATION_KEY> sphereSpin;
+		std::vector<AnimationManager::ANIMATION_KEY> torusSpin;
+		glm::quat torusTilt = glm::angleAxis(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+		for (int key = 0; key <= 3; key++)
+		{
+			glm::quat spin = glm::angleAxis(glm::radians(120.0f * key), glm::vec3(0.0f, 1.0f, 0.0f));
+			glm::quat tilted = torusTilt * spin;
+			float time = g_StressSpinPeriod * key / 3.0f;
+			sphereSpin.push_back(AnimationKey(time, glm::vec4(spin.x, spin.y, spin.z, spin.w)));
+			torusSpin.push_back(AnimationKey(time, glm::vec4(tilted.x, tilted.y, tilted.z, tilted.w)));
+		}
+		int sphereSpinCurve = m_pAnimationManager->AddCurve(AnimationManager::ANIMATION_SLERP, sphereSpin);
+		int torusSpinCurve = m_pAnimationManager->AddCurve(AnimationManager::ANIMATION_SLERP, torusSpin);
+		int bobCurve = m_pAnimationManager->AddCurve(AnimationManager::ANIMATION_HERMITE, {
+			AnimationKey(0.0f, glm::vec4(0.0f)),
+			AnimationKey(0.5f * g_StressBobPeriod, glm::vec4(0.0f, g_StressBobHeight, 0.0f, 0.0f)),
+			AnimationKey(g_StressBobPeriod, glm::vec4(0.0f)) });
+
+		m_stressNodes.clear();
+		for (int row = 0; row < g_StressGridRows; row++)
+		{
+			for (int column = 0; column < g_StressGridColumns; column++)
+			{
+				int index = row * g_StressGridColumns + column;
+				glm::vec3 position = g_StressGridCenter + glm::vec3(
+					(column - 0.5f * (g_StressGridColumns - 1)) * g_StressGridSpacing,
+					0.0f,
+					(row - 0.5f * (g_StressGridRows - 1)) * g_StressGridSpacing);
+				bool bTorus = ((index % 2) == 1);
+
+				int anchor = m_pAnimationManager->AddNode(-1, position, identity, glm::vec3(1.0f));
+				int node = m_pAnimationManager->AddNode(anchor, glm::vec3(0.0f), identity, glm::vec3(0.35f), g_StressObjectRadius);
+				float spinOffset = g_StressSpinPeriod * (float)(index * 37 % 360) / 360.0f;
+				m_pAnimationManager->BindCurve(node, AnimationManager::ANIMATION_CHANNEL_ROTATION, bTorus ? torusSpinCurve : sphereSpinCurve, spinOffset);
+				m_pAnimationManager->BindCurve(node, AnimationManager::ANIMATION_CHANNEL_TRANSLATION, bobCurve, 0.3f * (float)(index % 7));
+				m_stressNodes.push_back(node);
+			}
+		}
+	}
+
+	// pose everything before the scene is first captured
+	m_pAnimationManager->Update(0.0f, NULL);
 }
 
 /***********************************************************
@@ -459,9 +1932,19 @@ void SceneManager::SetupMaterials() {
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
+	CreateUniformBlocks();
+	CreateAreaLightTables();
+	// the clipmap samplers must be off the units of the 2D
+	// textures whether the indirect light is on or not
+	if (NULL != m_pShaderManager)
+	{
+		m_pVoxelGIManager->SetSamplers(m_pShaderManager);
+		m_pRayShadowManager->SetSamplers(m_pShaderManager);
+	}
 	SetupLights();          // NEW: moved from inside this method
 	LoadSceneTextures();
 	SetupMaterials();       // NEW: moved from inside LoadSceneTextures()
+	SetupAnimations();
 
 	// Load all required meshes for the highly detailed desk lamp scene
 	// Each mesh type only needs to be loaded once in memory
@@ -471,6 +1954,22 @@ void SceneManager::PrepareScene()
 	m_basicMeshes->LoadBoxMesh();            // For rectangular objects
 	m_basicMeshes->LoadConeMesh();           // For lamp shade interior and tapered elements
 	m_basicMeshes->LoadTaperedCylinderMesh(); // For lamp arm segments with realistic tapering
+	if (m_bStressTest == true)
+	{
+		m_basicMeshes->LoadTorusMesh();
+	}
+
+	// bake the far-field proxies for the static objects
+	CaptureSceneObjects();
+	BuildHLOD();
+	CaptureEnvironmentProbe();
+
+	// the visibility buffer pulls its vertices from one pool of
+	// every shape and proxy loaded so far
+	m_basicMeshes->CreateVertexPool();
+
+	// the rest of the world is streamed in by grid cell, if present
+	m_pStreamingManager->OpenSceneFile(g_WorldSceneFile);
 }
 
 /***********************************************************
@@ -479,11 +1978,9 @@ void SceneManager::PrepareScene()
 ***********************************************************/
 void SceneManager::LoadSceneTextures()
 {
-	CreateGLTexture("../../Utilities/textures/stainless.jpg", "stainless");
-	CreateGLTexture("../../Utilities/textures/gold-seamless-texture.jpg", "gold");
-	CreateGLTexture("../../Utilities/textures/wood_cherry_seamless.jpg", "wood");
-	CreateGLTexture("../../Utilities/textures/plastic_blue_seamless.jpg", "plastic");
-	CreateGLTexture("../../Utilities/textures/plastic_dark_seamless.jpg", "darkplastic");
+	// read and decode every texture in parallel on the asset
+	// loader's workers, uploading them on this thread
+	m_pAssetLoader->Run(LoadSceneTexturesAsync());
 
 	BindGLTextures();
 	// Material definitions are now in SetupMaterials()
@@ -501,12 +1998,14 @@ void SceneManager::RenderScene()
 	glm::vec3 scale, pos;
 	float xRot = 0, yRot = 0, zRot = 0;
 
+	BeginRenderObjects();
+
 	// === World Plane ===
 	scale = glm::vec3(100.0f, 1.0f, 100.0f);
 	pos = glm::vec3(0.0f, -0.3f, 0.0f);
 	SetTransformations(scale, 0, 0, 0, pos);
 	SetShaderMaterial("burntsand");
-	m_basicMeshes->DrawPlaneMesh();
+	DrawShape(ShapeMeshes::SHAPE_PLANE);
 
 	// === Desk ===
 	scale = glm::vec3(25.0f, 0.4f, 8.0f);
@@ -514,7 +2013,8 @@ void SceneManager::RenderScene()
 	SetTransformations(scale, 0, 0, 0, pos);
 	SetShaderTexture("wood");
 	SetTextureUVScale(2.5f, 1.5f);
-	m_basicMeshes->DrawBoxMesh();
+	SetShaderMaterial("wood");
+	DrawShape(ShapeMeshes::SHAPE_BOX);
 
 	// === Lamp Base ===
 	scale = glm::vec3(1.5f, 0.3f, 1.5f);
@@ -522,7 +2022,7 @@ void SceneManager::RenderScene()
 	SetTransformations(scale, 0, 0, 0, pos);
 	SetShaderTexture("stainless");
 	SetTextureUVScale(3.0f, 3.0f);
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(ShapeMeshes::SHAPE_CYLINDER);
 
 	// === Lamp Base Post ===
 	scale = glm::vec3(0.3f, 1.0f, 0.3f);
@@ -530,16 +2030,16 @@ void SceneManager::RenderScene()
 	SetTransformations(scale, 0, 0, 0, pos);
 	SetShaderTexture("darkplastic");
 	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(ShapeMeshes::SHAPE_CYLINDER);
 
 	// === Lamp Lower Arm ===
 	float lowerArmLength = 2.2f;
 	scale = glm::vec3(0.15f, lowerArmLength, 0.15f);
-	xRot = -50.0f;
+	xRot = m_pAnimationManager->GetParameter(m_lampLowerArmNode);
 	pos = glm::vec3(-8.0f, 2.0f, 0.0f);  // top of post
 	SetTransformations(scale, xRot, 0, 0, pos);
 	SetShaderMaterial("darkplastic");
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	DrawShape(ShapeMeshes::SHAPE_TAPERED_CYLINDER);
 
 	// === Lamp Elbow Joint (connected to top of lower arm) ===
 	float elbowOffset = -0.9f;
@@ -561,19 +2061,19 @@ void SceneManager::RenderScene()
 	SetTransformations(scale, 0, 0, 0, pos);
 	SetShaderTexture("plastic");
 	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawSphereMesh();
+	DrawShape(ShapeMeshes::SHAPE_SPHERE);
 
 	// === Lamp Upper Arm ===
 	float upperArmLength = 2.0f;
 	scale = glm::vec3(0.15f, upperArmLength, 0.15f);
-	xRot = -25.0f;
+	xRot = m_pAnimationManager->GetParameter(m_lampUpperArmNode);
 	yRot = 90.0f;
 	// To continue 3D alignment, update pos and use xRot, yRot for the new direction
 	SetTransformations(scale, xRot, yRot, 0, pos);
 	SetShaderTexture("darkplastic");
 	SetTextureUVScale(1.0f, 1.0f);
 	SetShaderMaterial("darkplastic");
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	DrawShape(ShapeMeshes::SHAPE_TAPERED_CYLINDER);
 
 	// === Lamp Head Joint (connected to top of upper arm) ===
 	float upperX = pos.x + upperArmLength * sin(glm::radians(-xRot));
@@ -584,16 +2084,16 @@ void SceneManager::RenderScene()
 	SetTransformations(scale, 0, 0, 0, pos);
 	SetShaderTexture("plastic");
 	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawSphereMesh();
+	DrawShape(ShapeMeshes::SHAPE_SPHERE);
 
 	// === Lamp Neck ===
 	float neckLength = 0.7f;
 	scale = glm::vec3(0.12f, neckLength, 0.12f);
-	xRot = -50.0f;
+	xRot = m_pAnimationManager->GetParameter(m_lampNeckNode);
 	glm::vec3 neckStart = pos;
 	SetTransformations(scale, xRot, 0, 0, neckStart);
 	SetShaderMaterial("darkplastic");
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(ShapeMeshes::SHAPE_CYLINDER);
 
 	// === Lamp Shade (at end of neck) ===
 	float shadeX = neckStart.x + neckLength * sin(glm::radians(-xRot));
@@ -604,7 +2104,15 @@ void SceneManager::RenderScene()
 	SetTransformations(scale, xRot, 0, 0, pos);
 	SetShaderTexture("stainless");
 	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawConeMesh();
+	DrawShape(ShapeMeshes::SHAPE_CONE);
+
+	// the mouth of the shade is the lamp's area light: the base of
+	// the cone, a disk in the mesh's xz plane facing down its -y
+	SetAreaLight(0, AREA_LIGHT_DISK,
+		glm::vec3(m_currentObject.model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)),
+		glm::vec3(m_currentObject.model * glm::vec4(1.0f, 0.0f, 0.0f, 0.0f)),
+		glm::vec3(m_currentObject.model * glm::vec4(0.0f, 0.0f, 1.0f, 0.0f)),
+		glm::vec3(1.0f, 0.8f, 0.6f), 3.0f);
 
 	// === Lamp Bulb ===
 	scale = glm::vec3(0.2f, 0.2f, 0.2f);
@@ -613,7 +2121,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("gold");
 	SetTextureUVScale(1.0f, 1.0f);
 	SetShaderMaterial("gold");
-	m_basicMeshes->DrawSphereMesh();
+	DrawShape(ShapeMeshes::SHAPE_SPHERE);
 
 	// ==== CLOSED LAPTOP ====
 	glm::vec3 laptopPos = glm::vec3(0.0f, -0.1f + 0.13f / 2, 0.0f); // centered, just on top of desk
@@ -624,16 +2132,20 @@ void SceneManager::RenderScene()
 	SetShaderTexture("darkplastic");      
 	SetTextureUVScale(2.0f, 1.5f);
 	SetShaderMaterial("darkplastic");
-	m_basicMeshes->DrawBoxMesh();
+	DrawShape(ShapeMeshes::SHAPE_BOX);
 
-	// Laptop lid (closed, just above base)
+	// Laptop lid (closed, just above base), hinged along the back
+	// edge of the base and opened by its animation
 	glm::vec3 lidScale = glm::vec3(6.9f, 0.10f, 4.4f); // slightly smaller
-	glm::vec3 lidPos = laptopPos + glm::vec3(0.0f, (laptopScale.y + lidScale.y) / 2, 0.0f); // slightly higher
-	SetTransformations(lidScale, 0, 0, 0, lidPos);
+	float lidAngle = m_pAnimationManager->GetParameter(m_laptopLidNode);
+	glm::vec3 lidHinge = laptopPos + glm::vec3(0.0f, laptopScale.y / 2, -lidScale.z / 2);
+	glm::vec3 lidPos = lidHinge + glm::vec3(glm::rotate(glm::radians(-lidAngle), glm::vec3(1.0f, 0.0f, 0.0f))
+		* glm::vec4(0.0f, lidScale.y / 2, lidScale.z / 2, 1.0f));
+	SetTransformations(lidScale, -lidAngle, 0, 0, lidPos);
 	SetShaderTexture("stainless");     
 	SetTextureUVScale(2.0f, 1.5f);
 	SetShaderMaterial("steel");
-	m_basicMeshes->DrawBoxMesh();
+	DrawShape(ShapeMeshes::SHAPE_BOX);
 
 	// ==== COFFEE CUP ====
 	glm::vec3 cupPos = glm::vec3(4.5f, -0.1f + 0.0f / 2, 0.3f); // right of laptop, near books
@@ -644,7 +2156,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("plastic"); 
 	SetTextureUVScale(1.0f, 1.0f);
 	SetShaderMaterial("plastic");
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(ShapeMeshes::SHAPE_CYLINDER);
 
 	// Cup rim
 	glm::vec3 rimScale = glm::vec3(0.48f, 0.09f, 0.48f);
@@ -653,7 +2165,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("stainless");
 	SetTextureUVScale(2.0f, 1.5f);
 	SetShaderMaterial("steel");
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	DrawShape(ShapeMeshes::SHAPE_TAPERED_CYLINDER);
 
 	// Cup handle
 	float mugRadius = cupScale.x / 2.0f;
@@ -687,7 +2199,7 @@ void SceneManager::RenderScene()
 		SetShaderTexture("plastic");
 		SetTextureUVScale(1.0f, 1.0f);
 		SetShaderMaterial("plastic");
-		m_basicMeshes->DrawCylinderMesh();
+		DrawShape(ShapeMeshes::SHAPE_CYLINDER);
 	}
 
 	// Book 1 (tall, back)
@@ -697,7 +2209,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("darkplastic");
 	SetTextureUVScale(0.5f, 1.0f);
 	SetShaderMaterial("darkplastic");
-	m_basicMeshes->DrawBoxMesh();
+	DrawShape(ShapeMeshes::SHAPE_BOX);
 
 	// Book 2 (shorter, in front)
 	glm::vec3 book2Pos = glm::vec3(6.5f, -0.1f + 0.95f / 2, 1.0f); // slightly left and forward
@@ -706,7 +2218,7 @@ void SceneManager::RenderScene()
 	SetShaderTexture("plastic");
 	SetTextureUVScale(0.5f, 1.0f);
 	SetShaderMaterial("plastic");
-	m_basicMeshes->DrawBoxMesh();
+	DrawShape(ShapeMeshes::SHAPE_BOX);
 
 	// Book 3, lying flat (extra realism/points)
 	glm::vec3 book3Pos = glm::vec3(7.89f, -0.1f + 0.18f / 2, 0.98f);
@@ -715,6 +2227,45 @@ void SceneManager::RenderScene()
 	SetShaderTexture("gold");
 	SetTextureUVScale(0.7f, 1.0f);
 	SetShaderMaterial("gold");
-	m_basicMeshes->DrawBoxMesh();
+	DrawShape(ShapeMeshes::SHAPE_BOX);
+
+	if (m_bStressTest == true)
+	{
+		DrawStressObjects();
+	}
+
+	EndRenderObjects();
+}
+
+/***********************************************************
+ *  DrawStressObjects()
+ *
+ *  This method is used for drawing a field of small spheres
+ *  and tori in every material, for comparing the costs of
+ *  the forward and visibility buffer paths on many small
+ *  triangles.  They turn and bob while the animations play,
+ *  which also loads the batched curve evaluation.
+ ***********************************************************/
+void SceneManager::DrawStressObjects()
+{
+	const int materialCount = sizeof(g_StressMaterials) / sizeof(g_StressMaterials[0]);
 
+	for (int row = 0; row < g_StressGridRows; row++)
+	{
+		for (int column = 0; column < g_StressGridColumns; column++)
+		{
+			int index = row * g_StressGridColumns + column;
+			bool bTorus = ((index % 2) == 1);
+
+			// posed by its animation, see SetupAnimations()
+			SetTransformations(m_pAnimationManager->GetWorldMatrix(m_stressNodes[index]));
+			SetShaderColor(
+				0.3f + 0.7f * (float)(index % 3) / 2.0f,
+				0.3f + 0.7f * (float)(index % 5) / 4.0f,
+				0.3f + 0.7f * (float)(index % 7) / 6.0f,
+				1.0f);
+			SetShaderMaterial(g_StressMaterials[index % materialCount]);
+			DrawShape(bTorus ? ShapeMeshes::SHAPE_TORUS : ShapeMeshes::SHAPE_SPHERE);
+		}
+	}
 }
\ No newline at end of file
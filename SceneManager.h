@@ -11,10 +11,28 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "ViewManager.h"
+#include "UniformBlocks.h"
+#include "AssetLoader.h"
+#include "DerivedDataCache.h"
+#include "MipGenerator.h"
+#include "QualityManager.h"
 
 #include <string>
 #include <vector>
 
+class HLODManager;
+class StreamingManager;
+class TransparencyManager;
+class LTCTable;
+class ReflectionManager;
+class VisibilityManager;
+class VoxelGIManager;
+class RayShadowManager;
+class SDFShadowManager;
+class ShadingLODManager;
+class AnimationManager;
+
 /***********************************************************
  *  SceneManager
  *
@@ -25,14 +43,70 @@ class SceneManager
 {
 public:
 	// constructor
-	SceneManager(ShaderManager* pShaderManager);
+	SceneManager(
+		ShaderManager* pShaderManager,
+		ViewManager* pViewManager = NULL,
+		DerivedDataCache* pDerivedDataCache = NULL);
 	// destructor
 	~SceneManager();
 
+	// decode jpeg textures at 1/2, 1/4 or 1/8 size to save memory on
+	// low end hardware, picked by the quality tier before the textures
+	// are loaded.  1 keeps the full size
+	void SetTextureDecodeScale(int denominator) { m_textureDecodeScale = denominator; }
+	// apply the scene settings of a quality tier, before PrepareScene()
+	void SetQualitySettings(const QualityManager::QUALITY_SETTINGS& settings);
+	// the HLOD proxy error allowed in pixels, larger switches to proxies sooner
+	void SetLODScreenError(float pixels);
+	// the number of lights shaded per pixel
+	void SetLightCount(int lightCount);
+	// the voxel cone traced indirect light
+	void SetVoxelGI(bool bEnabled);
+	// the ray traced shadows of the first lights
+	void SetRayShadows(bool bEnabled);
+	// the soft shadows and ambient occlusion from the distance
+	// fields of the primitive shapes
+	void SetSDFShadows(bool bShadows, bool bOcclusion);
+	// the texture space cache of the view independent shading of
+	// the objects that stay put
+	void SetShadingCache(bool bEnabled);
+	// scale the sizes the objects drawn the usual way switch to
+	// cheaper lighting at, larger switches sooner
+	void SetShadingLODScale(float scale);
+	// fragment shader invocations per measured frame of the objects
+	// lit per pixel, per vertex and flat, and the estimated fragment
+	// ALU cycles per frame the cheaper lighting saved
+	void GetShadingLODSavings(double fragments[3], double& savedCycles) const;
+	// average GPU time of the ray traced shadows in milliseconds
+	// with the given number of lights casting them
+	float GetRayShadowTime(int lightCount) const;
+	// draw the opaque objects through the visibility buffer instead
+	// of shading them as they are drawn
+	void SetVisibilityBuffer(bool bEnabled) { m_bVisibilityBuffer = bEnabled; }
+	bool GetVisibilityBuffer() const { return(m_bVisibilityBuffer); }
+	// add a field of small, finely tessellated objects in many
+	// materials behind the desk, before PrepareScene()
+	void SetStressTest(bool bEnabled) { m_bStressTest = bEnabled; }
+	// play or pause the keyframed animations of the scene
+	void SetAnimationPlaying(bool bPlaying);
+	bool GetAnimationPlaying() const;
+	// evaluate the animations of small and off screen objects
+	// less often
+	void SetAnimationLOD(bool bEnabled);
+	// average CPU time of the animation evaluation in
+	// milliseconds, and the channels evaluated and skipped per
+	// frame that evaluated any
+	void GetAnimationStats(double& milliseconds, double& evaluated, double& skipped) const;
+
 	struct TEXTURE_INFO
 	{
 		std::string tag;
 		uint32_t ID;
+		// UV offset and size of the image in the texture, less
+		// than the whole texture when it was packed in an atlas
+		glm::vec4 atlasRect;
+		// tiled by wrapping the UVs, clamped otherwise
+		bool bRepeat;
 	};
 
 	struct OBJECT_MATERIAL
@@ -42,9 +116,25 @@ public:
 		glm::vec3 diffuseColor;
 		glm::vec3 specularColor;
 		float shininess;
+		// roughest the surface may be and still get screen space
+		// reflections, 0 for none
+		float reflectionCutoff;
 		std::string tag;
 	};
 
+	// a shape drawn by RenderScene() together with the
+	// shader settings that were active for the draw
+	struct SCENE_OBJECT
+	{
+		ShapeMeshes::ShapeType shape;
+		glm::mat4 model;
+		bool bUseTexture;
+		std::string textureTag;
+		glm::vec2 UVscale;
+		glm::vec4 color;
+		std::string materialTag;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
@@ -56,9 +146,95 @@ private:
 	TEXTURE_INFO m_textureIDs[16];
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// pointer to view manager object
+	ViewManager* m_pViewManager;
+
+	// shader settings for the next draw command
+	SCENE_OBJECT m_currentObject;
+	// objects recorded by CaptureSceneObjects()
+	std::vector<SCENE_OBJECT> m_sceneObjects;
+	bool m_bCaptureScene;
+	// index of the next object drawn in RenderScene()
+	int m_drawIndex;
+
+	// hierarchical LOD proxies for the static objects
+	HLODManager* m_pHLODManager;
+	bool m_bUseHLOD;
+	std::vector<int> m_proxyNodes;
+	std::vector<bool> m_hiddenObjects;
+
+	// translucent objects of this frame, drawn after the opaque ones
+	TransparencyManager* m_pTransparencyManager;
+	std::vector<SCENE_OBJECT> m_transparentObjects;
+
+	// screen space reflections of the opaque objects
+	ReflectionManager* m_pReflectionManager;
+	bool m_bReflections;
+
+	// draws the opaque objects in a visibility and a resolve pass;
+	// m_bVisibilityFrame is set when this frame can use it
+	VisibilityManager* m_pVisibilityManager;
+	bool m_bVisibilityBuffer;
+	bool m_bVisibilityFrame;
+	bool m_bStressTest;
+
+	// indirect light traced through a voxel clipmap of the
+	// opaque objects, revoxelized where they or the lights change
+	VoxelGIManager* m_pVoxelGIManager;
+
+	// shadows ray traced from the depth of the visibility pass
+	// through a BVH of the opaque objects
+	RayShadowManager* m_pRayShadowManager;
+
+	// soft shadows and ambient occlusion marched through the
+	// analytic distance fields of the opaque primitive shapes
+	SDFShadowManager* m_pSDFShadowManager;
+
+	// cheaper lighting for the objects drawn the usual way that
+	// cover few pixels, from the material last set
+	ShadingLODManager* m_pShadingLODManager;
+	MATERIAL_BLOCK m_currentMaterial;
+
+	// keyframed curves posing the hinged parts of the scene and
+	// the objects of the stress test, one node each
+	AnimationManager* m_pAnimationManager;
+	int m_lampLowerArmNode;
+	int m_lampUpperArmNode;
+	int m_lampNeckNode;
+	int m_laptopLidNode;
+	std::vector<int> m_stressNodes;
 
-	// load texture images and convert to OpenGL texture data
-	bool CreateGLTexture(const char* filename, std::string tag);
+	// cooked texture and proxy data from earlier runs, may be NULL
+	DerivedDataCache* m_pDerivedDataCache;
+	// jpeg textures are decoded at 1/m_textureDecodeScale size
+	int m_textureDecodeScale;
+
+	// asynchronous file reads shared by the loaders below
+	AssetIO* m_pAssetIO;
+
+	// streams the cells of the world scene file around the camera
+	StreamingManager* m_pStreamingManager;
+
+	// runs the asset loading coroutines
+	AssetLoader* m_pAssetLoader;
+
+	// uniform buffers behind the shader material and lighting blocks
+	GLuint m_materialUBO;
+	GLuint m_lightingUBO;
+	LIGHTING_BLOCK m_lighting;
+	GLuint m_areaLightingUBO;
+	AREA_LIGHTING_BLOCK m_areaLighting;
+	int m_areaLightCount;
+	// lookup tables of the area light shading
+	LTCTable* m_pLTCTable;
+
+	// create an OpenGL texture from a cooked mip chain
+	GLuint UploadGLTexture(const MipGenerator::MIP_CHAIN& chain);
+	// read and decode one texture and build its mips, no levels on failure
+	AssetLoader::Task<MipGenerator::MIP_CHAIN> CookTextureAsync(std::string filename);
+	// load every scene texture at once, pack the small ones in an
+	// atlas and register them in order
+	AssetLoader::Task<bool> LoadSceneTexturesAsync();
 	// bind loaded OpenGL textures to slots in memory
 	void BindGLTextures();
 	// free the loaded OpenGL textures
@@ -66,6 +242,8 @@ private:
 	// find a loaded texture by tag
 	int FindTextureID(std::string tag);
 	int FindTextureSlot(std::string tag);
+	// find the ID and atlas region of a loaded texture by tag
+	bool FindTextureInfo(std::string tag, TEXTURE_INFO& texture);
 	// find a defined material by tag
 	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
 
@@ -78,6 +256,11 @@ private:
 		float ZrotationDegrees,
 		glm::vec3 positionXYZ);
 
+	// set a model matrix worked out elsewhere into the
+	// transform buffer
+	void SetTransformations(
+		const glm::mat4& model);
+
 	// set the color values into the shader
 	void SetShaderColor(
 		float redColorValue,
@@ -93,10 +276,77 @@ private:
 	void SetTextureUVScale(
 		float u, float v);
 
+	// draw the static objects into the environment probe
+	void CaptureEnvironmentProbe();
+
+	// create the uniform buffers and check them against the shader
+	void CreateUniformBlocks();
+	// upload the light sources into the lighting block
+	void UploadLights();
+	// load or start fitting the area light tables
+	void CreateAreaLightTables();
+	// bind the area light tables to their texture units
+	void BindAreaLightTables();
+	// upload the area lights, none until their tables are ready
+	void UploadAreaLights();
+
+	// set an area light; right and up are the half extents of a
+	// rectangle or the radii of a disk, and it shines toward
+	// cross(right, up), or both ways when two sided
+	void SetAreaLight(
+		int index,
+		GLint type,
+		glm::vec3 center,
+		glm::vec3 right,
+		glm::vec3 up,
+		glm::vec3 color,
+		float intensity,
+		bool bTwoSided = false);
+
 	// set the object material into the shader
 	void SetShaderMaterial(
 		std::string materialTag);
 
+	// draw a basic shape with the current shader settings
+	void DrawShape(
+		ShapeMeshes::ShapeType shape);
+	// set the shader settings of a recorded object and draw it
+	void DrawSceneObject(
+		const SCENE_OBJECT& object);
+	// draw a basic shape lit at the level of its size on the screen
+	void DrawShadedShape(
+		ShapeMeshes::ShapeType shape,
+		const glm::mat4& model);
+
+	// keep an opaque object for the visibility pass, drawn from
+	// the passed in vertex pool mesh, false when it must be
+	// drawn the usual way
+	bool AddVisibilityDraw(
+		const SCENE_OBJECT& object,
+		int poolMesh);
+	// keep an opaque object for the voxel clipmap, drawn from the
+	// passed in vertex pool mesh
+	void AddVoxelObject(
+		const SCENE_OBJECT& object,
+		int poolMesh);
+	// draw the field of objects of the stress test
+	void DrawStressObjects();
+
+	// true for objects blended in the transparency pass
+	bool IsTransparent(
+		const SCENE_OBJECT& object);
+	// draw the translucent objects of this frame without sorting
+	void DrawTransparentObjects();
+
+	// record every object drawn by RenderScene()
+	void CaptureSceneObjects();
+	// bake the HLOD proxies for the recorded objects
+	void BuildHLOD();
+	// select the HLOD proxies before drawing the objects
+	void BeginRenderObjects();
+	// draw the selected HLOD proxies
+	void EndRenderObjects();
+
 public:
 
 	// The following methods are for the students to 
@@ -108,4 +358,5 @@ public:
 	// === Add these declarations ===
 	void SetupLights();
 	void SetupMaterials();
+	void SetupAnimations();
 };
\ No newline at end of file
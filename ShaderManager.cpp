@@ -20,7 +20,7 @@ using namespace std;
  *  This method is called to load the shader data from 
  *  external GLSL compatible files.
  ***********************************************************/
-GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fragment_file_path,const char * vertex_inputs,const char * fragment_defines){
 
 	// Create the shaders
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
@@ -40,6 +40,16 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 		return 0;
 	}
 
+	// Declare the vertex inputs right after the #version line
+	if(vertex_inputs != NULL){
+		size_t InsertPos = 0;
+		if(VertexShaderCode.compare(0, 8, "#version") == 0){
+			InsertPos = VertexShaderCode.find('\n');
+			InsertPos = (InsertPos == std::string::npos) ? VertexShaderCode.size() : InsertPos + 1;
+		}
+		VertexShaderCode.insert(InsertPos, vertex_inputs);
+	}
+
 	// Read the Fragment Shader code from the file
 	std::string FragmentShaderCode;
 	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
@@ -50,9 +60,49 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 		FragmentShaderStream.close();
 	}
 
+	// Define the variant switches right after the #version line
+	if(fragment_defines != NULL){
+		size_t InsertPos = 0;
+		if(FragmentShaderCode.compare(0, 8, "#version") == 0){
+			InsertPos = FragmentShaderCode.find('\n');
+			InsertPos = (InsertPos == std::string::npos) ? FragmentShaderCode.size() : InsertPos + 1;
+		}
+		FragmentShaderCode.insert(InsertPos, fragment_defines);
+	}
+
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 
+	// Look for a program binary linked from the same sources by the same driver
+	DerivedDataCache::CACHE_KEY BinaryKey = DerivedDataCache::KeyBuilder("ShaderProgram", 1)
+		.Add(VertexShaderCode)
+		.Add(FragmentShaderCode)
+		.Add(std::string((const char*)glGetString(GL_VENDOR)))
+		.Add(std::string((const char*)glGetString(GL_RENDERER)))
+		.Add(std::string((const char*)glGetString(GL_VERSION)))
+		.GetKey();
+	GLint BinaryFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &BinaryFormats);
+	bool bCacheBinary = (m_pDerivedDataCache != NULL) && (BinaryFormats > 0);
+
+	std::vector<unsigned char> CachedBinary;
+	if(bCacheBinary && m_pDerivedDataCache->Get(BinaryKey, CachedBinary) && CachedBinary.size() > sizeof(GLenum)){
+		GLenum BinaryFormat;
+		memcpy(&BinaryFormat, CachedBinary.data(), sizeof(BinaryFormat));
+		GLuint ProgramID = glCreateProgram();
+		glProgramBinary(ProgramID, BinaryFormat, CachedBinary.data() + sizeof(BinaryFormat), (GLsizei)(CachedBinary.size() - sizeof(BinaryFormat)));
+		glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+		if(Result == GL_TRUE){
+			printf("Loaded cached shader program for %s and %s\n", vertex_file_path, fragment_file_path);
+			m_programID = ProgramID;
+			glDeleteShader(VertexShaderID);
+			glDeleteShader(FragmentShaderID);
+			return ProgramID;
+		}
+		// the driver rejected the binary, compile from source instead
+		glDeleteProgram(ProgramID);
+	}
+
 
 	// Compile Vertex Shader
 	printf("Compiling shader : %s...", vertex_file_path);
@@ -94,6 +144,9 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 	m_programID = ProgramID;
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
+	if(bCacheBinary){
+		glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glLinkProgram(ProgramID);
 
 	// Check the program
@@ -106,6 +159,19 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 	}
 
 	printf("success\n");
+
+	// Store the linked binary for the next run
+	if(bCacheBinary && Result == GL_TRUE){
+		GLint BinaryLength = 0;
+		glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &BinaryLength);
+		if(BinaryLength > 0){
+			GLenum BinaryFormat = 0;
+			std::vector<unsigned char> Binary(sizeof(BinaryFormat) + BinaryLength);
+			glGetProgramBinary(ProgramID, BinaryLength, NULL, &BinaryFormat, Binary.data() + sizeof(BinaryFormat));
+			memcpy(Binary.data(), &BinaryFormat, sizeof(BinaryFormat));
+			m_pDerivedDataCache->Put(BinaryKey, Binary);
+		}
+	}
 	
 	glDetachShader(ProgramID, VertexShaderID);
 	glDetachShader(ProgramID, FragmentShaderID);
@@ -116,4 +182,173 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 	return ProgramID;
 }
 
+/***********************************************************
+ *  LoadComputeShader()
+ *
+ *  This method is called to load a compute shader from an
+ *  external GLSL file and link it into a program on its
+ *  own, with the binary cached like LoadShaders() does.
+ ***********************************************************/
+GLuint ShaderManager::LoadComputeShader(const char * compute_file_path,const char * compute_defines){
+
+	// Read the Compute Shader code from the file
+	std::string ComputeShaderCode;
+	std::ifstream ComputeShaderStream(compute_file_path, std::ios::in);
+	if(ComputeShaderStream.is_open()){
+		std::stringstream sstr;
+		sstr << ComputeShaderStream.rdbuf();
+		ComputeShaderCode = sstr.str();
+		ComputeShaderStream.close();
+	}else{
+		printf("Impossible to open %s. Are you in the right directory ?\n", compute_file_path);
+		return 0;
+	}
+
+	// Define the switches right after the #version line
+	if(compute_defines != NULL){
+		size_t InsertPos = 0;
+		if(ComputeShaderCode.compare(0, 8, "#version") == 0){
+			InsertPos = ComputeShaderCode.find('\n');
+			InsertPos = (InsertPos == std::string::npos) ? ComputeShaderCode.size() : InsertPos + 1;
+		}
+		ComputeShaderCode.insert(InsertPos, compute_defines);
+	}
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+
+	// Look for a program binary linked from the same source by the same driver
+	DerivedDataCache::CACHE_KEY BinaryKey = DerivedDataCache::KeyBuilder("ComputeProgram", 1)
+		.Add(ComputeShaderCode)
+		.Add(std::string((const char*)glGetString(GL_VENDOR)))
+		.Add(std::string((const char*)glGetString(GL_RENDERER)))
+		.Add(std::string((const char*)glGetString(GL_VERSION)))
+		.GetKey();
+	GLint BinaryFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &BinaryFormats);
+	bool bCacheBinary = (m_pDerivedDataCache != NULL) && (BinaryFormats > 0);
+
+	std::vector<unsigned char> CachedBinary;
+	if(bCacheBinary && m_pDerivedDataCache->Get(BinaryKey, CachedBinary) && CachedBinary.size() > sizeof(GLenum)){
+		GLenum BinaryFormat;
+		memcpy(&BinaryFormat, CachedBinary.data(), sizeof(BinaryFormat));
+		GLuint ProgramID = glCreateProgram();
+		glProgramBinary(ProgramID, BinaryFormat, CachedBinary.data() + sizeof(BinaryFormat), (GLsizei)(CachedBinary.size() - sizeof(BinaryFormat)));
+		glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+		if(Result == GL_TRUE){
+			printf("Loaded cached compute program for %s\n", compute_file_path);
+			m_programID = ProgramID;
+			return ProgramID;
+		}
+		// the driver rejected the binary, compile from source instead
+		glDeleteProgram(ProgramID);
+	}
+
+	// Compile Compute Shader
+	printf("Compiling shader : %s...", compute_file_path);
+	GLuint ComputeShaderID = glCreateShader(GL_COMPUTE_SHADER);
+	char const * ComputeSourcePointer = ComputeShaderCode.c_str();
+	glShaderSource(ComputeShaderID, 1, &ComputeSourcePointer , NULL);
+	glCompileShader(ComputeShaderID);
+
+	// Check Compute Shader
+	glGetShaderiv(ComputeShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(ComputeShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 0 ){
+		std::vector<char> ComputeShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(ComputeShaderID, InfoLogLength, NULL, &ComputeShaderErrorMessage[0]);
+		printf("\n%s\n", &ComputeShaderErrorMessage[0]);
+	}
+
+	printf("success\n");
+
+	// Link the program
+	printf("Linking compute program...");
+	GLuint ProgramID = glCreateProgram();
+	m_programID = ProgramID;
+	glAttachShader(ProgramID, ComputeShaderID);
+	if(bCacheBinary){
+		glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(ProgramID);
+
+	// Check the program
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 1 ){
+		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		printf("\n%s\n", &ProgramErrorMessage[0]);
+	}
+
+	printf("success\n");
+
+	// Store the linked binary for the next run
+	if(bCacheBinary && Result == GL_TRUE){
+		GLint BinaryLength = 0;
+		glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &BinaryLength);
+		if(BinaryLength > 0){
+			GLenum BinaryFormat = 0;
+			std::vector<unsigned char> Binary(sizeof(BinaryFormat) + BinaryLength);
+			glGetProgramBinary(ProgramID, BinaryLength, NULL, &BinaryFormat, Binary.data() + sizeof(BinaryFormat));
+			memcpy(Binary.data(), &BinaryFormat, sizeof(BinaryFormat));
+			m_pDerivedDataCache->Put(BinaryKey, Binary);
+		}
+	}
+
+	glDetachShader(ProgramID, ComputeShaderID);
+	glDeleteShader(ComputeShaderID);
+
+	return ProgramID;
+}
+
+/***********************************************************
+ *  CheckUniformBlock()
+ *
+ *  This method is called after linking to compare a uniform
+ *  block with its C++ mirror, using the program's reflection
+ *  data.  Any difference is reported and false is returned.
+ ***********************************************************/
+bool ShaderManager::CheckUniformBlock(const char * block_name, GLuint binding, GLint data_size, const std::vector<BLOCK_MEMBER>& members){
+
+	GLuint BlockIndex = glGetProgramResourceIndex(m_programID, GL_UNIFORM_BLOCK, block_name);
+	if(BlockIndex == GL_INVALID_INDEX){
+		printf("Uniform block %s is not used by the shader program\n", block_name);
+		return false;
+	}
+
+	bool bMatches = true;
+
+	// the block binding and total size
+	const GLenum BlockProps[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+	GLint BlockValues[2] = { 0, 0 };
+	glGetProgramResourceiv(m_programID, GL_UNIFORM_BLOCK, BlockIndex, 2, BlockProps, 2, NULL, BlockValues);
+	if(BlockValues[0] != (GLint)binding){
+		printf("Uniform block %s is bound to %d, expected %u\n", block_name, BlockValues[0], binding);
+		bMatches = false;
+	}
+	if(BlockValues[1] != data_size){
+		printf("Uniform block %s is %d bytes, expected %d\n", block_name, BlockValues[1], data_size);
+		bMatches = false;
+	}
+
+	// every member offset
+	for(const BLOCK_MEMBER& member : members){
+		GLuint MemberIndex = glGetProgramResourceIndex(m_programID, GL_UNIFORM, member.name.c_str());
+		if(MemberIndex == GL_INVALID_INDEX){
+			// members the shader never reads can be optimized away
+			continue;
+		}
+		const GLenum MemberProps[] = { GL_OFFSET };
+		GLint Offset = -1;
+		glGetProgramResourceiv(m_programID, GL_UNIFORM, MemberIndex, 1, MemberProps, 1, NULL, &Offset);
+		if(Offset != member.offset){
+			printf("Uniform %s is at offset %d, expected %d\n", member.name.c_str(), Offset, member.offset);
+			bMatches = false;
+		}
+	}
+
+	return bMatches;
+}
+
 
@@ -2,6 +2,8 @@
 
 #include <GL/glew.h>        // GLEW library
 
+#include "DerivedDataCache.h"
+
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -10,15 +12,46 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 
 class ShaderManager
 {
 public:
 	unsigned int m_programID;
+
+	// linked program binaries are cached here when it is set
+	DerivedDataCache* m_pDerivedDataCache = NULL;
 	
+	// vertex_inputs, when passed, is inserted after the #version
+	// line of the vertex shader to declare its input attributes,
+	// and fragment_defines after that of the fragment shader to
+	// compile a variant of it
 	GLuint LoadShaders(
 		const char* vertex_file_path, 
-		const char* fragment_file_path);
+		const char* fragment_file_path,
+		const char* vertex_inputs = NULL,
+		const char* fragment_defines = NULL);
+
+	// load a compute program the same way, with defines inserted
+	// after the #version line of the compute shader
+	GLuint LoadComputeShader(
+		const char* compute_file_path,
+		const char* compute_defines = NULL);
+
+	// one member of a uniform block and its expected byte offset
+	struct BLOCK_MEMBER
+	{
+		std::string name;
+		GLint offset;
+	};
+
+	// compare a uniform block of the linked program with the
+	// binding, size and member offsets of its C++ mirror
+	bool CheckUniformBlock(
+		const char* block_name,
+		GLuint binding,
+		GLint data_size,
+		const std::vector<BLOCK_MEMBER>& members);
 
 	// activate the shader
 	// ------------------------------------------------------------------------
@@ -40,6 +73,12 @@ public:
 		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), value);
 	}
 
+	// ------------------------------------------------------------------------
+	inline void setUIntValue(const std::string &name, unsigned int value) const
+	{
+		glUniform1ui(glGetUniformLocation(m_programID, name.c_str()), value);
+	}
+
 	// ------------------------------------------------------------------------
 	inline void setFloatValue(const std::string &name, float value) const
 	{
@@ -67,6 +106,18 @@ public:
 		glUniform3f(glGetUniformLocation(m_programID, name.c_str()), x, y, z);
 	}
 
+	// ------------------------------------------------------------------------
+	inline void setIVec2Value(const std::string &name, int x, int y) const
+	{
+		glUniform2i(glGetUniformLocation(m_programID, name.c_str()), x, y);
+	}
+
+	// ------------------------------------------------------------------------
+	inline void setIVec3Value(const std::string &name, const glm::ivec3 &value) const
+	{
+		glUniform3iv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+	}
+
 	// ------------------------------------------------------------------------
 	inline void setVec4Value(const std::string &name, const glm::vec4 &value) const
 	{
@@ -0,0 +1,586 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadingcachemanager.cpp
+// ============
+// texture space cache of the view independent shading of static objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadingCacheManager.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// declaration of global variables
+namespace
+{
+	const char* g_ShadingVertexShader = "../../Utilities/shaders/shadingCacheVertexShader.glsl";
+	// the shading pass is the scene fragment shader, compiled to
+	// read its surface from the lattice of a cached triangle
+	const char* g_ShadingFragmentShader = "../../Utilities/shaders/fragmentShader.glsl";
+	const char* g_ShadingDefines = "#define SHADING_CACHE\n";
+
+	// the atlas is split into pages, each of which holds the
+	// blocks of one size
+	const GLuint g_AtlasSize = 2048;
+	const GLuint g_PageSize = 256;
+	// world units between the texels of a lattice, and the most
+	// divisions along the edges of a triangle, one less than the
+	// largest block; objects with larger triangles are not cached
+	const float g_TexelSize = 0.1f;
+	const int g_MaxDivisions = 127;
+
+	// requests the resolve pass can make in a frame, as in the
+	// declaration below, triangle records and objects
+	const GLuint g_MaxRequests = 8192;
+	const GLuint g_MaxRecords = 1u << 19;
+	const GLuint g_MaxObjects = 4096;
+	// the triangle records follow the indirect command and the
+	// request list in the cache buffer
+	const GLsizeiptr g_TriangleOffset = (4 + g_MaxRequests) * sizeof(GLuint);
+	// frames an object is kept without being drawn
+	const GLuint g_EvictFrames = 60;
+
+	// the cache uses the units after the ray shadows
+	const GLuint g_LightTextureUnit = 39;
+	const GLuint g_VisibilityTextureUnit = 40;
+
+	// the GLSL side of the cache buffer, which must match
+	// SHADING_CACHE_TRIANGLE_BLOCK and the constants above
+	const char* g_CacheDeclaration =
+		"#define SHADING_CACHE_MAX_REQUESTS 8192\n"
+		"#define SHADING_CACHE_REFRESH_FRAMES 240u\n"
+		"struct ShadingCacheTriangle\n"
+		"{\n"
+		"    uint origin;\n"
+		"    uint divisions;\n"
+		"    uint object;\n"
+		"    uint meshTriangle;\n"
+		"    uint stamp;\n"
+		"    uint requested;\n"
+		"};\n"
+		"layout(std430, binding = 13) buffer ShadingCacheBuffer\n"
+		"{\n"
+		"    uint shadingCacheCommand[4];\n"
+		"    uint shadingCacheRequests[SHADING_CACHE_MAX_REQUESTS];\n"
+		"    ShadingCacheTriangle shadingCacheTriangles[];\n"
+		"};\n";
+}
+
+/***********************************************************
+ *  ShadingCacheManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadingCacheManager::ShadingCacheManager(ShapeMeshes* pShapeMeshes, DerivedDataCache* pDerivedDataCache)
+{
+	m_pShapeMeshes = pShapeMeshes;
+	m_pShadingShader = new ShaderManager();
+	m_pShadingShader->m_programID = 0;
+	m_pShadingShader->m_pDerivedDataCache = pDerivedDataCache;
+	m_bShadersLoaded = false;
+	m_bEnabled = false;
+	m_bInvalidated = false;
+	m_frame = 0;
+	m_validFrame = 0;
+	m_cacheBuffer = 0;
+	m_objectBuffer = 0;
+	m_lightTexture = 0;
+	m_visibilityTexture = 0;
+	m_framebuffer = 0;
+	Clear();
+}
+
+/***********************************************************
+ *  ~ShadingCacheManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadingCacheManager::~ShadingCacheManager()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	glDeleteTextures(1, &m_lightTexture);
+	m_lightTexture = 0;
+	glDeleteTextures(1, &m_visibilityTexture);
+	m_visibilityTexture = 0;
+	glDeleteBuffers(1, &m_cacheBuffer);
+	m_cacheBuffer = 0;
+	glDeleteBuffers(1, &m_objectBuffer);
+	m_objectBuffer = 0;
+	if (m_pShadingShader->m_programID != 0)
+	{
+		glDeleteProgram(m_pShadingShader->m_programID);
+	}
+	delete m_pShadingShader;
+	m_pShadingShader = NULL;
+	m_pShapeMeshes = NULL;
+}
+
+/***********************************************************
+ *  GLSLDeclaration()
+ ***********************************************************/
+const char* ShadingCacheManager::GLSLDeclaration()
+{
+	return(g_CacheDeclaration);
+}
+
+/***********************************************************
+ *  LoadShaders()
+ *
+ *  This method is used for loading the shading program and
+ *  creating the atlas and buffers the first time the cache
+ *  is used.  If anything fails every pixel is shaded in
+ *  full.  The indirect command at the start of the cache
+ *  buffer draws six vertices per request; the resolve pass
+ *  counts the requests into its instance count.
+ ***********************************************************/
+bool ShadingCacheManager::LoadShaders()
+{
+	if (m_bShadersLoaded == false)
+	{
+		m_bShadersLoaded = true;
+		std::string shadingDefines = std::string(g_ShadingDefines) + VertexPool::GLSLDeclaration() + g_CacheDeclaration;
+		m_pShadingShader->LoadShaders(g_ShadingVertexShader, g_ShadingFragmentShader, g_CacheDeclaration, shadingDefines.c_str());
+		if (m_pShadingShader->m_programID == 0)
+		{
+			std::cout << "Could not load the shading cache shader, shading every pixel in full" << std::endl;
+			return(false);
+		}
+
+		glCreateBuffers(1, &m_cacheBuffer);
+		glNamedBufferStorage(m_cacheBuffer, g_TriangleOffset + (GLsizeiptr)g_MaxRecords * sizeof(SHADING_CACHE_TRIANGLE_BLOCK), NULL, GL_DYNAMIC_STORAGE_BIT);
+		const GLuint command[4] = { 6, 0, 0, 0 };
+		glNamedBufferSubData(m_cacheBuffer, 0, sizeof(command), command);
+		glCreateBuffers(1, &m_objectBuffer);
+		glNamedBufferStorage(m_objectBuffer, g_MaxObjects * sizeof(SHADING_CACHE_OBJECT_BLOCK), NULL, GL_DYNAMIC_STORAGE_BIT);
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_lightTexture);
+		glTextureStorage2D(m_lightTexture, 1, GL_RGBA16F, g_AtlasSize, g_AtlasSize);
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_visibilityTexture);
+		glTextureStorage2D(m_visibilityTexture, 1, GL_RGBA8, g_AtlasSize, g_AtlasSize);
+		glCreateFramebuffers(1, &m_framebuffer);
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_lightTexture, 0);
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT1, m_visibilityTexture, 0);
+		const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glNamedFramebufferDrawBuffers(m_framebuffer, 2, drawBuffers);
+		if (glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "Could not create the shading cache atlas, shading every pixel in full" << std::endl;
+			glDeleteProgram(m_pShadingShader->m_programID);
+			m_pShadingShader->m_programID = 0;
+		}
+	}
+	return(m_pShadingShader->m_programID != 0);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for dropping every cached object and
+ *  candidate and making the whole atlas and every record
+ *  and slot free again.
+ ***********************************************************/
+void ShadingCacheManager::Clear()
+{
+	m_entries.clear();
+	m_candidates.clear();
+
+	m_freeRecords.clear();
+	RECORD_RANGE range = { 0, g_MaxRecords };
+	m_freeRecords.push_back(range);
+	// taken from the back, so the lowest first
+	m_freeObjects.clear();
+	for (GLuint i = g_MaxObjects; i > 0; i--)
+	{
+		m_freeObjects.push_back(i - 1);
+	}
+	m_freePages.clear();
+	for (GLuint y = 0; y < g_AtlasSize; y += g_PageSize)
+	{
+		for (GLuint x = 0; x < g_AtlasSize; x += g_PageSize)
+		{
+			m_freePages.push_back(x | (y << 16));
+		}
+	}
+	m_freeBlocks.clear();
+}
+
+/***********************************************************
+ *  SetEnabled()
+ *
+ *  This method is used for turning the cache on or off.
+ *  The objects are only collected while it is on, so it
+ *  starts empty either way.
+ ***********************************************************/
+void ShadingCacheManager::SetEnabled(bool bEnabled)
+{
+	if (bEnabled != m_bEnabled)
+	{
+		m_bEnabled = bEnabled;
+		Clear();
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for counting the frame and letting
+ *  go of the objects that were not drawn lately, and of
+ *  the candidates not drawn the last frame.  Once room is
+ *  freed the candidates that did not fit may try again.
+ ***********************************************************/
+void ShadingCacheManager::BeginFrame()
+{
+	m_frame++;
+	if (m_bEnabled == false)
+	{
+		return;
+	}
+
+	bool bReleased = false;
+	for (auto entry = m_entries.begin(); entry != m_entries.end();)
+	{
+		if (m_frame - entry->second.lastFrame > g_EvictFrames)
+		{
+			Release(entry->second);
+			entry = m_entries.erase(entry);
+			bReleased = true;
+		}
+		else
+		{
+			++entry;
+		}
+	}
+	for (auto candidate = m_candidates.begin(); candidate != m_candidates.end();)
+	{
+		if (candidate->second.lastFrame + 1 < m_frame)
+		{
+			candidate = m_candidates.erase(candidate);
+		}
+		else
+		{
+			if (bReleased == true)
+			{
+				candidate->second.bRejected = false;
+			}
+			++candidate;
+		}
+	}
+}
+
+/***********************************************************
+ *  FindTriangles()
+ *
+ *  This method is used for finding the cached object drawn
+ *  with this mesh, transform and material.  An object that
+ *  is not cached yet becomes a candidate, and is cached
+ *  when it is drawn the same way the next frame.
+ ***********************************************************/
+GLint ShadingCacheManager::FindTriangles(int poolMesh, const VISIBILITY_DRAW_BLOCK& draw)
+{
+	if ((m_bEnabled == false) || (poolMesh < 0) || (LoadShaders() == false))
+	{
+		return(-1);
+	}
+
+	CACHE_KEY key = CACHE_KEY();
+	key.mesh = (GLuint)poolMesh;
+	key.model = draw.model;
+	key.material = draw.material;
+
+	auto found = m_entries.find(key);
+	if (found != m_entries.end())
+	{
+		found->second.lastFrame = m_frame;
+		return((GLint)found->second.firstTriangle);
+	}
+
+	CANDIDATE& candidate = m_candidates[key];
+	if ((candidate.lastFrame != 0) && (candidate.lastFrame + 1 == m_frame) && (candidate.bRejected == false))
+	{
+		CACHE_ENTRY entry = CACHE_ENTRY();
+		if (Allocate(key, draw, entry) == true)
+		{
+			entry.lastFrame = m_frame;
+			m_entries[key] = entry;
+			m_candidates.erase(key);
+			return((GLint)entry.firstTriangle);
+		}
+		candidate.bRejected = true;
+	}
+	candidate.lastFrame = m_frame;
+	return(-1);
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method is used for giving an object a run of
+ *  triangle records, a block of the atlas per triangle and
+ *  a slot, and uploading them.  The lattice divisions come
+ *  from the average triangle of the object: the surface of
+ *  its world bounds shared by its triangles, taken as right
+ *  triangles with equal legs.  Triangles too large for the
+ *  biggest block at the texel size, like the floor's, are
+ *  shaded in full instead.
+ ***********************************************************/
+bool ShadingCacheManager::Allocate(const CACHE_KEY& key, const VISIBILITY_DRAW_BLOCK& draw, CACHE_ENTRY& entry)
+{
+	VertexPool* pVertexPool = m_pShapeMeshes->GetVertexPool();
+	if ((NULL == pVertexPool) || (m_freeObjects.empty() == true))
+	{
+		return(false);
+	}
+	GLuint triangleCount = pVertexPool->GetIndexCount((int)key.mesh) / 3;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	if ((triangleCount == 0) || (pVertexPool->GetMeshBounds((int)key.mesh, boundsMin, boundsMax) == false))
+	{
+		return(false);
+	}
+
+	// the run of records, first fit
+	size_t rangeIndex = 0;
+	while ((rangeIndex < m_freeRecords.size()) && (m_freeRecords[rangeIndex].count < triangleCount))
+	{
+		rangeIndex++;
+	}
+	if (rangeIndex == m_freeRecords.size())
+	{
+		return(false);
+	}
+
+	glm::vec3 worldMin = glm::vec3(FLT_MAX);
+	glm::vec3 worldMax = glm::vec3(-FLT_MAX);
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 local = glm::vec3(
+			(corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec3 world = glm::vec3(key.model * glm::vec4(local, 1.0f));
+		worldMin = glm::min(worldMin, world);
+		worldMax = glm::max(worldMax, world);
+	}
+	glm::vec3 size = worldMax - worldMin;
+	float area = 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	float edge = sqrtf(2.0f * area / (float)triangleCount);
+	int divisions = std::max((int)ceilf(edge / g_TexelSize), 1);
+	if (divisions > g_MaxDivisions)
+	{
+		return(false);
+	}
+	GLuint blockSize = 2;
+	while (blockSize < (GLuint)divisions + 1)
+	{
+		blockSize *= 2;
+	}
+
+	entry.blockSize = blockSize;
+	entry.blocks.clear();
+	for (GLuint i = 0; i < triangleCount; i++)
+	{
+		GLuint origin = 0;
+		if (AllocateBlock(blockSize, origin) == false)
+		{
+			std::vector<GLuint>& freeBlocks = m_freeBlocks[blockSize];
+			freeBlocks.insert(freeBlocks.end(), entry.blocks.begin(), entry.blocks.end());
+			entry.blocks.clear();
+			return(false);
+		}
+		entry.blocks.push_back(origin);
+	}
+
+	entry.firstTriangle = m_freeRecords[rangeIndex].first;
+	entry.triangleCount = triangleCount;
+	m_freeRecords[rangeIndex].first += triangleCount;
+	m_freeRecords[rangeIndex].count -= triangleCount;
+	if (m_freeRecords[rangeIndex].count == 0)
+	{
+		m_freeRecords.erase(m_freeRecords.begin() + rangeIndex);
+	}
+	entry.object = m_freeObjects.back();
+	m_freeObjects.pop_back();
+
+	SHADING_CACHE_OBJECT_BLOCK object = SHADING_CACHE_OBJECT_BLOCK();
+	object.model = draw.model;
+	object.normalMatrix = draw.normalMatrix;
+	object.material = draw.material;
+	object.mesh = key.mesh;
+	glNamedBufferSubData(m_objectBuffer, entry.object * sizeof(SHADING_CACHE_OBJECT_BLOCK), sizeof(SHADING_CACHE_OBJECT_BLOCK), &object);
+
+	// the records start unshaded
+	std::vector<SHADING_CACHE_TRIANGLE_BLOCK> records(triangleCount);
+	for (GLuint i = 0; i < triangleCount; i++)
+	{
+		records[i] = SHADING_CACHE_TRIANGLE_BLOCK();
+		records[i].origin = entry.blocks[i];
+		records[i].divisions = (GLuint)divisions;
+		records[i].object = entry.object;
+		records[i].meshTriangle = i;
+	}
+	glNamedBufferSubData(m_cacheBuffer,
+		g_TriangleOffset + (GLintptr)entry.firstTriangle * sizeof(SHADING_CACHE_TRIANGLE_BLOCK),
+		records.size() * sizeof(SHADING_CACHE_TRIANGLE_BLOCK), records.data());
+	return(true);
+}
+
+/***********************************************************
+ *  Release()
+ *
+ *  This method is used for returning the records, blocks
+ *  and slot of an object.  Neighbouring runs of records
+ *  are joined again.  The pages stay with their block
+ *  size.
+ ***********************************************************/
+void ShadingCacheManager::Release(const CACHE_ENTRY& entry)
+{
+	RECORD_RANGE range = { entry.firstTriangle, entry.triangleCount };
+	m_freeRecords.push_back(range);
+	std::sort(m_freeRecords.begin(), m_freeRecords.end(),
+		[](const RECORD_RANGE& a, const RECORD_RANGE& b) { return(a.first < b.first); });
+	size_t joined = 0;
+	for (size_t i = 1; i < m_freeRecords.size(); i++)
+	{
+		if (m_freeRecords[joined].first + m_freeRecords[joined].count == m_freeRecords[i].first)
+		{
+			m_freeRecords[joined].count += m_freeRecords[i].count;
+		}
+		else
+		{
+			m_freeRecords[++joined] = m_freeRecords[i];
+		}
+	}
+	m_freeRecords.resize(joined + 1);
+
+	std::vector<GLuint>& freeBlocks = m_freeBlocks[entry.blockSize];
+	freeBlocks.insert(freeBlocks.end(), entry.blocks.begin(), entry.blocks.end());
+	m_freeObjects.push_back(entry.object);
+}
+
+/***********************************************************
+ *  AllocateBlock()
+ *
+ *  This method is used for taking a free block of a size,
+ *  splitting a free page into blocks of that size when
+ *  there are none.
+ ***********************************************************/
+bool ShadingCacheManager::AllocateBlock(GLuint blockSize, GLuint& origin)
+{
+	std::vector<GLuint>& freeBlocks = m_freeBlocks[blockSize];
+	if (freeBlocks.empty() == true)
+	{
+		if (m_freePages.empty() == true)
+		{
+			return(false);
+		}
+		GLuint page = m_freePages.back();
+		m_freePages.pop_back();
+		GLuint pageX = page & 0xFFFFu;
+		GLuint pageY = page >> 16;
+		for (GLuint y = 0; y < g_PageSize; y += blockSize)
+		{
+			for (GLuint x = 0; x < g_PageSize; x += blockSize)
+			{
+				freeBlocks.push_back((pageX + x) | ((pageY + y) << 16));
+			}
+		}
+	}
+	origin = freeBlocks.back();
+	freeBlocks.pop_back();
+	return(true);
+}
+
+/***********************************************************
+ *  GetShadingShader()
+ ***********************************************************/
+ShaderManager* ShadingCacheManager::GetShadingShader()
+{
+	if ((m_bEnabled == false) || (LoadShaders() == false))
+	{
+		return(NULL);
+	}
+	return(m_pShadingShader);
+}
+
+/***********************************************************
+ *  SetResolveUniforms()
+ *
+ *  This method is used for handing the cache to the resolve
+ *  program, which must be current.  A change of the lighting
+ *  since the last frame makes the texels shaded before this
+ *  frame stale; this frame's shading pass runs with the new
+ *  lighting.
+ ***********************************************************/
+void ShadingCacheManager::SetResolveUniforms(ShaderManager* pShader)
+{
+	bool bActive = (m_bEnabled == true) && (m_entries.empty() == false) && (m_pShadingShader->m_programID != 0);
+	pShader->setBoolValue("bShadingCache", bActive);
+	if (bActive == false)
+	{
+		return;
+	}
+
+	if (m_bInvalidated == true)
+	{
+		m_validFrame = m_frame;
+		m_bInvalidated = false;
+	}
+	pShader->setUIntValue("shadingCacheFrame", m_frame);
+	pShader->setUIntValue("shadingCacheValidFrame", m_validFrame);
+	pShader->setSampler2DValue("shadingCacheLight", g_LightTextureUnit);
+	pShader->setSampler2DValue("shadingCacheVisibility", g_VisibilityTextureUnit);
+	glBindTextureUnit(g_LightTextureUnit, m_lightTexture);
+	glBindTextureUnit(g_VisibilityTextureUnit, m_visibilityTexture);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADING_CACHE_BINDING, m_cacheBuffer);
+}
+
+/***********************************************************
+ *  Shade()
+ *
+ *  This method is used for drawing a block of the atlas for
+ *  every triangle the resolve pass asked for, with the
+ *  instance count it wrote, and emptying the request list
+ *  for the next frame.  The shading program must have the
+ *  lighting settings of the scene already.
+ ***********************************************************/
+void ShadingCacheManager::Shade(ViewManager* pViewManager)
+{
+	if ((m_bEnabled == false) || (m_entries.empty() == true) || (m_pShadingShader->m_programID == 0))
+	{
+		return;
+	}
+
+	// the requests and their count were written by the resolve pass
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, g_AtlasSize, g_AtlasSize);
+	glDisable(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+	m_pShadingShader->use();
+	m_pShadingShader->setUIntValue("shadingCacheFrame", m_frame);
+	m_pShadingShader->setVec2Value("atlasSize", (float)g_AtlasSize, (float)g_AtlasSize);
+	m_pShapeMeshes->GetVertexPool()->Bind();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADING_CACHE_OBJECT_BINDING, m_objectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADING_CACHE_BINDING, m_cacheBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_cacheBuffer);
+	glDrawArraysIndirect(GL_TRIANGLES, NULL);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+
+	// the stamps are read by the next resolve pass
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	const GLuint noRequests = 0;
+	glClearNamedBufferSubData(m_cacheBuffer, GL_R32UI, sizeof(GLuint), sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &noRequests);
+
+	glEnable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+	pViewManager->BeginSceneFrame();
+}
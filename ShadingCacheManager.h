@@ -0,0 +1,174 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadingcachemanager.h
+// ============
+// texture space cache of the view independent shading of static objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "ShaderManager.h"
+#include "ShapeMeshes.h"
+#include "VertexPool.h"
+#include "ViewManager.h"
+#include "UniformBlocks.h"
+
+#include <cstring>
+#include <map>
+#include <vector>
+
+/***********************************************************
+ *  ShadingCacheManager
+ *
+ *  This class keeps the shading of the objects that stay
+ *  put in an atlas, so the resolve pass of the visibility
+ *  buffer reads it instead of computing it in every pixel
+ *  of every frame.  Only what does not depend on the view
+ *  is kept: the ambient light with its occlusion, the
+ *  diffuse light of the area lights and the voxelized
+ *  scene, and the distance field shadow of each light.
+ *  The resolve pass still adds the direct and specular
+ *  light itself.
+ *
+ *  Every triangle of a cached object gets a block of the
+ *  atlas holding a lattice of texels over it, with the same
+ *  number of divisions along its edges for every triangle
+ *  of the object, picked from its size; a pixel blends the
+ *  three lattice points around it.  The blocks are power
+ *  of two squares handed out from pages of the atlas per
+ *  size, and objects whose triangles are too large for the
+ *  biggest block stay uncached.
+ *
+ *  The texels are shaded at their own rate: the resolve
+ *  pass asks for the triangles it sees whose texels are
+ *  missing, shaded before the lighting last changed, or a
+ *  few seconds old, and after it the shading pass draws one
+ *  block for each triangle asked for with an indirect draw
+ *  the resolve pass counted.  Nothing is read back.
+ *
+ *  An object is cached once it is drawn with the same mesh,
+ *  transform and material in two frames in a row, and let
+ *  go when it has not been drawn for a while.
+ ***********************************************************/
+class ShadingCacheManager
+{
+public:
+	// constructor, the meshes are read from the vertex pool of
+	// pShapeMeshes and the program binaries are cached in
+	// pDerivedDataCache when passed
+	ShadingCacheManager(ShapeMeshes* pShapeMeshes, DerivedDataCache* pDerivedDataCache = NULL);
+	// destructor
+	~ShadingCacheManager();
+
+	// the GLSL declarations of the triangle records and request
+	// list, for the resolve and shading programs
+	static const char* GLSLDeclaration();
+
+	// turn the cache on or off; everything in it is dropped
+	void SetEnabled(bool bEnabled);
+	bool GetEnabled() const { return(m_bEnabled); }
+	// the lighting changed, the texels shaded so far are stale
+	void Invalidate() { m_bInvalidated = true; }
+
+	// start a frame and let go of the objects not drawn lately
+	void BeginFrame();
+	// the first triangle record of an object drawn this frame,
+	// caching it when it was drawn the same way the last frame,
+	// or -1 when it is not cached
+	GLint FindTriangles(int poolMesh, const VISIBILITY_DRAW_BLOCK& draw);
+	// the shading program, created the first time, or NULL when
+	// it cannot be; the caller copies the lighting settings
+	// into it before Shade()
+	ShaderManager* GetShadingShader();
+	// point the cache uniforms of the resolve program at this
+	// frame's cache
+	void SetResolveUniforms(ShaderManager* pShader);
+	// shade the texels the resolve pass asked for and bind the
+	// scene target again.  The caller makes its shader program
+	// current again afterwards
+	void Shade(ViewManager* pViewManager);
+
+private:
+	// what makes an object the same as the last frame's
+	struct CACHE_KEY
+	{
+		GLuint mesh;
+		glm::mat4 model;
+		MATERIAL_BLOCK material;
+
+		bool operator<(const CACHE_KEY& other) const
+		{
+			return(memcmp(this, &other, sizeof(CACHE_KEY)) < 0);
+		}
+	};
+
+	// the triangle records, atlas blocks and object slot of a
+	// cached object
+	struct CACHE_ENTRY
+	{
+		GLuint firstTriangle;
+		GLuint triangleCount;
+		GLuint object;
+		GLuint blockSize;
+		std::vector<GLuint> blocks;
+		GLuint lastFrame;
+	};
+
+	// an object seen but not cached yet
+	struct CANDIDATE
+	{
+		GLuint lastFrame;
+		// it did not fit, tried again once something is let go
+		bool bRejected;
+	};
+
+	// a free run of triangle records
+	struct RECORD_RANGE
+	{
+		GLuint first;
+		GLuint count;
+	};
+
+	ShapeMeshes* m_pShapeMeshes;
+	ShaderManager* m_pShadingShader;
+	bool m_bShadersLoaded;
+	bool m_bEnabled;
+	bool m_bInvalidated;
+
+	// frames count from 1, a stamp of 0 is never shaded
+	GLuint m_frame;
+	GLuint m_validFrame;
+
+	std::map<CACHE_KEY, CACHE_ENTRY> m_entries;
+	std::map<CACHE_KEY, CANDIDATE> m_candidates;
+
+	// free triangle records, object slots, pages of the atlas
+	// and blocks of each size, as x | y << 16 origins
+	std::vector<RECORD_RANGE> m_freeRecords;
+	std::vector<GLuint> m_freeObjects;
+	std::vector<GLuint> m_freePages;
+	std::map<GLuint, std::vector<GLuint>> m_freeBlocks;
+
+	GLuint m_cacheBuffer;
+	GLuint m_objectBuffer;
+	GLuint m_lightTexture;
+	GLuint m_visibilityTexture;
+	GLuint m_framebuffer;
+
+	// load the shading program and create the atlas and
+	// buffers, false if anything failed
+	bool LoadShaders();
+	// drop every object and free all of the atlas
+	void Clear();
+	// give a new object its records, blocks and slot, false
+	// when the cache has no room for it
+	bool Allocate(const CACHE_KEY& key, const VISIBILITY_DRAW_BLOCK& draw, CACHE_ENTRY& entry);
+	// return the records, blocks and slot of an object
+	void Release(const CACHE_ENTRY& entry);
+	// take a block of the given size, false when the atlas is full
+	bool AllocateBlock(GLuint blockSize, GLuint& origin);
+};
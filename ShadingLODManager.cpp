@@ -0,0 +1,278 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadinglodmanager.cpp
+// ============
+// cheaper lighting for the objects that cover few pixels
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadingLODManager.h"
+
+#include <algorithm>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// pixels across an object must cover to be lit per pixel,
+	// and per vertex; smaller objects get one color
+	const float g_FullLevelPixels = 64.0f;
+	const float g_VertexLevelPixels = 16.0f;
+
+	// a frame is measured this often, with at most this many of
+	// its draws counted
+	const long long g_MeasureInterval = 60;
+	const int g_MaxMeasuredDraws = 4096;
+
+	// scalar ALU operations per fragment of the Phong lighting,
+	// counted from the GLSL: the normal and view direction, and
+	// CalcLightSource() once per light.  The vertex level only
+	// scales the interpolated light and the flat level reads a
+	// uniform.  A vendor's offline shader compiler gives the
+	// exact counts for one GPU
+	const double g_FullSetupCycles = 17.0;
+	const double g_FullLightCycles = 50.0;
+	const double g_VertexCycles = 3.0;
+	const double g_FlatCycles = 0.0;
+}
+
+/***********************************************************
+ *  ShadingLODManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadingLODManager::ShadingLODManager()
+{
+	m_bEnabled = true;
+	m_scale = 1.0f;
+	m_lightCount = TOTAL_LIGHTS;
+	m_pViewManager = NULL;
+	m_cameraPosition = glm::vec3(0.0f);
+	m_queryCount = 0;
+	m_bMeasuring = false;
+	m_bQueryOpen = false;
+	m_bPending = false;
+	m_measuredLightCount = TOTAL_LIGHTS;
+	m_frameIndex = 0;
+	for (int i = 0; i < SHADING_LEVEL_COUNT; i++)
+	{
+		m_fragments[i] = 0.0;
+	}
+	m_savedCycles = 0.0;
+	m_measuredFrames = 0;
+}
+
+/***********************************************************
+ *  ~ShadingLODManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadingLODManager::~ShadingLODManager()
+{
+	if (m_queries.size() > 0)
+	{
+		glDeleteQueries((GLsizei)m_queries.size(), m_queries.data());
+	}
+	m_queries.clear();
+	m_pViewManager = NULL;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for keeping the camera the levels of
+ *  this frame are picked with, and for the measuring: the
+ *  counts of the last measured frame are read once all of
+ *  them are ready, and only then is another frame measured.
+ ***********************************************************/
+void ShadingLODManager::BeginFrame(ViewManager* pViewManager)
+{
+	m_pViewManager = pViewManager;
+	if (NULL != pViewManager)
+	{
+		m_cameraPosition = pViewManager->GetCameraPosition();
+	}
+
+	m_bMeasuring = false;
+	if (m_bPending == true)
+	{
+		ReadQueries();
+	}
+	m_frameIndex++;
+	if ((m_bPending == false) && (m_bEnabled == true) && (m_frameIndex % g_MeasureInterval == 0))
+	{
+		if (m_queries.size() == 0)
+		{
+			m_queries.resize(g_MaxMeasuredDraws);
+			glCreateQueries(GL_FRAGMENT_SHADER_INVOCATIONS, g_MaxMeasuredDraws, m_queries.data());
+			m_queryLevels.resize(g_MaxMeasuredDraws);
+		}
+		m_queryCount = 0;
+		m_measuredLightCount = m_lightCount;
+		m_bMeasuring = true;
+	}
+}
+
+/***********************************************************
+ *  SelectLevel()
+ *
+ *  This method is used for picking the level of an object
+ *  from the pixels the sphere around its box covers, at the
+ *  distance of its center.  The camera inside the sphere
+ *  always gets the full level.
+ ***********************************************************/
+ShadingLODManager::SHADING_LEVEL ShadingLODManager::SelectLevel(
+	const glm::mat4& model,
+	const glm::vec3& boundsMin,
+	const glm::vec3& boundsMax) const
+{
+	if ((m_bEnabled == false) || (NULL == m_pViewManager))
+	{
+		return(SHADING_LEVEL_FULL);
+	}
+
+	glm::vec3 center = glm::vec3(model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	float radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+	float distance = glm::length(center - m_cameraPosition);
+	if (distance <= radius)
+	{
+		return(SHADING_LEVEL_FULL);
+	}
+
+	float pixels = m_pViewManager->GetProjectedSize(2.0f * radius, distance);
+	if (pixels >= g_FullLevelPixels * m_scale)
+	{
+		return(SHADING_LEVEL_FULL);
+	}
+	if (pixels >= g_VertexLevelPixels * m_scale)
+	{
+		return(SHADING_LEVEL_VERTEX);
+	}
+	return(SHADING_LEVEL_FLAT);
+}
+
+/***********************************************************
+ *  CalcFlatLight()
+ *
+ *  This method is used for working out the one color an
+ *  object at the flat level is lit with: the ambient light
+ *  and the diffuse light of every light on the half of a
+ *  sphere at its center that faces the camera.  The mean
+ *  of the Lambert term over that half is taken as
+ *  (1 + cos) / 4 of the angle between the camera and the
+ *  light, which is exact toward and away from the light.
+ ***********************************************************/
+glm::vec3 ShadingLODManager::CalcFlatLight(
+	const LIGHTING_BLOCK& lighting,
+	const MATERIAL_BLOCK& material,
+	const glm::mat4& model) const
+{
+	glm::vec3 center = glm::vec3(model[3]);
+	glm::vec3 toCamera = m_cameraPosition - center;
+	toCamera = (glm::length(toCamera) > 0.0f) ? glm::normalize(toCamera) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+	glm::vec3 result = glm::vec3(0.0f);
+	for (int i = 0; i < std::min(m_lightCount, TOTAL_LIGHTS); i++)
+	{
+		const LIGHT_SOURCE_BLOCK& light = lighting.lightSources[i];
+		glm::vec3 toLight = light.position - center;
+		float impact = 0.25f;
+		if (glm::length(toLight) > 0.0f)
+		{
+			impact = 0.25f * (1.0f + glm::dot(toCamera, glm::normalize(toLight)));
+		}
+		result += light.ambientColor + material.ambientColor * material.ambientStrength;
+		result += impact * material.diffuseColor;
+	}
+	return(result);
+}
+
+/***********************************************************
+ *  BeginDraw()
+ ***********************************************************/
+void ShadingLODManager::BeginDraw(SHADING_LEVEL level)
+{
+	if ((m_bMeasuring == false) || (m_queryCount >= (int)m_queries.size()))
+	{
+		return;
+	}
+	m_queryLevels[m_queryCount] = level;
+	glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, m_queries[m_queryCount]);
+	m_bQueryOpen = true;
+}
+
+/***********************************************************
+ *  EndDraw()
+ ***********************************************************/
+void ShadingLODManager::EndDraw()
+{
+	if (m_bQueryOpen == false)
+	{
+		return;
+	}
+	glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+	m_bQueryOpen = false;
+	m_queryCount++;
+	m_bPending = true;
+}
+
+/***********************************************************
+ *  ReadQueries()
+ *
+ *  This method is used for adding the counts of the last
+ *  measured frame to the totals once every query of it is
+ *  ready, so reading them never waits for the GPU.  The
+ *  cycles saved are those of the full lighting with the
+ *  light count of that frame less those of the level.
+ ***********************************************************/
+void ShadingLODManager::ReadQueries()
+{
+	for (int i = 0; i < m_queryCount; i++)
+	{
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(m_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE)
+		{
+			return;
+		}
+	}
+
+	const double levelCycles[SHADING_LEVEL_COUNT] = {
+		g_FullSetupCycles + g_FullLightCycles * std::min(m_measuredLightCount, TOTAL_LIGHTS),
+		g_VertexCycles,
+		g_FlatCycles };
+	for (int i = 0; i < m_queryCount; i++)
+	{
+		GLuint64 fragments = 0;
+		glGetQueryObjectui64v(m_queries[i], GL_QUERY_RESULT, &fragments);
+		int level = m_queryLevels[i];
+		m_fragments[level] += (double)fragments;
+		m_savedCycles += (double)fragments * (levelCycles[SHADING_LEVEL_FULL] - levelCycles[level]);
+	}
+	m_measuredFrames++;
+	m_bPending = false;
+}
+
+/***********************************************************
+ *  GetFragmentsPerFrame()
+ ***********************************************************/
+double ShadingLODManager::GetFragmentsPerFrame(SHADING_LEVEL level) const
+{
+	if (m_measuredFrames == 0)
+	{
+		return(0.0);
+	}
+	return(m_fragments[level] / m_measuredFrames);
+}
+
+/***********************************************************
+ *  GetSavedCyclesPerFrame()
+ ***********************************************************/
+double ShadingLODManager::GetSavedCyclesPerFrame() const
+{
+	if (m_measuredFrames == 0)
+	{
+		return(0.0);
+	}
+	return(m_savedCycles / m_measuredFrames);
+}
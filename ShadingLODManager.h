@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadinglodmanager.h
+// ============
+// cheaper lighting for the objects that cover few pixels
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "ViewManager.h"
+#include "UniformBlocks.h"
+
+#include <vector>
+
+/***********************************************************
+ *  ShadingLODManager
+ *
+ *  This class picks how each object drawn the usual way is
+ *  lit from how many pixels it covers: the full per pixel
+ *  lighting up close, the Phong lighting of the vertices
+ *  interpolated over the triangles (Gouraud) further away,
+ *  and one color worked out for the whole object on the
+ *  CPU from its ambient and diffuse light when it is only
+ *  a few pixels across.  The scene shader switches on the
+ *  level of the draw, which is the same for every pixel of
+ *  it, so the levels cost what a variant of the shader
+ *  would without changing programs between draws.
+ *
+ *  Every so often the fragment shader invocations of every
+ *  level are counted over one frame with pipeline
+ *  statistics queries, read back frames later when they
+ *  are ready, to estimate the fragment ALU cycles the
+ *  cheaper levels save.
+ ***********************************************************/
+class ShadingLODManager
+{
+public:
+	// the lighting of a draw; SHADING_LEVEL_* in the shaders
+	enum SHADING_LEVEL
+	{
+		SHADING_LEVEL_FULL = 0,
+		SHADING_LEVEL_VERTEX,
+		SHADING_LEVEL_FLAT,
+		SHADING_LEVEL_COUNT
+	};
+
+	// constructor
+	ShadingLODManager();
+	// destructor
+	~ShadingLODManager();
+
+	// turn the cheaper levels on or off; every draw is lit in
+	// full while they are off
+	void SetEnabled(bool bEnabled) { m_bEnabled = bEnabled; }
+	bool GetEnabled() const { return(m_bEnabled); }
+	// scale the sizes the levels switch at, larger switches to
+	// the cheaper levels sooner
+	void SetScale(float scale) { m_scale = scale; }
+	// the lights shaded per pixel
+	void SetLightCount(int lightCount) { m_lightCount = lightCount; }
+
+	// take the camera of this frame, read the counts of the last
+	// measured frame when they are ready and start measuring
+	// this one when it is time
+	void BeginFrame(ViewManager* pViewManager);
+	// the level of an object from the box its mesh fits in
+	SHADING_LEVEL SelectLevel(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+	// the light of the whole object for SHADING_LEVEL_FLAT
+	glm::vec3 CalcFlatLight(const LIGHTING_BLOCK& lighting, const MATERIAL_BLOCK& material, const glm::mat4& model) const;
+
+	// wrap the draw call of an object at a level, counted when
+	// the frame is measured
+	void BeginDraw(SHADING_LEVEL level);
+	void EndDraw();
+
+	// average fragment shader invocations per measured frame at a
+	// level, and the estimated fragment ALU cycles per frame the
+	// cheaper levels saved; 0 before a frame was measured
+	double GetFragmentsPerFrame(SHADING_LEVEL level) const;
+	double GetSavedCyclesPerFrame() const;
+
+private:
+	bool m_bEnabled;
+	float m_scale;
+	int m_lightCount;
+
+	// camera of this frame
+	ViewManager* m_pViewManager;
+	glm::vec3 m_cameraPosition;
+
+	// queries of the measured frame and the level of each draw
+	std::vector<GLuint> m_queries;
+	std::vector<int> m_queryLevels;
+	int m_queryCount;
+	bool m_bMeasuring;
+	bool m_bQueryOpen;
+	bool m_bPending;
+	// light count of the measured frame
+	int m_measuredLightCount;
+	long long m_frameIndex;
+
+	// totals over the measured frames
+	double m_fragments[SHADING_LEVEL_COUNT];
+	double m_savedCycles;
+	int m_measuredFrames;
+
+	// read the queries of the measured frame if all are ready
+	void ReadQueries();
+};
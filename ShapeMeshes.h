@@ -12,8 +12,14 @@
 
 #include <GL/glew.h>
 
+#include "VertexFormat.h"
+
 #include <glm/glm.hpp>
 
+#include <vector>
+
+class VertexPool;
+
 /***********************************************************
  *  ShapeMeshes
  *
@@ -25,6 +31,31 @@ class ShapeMeshes
 public:
 	// constructor
 	ShapeMeshes();
+	// destructor
+	~ShapeMeshes();
+
+	// identifiers for the available 3D shapes
+	enum ShapeType
+	{
+		SHAPE_BOX,
+		SHAPE_CONE,
+		SHAPE_CYLINDER,
+		SHAPE_PLANE,
+		SHAPE_PRISM,
+		SHAPE_PYRAMID3,
+		SHAPE_PYRAMID4,
+		SHAPE_SPHERE,
+		SHAPE_TAPERED_CYLINDER,
+		SHAPE_TORUS,
+		SHAPE_COUNT
+	};
+
+	// memory layout of every shape mesh vertex, also used
+	// to generate the vertex shader input declarations
+	typedef VertexFormat::Layout<
+		VertexFormat::Attribute<"inVertexPosition", 0, GLfloat, 3>,
+		VertexFormat::Attribute<"inVertexNormal", 1, GLfloat, 3>,
+		VertexFormat::Attribute<"inTextureCoordinate", 2, GLfloat, 2>> VertexLayout;
 
 private:
 
@@ -49,8 +80,20 @@ private:
 	GLMesh m_TaperedCylinderMesh;
 	GLMesh m_TorusMesh;
 
+	// meshes built at runtime from generated vertex data
+	std::vector<GLMesh> m_CustomMeshes;
+
 	bool m_bMemoryLayoutDone;
 
+	// tube radius the torus was last loaded with
+	float m_torusTubeRadius;
+
+	// every loaded mesh packed for vertex pulling, and the
+	// pool mesh of each shape and custom mesh (-1 if none)
+	VertexPool* m_pVertexPool;
+	int m_ShapePoolMeshes[SHAPE_COUNT];
+	std::vector<int> m_CustomPoolMeshes;
+
 public:
 	// methods for loading the shape mesh data 
 	// into memory
@@ -88,6 +131,45 @@ public:
 	void DrawHalfTorusMesh();
 	void DrawCubeMesh();
 
+	// draw the shape mesh for the passed in identifier
+	void DrawShapeMesh(ShapeType shape);
+
+	// read back the shape mesh as an interleaved triangle
+	// list (position, normal, uv) in object space
+	bool GetShapeTriangles(
+		ShapeType shape,
+		std::vector<GLfloat>& triangleVerts);
+	// read back the shape mesh vertices as stored, with the
+	// indices of the triangles they form
+	bool GetShapeIndexedTriangles(
+		ShapeType shape,
+		std::vector<GLfloat>& verts,
+		std::vector<GLuint>& indices);
+
+	// methods for loading, drawing and freeing meshes
+	// built from generated vertex data
+	int LoadCustomMesh(
+		const std::vector<GLfloat>& verts,
+		const std::vector<GLuint>& indices);
+	void DrawCustomMesh(int meshIndex);
+	int GetCustomMeshCount() { return((int)m_CustomMeshes.size()); }
+	// read back a custom mesh as vertices and triangle list indices
+	bool GetCustomMeshTriangles(
+		int meshIndex,
+		std::vector<GLfloat>& verts,
+		std::vector<GLuint>& indices);
+	void DestroyCustomMeshes();
+
+	// pack every loaded shape and custom mesh into the vertex
+	// pool, to be drawn without their vertex arrays
+	bool CreateVertexPool();
+	VertexPool* GetVertexPool() { return(m_pVertexPool); }
+	int GetShapePoolMesh(ShapeType shape);
+	int GetCustomMeshPoolMesh(int meshIndex);
+
+	// tube radius of the loaded torus, its main radius is 1
+	float GetTorusTubeRadius() const { return(m_torusTubeRadius); }
+
 
 private:
 
@@ -98,5 +180,8 @@ private:
 
 	// called to set the memory layout 
 	// template for shader data
-	void SetShaderMemoryLayout();
+	void SetShaderMemoryLayout(GLuint vertexBuffer);
+
+	// get the stored GL data for the passed in shape
+	GLMesh* GetShapeMesh(ShapeType shape);
 };
\ No newline at end of file
@@ -0,0 +1,637 @@
+///////////////////////////////////////////////////////////////////////////////
+// streamingmanager.cpp
+// ============
+// stream the cells of a chunked scene file in and out around the camera
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StreamingManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// scene file layout:
+	//   header      "SCNC", version, cell size, chunk count
+	//   chunk table one entry per cell: x, z, offset, size
+	//   chunks      object count, then the objects of the cell
+	const char g_SceneFileMagic[4] = { 'S', 'C', 'N', 'C' };
+	const uint32_t g_SceneFileVersion = 1;
+	const size_t g_ChunkEntrySize = sizeof(int32_t) * 2 + sizeof(uint64_t) + sizeof(uint32_t);
+
+	template <typename T>
+	void WriteValue(std::vector<char>& buffer, const T& value)
+	{
+		const char* bytes = reinterpret_cast<const char*>(&value);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+	void WriteString(std::vector<char>& buffer, const std::string& value)
+	{
+		WriteValue(buffer, (uint16_t)value.size());
+		buffer.insert(buffer.end(), value.begin(), value.end());
+	}
+
+	template <typename T>
+	bool ReadValue(const std::vector<char>& buffer, size_t& offset, T& value)
+	{
+		if (offset + sizeof(T) > buffer.size())
+		{
+			return(false);
+		}
+		memcpy(&value, &buffer[offset], sizeof(T));
+		offset += sizeof(T);
+		return(true);
+	}
+
+	bool ReadString(const std::vector<char>& buffer, size_t& offset, std::string& value)
+	{
+		uint16_t length = 0;
+		if ((ReadValue(buffer, offset, length) == false) || (offset + length > buffer.size()))
+		{
+			return(false);
+		}
+		value.assign(&buffer[offset], length);
+		offset += length;
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  StreamingManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StreamingManager::StreamingManager(AssetIO* pAssetIO)
+{
+	m_pAssetIO = pAssetIO;
+	m_cellSize = 16.0f;
+	m_loadRadius = 40.0f;
+	m_unloadRadius = 52.0f;
+	m_prefetchSeconds = 1.5f;
+	m_maxResidentCells = 64;
+	m_bStopLoader = false;
+}
+
+/***********************************************************
+ *  ~StreamingManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StreamingManager::~StreamingManager()
+{
+	CloseSceneFile();
+}
+
+/***********************************************************
+ *  WriteSceneFile()
+ *
+ *  This method is used for sorting the passed in objects
+ *  into grid cells by their position and writing each cell
+ *  as a separate chunk, so that a cell can be read without
+ *  touching the rest of the file.
+ ***********************************************************/
+bool StreamingManager::WriteSceneFile(
+	const char* filename,
+	const std::vector<SceneManager::SCENE_OBJECT>& objects,
+	float cellSize)
+{
+	// group the objects by the cell of their origin
+	std::map<CELL_KEY, std::vector<const SceneManager::SCENE_OBJECT*>> cells;
+	for (const SceneManager::SCENE_OBJECT& object : objects)
+	{
+		glm::vec3 position = glm::vec3(object.model[3]);
+		CELL_KEY cell((int)std::floor(position.x / cellSize), (int)std::floor(position.z / cellSize));
+		cells[cell].push_back(&object);
+	}
+
+	// serialize every chunk
+	std::vector<std::vector<char>> chunks;
+	for (auto& cell : cells)
+	{
+		std::vector<char> chunk;
+		WriteValue(chunk, (uint32_t)cell.second.size());
+		for (const SceneManager::SCENE_OBJECT* object : cell.second)
+		{
+			WriteValue(chunk, (int32_t)object->shape);
+			for (int column = 0; column < 4; column++)
+			{
+				for (int row = 0; row < 4; row++)
+				{
+					WriteValue(chunk, object->model[column][row]);
+				}
+			}
+			WriteValue(chunk, (uint8_t)(object->bUseTexture ? 1 : 0));
+			WriteValue(chunk, object->UVscale.x);
+			WriteValue(chunk, object->UVscale.y);
+			for (int i = 0; i < 4; i++)
+			{
+				WriteValue(chunk, object->color[i]);
+			}
+			WriteString(chunk, object->textureTag);
+			WriteString(chunk, object->materialTag);
+		}
+		chunks.push_back(chunk);
+	}
+
+	// header and chunk table
+	std::vector<char> header(g_SceneFileMagic, g_SceneFileMagic + 4);
+	WriteValue(header, g_SceneFileVersion);
+	WriteValue(header, cellSize);
+	WriteValue(header, (uint32_t)chunks.size());
+
+	uint64_t offset = header.size() + chunks.size() * g_ChunkEntrySize;
+	int chunkIndex = 0;
+	for (auto& cell : cells)
+	{
+		WriteValue(header, (int32_t)cell.first.first);
+		WriteValue(header, (int32_t)cell.first.second);
+		WriteValue(header, offset);
+		WriteValue(header, (uint32_t)chunks[chunkIndex].size());
+		offset += chunks[chunkIndex].size();
+		chunkIndex++;
+	}
+
+	std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "Could not write scene file:" << filename << std::endl;
+		return(false);
+	}
+	file.write(header.data(), header.size());
+	for (const std::vector<char>& chunk : chunks)
+	{
+		file.write(chunk.data(), chunk.size());
+	}
+
+	return(file.good());
+}
+
+/***********************************************************
+ *  OpenSceneFile()
+ *
+ *  This method is used for reading the chunk table of a
+ *  scene file and starting the loader thread.  No objects
+ *  are read until their cell is requested.  The table and
+ *  every chunk in it are checked against the length of the
+ *  file, so a damaged file is refused before anything is
+ *  allocated for it.
+ ***********************************************************/
+bool StreamingManager::OpenSceneFile(const char* filename)
+{
+	CloseSceneFile();
+
+	std::ifstream file(filename, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		return(false);
+	}
+
+	char magic[4] = { 0 };
+	uint32_t version = 0;
+	uint32_t chunkCount = 0;
+	file.read(magic, 4);
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	file.read(reinterpret_cast<char*>(&m_cellSize), sizeof(m_cellSize));
+	file.read(reinterpret_cast<char*>(&chunkCount), sizeof(chunkCount));
+	if (!file.good() || (memcmp(magic, g_SceneFileMagic, 4) != 0) || (version != g_SceneFileVersion) || (m_cellSize <= 0.0f))
+	{
+		std::cout << "Not a streamable scene file:" << filename << std::endl;
+		return(false);
+	}
+
+	std::streamoff tableStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	uint64_t fileSize = (uint64_t)file.tellg();
+	file.seekg(tableStart, std::ios::beg);
+	uint64_t tableSize = (uint64_t)chunkCount * g_ChunkEntrySize;
+	if ((tableStart < 0) || (tableSize > fileSize - (uint64_t)tableStart))
+	{
+		std::cout << "Scene file chunk table is truncated:" << filename << std::endl;
+		return(false);
+	}
+
+	std::vector<char> table((size_t)tableSize);
+	file.read(table.data(), table.size());
+	if ((size_t)file.gcount() != table.size())
+	{
+		std::cout << "Scene file chunk table is truncated:" << filename << std::endl;
+		return(false);
+	}
+	size_t offset = 0;
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		int32_t x = 0;
+		int32_t z = 0;
+		CHUNK_INFO chunk;
+		if (!(ReadValue(table, offset, x) && ReadValue(table, offset, z) &&
+			ReadValue(table, offset, chunk.offset) && ReadValue(table, offset, chunk.size)))
+		{
+			std::cout << "Scene file chunk table is truncated:" << filename << std::endl;
+			m_chunks.clear();
+			return(false);
+		}
+		if ((chunk.offset < (uint64_t)tableStart + tableSize) || (chunk.offset > fileSize) || (chunk.size > fileSize - chunk.offset))
+		{
+			std::cout << "Scene file chunk is outside the file:" << filename << ", cell:" << x << "," << z << std::endl;
+			m_chunks.clear();
+			return(false);
+		}
+		m_chunks[CELL_KEY(x, z)] = chunk;
+	}
+
+	m_filename = filename;
+	m_bStopLoader = false;
+	m_loaderThread = std::thread(&StreamingManager::LoaderThread, this);
+
+	std::cout << "Streaming scene file:" << filename << ", cells:" << m_chunks.size() << ", cell size:" << m_cellSize << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  CloseSceneFile()
+ *
+ *  This method is used for stopping the loader thread and
+ *  releasing every resident cell.
+ ***********************************************************/
+void StreamingManager::CloseSceneFile()
+{
+	if (m_loaderThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bStopLoader = true;
+		}
+		m_wakeLoader.notify_all();
+		m_loaderThread.join();
+	}
+
+	m_requests.clear();
+	m_completed.clear();
+	m_chunks.clear();
+	m_residentCells.clear();
+	m_pendingCells.clear();
+	m_filename.clear();
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for keeping the cells around the
+ *  camera, and around where the camera will be after the
+ *  prefetch time, resident.  Cells are only released once
+ *  they are further than the unload radius from both, so
+ *  a camera moving back and forth over a cell border does
+ *  not make the cell load and unload every frame.  When the
+ *  budget is full, a wanted cell is only loaded in place of
+ *  a resident cell that is further away, so the cells near
+ *  the camera are never traded for further ones.
+ ***********************************************************/
+void StreamingManager::Update(glm::vec3 cameraPosition, glm::vec3 cameraVelocity)
+{
+	if (m_chunks.size() == 0)
+	{
+		return;
+	}
+
+	glm::vec3 predictedPosition = cameraPosition + cameraVelocity * m_prefetchSeconds;
+
+	// collect the cells finished by the loader
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& loaded : m_completed)
+		{
+			// drop the result if the cell was released while loading
+			if (m_pendingCells.erase(loaded.first) > 0)
+			{
+				m_residentCells[loaded.first].swap(loaded.second);
+			}
+		}
+		m_completed.clear();
+	}
+
+	// release the cells that are far from the camera and its path
+	for (auto cell = m_residentCells.begin(); cell != m_residentCells.end(); )
+	{
+		float distance = std::min(GetCellDistance(cell->first, cameraPosition), GetCellDistance(cell->first, predictedPosition));
+		if (distance > m_unloadRadius)
+		{
+			cell = m_residentCells.erase(cell);
+		}
+		else
+		{
+			++cell;
+		}
+	}
+
+	// forget the requests that the camera has moved away from
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto cell = m_pendingCells.begin(); cell != m_pendingCells.end(); )
+		{
+			float distance = std::min(GetCellDistance(*cell, cameraPosition), GetCellDistance(*cell, predictedPosition));
+			if (distance > m_unloadRadius)
+			{
+				m_requests.erase(std::remove(m_requests.begin(), m_requests.end(), *cell), m_requests.end());
+				cell = m_pendingCells.erase(cell);
+			}
+			else
+			{
+				++cell;
+			}
+		}
+	}
+
+	// find the wanted cells, nearest to the camera or its path first
+	std::vector<std::pair<float, CELL_KEY>> wanted;
+	std::set<CELL_KEY> found;
+	int reach = (int)std::ceil(m_loadRadius / m_cellSize);
+	for (glm::vec3 center : { cameraPosition, predictedPosition })
+	{
+		CELL_KEY centerCell = GetCell(center);
+		for (int x = centerCell.first - reach; x <= centerCell.first + reach; x++)
+		{
+			for (int z = centerCell.second - reach; z <= centerCell.second + reach; z++)
+			{
+				CELL_KEY cell(x, z);
+				if ((GetCellDistance(cell, center) <= m_loadRadius) &&
+					(m_chunks.count(cell) > 0) &&
+					(m_residentCells.count(cell) == 0) &&
+					(m_pendingCells.count(cell) == 0) &&
+					(found.insert(cell).second == true))
+				{
+					float distance = std::min(GetCellDistance(cell, cameraPosition), GetCellDistance(cell, predictedPosition));
+					wanted.push_back(std::make_pair(distance, cell));
+				}
+			}
+		}
+	}
+	std::sort(wanted.begin(), wanted.end());
+
+	// the resident cells that can make room, furthest last
+	std::vector<std::pair<float, CELL_KEY>> evictable;
+	for (auto& cell : m_residentCells)
+	{
+		float distance = std::min(GetCellDistance(cell.first, cameraPosition), GetCellDistance(cell.first, predictedPosition));
+		evictable.push_back(std::make_pair(distance, cell.first));
+	}
+	std::sort(evictable.begin(), evictable.end());
+
+	// keep within the memory budget: request the nearest wanted
+	// cells while there is room, then only in place of a resident
+	// cell further away than the one requested
+	std::vector<CELL_KEY> requests;
+	for (auto& cell : wanted)
+	{
+		if (m_residentCells.size() + m_pendingCells.size() >= m_maxResidentCells)
+		{
+			if ((evictable.size() == 0) || (evictable.back().first <= cell.first))
+			{
+				break;
+			}
+			m_residentCells.erase(evictable.back().second);
+			evictable.pop_back();
+		}
+		m_pendingCells.insert(cell.second);
+		requests.push_back(cell.second);
+	}
+
+	if (requests.size() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (const CELL_KEY& request : requests)
+			{
+				m_requests.push_back(request);
+			}
+		}
+		m_wakeLoader.notify_one();
+	}
+}
+
+/***********************************************************
+ *  LoaderThread()
+ *
+ *  This method runs on the loader thread.  It reads and
+ *  parses the requested chunks and hands the objects back
+ *  to the render thread.  With an asset I/O backend every
+ *  waiting request is read in one batch, otherwise the
+ *  chunks are read one at a time with a blocking stream.
+ ***********************************************************/
+void StreamingManager::LoaderThread()
+{
+	std::ifstream file;
+	if (NULL == m_pAssetIO)
+	{
+		file.open(m_filename, std::ios::in | std::ios::binary);
+	}
+
+	while (true)
+	{
+		std::deque<CELL_KEY> cells;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeLoader.wait(lock, [this] { return m_bStopLoader || !m_requests.empty(); });
+			if (m_bStopLoader)
+			{
+				return;
+			}
+			if (NULL != m_pAssetIO)
+			{
+				cells.swap(m_requests);
+			}
+			else
+			{
+				cells.push_back(m_requests.front());
+				m_requests.pop_front();
+			}
+		}
+
+		if (NULL != m_pAssetIO)
+		{
+			ReadCellsAsync(cells);
+			continue;
+		}
+
+		CELL_KEY cell = cells.front();
+		std::vector<SceneManager::SCENE_OBJECT> objects;
+		auto chunk = m_chunks.find(cell);
+		if ((chunk != m_chunks.end()) && (ReadChunk(file, chunk->second, objects) == false))
+		{
+			std::cout << "Could not read scene cell:" << cell.first << "," << cell.second << std::endl;
+			file.clear();
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_completed.push_back(std::make_pair(cell, std::move(objects)));
+	}
+}
+
+/***********************************************************
+ *  ReadCellsAsync()
+ *
+ *  This method is used for queueing the range reads of a
+ *  batch of cells at once, so the I/O backend can submit
+ *  them together, and parsing each chunk on the loader
+ *  thread as soon as its data arrives.
+ ***********************************************************/
+void StreamingManager::ReadCellsAsync(const std::deque<CELL_KEY>& cells)
+{
+	std::mutex arrivedMutex;
+	std::condition_variable arrivedCondition;
+	std::vector<std::pair<CELL_KEY, std::vector<unsigned char>>> arrived;
+	size_t outstanding = 0;
+
+	for (const CELL_KEY& cell : cells)
+	{
+		auto chunk = m_chunks.find(cell);
+		if (chunk == m_chunks.end())
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_completed.push_back(std::make_pair(cell, std::vector<SceneManager::SCENE_OBJECT>()));
+			continue;
+		}
+
+		outstanding++;
+		m_pAssetIO->ReadAsync(m_filename, chunk->second.offset, chunk->second.size,
+			[cell, &arrivedMutex, &arrivedCondition, &arrived](std::vector<unsigned char>& data)
+		{
+			// notify under the lock, the condition lives on the loader's stack
+			std::lock_guard<std::mutex> lock(arrivedMutex);
+			arrived.push_back(std::make_pair(cell, std::move(data)));
+			arrivedCondition.notify_one();
+		});
+	}
+
+	while (outstanding > 0)
+	{
+		std::vector<std::pair<CELL_KEY, std::vector<unsigned char>>> ready;
+		{
+			std::unique_lock<std::mutex> lock(arrivedMutex);
+			arrivedCondition.wait(lock, [&arrived] { return !arrived.empty(); });
+			ready.swap(arrived);
+		}
+		outstanding -= ready.size();
+
+		for (auto& read : ready)
+		{
+			std::vector<SceneManager::SCENE_OBJECT> objects;
+			std::vector<char> buffer(read.second.begin(), read.second.end());
+			if ((buffer.size() != m_chunks.at(read.first).size) || (ParseChunk(buffer, objects) == false))
+			{
+				std::cout << "Could not read scene cell:" << read.first.first << "," << read.first.second << std::endl;
+				objects.clear();
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_completed.push_back(std::make_pair(read.first, std::move(objects)));
+		}
+	}
+}
+
+/***********************************************************
+ *  ReadChunk()
+ *
+ *  This method is used for reading one chunk and parsing
+ *  the objects stored in it.
+ ***********************************************************/
+bool StreamingManager::ReadChunk(
+	std::ifstream& file,
+	const CHUNK_INFO& chunk,
+	std::vector<SceneManager::SCENE_OBJECT>& objects)
+{
+	std::vector<char> buffer(chunk.size);
+	file.seekg(chunk.offset);
+	file.read(buffer.data(), buffer.size());
+	if (!file.good())
+	{
+		return(false);
+	}
+
+	return(ParseChunk(buffer, objects));
+}
+
+/***********************************************************
+ *  ParseChunk()
+ *
+ *  This method is used for parsing the objects stored in
+ *  a chunk that has already been read into memory.
+ ***********************************************************/
+bool StreamingManager::ParseChunk(
+	const std::vector<char>& buffer,
+	std::vector<SceneManager::SCENE_OBJECT>& objects)
+{
+	size_t offset = 0;
+	uint32_t objectCount = 0;
+	if (ReadValue(buffer, offset, objectCount) == false)
+	{
+		return(false);
+	}
+
+	objects.reserve(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		SceneManager::SCENE_OBJECT object;
+		int32_t shape = 0;
+		uint8_t bUseTexture = 0;
+		bool bRead = ReadValue(buffer, offset, shape);
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				bRead = bRead && ReadValue(buffer, offset, object.model[column][row]);
+			}
+		}
+		bRead = bRead && ReadValue(buffer, offset, bUseTexture);
+		bRead = bRead && ReadValue(buffer, offset, object.UVscale.x);
+		bRead = bRead && ReadValue(buffer, offset, object.UVscale.y);
+		for (int c = 0; c < 4; c++)
+		{
+			bRead = bRead && ReadValue(buffer, offset, object.color[c]);
+		}
+		bRead = bRead && ReadString(buffer, offset, object.textureTag);
+		bRead = bRead && ReadString(buffer, offset, object.materialTag);
+		if ((bRead == false) || (shape < 0) || (shape >= ShapeMeshes::SHAPE_COUNT))
+		{
+			return(false);
+		}
+
+		object.shape = (ShapeMeshes::ShapeType)shape;
+		object.bUseTexture = (bUseTexture != 0);
+		objects.push_back(object);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetCell()
+ *
+ *  This method is used for getting the grid cell that
+ *  contains the passed in world position.
+ ***********************************************************/
+StreamingManager::CELL_KEY StreamingManager::GetCell(glm::vec3 position)
+{
+	return(CELL_KEY((int)std::floor(position.x / m_cellSize), (int)std::floor(position.z / m_cellSize)));
+}
+
+/***********************************************************
+ *  GetCellDistance()
+ *
+ *  This method is used for getting the distance on the XZ
+ *  plane from a position to the nearest point of a cell.
+ ***********************************************************/
+float StreamingManager::GetCellDistance(const CELL_KEY& cell, glm::vec3 position)
+{
+	float minX = cell.first * m_cellSize;
+	float minZ = cell.second * m_cellSize;
+	float dx = std::max({ minX - position.x, 0.0f, position.x - (minX + m_cellSize) });
+	float dz = std::max({ minZ - position.z, 0.0f, position.z - (minZ + m_cellSize) });
+
+	return(std::sqrt(dx * dx + dz * dz));
+}
\ No newline at end of file
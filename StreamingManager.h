@@ -0,0 +1,118 @@
+///////////////////////////////////////////////////////////////////////////////
+// streamingmanager.h
+// ============
+// stream the cells of a chunked scene file in and out around the camera
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "AssetIO.h"
+#include "SceneManager.h"
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/***********************************************************
+ *  StreamingManager
+ *
+ *  This class keeps the grid cells of a chunked scene file
+ *  resident while they are near the camera.  Cells are read
+ *  and parsed on a worker thread, requested ahead of the
+ *  camera along its velocity, and released with hysteresis
+ *  so memory stays bounded however large the world is.
+ ***********************************************************/
+class StreamingManager
+{
+public:
+	// constructor, chunks are read through pAssetIO when passed
+	StreamingManager(AssetIO* pAssetIO = NULL);
+	// destructor
+	~StreamingManager();
+
+	// grid cell coordinates on the XZ plane
+	typedef std::pair<int, int> CELL_KEY;
+	typedef std::map<CELL_KEY, std::vector<SceneManager::SCENE_OBJECT>> CELL_MAP;
+
+	// write the objects into a scene file with one chunk per grid cell
+	static bool WriteSceneFile(
+		const char* filename,
+		const std::vector<SceneManager::SCENE_OBJECT>& objects,
+		float cellSize);
+
+	// open a chunked scene file and start the loader thread
+	bool OpenSceneFile(const char* filename);
+	// stop the loader thread and release every cell
+	void CloseSceneFile();
+
+	// request, collect and release cells for the camera state
+	void Update(glm::vec3 cameraPosition, glm::vec3 cameraVelocity);
+
+	// the cells that are currently loaded
+	const CELL_MAP& GetResidentCells() const { return m_residentCells; }
+
+private:
+	// location of one cell's chunk in the scene file
+	struct CHUNK_INFO
+	{
+		uint64_t offset;
+		uint32_t size;
+	};
+
+	// asynchronous range reads, NULL to read with a blocking stream
+	AssetIO* m_pAssetIO;
+
+	// the open scene file
+	std::string m_filename;
+	float m_cellSize;
+	std::map<CELL_KEY, CHUNK_INFO> m_chunks;
+
+	// cells that are loaded, or waiting for the loader
+	CELL_MAP m_residentCells;
+	std::set<CELL_KEY> m_pendingCells;
+
+	// radius around the camera that must be resident
+	float m_loadRadius;
+	// cells are only released beyond this radius
+	float m_unloadRadius;
+	// seconds of camera movement to prefetch ahead
+	float m_prefetchSeconds;
+	// hard limit on the number of resident cells
+	size_t m_maxResidentCells;
+
+	// loader thread state, guarded by m_mutex
+	std::thread m_loaderThread;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeLoader;
+	std::deque<CELL_KEY> m_requests;
+	std::vector<std::pair<CELL_KEY, std::vector<SceneManager::SCENE_OBJECT>>> m_completed;
+	bool m_bStopLoader;
+
+	// loader thread main loop
+	void LoaderThread();
+	// read a batch of cells with one submission through m_pAssetIO
+	void ReadCellsAsync(const std::deque<CELL_KEY>& cells);
+	// read and parse the objects of one chunk
+	static bool ReadChunk(
+		std::ifstream& file,
+		const CHUNK_INFO& chunk,
+		std::vector<SceneManager::SCENE_OBJECT>& objects);
+	// parse the objects of a chunk already in memory
+	static bool ParseChunk(
+		const std::vector<char>& buffer,
+		std::vector<SceneManager::SCENE_OBJECT>& objects);
+
+	// get the cell that contains a world position
+	CELL_KEY GetCell(glm::vec3 position);
+	// get the distance on the XZ plane from a position to a cell
+	float GetCellDistance(const CELL_KEY& cell, glm::vec3 position);
+};
\ No newline at end of file
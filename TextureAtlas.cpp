@@ -0,0 +1,471 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureatlas.cpp
+// ============
+// pack small textures into one mip-safe texture atlas
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+// declaration of global variables
+namespace
+{
+	/***********************************************************
+	 *  AddressTexel()
+	 *
+	 *  Map a texel index outside of 0..size-1 back inside,
+	 *  wrapping around or clamping to the edge.
+	 ***********************************************************/
+	int AddressTexel(int index, int size, bool bRepeat)
+	{
+		if (bRepeat == true)
+		{
+			return(((index % size) + size) % size);
+		}
+		return(std::min(std::max(index, 0), size - 1));
+	}
+
+	/***********************************************************
+	 *  ConvertToRGBA()
+	 *
+	 *  Expand gray, gray alpha or RGB texels to RGBA.
+	 ***********************************************************/
+	void ConvertToRGBA(const unsigned char* source, size_t texels, int colorChannels, unsigned char* destination)
+	{
+		for (size_t i = 0; i < texels; i++)
+		{
+			const unsigned char* src = source + i * colorChannels;
+			unsigned char* dst = destination + i * 4;
+			if (colorChannels <= 2)
+			{
+				dst[0] = dst[1] = dst[2] = src[0];
+				dst[3] = (colorChannels == 2) ? src[1] : 255;
+			}
+			else
+			{
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+				dst[3] = (colorChannels == 4) ? src[3] : 255;
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  ResampleRGBA()
+	 *
+	 *  Bilinear resize of an RGBA image, used to stretch images
+	 *  that are not a multiple of the gutter in size.
+	 ***********************************************************/
+	void ResampleRGBA(
+		const std::vector<unsigned char>& source,
+		int sourceWidth,
+		int sourceHeight,
+		int width,
+		int height,
+		bool bRepeat,
+		std::vector<unsigned char>& destination)
+	{
+		destination.resize((size_t)width * height * 4);
+		float scaleX = (float)sourceWidth / (float)width;
+		float scaleY = (float)sourceHeight / (float)height;
+		for (int y = 0; y < height; y++)
+		{
+			float v = (y + 0.5f) * scaleY - 0.5f;
+			int y0 = (int)std::floor(v);
+			float fy = v - y0;
+			int row0 = AddressTexel(y0, sourceHeight, bRepeat);
+			int row1 = AddressTexel(y0 + 1, sourceHeight, bRepeat);
+			for (int x = 0; x < width; x++)
+			{
+				float u = (x + 0.5f) * scaleX - 0.5f;
+				int x0 = (int)std::floor(u);
+				float fx = u - x0;
+				int column0 = AddressTexel(x0, sourceWidth, bRepeat);
+				int column1 = AddressTexel(x0 + 1, sourceWidth, bRepeat);
+				for (int c = 0; c < 4; c++)
+				{
+					float top = source[((size_t)row0 * sourceWidth + column0) * 4 + c] * (1.0f - fx) +
+						source[((size_t)row0 * sourceWidth + column1) * 4 + c] * fx;
+					float bottom = source[((size_t)row1 * sourceWidth + column0) * 4 + c] * (1.0f - fx) +
+						source[((size_t)row1 * sourceWidth + column1) * 4 + c] * fx;
+					destination[((size_t)y * width + x) * 4 + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  TextureAtlas()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureAtlas::TextureAtlas()
+{
+	m_gutter = 32;
+	m_maxSize = 4096;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  GetLevelCount()
+ *
+ *  This method is used for getting the number of atlas
+ *  levels that still have a gutter of at least one texel.
+ ***********************************************************/
+int TextureAtlas::GetLevelCount() const
+{
+	int levelCount = 1;
+	for (int gutter = m_gutter; gutter > 1; gutter >>= 1)
+	{
+		levelCount++;
+	}
+	return(levelCount);
+}
+
+/***********************************************************
+ *  AddImage()
+ *
+ *  This method is used for queueing an image for the atlas.
+ *  The image is converted to RGBA and, when its size is not
+ *  a multiple of the gutter, stretched up to the next one so
+ *  it stays aligned on every atlas level.  The cooked mips
+ *  are reused when they line up; otherwise the mips are
+ *  built again with the addressing the region is sampled
+ *  with.  It returns the region index, or -1 for an empty
+ *  image.
+ ***********************************************************/
+int TextureAtlas::AddImage(const MipGenerator::MIP_CHAIN& chain, bool bRepeat)
+{
+	if (chain.levels.size() == 0)
+	{
+		return(-1);
+	}
+
+	const MipGenerator::MIP_LEVEL& top = chain.levels[0];
+	int levelCount = GetLevelCount();
+	int width = ((top.width + m_gutter - 1) / m_gutter) * m_gutter;
+	int height = ((top.height + m_gutter - 1) / m_gutter) * m_gutter;
+
+	ATLAS_IMAGE image;
+	image.bRepeat = bRepeat;
+	image.chain.colorChannels = 4;
+
+	// the cooked chain was filtered with wrapping, so it only
+	// fits repeating images
+	bool bReuseMips = (bRepeat == true) && (width == top.width) && (height == top.height) &&
+		((int)chain.levels.size() >= levelCount);
+	if (bReuseMips == true)
+	{
+		size_t offset = 0;
+		for (int level = 0; level < levelCount; level++)
+		{
+			const MipGenerator::MIP_LEVEL& mip = chain.levels[level];
+			size_t texels = (size_t)mip.width * mip.height;
+			image.chain.levels.push_back({ mip.width, mip.height, offset });
+			image.chain.pixels.resize(offset + texels * 4);
+			ConvertToRGBA(chain.pixels.data() + mip.offset, texels, chain.colorChannels, image.chain.pixels.data() + offset);
+			offset += texels * 4;
+		}
+	}
+	else
+	{
+		std::vector<unsigned char> pixels((size_t)top.width * top.height * 4);
+		ConvertToRGBA(chain.pixels.data() + top.offset, (size_t)top.width * top.height, chain.colorChannels, pixels.data());
+		if ((width != top.width) || (height != top.height))
+		{
+			std::vector<unsigned char> resized;
+			ResampleRGBA(pixels, top.width, top.height, width, height, bRepeat, resized);
+			pixels.swap(resized);
+		}
+
+		MipGenerator mipGenerator;
+		mipGenerator.SetWrap(bRepeat);
+		mipGenerator.Generate(pixels.data(), width, height, 4, image.chain);
+
+		// keep only the levels the atlas has
+		const MipGenerator::MIP_LEVEL& last = image.chain.levels[levelCount - 1];
+		image.chain.pixels.resize(last.offset + (size_t)last.width * last.height * 4);
+		image.chain.levels.resize(levelCount);
+	}
+
+	m_images.push_back(std::move(image));
+	m_regions.push_back({ 0, 0, width, height, bRepeat });
+
+	return((int)m_images.size() - 1);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for forgetting the queued images.
+ ***********************************************************/
+void TextureAtlas::Clear()
+{
+	m_images.clear();
+	m_regions.clear();
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  PackImages()
+ *
+ *  This method is used for placing every queued image, with
+ *  its gutter on each side, in an atlas of the given size
+ *  using MaxRects.  The free space is kept as the list of
+ *  maximal free rectangles; each image goes in the one that
+ *  leaves the least space on its shorter side, then every
+ *  free rectangle it overlaps is split around it.  Sizes are
+ *  in gutter sized blocks, which keeps everything aligned.
+ ***********************************************************/
+bool TextureAtlas::PackImages(int widthBlocks, int heightBlocks, std::vector<BLOCK_RECT>& placed) const
+{
+	std::vector<BLOCK_RECT> sizes(m_images.size());
+	for (size_t i = 0; i < m_regions.size(); i++)
+	{
+		sizes[i] = { 0, 0, m_regions[i].width / m_gutter + 2, m_regions[i].height / m_gutter + 2 };
+	}
+
+	// place the largest images first
+	std::vector<int> order(m_images.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&sizes](int a, int b)
+	{
+		int sideA = std::max(sizes[a].width, sizes[a].height);
+		int sideB = std::max(sizes[b].width, sizes[b].height);
+		if (sideA != sideB)
+		{
+			return(sideA > sideB);
+		}
+		return(sizes[a].width * sizes[a].height > sizes[b].width * sizes[b].height);
+	});
+
+	auto contains = [](const BLOCK_RECT& outer, const BLOCK_RECT& inner)
+	{
+		return((inner.x >= outer.x) && (inner.y >= outer.y) &&
+			(inner.x + inner.width <= outer.x + outer.width) &&
+			(inner.y + inner.height <= outer.y + outer.height));
+	};
+
+	placed.assign(m_images.size(), { 0, 0, 0, 0 });
+	std::vector<BLOCK_RECT> freeRects = { { 0, 0, widthBlocks, heightBlocks } };
+	std::vector<BLOCK_RECT> splitRects;
+	for (int index : order)
+	{
+		int width = sizes[index].width;
+		int height = sizes[index].height;
+
+		// best short side fit
+		int best = -1;
+		int bestShortSide = INT_MAX;
+		int bestLongSide = INT_MAX;
+		for (int i = 0; i < (int)freeRects.size(); i++)
+		{
+			if ((freeRects[i].width < width) || (freeRects[i].height < height))
+			{
+				continue;
+			}
+			int leftoverX = freeRects[i].width - width;
+			int leftoverY = freeRects[i].height - height;
+			int shortSide = std::min(leftoverX, leftoverY);
+			int longSide = std::max(leftoverX, leftoverY);
+			if ((shortSide < bestShortSide) || ((shortSide == bestShortSide) && (longSide < bestLongSide)))
+			{
+				best = i;
+				bestShortSide = shortSide;
+				bestLongSide = longSide;
+			}
+		}
+		if (best < 0)
+		{
+			return(false);
+		}
+
+		BLOCK_RECT used = { freeRects[best].x, freeRects[best].y, width, height };
+		placed[index] = used;
+
+		// split the free rectangles the image overlaps into the
+		// (up to four) maximal rectangles around it
+		splitRects.clear();
+		for (const BLOCK_RECT& free : freeRects)
+		{
+			if ((used.x >= free.x + free.width) || (used.x + used.width <= free.x) ||
+				(used.y >= free.y + free.height) || (used.y + used.height <= free.y))
+			{
+				splitRects.push_back(free);
+				continue;
+			}
+			if (used.x > free.x)
+			{
+				splitRects.push_back({ free.x, free.y, used.x - free.x, free.height });
+			}
+			if (used.x + used.width < free.x + free.width)
+			{
+				splitRects.push_back({ used.x + used.width, free.y, free.x + free.width - used.x - used.width, free.height });
+			}
+			if (used.y > free.y)
+			{
+				splitRects.push_back({ free.x, free.y, free.width, used.y - free.y });
+			}
+			if (used.y + used.height < free.y + free.height)
+			{
+				splitRects.push_back({ free.x, used.y + used.height, free.width, free.y + free.height - used.y - used.height });
+			}
+		}
+
+		// drop the rectangles inside another one, keeping the
+		// first of two equal ones
+		freeRects.clear();
+		for (size_t i = 0; i < splitRects.size(); i++)
+		{
+			bool bContained = false;
+			for (size_t j = 0; (j < splitRects.size()) && (bContained == false); j++)
+			{
+				if ((i != j) && contains(splitRects[j], splitRects[i]))
+				{
+					bContained = (contains(splitRects[i], splitRects[j]) == false) || (j < i);
+				}
+			}
+			if (bContained == false)
+			{
+				freeRects.push_back(splitRects[i]);
+			}
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  CopyRegion()
+ *
+ *  This method is used for copying one mip level of an
+ *  image into the same level of the atlas, filling the
+ *  gutter around it with wrapped or clamped texels.
+ ***********************************************************/
+void TextureAtlas::CopyRegion(
+	const ATLAS_IMAGE& image,
+	const ATLAS_REGION& region,
+	int level,
+	unsigned char* atlasPixels,
+	int atlasWidth) const
+{
+	const MipGenerator::MIP_LEVEL& mip = image.chain.levels[level];
+	const unsigned char* source = image.chain.pixels.data() + mip.offset;
+	int gutter = m_gutter >> level;
+	int originX = region.x >> level;
+	int originY = region.y >> level;
+
+	for (int y = -gutter; y < mip.height + gutter; y++)
+	{
+		int sourceY = AddressTexel(y, mip.height, image.bRepeat);
+		unsigned char* destination = atlasPixels + ((size_t)(originY + y) * atlasWidth + originX - gutter) * 4;
+		for (int x = -gutter; x < mip.width + gutter; x++)
+		{
+			int sourceX = AddressTexel(x, mip.width, image.bRepeat);
+			memcpy(destination, source + ((size_t)sourceY * mip.width + sourceX) * 4, 4);
+			destination += 4;
+		}
+	}
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for packing the queued images into
+ *  the smallest power of two atlas that holds them, growing
+ *  the shorter side until they fit, and composing every
+ *  atlas level from the levels of the images.  It returns
+ *  false when the images do not fit in the maximum size.
+ ***********************************************************/
+bool TextureAtlas::Build(MipGenerator::MIP_CHAIN& atlas)
+{
+	atlas.colorChannels = 4;
+	atlas.levels.clear();
+	atlas.pixels.clear();
+	m_width = 0;
+	m_height = 0;
+
+	if (m_images.size() == 0)
+	{
+		return(false);
+	}
+
+	// start from the smallest square with room for every image
+	size_t area = 0;
+	int largest = 0;
+	for (const ATLAS_REGION& region : m_regions)
+	{
+		int width = region.width + 2 * m_gutter;
+		int height = region.height + 2 * m_gutter;
+		area += (size_t)width * height;
+		largest = std::max(largest, std::max(width, height));
+	}
+	int size = m_gutter;
+	while (((size_t)size * size < area) || (size < largest))
+	{
+		size *= 2;
+	}
+
+	int width = size;
+	int height = size;
+	std::vector<BLOCK_RECT> placed;
+	bool bPacked = false;
+	while ((bPacked == false) && (width <= m_maxSize) && (height <= m_maxSize))
+	{
+		bPacked = PackImages(width / m_gutter, height / m_gutter, placed);
+		if (bPacked == false)
+		{
+			if (width <= height)
+			{
+				width *= 2;
+			}
+			else
+			{
+				height *= 2;
+			}
+		}
+	}
+	if (bPacked == false)
+	{
+		return(false);
+	}
+
+	m_width = width;
+	m_height = height;
+	for (size_t i = 0; i < m_regions.size(); i++)
+	{
+		m_regions[i].x = (placed[i].x + 1) * m_gutter;
+		m_regions[i].y = (placed[i].y + 1) * m_gutter;
+	}
+
+	int levelCount = GetLevelCount();
+	size_t offset = 0;
+	for (int level = 0; level < levelCount; level++)
+	{
+		MipGenerator::MIP_LEVEL mip = { m_width >> level, m_height >> level, offset };
+		atlas.levels.push_back(mip);
+		offset += (size_t)mip.width * mip.height * 4;
+	}
+	atlas.pixels.assign(offset, 0);
+
+	for (int level = 0; level < levelCount; level++)
+	{
+		unsigned char* levelPixels = atlas.pixels.data() + atlas.levels[level].offset;
+		for (size_t i = 0; i < m_images.size(); i++)
+		{
+			CopyRegion(m_images[i], m_regions[i], level, levelPixels, atlas.levels[level].width);
+		}
+	}
+
+	return(true);
+}
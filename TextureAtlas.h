@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureatlas.h
+// ============
+// pack small textures into one mip-safe texture atlas
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MipGenerator.h"
+
+#include <vector>
+
+/***********************************************************
+ *  TextureAtlas
+ *
+ *  This class packs several small textures into one, so
+ *  objects with different textures can share a single
+ *  texture binding.  Images are placed with a MaxRects
+ *  packer (best short side fit) and each one is surrounded
+ *  by a gutter.  The gutter is filled per mip level from
+ *  the image's own mips, wrapped around for repeating images
+ *  and clamped to the edge for the others, so filtering at
+ *  the edge of a region never reads a neighbour.
+ *
+ *  Regions start and end on multiples of the gutter, which
+ *  keeps them texel aligned down to the level where the
+ *  gutter is one texel wide; the atlas stops at that level.
+ *  Repeating images are tiled by the fragment shader, which
+ *  wraps the UVs inside the region.
+ ***********************************************************/
+class TextureAtlas
+{
+public:
+	// constructor
+	TextureAtlas();
+
+	// where an image was placed, in level 0 texels, without its gutter
+	struct ATLAS_REGION
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+		bool bRepeat;
+	};
+
+	// queue an image with its mip chain, returns its region index
+	int AddImage(const MipGenerator::MIP_CHAIN& chain, bool bRepeat);
+	// pack the queued images into an RGBA mip chain, false if they do not fit
+	bool Build(MipGenerator::MIP_CHAIN& atlas);
+	// forget the queued images
+	void Clear();
+
+	int GetImageCount() const { return (int)m_images.size(); }
+	const ATLAS_REGION& GetRegion(int index) const { return m_regions[index]; }
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+
+	// gutter around every image, a power of two, set before adding images
+	void SetGutter(int texels) { m_gutter = texels; }
+	// the largest atlas width or height
+	void SetMaxSize(int texels) { m_maxSize = texels; }
+
+private:
+	int m_gutter;
+	int m_maxSize;
+	int m_width;
+	int m_height;
+
+	// a queued image, RGBA and rounded up to a multiple of the gutter
+	struct ATLAS_IMAGE
+	{
+		MipGenerator::MIP_CHAIN chain;
+		bool bRepeat;
+	};
+	std::vector<ATLAS_IMAGE> m_images;
+	std::vector<ATLAS_REGION> m_regions;
+
+	// a rectangle in gutter sized blocks
+	struct BLOCK_RECT
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+
+	// the levels kept in the atlas for the current gutter
+	int GetLevelCount() const;
+	// place every image (with its gutter) in an atlas of the given blocks
+	bool PackImages(int widthBlocks, int heightBlocks, std::vector<BLOCK_RECT>& placed) const;
+	// copy one level of an image and its gutter into an atlas level
+	void CopyRegion(
+		const ATLAS_IMAGE& image,
+		const ATLAS_REGION& region,
+		int level,
+		unsigned char* atlasPixels,
+		int atlasWidth) const;
+};
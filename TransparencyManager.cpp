@@ -0,0 +1,217 @@
+///////////////////////////////////////////////////////////////////////////////
+// transparencymanager.cpp
+// ============
+// weighted blended order-independent transparency over the scene target
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransparencyManager.h"
+
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	const char* g_CompositeVertexShader = "../../Utilities/shaders/fullscreenVertexShader.glsl";
+	const char* g_CompositeFragmentShader = "../../Utilities/shaders/oitCompositeFragmentShader.glsl";
+
+	// the composite samplers use the units after the 16 scene
+	// texture slots, so the scene bindings are left alone
+	const GLuint g_AccumTextureUnit = 16;
+	const GLuint g_RevealTextureUnit = 17;
+	const GLuint g_AccumTextureMSUnit = 18;
+	const GLuint g_RevealTextureMSUnit = 19;
+}
+
+/***********************************************************
+ *  TransparencyManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TransparencyManager::TransparencyManager(DerivedDataCache* pDerivedDataCache)
+{
+	m_pCompositeShader = new ShaderManager();
+	m_pCompositeShader->m_programID = 0;
+	m_pCompositeShader->m_pDerivedDataCache = pDerivedDataCache;
+	m_compositeVAO = 0;
+	m_bShaderLoaded = false;
+	m_framebuffer = 0;
+	m_accumTexture = 0;
+	m_revealTexture = 0;
+	m_width = 0;
+	m_height = 0;
+	m_samples = 0;
+}
+
+/***********************************************************
+ *  ~TransparencyManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TransparencyManager::~TransparencyManager()
+{
+	DestroyTargets();
+	if (m_compositeVAO != 0)
+	{
+		glDeleteVertexArrays(1, &m_compositeVAO);
+		m_compositeVAO = 0;
+	}
+	if (m_pCompositeShader->m_programID != 0)
+	{
+		glDeleteProgram(m_pCompositeShader->m_programID);
+	}
+	delete m_pCompositeShader;
+	m_pCompositeShader = NULL;
+}
+
+/***********************************************************
+ *  CreateTargets()
+ *
+ *  This method is used for creating the accumulation
+ *  target, with half float color to hold the weighted sums,
+ *  and the revealage target.  They are multisampled like
+ *  the scene target, so its depth can be attached.
+ ***********************************************************/
+void TransparencyManager::CreateTargets(int width, int height, int samples)
+{
+	DestroyTargets();
+
+	if (samples > 1)
+	{
+		glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &m_accumTexture);
+		glTextureStorage2DMultisample(m_accumTexture, samples, GL_RGBA16F, width, height, GL_TRUE);
+		glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &m_revealTexture);
+		glTextureStorage2DMultisample(m_revealTexture, samples, GL_R16F, width, height, GL_TRUE);
+	}
+	else
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_accumTexture);
+		glTextureStorage2D(m_accumTexture, 1, GL_RGBA16F, width, height);
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_revealTexture);
+		glTextureStorage2D(m_revealTexture, 1, GL_R16F, width, height);
+	}
+
+	glCreateFramebuffers(1, &m_framebuffer);
+	glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_accumTexture, 0);
+	glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT1, m_revealTexture, 0);
+	const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glNamedFramebufferDrawBuffers(m_framebuffer, 2, drawBuffers);
+
+	m_width = width;
+	m_height = height;
+	m_samples = samples;
+}
+
+/***********************************************************
+ *  DestroyTargets()
+ ***********************************************************/
+void TransparencyManager::DestroyTargets()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	GLuint textures[2] = { m_accumTexture, m_revealTexture };
+	glDeleteTextures(2, textures);
+	m_accumTexture = 0;
+	m_revealTexture = 0;
+	m_width = 0;
+	m_height = 0;
+	m_samples = 0;
+}
+
+/***********************************************************
+ *  BeginTransparency()
+ *
+ *  This method is used for preparing the translucent draws.
+ *  The targets follow the size of the scene target, and its
+ *  current depth texture is attached every frame since the
+ *  scene target is recreated when the render scale changes.
+ *  The accumulation target is cleared to 0 and adds every
+ *  surface, the revealage target is cleared to 1 and is
+ *  multiplied by 1 - alpha of every surface.  Depth is
+ *  tested but not written, so no surface hides another.
+ ***********************************************************/
+bool TransparencyManager::BeginTransparency(ViewManager* pViewManager)
+{
+	if ((NULL == pViewManager) || (pViewManager->GetSceneFramebuffer() == 0))
+	{
+		return(false);
+	}
+
+	if (m_bShaderLoaded == false)
+	{
+		m_bShaderLoaded = true;
+		m_pCompositeShader->LoadShaders(g_CompositeVertexShader, g_CompositeFragmentShader);
+		glCreateVertexArrays(1, &m_compositeVAO);
+	}
+	if (m_pCompositeShader->m_programID == 0)
+	{
+		return(false);
+	}
+
+	int width = pViewManager->GetSceneWidth();
+	int height = pViewManager->GetSceneHeight();
+	int samples = pViewManager->GetSceneSamples();
+	if ((m_framebuffer == 0) || (width != m_width) || (height != m_height) || (samples != m_samples))
+	{
+		CreateTargets(width, height, samples);
+	}
+	glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_ATTACHMENT, pViewManager->GetSceneDepthTexture(), 0);
+	if (glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Could not create the transparency targets, blending in draw order" << std::endl;
+		DestroyTargets();
+		glDeleteProgram(m_pCompositeShader->m_programID);
+		m_pCompositeShader->m_programID = 0;
+		return(false);
+	}
+
+	const GLfloat accumClear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat revealClear[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glClearNamedFramebufferfv(m_framebuffer, GL_COLOR, 0, accumClear);
+	glClearNamedFramebufferfv(m_framebuffer, GL_COLOR, 1, revealClear);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+	glBlendFunci(0, GL_ONE, GL_ONE);
+	glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+	return(true);
+}
+
+/***********************************************************
+ *  EndTransparency()
+ *
+ *  This method is used for drawing one full screen triangle
+ *  over the scene target that divides the accumulated color
+ *  by the accumulated weight and blends it with the scene
+ *  behind by the revealage.  The caller makes its own shader
+ *  program current again afterwards.
+ ***********************************************************/
+void TransparencyManager::EndTransparency(ViewManager* pViewManager)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, pViewManager->GetSceneFramebuffer());
+	glDisable(GL_DEPTH_TEST);
+	glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+
+	m_pCompositeShader->use();
+	bool bMultisample = (m_samples > 1);
+	m_pCompositeShader->setBoolValue("bMultisample", bMultisample);
+	m_pCompositeShader->setSampler2DValue("accumTexture", g_AccumTextureUnit);
+	m_pCompositeShader->setSampler2DValue("revealTexture", g_RevealTextureUnit);
+	m_pCompositeShader->setSampler2DValue("accumTextureMS", g_AccumTextureMSUnit);
+	m_pCompositeShader->setSampler2DValue("revealTextureMS", g_RevealTextureMSUnit);
+	glBindTextureUnit(bMultisample ? g_AccumTextureMSUnit : g_AccumTextureUnit, m_accumTexture);
+	glBindTextureUnit(bMultisample ? g_RevealTextureMSUnit : g_RevealTextureUnit, m_revealTexture);
+
+	glBindVertexArray(m_compositeVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	// back to the opaque render state set up by the view manager
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+}
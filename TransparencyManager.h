@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// transparencymanager.h
+// ============
+// weighted blended order-independent transparency over the scene target
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "ShaderManager.h"
+#include "ViewManager.h"
+
+/***********************************************************
+ *  TransparencyManager
+ *
+ *  This class draws translucent surfaces without sorting
+ *  them.  They are drawn after the opaque objects into an
+ *  accumulation target, which sums their premultiplied
+ *  colors weighted by depth, and a revealage target, which
+ *  multiplies how much of the background each one lets
+ *  through.  Both share the depth of the scene target, so
+ *  opaque objects still hide them.  One full screen pass
+ *  then blends the weighted average over the scene.
+ ***********************************************************/
+class TransparencyManager
+{
+public:
+	// constructor, the composite program binary is cached in
+	// pDerivedDataCache when passed
+	TransparencyManager(DerivedDataCache* pDerivedDataCache = NULL);
+	// destructor
+	~TransparencyManager();
+
+	// bind the transparency targets over the scene depth and set
+	// the blending for the translucent draws; false when there is
+	// no scene target to share, so they must be blended in order
+	bool BeginTransparency(ViewManager* pViewManager);
+	// blend the translucent surfaces over the scene target and
+	// restore the opaque render state
+	void EndTransparency(ViewManager* pViewManager);
+
+private:
+	// composite shader program and its empty vertex array
+	ShaderManager* m_pCompositeShader;
+	GLuint m_compositeVAO;
+	bool m_bShaderLoaded;
+
+	// accumulation and revealage targets
+	GLuint m_framebuffer;
+	GLuint m_accumTexture;
+	GLuint m_revealTexture;
+	int m_width;
+	int m_height;
+	int m_samples;
+
+	// create the targets at the size and samples of the scene target
+	void CreateTargets(int width, int height, int samples);
+	// free the targets
+	void DestroyTargets();
+};
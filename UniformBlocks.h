@@ -0,0 +1,513 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformblocks.h
+// ============
+// C++ mirrors of the shader uniform blocks, with their std140 / std430
+// layouts checked at compile time
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+
+/***********************************************************
+ *  UniformLayout
+ *
+ *  The std140 and std430 layout rules, evaluated by the
+ *  compiler.  A Struct<> lists the GLSL member types of a
+ *  block or struct in declaration order and gives back the
+ *  offset of every member and the padded size, which the
+ *  C++ mirror structs are then checked against.
+ ***********************************************************/
+namespace UniformLayout
+{
+	enum Packing
+	{
+		STD140,
+		STD430
+	};
+
+	// base size and alignment of the GLSL scalar and vector types
+	template <typename T> struct Member;
+	template <> struct Member<GLfloat> { static constexpr size_t size = 4; static constexpr size_t alignment = 4; };
+	template <> struct Member<GLint> { static constexpr size_t size = 4; static constexpr size_t alignment = 4; };
+	template <> struct Member<GLuint> { static constexpr size_t size = 4; static constexpr size_t alignment = 4; };
+	template <> struct Member<glm::vec2> { static constexpr size_t size = 8; static constexpr size_t alignment = 8; };
+	template <> struct Member<glm::vec3> { static constexpr size_t size = 12; static constexpr size_t alignment = 16; };
+	template <> struct Member<glm::ivec3> { static constexpr size_t size = 12; static constexpr size_t alignment = 16; };
+	template <> struct Member<glm::vec4> { static constexpr size_t size = 16; static constexpr size_t alignment = 16; };
+	template <> struct Member<glm::mat4> { static constexpr size_t size = 64; static constexpr size_t alignment = 16; };
+
+	constexpr size_t RoundUp(size_t value, size_t alignment)
+	{
+		return(((value + alignment - 1) / alignment) * alignment);
+	}
+
+	/***********************************************************
+	 *  Struct
+	 *
+	 *  Layout of a GLSL struct or block.  A Struct<> can be a
+	 *  member of another Struct<>, and Array<> wraps a member
+	 *  type into a fixed size array.
+	 ***********************************************************/
+	template <Packing P, typename... Members>
+	struct Struct;
+
+	template <typename T, size_t Count>
+	struct Array;
+
+	// the size / alignment of a member under a packing rule
+	template <Packing P, typename T>
+	struct Rules
+	{
+		static constexpr size_t size = Member<T>::size;
+		static constexpr size_t alignment = Member<T>::alignment;
+	};
+
+	template <Packing P, Packing Q, typename... Members>
+	struct Rules<P, Struct<Q, Members...>>
+	{
+		static_assert(P == Q, "nested structs must use the packing of their block");
+		static constexpr size_t size = Struct<Q, Members...>::size;
+		static constexpr size_t alignment = Struct<Q, Members...>::alignment;
+	};
+
+	template <Packing P, typename T, size_t Count>
+	struct Rules<P, Array<T, Count>>
+	{
+		// std140 rounds array elements up to a vec4
+		static constexpr size_t stride = (P == STD140)
+			? RoundUp(Rules<P, T>::size, RoundUp(Rules<P, T>::alignment, 16))
+			: RoundUp(Rules<P, T>::size, Rules<P, T>::alignment);
+		static constexpr size_t size = stride * Count;
+		static constexpr size_t alignment = (P == STD140) ? RoundUp(Rules<P, T>::alignment, 16) : Rules<P, T>::alignment;
+	};
+
+	template <Packing P, typename... Members>
+	struct Struct
+	{
+		static constexpr size_t count = sizeof...(Members);
+
+		// std140 rounds struct alignment up to a vec4
+		static constexpr size_t alignment = []()
+		{
+			size_t result = 1;
+			((result = (Rules<P, Members>::alignment > result) ? Rules<P, Members>::alignment : result), ...);
+			return((P == STD140) ? RoundUp(result, 16) : result);
+		}();
+
+		// the byte offset of every member
+		static constexpr std::array<size_t, count> offsets = []()
+		{
+			std::array<size_t, count> result = {};
+			size_t cursor = 0;
+			size_t index = 0;
+			((cursor = RoundUp(cursor, Rules<P, Members>::alignment),
+				result[index++] = cursor,
+				cursor += Rules<P, Members>::size), ...);
+			return(result);
+		}();
+
+		// the size including the padding at the end
+		static constexpr size_t size = []()
+		{
+			size_t cursor = 0;
+			((cursor = RoundUp(cursor, Rules<P, Members>::alignment) + Rules<P, Members>::size), ...);
+			return(RoundUp(cursor, alignment));
+		}();
+	};
+}
+
+/***********************************************************
+ *  Uniform block bindings and mirror structs
+ *
+ *  These must match the blocks declared in the fragment
+ *  shader.  The static_asserts check the C++ structs against
+ *  the std140 rules, and SceneManager checks them against
+ *  the linked program's reflection data at startup, so a
+ *  whole block can be uploaded with one buffer update.
+ ***********************************************************/
+const GLuint MATERIAL_BLOCK_BINDING = 1;
+const GLuint LIGHTING_BLOCK_BINDING = 2;
+const GLuint AREA_LIGHTING_BLOCK_BINDING = 3;
+const GLuint VOXEL_GI_BLOCK_BINDING = 4;
+const GLuint SDF_SHADOW_BLOCK_BINDING = 5;
+const int TOTAL_LIGHTS = 4;
+const int TOTAL_AREA_LIGHTS = 4;
+const int VOXEL_CLIP_LEVELS = 4;
+
+// GLSL: struct Material (in uniform block MaterialBlock)
+struct MATERIAL_BLOCK
+{
+	glm::vec3 ambientColor;
+	float ambientStrength;
+	glm::vec3 diffuseColor;
+	float reflectionCutoff;
+	glm::vec3 specularColor;
+	float shininess;
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD140,
+	glm::vec3, GLfloat, glm::vec3, GLfloat, glm::vec3, GLfloat> MATERIAL_LAYOUT;
+
+static_assert(offsetof(MATERIAL_BLOCK, ambientColor) == MATERIAL_LAYOUT::offsets[0], "Material.ambientColor offset");
+static_assert(offsetof(MATERIAL_BLOCK, ambientStrength) == MATERIAL_LAYOUT::offsets[1], "Material.ambientStrength offset");
+static_assert(offsetof(MATERIAL_BLOCK, diffuseColor) == MATERIAL_LAYOUT::offsets[2], "Material.diffuseColor offset");
+static_assert(offsetof(MATERIAL_BLOCK, reflectionCutoff) == MATERIAL_LAYOUT::offsets[3], "Material.reflectionCutoff offset");
+static_assert(offsetof(MATERIAL_BLOCK, specularColor) == MATERIAL_LAYOUT::offsets[4], "Material.specularColor offset");
+static_assert(offsetof(MATERIAL_BLOCK, shininess) == MATERIAL_LAYOUT::offsets[5], "Material.shininess offset");
+static_assert(sizeof(MATERIAL_BLOCK) == MATERIAL_LAYOUT::size, "Material size");
+
+// GLSL: struct LightSource
+struct LIGHT_SOURCE_BLOCK
+{
+	glm::vec3 position;
+	float padding0;
+	glm::vec3 ambientColor;
+	float padding1;
+	glm::vec3 diffuseColor;
+	float padding2;
+	glm::vec3 specularColor;
+	float focalStrength;
+	float specularIntensity;
+	float padding3[3];
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD140,
+	glm::vec3, glm::vec3, glm::vec3, glm::vec3, GLfloat, GLfloat> LIGHT_SOURCE_LAYOUT;
+
+static_assert(offsetof(LIGHT_SOURCE_BLOCK, position) == LIGHT_SOURCE_LAYOUT::offsets[0], "LightSource.position offset");
+static_assert(offsetof(LIGHT_SOURCE_BLOCK, ambientColor) == LIGHT_SOURCE_LAYOUT::offsets[1], "LightSource.ambientColor offset");
+static_assert(offsetof(LIGHT_SOURCE_BLOCK, diffuseColor) == LIGHT_SOURCE_LAYOUT::offsets[2], "LightSource.diffuseColor offset");
+static_assert(offsetof(LIGHT_SOURCE_BLOCK, specularColor) == LIGHT_SOURCE_LAYOUT::offsets[3], "LightSource.specularColor offset");
+static_assert(offsetof(LIGHT_SOURCE_BLOCK, focalStrength) == LIGHT_SOURCE_LAYOUT::offsets[4], "LightSource.focalStrength offset");
+static_assert(offsetof(LIGHT_SOURCE_BLOCK, specularIntensity) == LIGHT_SOURCE_LAYOUT::offsets[5], "LightSource.specularIntensity offset");
+static_assert(sizeof(LIGHT_SOURCE_BLOCK) == LIGHT_SOURCE_LAYOUT::size, "LightSource size");
+
+// GLSL: uniform block LightingBlock
+struct LIGHTING_BLOCK
+{
+	LIGHT_SOURCE_BLOCK lightSources[TOTAL_LIGHTS];
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD140,
+	UniformLayout::Array<LIGHT_SOURCE_LAYOUT, TOTAL_LIGHTS>> LIGHTING_LAYOUT;
+
+static_assert(sizeof(LIGHTING_BLOCK) == LIGHTING_LAYOUT::size, "LightingBlock size");
+
+// shapes of the area lights
+const GLint AREA_LIGHT_RECT = 0;
+const GLint AREA_LIGHT_DISK = 1;
+
+// GLSL: struct AreaLight
+struct AREA_LIGHT_BLOCK
+{
+	glm::vec3 center;
+	GLint type;
+	glm::vec3 right;
+	GLint bTwoSided;
+	glm::vec3 up;
+	float padding0;
+	glm::vec3 color;
+	float intensity;
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD140,
+	glm::vec3, GLint, glm::vec3, GLint, glm::vec3, glm::vec3, GLfloat> AREA_LIGHT_LAYOUT;
+
+static_assert(offsetof(AREA_LIGHT_BLOCK, center) == AREA_LIGHT_LAYOUT::offsets[0], "AreaLight.center offset");
+static_assert(offsetof(AREA_LIGHT_BLOCK, type) == AREA_LIGHT_LAYOUT::offsets[1], "AreaLight.type offset");
+static_assert(offsetof(AREA_LIGHT_BLOCK, right) == AREA_LIGHT_LAYOUT::offsets[2], "AreaLight.right offset");
+static_assert(offsetof(AREA_LIGHT_BLOCK, bTwoSided) == AREA_LIGHT_LAYOUT::offsets[3], "AreaLight.bTwoSided offset");
+static_assert(offsetof(AREA_LIGHT_BLOCK, up) == AREA_LIGHT_LAYOUT::offsets[4], "AreaLight.up offset");
+static_assert(offsetof(AREA_LIGHT_BLOCK, color) == AREA_LIGHT_LAYOUT::offsets[5], "AreaLight.color offset");
+static_assert(offsetof(AREA_LIGHT_BLOCK, intensity) == AREA_LIGHT_LAYOUT::offsets[6], "AreaLight.intensity offset");
+static_assert(sizeof(AREA_LIGHT_BLOCK) == AREA_LIGHT_LAYOUT::size, "AreaLight size");
+
+// GLSL: uniform block AreaLightingBlock
+struct AREA_LIGHTING_BLOCK
+{
+	AREA_LIGHT_BLOCK areaLights[TOTAL_AREA_LIGHTS];
+	GLint areaLightCount;
+	GLint padding0[3];
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD140,
+	UniformLayout::Array<AREA_LIGHT_LAYOUT, TOTAL_AREA_LIGHTS>, GLint> AREA_LIGHTING_LAYOUT;
+
+static_assert(offsetof(AREA_LIGHTING_BLOCK, areaLightCount) == AREA_LIGHTING_LAYOUT::offsets[1], "AreaLightingBlock.areaLightCount offset");
+static_assert(sizeof(AREA_LIGHTING_BLOCK) == AREA_LIGHTING_LAYOUT::size, "AreaLightingBlock size");
+
+// GLSL: uniform block VoxelGIBlock
+struct VOXEL_GI_BLOCK
+{
+	// world position of the lowest corner of each clip level,
+	// and its voxel size in w
+	glm::vec4 voxelLevelOrigins[VOXEL_CLIP_LEVELS];
+	GLint bVoxelGI;
+	// voxels along each side of a clip level
+	GLint voxelResolution;
+	float voxelDiffuseStrength;
+	float voxelSpecularStrength;
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD140,
+	UniformLayout::Array<glm::vec4, VOXEL_CLIP_LEVELS>, GLint, GLint, GLfloat, GLfloat> VOXEL_GI_LAYOUT;
+
+static_assert(offsetof(VOXEL_GI_BLOCK, bVoxelGI) == VOXEL_GI_LAYOUT::offsets[1], "VoxelGIBlock.bVoxelGI offset");
+static_assert(offsetof(VOXEL_GI_BLOCK, voxelResolution) == VOXEL_GI_LAYOUT::offsets[2], "VoxelGIBlock.voxelResolution offset");
+static_assert(offsetof(VOXEL_GI_BLOCK, voxelDiffuseStrength) == VOXEL_GI_LAYOUT::offsets[3], "VoxelGIBlock.voxelDiffuseStrength offset");
+static_assert(offsetof(VOXEL_GI_BLOCK, voxelSpecularStrength) == VOXEL_GI_LAYOUT::offsets[4], "VoxelGIBlock.voxelSpecularStrength offset");
+static_assert(sizeof(VOXEL_GI_BLOCK) == VOXEL_GI_LAYOUT::size, "VoxelGIBlock size");
+
+// GLSL: uniform block SDFShadowBlock
+struct SDF_SHADOW_BLOCK
+{
+	// world position of the lowest corner of the primitive grid
+	// and the side of its cells
+	glm::vec3 sdfGridOrigin;
+	float sdfCellSize;
+	// cells along each axis
+	glm::ivec3 sdfGridSize;
+	// a cell lists every primitive nearer than this to it, so
+	// distances are exact up to it and clamped past it
+	float sdfReach;
+	GLint bSDFShadows;
+	GLint bSDFOcclusion;
+	// penumbra sharpness, and how far the shadow rays march
+	float sdfShadowSoftness;
+	float sdfShadowDistance;
+	// how far from the surface the occlusion is sampled
+	float sdfOcclusionDistance;
+	float padding0[3];
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD140,
+	glm::vec3, GLfloat, glm::ivec3, GLfloat, GLint, GLint, GLfloat, GLfloat, GLfloat> SDF_SHADOW_LAYOUT;
+
+static_assert(offsetof(SDF_SHADOW_BLOCK, sdfCellSize) == SDF_SHADOW_LAYOUT::offsets[1], "SDFShadowBlock.sdfCellSize offset");
+static_assert(offsetof(SDF_SHADOW_BLOCK, sdfGridSize) == SDF_SHADOW_LAYOUT::offsets[2], "SDFShadowBlock.sdfGridSize offset");
+static_assert(offsetof(SDF_SHADOW_BLOCK, sdfReach) == SDF_SHADOW_LAYOUT::offsets[3], "SDFShadowBlock.sdfReach offset");
+static_assert(offsetof(SDF_SHADOW_BLOCK, bSDFShadows) == SDF_SHADOW_LAYOUT::offsets[4], "SDFShadowBlock.bSDFShadows offset");
+static_assert(offsetof(SDF_SHADOW_BLOCK, bSDFOcclusion) == SDF_SHADOW_LAYOUT::offsets[5], "SDFShadowBlock.bSDFOcclusion offset");
+static_assert(offsetof(SDF_SHADOW_BLOCK, sdfShadowSoftness) == SDF_SHADOW_LAYOUT::offsets[6], "SDFShadowBlock.sdfShadowSoftness offset");
+static_assert(offsetof(SDF_SHADOW_BLOCK, sdfShadowDistance) == SDF_SHADOW_LAYOUT::offsets[7], "SDFShadowBlock.sdfShadowDistance offset");
+static_assert(offsetof(SDF_SHADOW_BLOCK, sdfOcclusionDistance) == SDF_SHADOW_LAYOUT::offsets[8], "SDFShadowBlock.sdfOcclusionDistance offset");
+static_assert(sizeof(SDF_SHADOW_BLOCK) == SDF_SHADOW_LAYOUT::size, "SDFShadowBlock size");
+
+/***********************************************************
+ *  Shader storage blocks
+ *
+ *  These must match the buffers declared by
+ *  VertexPool::GLSLDeclaration(),
+ *  ShadingCacheManager::GLSLDeclaration(), the visibility,
+ *  voxel and ray shadow shaders and the fragment shader,
+ *  and use the std430 rules.
+ ***********************************************************/
+const GLuint VERTEX_POOL_POSITION_BINDING = 0;
+const GLuint VISIBILITY_DRAW_BINDING = 1;
+const GLuint VERTEX_POOL_INDEX_BINDING = 2;
+const GLuint VERTEX_POOL_MESH_BINDING = 3;
+const GLuint VERTEX_POOL_ATTRIBUTE_BINDING = 4;
+const GLuint VOXEL_DRAW_BINDING = 5;
+const GLuint RAY_SHADOW_OBJECT_BINDING = 6;
+const GLuint RAY_SHADOW_TRIANGLE_BINDING = 7;
+const GLuint RAY_SHADOW_NODE_BINDING = 8;
+const GLuint RAY_SHADOW_SOURCE_BINDING = 9;
+const GLuint SDF_PRIMITIVE_BINDING = 10;
+const GLuint SDF_GRID_BINDING = 11;
+const GLuint SHADING_CACHE_OBJECT_BINDING = 12;
+const GLuint SHADING_CACHE_BINDING = 13;
+
+// GLSL: struct PoolMesh, where a mesh of the vertex pool is and how it is stored
+struct POOL_MESH_BLOCK
+{
+	// the compressed format stores positions relative to these
+	glm::vec4 boundsMin;
+	glm::vec4 boundsExtent;
+	// first word of the vertices in the position stream and in
+	// the stream of the other attributes
+	GLuint firstPositionWord;
+	GLuint firstAttributeWord;
+	GLuint format;
+	// first index and number of indices in the index buffer
+	GLuint firstIndex;
+	GLuint indexCount;
+	GLuint padding0[3];
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD430,
+	glm::vec4, glm::vec4, GLuint, GLuint, GLuint, GLuint, GLuint> POOL_MESH_LAYOUT;
+
+static_assert(offsetof(POOL_MESH_BLOCK, boundsMin) == POOL_MESH_LAYOUT::offsets[0], "PoolMesh.boundsMin offset");
+static_assert(offsetof(POOL_MESH_BLOCK, boundsExtent) == POOL_MESH_LAYOUT::offsets[1], "PoolMesh.boundsExtent offset");
+static_assert(offsetof(POOL_MESH_BLOCK, firstPositionWord) == POOL_MESH_LAYOUT::offsets[2], "PoolMesh.firstPositionWord offset");
+static_assert(offsetof(POOL_MESH_BLOCK, firstAttributeWord) == POOL_MESH_LAYOUT::offsets[3], "PoolMesh.firstAttributeWord offset");
+static_assert(offsetof(POOL_MESH_BLOCK, format) == POOL_MESH_LAYOUT::offsets[4], "PoolMesh.format offset");
+static_assert(offsetof(POOL_MESH_BLOCK, firstIndex) == POOL_MESH_LAYOUT::offsets[5], "PoolMesh.firstIndex offset");
+static_assert(offsetof(POOL_MESH_BLOCK, indexCount) == POOL_MESH_LAYOUT::offsets[6], "PoolMesh.indexCount offset");
+static_assert(sizeof(POOL_MESH_BLOCK) == POOL_MESH_LAYOUT::size, "PoolMesh size");
+
+typedef UniformLayout::Struct<UniformLayout::STD430,
+	glm::vec3, GLfloat, glm::vec3, GLfloat, glm::vec3, GLfloat> MATERIAL_STORAGE_LAYOUT;
+
+// GLSL: struct VisibilityDraw, one per object drawn into the visibility buffer
+struct VISIBILITY_DRAW_BLOCK
+{
+	glm::mat4 model;
+	// inverse transpose of the model matrix, in the upper 3x3
+	glm::mat4 normalMatrix;
+	MATERIAL_BLOCK material;
+	glm::vec4 color;
+	glm::vec4 atlasRect;
+	glm::vec2 UVscale;
+	// scene texture unit, -1 for the flat color
+	GLint textureSlot;
+	GLint bAtlasRepeat;
+	// mesh of the vertex pool that is drawn
+	GLuint mesh;
+	// shading cache record of the mesh's first triangle, -1 when
+	// the object is not cached
+	GLint cacheTriangles;
+	GLuint padding0[2];
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD430,
+	glm::mat4, glm::mat4, MATERIAL_STORAGE_LAYOUT, glm::vec4, glm::vec4, glm::vec2, GLint, GLint, GLuint, GLint> VISIBILITY_DRAW_LAYOUT;
+
+static_assert(offsetof(VISIBILITY_DRAW_BLOCK, model) == VISIBILITY_DRAW_LAYOUT::offsets[0], "VisibilityDraw.model offset");
+static_assert(offsetof(VISIBILITY_DRAW_BLOCK, normalMatrix) == VISIBILITY_DRAW_LAYOUT::offsets[1], "VisibilityDraw.normalMatrix offset");
+static_assert(offsetof(VISIBILITY_DRAW_BLOCK, material) == VISIBILITY_DRAW_LAYOUT::offsets[2], "VisibilityDraw.material offset");
+static_assert(sizeof(MATERIAL_BLOCK) == MATERIAL_STORAGE_LAYOUT::size, "VisibilityDraw.material size");
+static_assert(offsetof(VISIBILITY_DRAW_BLOCK, color) == VISIBILITY_DRAW_LAYOUT::offsets[3], "VisibilityDraw.color offset");
+static_assert(offsetof(VISIBILITY_DRAW_BLOCK, atlasRect) == VISIBILITY_DRAW_LAYOUT::offsets[4], "VisibilityDraw.atlasRect offset");
+static_assert(offsetof(VISIBILITY_DRAW_BLOCK, UVscale) == VISIBILITY_DRAW_LAYOUT::offsets[5], "VisibilityDraw.UVscale offset");
+static_assert(offsetof(VISIBILITY_DRAW_BLOCK, textureSlot) == VISIBILITY_DRAW_LAYOUT::offsets[6], "VisibilityDraw.textureSlot offset");
+static_assert(offsetof(VISIBILITY_DRAW_BLOCK, bAtlasRepeat) == VISIBILITY_DRAW_LAYOUT::offsets[7], "VisibilityDraw.bAtlasRepeat offset");
+static_assert(offsetof(VISIBILITY_DRAW_BLOCK, mesh) == VISIBILITY_DRAW_LAYOUT::offsets[8], "VisibilityDraw.mesh offset");
+static_assert(offsetof(VISIBILITY_DRAW_BLOCK, cacheTriangles) == VISIBILITY_DRAW_LAYOUT::offsets[9], "VisibilityDraw.cacheTriangles offset");
+static_assert(sizeof(VISIBILITY_DRAW_BLOCK) == VISIBILITY_DRAW_LAYOUT::size, "VisibilityDraw size");
+
+// GLSL: struct VoxelDraw, one per object voxelized into the clipmap
+struct VOXEL_DRAW_BLOCK
+{
+	glm::mat4 model;
+	// inverse transpose of the model matrix, in the upper 3x3
+	glm::mat4 normalMatrix;
+	// diffuse reflectance the voxels take, alpha unused
+	glm::vec4 albedo;
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD430,
+	glm::mat4, glm::mat4, glm::vec4> VOXEL_DRAW_LAYOUT;
+
+static_assert(offsetof(VOXEL_DRAW_BLOCK, normalMatrix) == VOXEL_DRAW_LAYOUT::offsets[1], "VoxelDraw.normalMatrix offset");
+static_assert(offsetof(VOXEL_DRAW_BLOCK, albedo) == VOXEL_DRAW_LAYOUT::offsets[2], "VoxelDraw.albedo offset");
+static_assert(sizeof(VOXEL_DRAW_BLOCK) == VOXEL_DRAW_LAYOUT::size, "VoxelDraw size");
+
+// GLSL: struct ShadowObject, one per shadow caster of the ray traced shadows
+struct RAY_SHADOW_OBJECT_BLOCK
+{
+	glm::mat4 model;
+	// mesh of the vertex pool its triangles are read from
+	GLuint poolMesh;
+	GLuint padding0[3];
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD430,
+	glm::mat4, GLuint> RAY_SHADOW_OBJECT_LAYOUT;
+
+static_assert(offsetof(RAY_SHADOW_OBJECT_BLOCK, poolMesh) == RAY_SHADOW_OBJECT_LAYOUT::offsets[1], "ShadowObject.poolMesh offset");
+static_assert(sizeof(RAY_SHADOW_OBJECT_BLOCK) == RAY_SHADOW_OBJECT_LAYOUT::size, "ShadowObject size");
+
+// GLSL: struct BVHNode, one node of the ray traced shadows' BVH
+struct BVH_NODE_BLOCK
+{
+	glm::vec3 boundsMin;
+	// the first child for an inner node, the second follows it;
+	// the first triangle for a leaf
+	GLuint first;
+	glm::vec3 boundsMax;
+	// triangles of a leaf, 0 for an inner node
+	GLuint count;
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD430,
+	glm::vec3, GLuint, glm::vec3, GLuint> BVH_NODE_LAYOUT;
+
+static_assert(offsetof(BVH_NODE_BLOCK, first) == BVH_NODE_LAYOUT::offsets[1], "BVHNode.first offset");
+static_assert(offsetof(BVH_NODE_BLOCK, boundsMax) == BVH_NODE_LAYOUT::offsets[2], "BVHNode.boundsMax offset");
+static_assert(offsetof(BVH_NODE_BLOCK, count) == BVH_NODE_LAYOUT::offsets[3], "BVHNode.count offset");
+static_assert(sizeof(BVH_NODE_BLOCK) == BVH_NODE_LAYOUT::size, "BVHNode size");
+
+// GLSL: struct SDFPrimitive, one per shape of the analytic shadows
+struct SDF_PRIMITIVE_BLOCK
+{
+	// inverse of the model matrix, into the space of the shape mesh
+	glm::mat4 worldToLocal;
+	// ShapeMeshes::ShapeType of the shape
+	GLuint shape;
+	// smallest scale of the model matrix; a local distance times
+	// this never exceeds the world distance
+	float scale;
+	// tube radius of a torus
+	float parameter;
+	float padding0;
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD430,
+	glm::mat4, GLuint, GLfloat, GLfloat> SDF_PRIMITIVE_LAYOUT;
+
+static_assert(offsetof(SDF_PRIMITIVE_BLOCK, shape) == SDF_PRIMITIVE_LAYOUT::offsets[1], "SDFPrimitive.shape offset");
+static_assert(offsetof(SDF_PRIMITIVE_BLOCK, scale) == SDF_PRIMITIVE_LAYOUT::offsets[2], "SDFPrimitive.scale offset");
+static_assert(offsetof(SDF_PRIMITIVE_BLOCK, parameter) == SDF_PRIMITIVE_LAYOUT::offsets[3], "SDFPrimitive.parameter offset");
+static_assert(sizeof(SDF_PRIMITIVE_BLOCK) == SDF_PRIMITIVE_LAYOUT::size, "SDFPrimitive size");
+
+// GLSL: struct ShadingCacheObject, one per object of the shading cache
+struct SHADING_CACHE_OBJECT_BLOCK
+{
+	glm::mat4 model;
+	// inverse transpose of the model matrix, in the upper 3x3
+	glm::mat4 normalMatrix;
+	MATERIAL_BLOCK material;
+	// mesh of the vertex pool its triangles are read from
+	GLuint mesh;
+	GLuint padding0[3];
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD430,
+	glm::mat4, glm::mat4, MATERIAL_STORAGE_LAYOUT, GLuint> SHADING_CACHE_OBJECT_LAYOUT;
+
+static_assert(offsetof(SHADING_CACHE_OBJECT_BLOCK, normalMatrix) == SHADING_CACHE_OBJECT_LAYOUT::offsets[1], "ShadingCacheObject.normalMatrix offset");
+static_assert(offsetof(SHADING_CACHE_OBJECT_BLOCK, material) == SHADING_CACHE_OBJECT_LAYOUT::offsets[2], "ShadingCacheObject.material offset");
+static_assert(offsetof(SHADING_CACHE_OBJECT_BLOCK, mesh) == SHADING_CACHE_OBJECT_LAYOUT::offsets[3], "ShadingCacheObject.mesh offset");
+static_assert(sizeof(SHADING_CACHE_OBJECT_BLOCK) == SHADING_CACHE_OBJECT_LAYOUT::size, "ShadingCacheObject size");
+
+// GLSL: struct ShadingCacheTriangle, one per triangle of a cached object,
+// declared by ShadingCacheManager::GLSLDeclaration()
+struct SHADING_CACHE_TRIANGLE_BLOCK
+{
+	// lowest corner of its block in the atlas, x in the low 16 bits
+	GLuint origin;
+	// edge divisions of the texel lattice over the triangle
+	GLuint divisions;
+	GLuint object;
+	// triangle of the object's pool mesh
+	GLuint meshTriangle;
+	// frame the texels were last shaded in, 0 for never
+	GLuint stamp;
+	// 1 while the triangle waits in the request list
+	GLuint requested;
+};
+
+typedef UniformLayout::Struct<UniformLayout::STD430,
+	GLuint, GLuint, GLuint, GLuint, GLuint, GLuint> SHADING_CACHE_TRIANGLE_LAYOUT;
+
+static_assert(offsetof(SHADING_CACHE_TRIANGLE_BLOCK, stamp) == SHADING_CACHE_TRIANGLE_LAYOUT::offsets[4], "ShadingCacheTriangle.stamp offset");
+static_assert(offsetof(SHADING_CACHE_TRIANGLE_BLOCK, requested) == SHADING_CACHE_TRIANGLE_LAYOUT::offsets[5], "ShadingCacheTriangle.requested offset");
+static_assert(sizeof(SHADING_CACHE_TRIANGLE_BLOCK) == SHADING_CACHE_TRIANGLE_LAYOUT::size, "ShadingCacheTriangle size");
\ No newline at end of file
@@ -0,0 +1,327 @@
+///////////////////////////////////////////////////////////////////////////////
+// vertexformat.h
+// ============
+// compile-time description of a vertex memory layout, used to set up the
+// vertex attributes and to generate the matching GLSL input declarations
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+/***********************************************************
+ *  VertexFormat
+ *
+ *  A layout is a list of typed attributes.  From that list
+ *  the compiler works out the offsets and the stride of
+ *  every buffer binding, and builds the GLSL "in" lines for
+ *  the vertex shader, so the C++ data, the attribute setup
+ *  and the shader inputs all come from one description.
+ ***********************************************************/
+namespace VertexFormat
+{
+	/***********************************************************
+	 *  FixedString
+	 *
+	 *  A string literal that can be passed as a template
+	 *  argument, used for the shader input names.
+	 ***********************************************************/
+	template <std::size_t N>
+	struct FixedString
+	{
+		char text[N] = {};
+
+		constexpr FixedString(const char (&str)[N])
+		{
+			for (std::size_t i = 0; i < N; i++)
+			{
+				text[i] = str[i];
+			}
+		}
+
+		constexpr std::size_t Length() const { return N - 1; }
+	};
+
+	/***********************************************************
+	 *  ComponentType
+	 *
+	 *  The GL type enum of a C++ component type, and how the
+	 *  component shows up in the shader when not normalized.
+	 ***********************************************************/
+	template <typename T> struct ComponentType;
+
+	template <> struct ComponentType<GLfloat>
+	{
+		static constexpr GLenum Type = GL_FLOAT;
+		static constexpr bool Integer = false;
+		static constexpr bool Signed = true;
+	};
+	template <> struct ComponentType<GLbyte>
+	{
+		static constexpr GLenum Type = GL_BYTE;
+		static constexpr bool Integer = true;
+		static constexpr bool Signed = true;
+	};
+	template <> struct ComponentType<GLubyte>
+	{
+		static constexpr GLenum Type = GL_UNSIGNED_BYTE;
+		static constexpr bool Integer = true;
+		static constexpr bool Signed = false;
+	};
+	template <> struct ComponentType<GLshort>
+	{
+		static constexpr GLenum Type = GL_SHORT;
+		static constexpr bool Integer = true;
+		static constexpr bool Signed = true;
+	};
+	template <> struct ComponentType<GLushort>
+	{
+		static constexpr GLenum Type = GL_UNSIGNED_SHORT;
+		static constexpr bool Integer = true;
+		static constexpr bool Signed = false;
+	};
+	template <> struct ComponentType<GLint>
+	{
+		static constexpr GLenum Type = GL_INT;
+		static constexpr bool Integer = true;
+		static constexpr bool Signed = true;
+	};
+	template <> struct ComponentType<GLuint>
+	{
+		static constexpr GLenum Type = GL_UNSIGNED_INT;
+		static constexpr bool Integer = true;
+		static constexpr bool Signed = false;
+	};
+
+	/***********************************************************
+	 *  Attribute
+	 *
+	 *  One vertex attribute: its shader input name, location,
+	 *  component type and count, whether integer components
+	 *  are normalized to [0, 1] / [-1, 1], and which buffer
+	 *  binding it is read from.  Integer components that are
+	 *  not normalized reach the shader as int / uint vectors.
+	 ***********************************************************/
+	template <
+		FixedString Name,
+		GLuint Location,
+		typename T,
+		GLint Components,
+		bool Normalized = false,
+		GLuint Binding = 0>
+	struct Attribute
+	{
+		static_assert(Components >= 1 && Components <= 4, "an attribute has 1 to 4 components");
+		static_assert(!Normalized || ComponentType<T>::Integer, "only integer components can be normalized");
+
+		typedef T COMPONENT;
+
+		static constexpr FixedString name = Name;
+		static constexpr GLuint location = Location;
+		static constexpr GLenum type = ComponentType<T>::Type;
+		static constexpr GLint components = Components;
+		static constexpr bool normalized = Normalized;
+		static constexpr GLuint binding = Binding;
+		static constexpr GLuint size = sizeof(T) * Components;
+		static constexpr bool integerInShader = ComponentType<T>::Integer && !Normalized;
+
+		// the GLSL type the shader declares for this input
+		static constexpr const char* GLSLType()
+		{
+			constexpr const char* floatTypes[] = { "float", "vec2", "vec3", "vec4" };
+			constexpr const char* intTypes[] = { "int", "ivec2", "ivec3", "ivec4" };
+			constexpr const char* uintTypes[] = { "uint", "uvec2", "uvec3", "uvec4" };
+			if (!integerInShader)
+			{
+				return(floatTypes[Components - 1]);
+			}
+			return(ComponentType<T>::Signed ? intTypes[Components - 1] : uintTypes[Components - 1]);
+		}
+	};
+
+	/***********************************************************
+	 *  Layout helpers
+	 *
+	 *  Free functions so they can be used from the static
+	 *  members and checks inside Layout.
+	 ***********************************************************/
+	template <typename... Attributes>
+	constexpr GLuint BindingStride(GLuint binding)
+	{
+		GLuint stride = 0;
+		((stride += (Attributes::binding == binding) ? Attributes::size : 0), ...);
+		return(stride);
+	}
+
+	template <typename... Attributes>
+	constexpr bool UniqueLocations()
+	{
+		constexpr GLuint locations[] = { Attributes::location... };
+		for (std::size_t i = 0; i < sizeof...(Attributes); i++)
+		{
+			for (std::size_t j = i + 1; j < sizeof...(Attributes); j++)
+			{
+				if (locations[i] == locations[j])
+				{
+					return(false);
+				}
+			}
+		}
+		return(true);
+	}
+
+	constexpr std::size_t TextLength(const char* text)
+	{
+		std::size_t length = 0;
+		while (text[length] != '\0')
+		{
+			length++;
+		}
+		return(length);
+	}
+
+	constexpr std::size_t NumberLength(GLuint value)
+	{
+		return((value < 10) ? 1 : 1 + NumberLength(value / 10));
+	}
+
+	// length of "layout (location = N) in TYPE NAME;\n"
+	template <typename A>
+	constexpr std::size_t DeclarationLength()
+	{
+		return(19 + NumberLength(A::location) + 5 + TextLength(A::GLSLType()) + 1 + A::name.Length() + 2);
+	}
+
+	template <typename A, std::size_t N>
+	constexpr void AppendDeclaration(std::array<char, N>& text, std::size_t& pos)
+	{
+		auto append = [&](const char* str)
+		{
+			for (std::size_t i = 0; str[i] != '\0'; i++)
+			{
+				text[pos++] = str[i];
+			}
+		};
+
+		append("layout (location = ");
+		for (std::size_t digit = NumberLength(A::location); digit > 0; digit--)
+		{
+			GLuint value = A::location;
+			for (std::size_t i = 1; i < digit; i++)
+			{
+				value /= 10;
+			}
+			text[pos++] = (char)('0' + value % 10);
+		}
+		append(") in ");
+		append(A::GLSLType());
+		append(" ");
+		append(A::name.text);
+		append(";\n");
+	}
+
+	/***********************************************************
+	 *  Layout
+	 *
+	 *  A complete vertex format.  Attributes with the same
+	 *  binding are interleaved in one buffer in the listed
+	 *  order; using several bindings splits the vertex data
+	 *  into separate streams.
+	 ***********************************************************/
+	template <typename... Attributes>
+	struct Layout
+	{
+		static constexpr std::size_t AttributeCount = sizeof...(Attributes);
+		static_assert(AttributeCount > 0, "a vertex layout needs at least one attribute");
+		static_assert(UniqueLocations<Attributes...>(), "vertex attributes must not share a location");
+
+		static constexpr GLuint BindingCount = []()
+		{
+			GLuint count = 0;
+			((count = (Attributes::binding + 1 > count) ? Attributes::binding + 1 : count), ...);
+			return(count);
+		}();
+
+		static_assert([]()
+		{
+			for (GLuint binding = 0; binding < BindingCount; binding++)
+			{
+				if (BindingStride<Attributes...>(binding) == 0)
+				{
+					return(false);
+				}
+			}
+			return(true);
+		}(), "every vertex buffer binding needs at least one attribute");
+
+		// size of one vertex in the buffer of a binding
+		static constexpr GLuint Stride(GLuint binding)
+		{
+			return(BindingStride<Attributes...>(binding));
+		}
+
+		// byte offset of every attribute inside its binding
+		static constexpr std::array<GLuint, AttributeCount> Offsets = []()
+		{
+			std::array<GLuint, AttributeCount> offsets = {};
+			std::array<GLuint, BindingCount> cursor = {};
+			std::size_t index = 0;
+			((offsets[index++] = cursor[Attributes::binding], cursor[Attributes::binding] += Attributes::size), ...);
+			return(offsets);
+		}();
+
+		// the "layout (location = N) in TYPE NAME;" lines for the shader
+		static constexpr auto Declaration = []()
+		{
+			std::array<char, (DeclarationLength<Attributes>() + ... + 1)> text = {};
+			std::size_t pos = 0;
+			(AppendDeclaration<Attributes>(text, pos), ...);
+			text[pos] = '\0';
+			return(text);
+		}();
+
+		static const char* GLSLDeclaration() { return Declaration.data(); }
+
+		/***********************************************************
+		 *  Apply()
+		 *
+		 *  Describe the layout on the bound vertex array object
+		 *  and attach one buffer per binding (buffers[binding]).
+		 ***********************************************************/
+		static void Apply(const GLuint* buffers)
+		{
+			ApplyAttributes(std::make_index_sequence<AttributeCount>());
+			for (GLuint binding = 0; binding < BindingCount; binding++)
+			{
+				glBindVertexBuffer(binding, buffers[binding], 0, BindingStride<Attributes...>(binding));
+			}
+		}
+
+	private:
+		template <typename A>
+		static void ApplyAttribute(GLuint offset)
+		{
+			if (A::integerInShader)
+			{
+				glVertexAttribIFormat(A::location, A::components, A::type, offset);
+			}
+			else
+			{
+				glVertexAttribFormat(A::location, A::components, A::type, A::normalized ? GL_TRUE : GL_FALSE, offset);
+			}
+			glVertexAttribBinding(A::location, A::binding);
+			glEnableVertexAttribArray(A::location);
+		}
+
+		template <std::size_t... Index>
+		static void ApplyAttributes(std::index_sequence<Index...>)
+		{
+			(ApplyAttribute<Attributes>(Offsets[Index]), ...);
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,399 @@
+///////////////////////////////////////////////////////////////////////////////
+// vertexpool.cpp
+// ============
+// one storage buffer of packed vertices, read by the vertex shader
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VertexPool.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// position, normal and uv of every vertex passed in
+	const size_t g_FloatsPerVertex = 8;
+	// 32 bit words a vertex takes in each format, in the position
+	// stream and in the stream of the other attributes
+	const GLuint g_FullPositionWords = 3;
+	const GLuint g_FullAttributeWords = 5;
+	const GLuint g_CompressedPositionWords = 2;
+	const GLuint g_CompressedAttributeWords = 2;
+
+	// the pool buffers and the decoding of both formats, see
+	// VertexPool::GLSLDeclaration(); the binding points are the
+	// VERTEX_POOL_* ones in UniformBlocks.h
+	const char* g_PoolDeclaration =
+		"#define VERTEX_POOL_FORMAT_FULL 0u\n"
+		"struct PoolMesh\n"
+		"{\n"
+		"    vec4 boundsMin;\n"
+		"    vec4 boundsExtent;\n"
+		"    uint firstPositionWord;\n"
+		"    uint firstAttributeWord;\n"
+		"    uint format;\n"
+		"    uint firstIndex;\n"
+		"    uint indexCount;\n"
+		"};\n"
+		"layout(std430, binding = 0) readonly buffer VertexPoolPositions\n"
+		"{\n"
+		"    uint poolPositions[];\n"
+		"};\n"
+		"layout(std430, binding = 4) readonly buffer VertexPoolAttributes\n"
+		"{\n"
+		"    uint poolAttributes[];\n"
+		"};\n"
+		"layout(std430, binding = 2) readonly buffer VertexPoolIndices\n"
+		"{\n"
+		"    uint poolIndices[];\n"
+		"};\n"
+		"layout(std430, binding = 3) readonly buffer VertexPoolMeshes\n"
+		"{\n"
+		"    PoolMesh poolMeshes[];\n"
+		"};\n"
+		"struct PulledVertex\n"
+		"{\n"
+		"    vec3 position;\n"
+		"    vec3 normal;\n"
+		"    vec2 textureCoordinate;\n"
+		"};\n"
+		"vec3 FetchPulledPosition(uint mesh, uint vertex)\n"
+		"{\n"
+		"    PoolMesh poolMesh = poolMeshes[mesh];\n"
+		"    if(poolMesh.format == VERTEX_POOL_FORMAT_FULL)\n"
+		"    {\n"
+		"        uint base = poolMesh.firstPositionWord + vertex * 3u;\n"
+		"        return uintBitsToFloat(uvec3(poolPositions[base], poolPositions[base + 1u], poolPositions[base + 2u]));\n"
+		"    }\n"
+		"    uint base = poolMesh.firstPositionWord + vertex * 2u;\n"
+		"    vec3 position = vec3(unpackUnorm2x16(poolPositions[base]), unpackUnorm2x16(poolPositions[base + 1u]).x);\n"
+		"    return poolMesh.boundsMin.xyz + position * poolMesh.boundsExtent.xyz;\n"
+		"}\n"
+		"PulledVertex FetchPulledVertex(uint mesh, uint vertex)\n"
+		"{\n"
+		"    PoolMesh poolMesh = poolMeshes[mesh];\n"
+		"    PulledVertex pulled;\n"
+		"    pulled.position = FetchPulledPosition(mesh, vertex);\n"
+		"    if(poolMesh.format == VERTEX_POOL_FORMAT_FULL)\n"
+		"    {\n"
+		"        uint base = poolMesh.firstAttributeWord + vertex * 5u;\n"
+		"        pulled.normal = uintBitsToFloat(uvec3(poolAttributes[base], poolAttributes[base + 1u], poolAttributes[base + 2u]));\n"
+		"        pulled.textureCoordinate = uintBitsToFloat(uvec2(poolAttributes[base + 3u], poolAttributes[base + 4u]));\n"
+		"        return pulled;\n"
+		"    }\n"
+		"    uint base = poolMesh.firstAttributeWord + vertex * 2u;\n"
+		"    vec2 octahedral = unpackSnorm2x16(poolAttributes[base]);\n"
+		"    vec3 normal = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));\n"
+		"    if(normal.z < 0.0)\n"
+		"    {\n"
+		"        normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);\n"
+		"    }\n"
+		"    pulled.normal = normalize(normal);\n"
+		"    pulled.textureCoordinate = unpackHalf2x16(poolAttributes[base + 1u]);\n"
+		"    return pulled;\n"
+		"}\n";
+
+	static_assert(VERTEX_POOL_POSITION_BINDING == 0 && VERTEX_POOL_INDEX_BINDING == 2
+		&& VERTEX_POOL_MESH_BINDING == 3 && VERTEX_POOL_ATTRIBUTE_BINDING == 4,
+		"the pool declaration must match the binding points");
+
+	// store a float in a buffer of words
+	GLuint FloatBits(GLfloat value)
+	{
+		GLuint bits = 0;
+		memcpy(&bits, &value, sizeof(bits));
+		return(bits);
+	}
+
+	// map a unit vector onto the octahedron unfolded into [-1, 1]
+	glm::vec2 OctahedralEncode(glm::vec3 normal)
+	{
+		float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+		if (length <= 0.0f)
+		{
+			return(glm::vec2(0.0f));
+		}
+		glm::vec2 encoded = glm::vec2(normal.x, normal.y) / length;
+		if (normal.z < 0.0f)
+		{
+			encoded = glm::vec2(
+				(1.0f - std::abs(encoded.y)) * (encoded.x >= 0.0f ? 1.0f : -1.0f),
+				(1.0f - std::abs(encoded.x)) * (encoded.y >= 0.0f ? 1.0f : -1.0f));
+		}
+		return(encoded);
+	}
+}
+
+/***********************************************************
+ *  VertexPool()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+VertexPool::VertexPool()
+{
+	m_bUploaded = false;
+	m_positionBytes = 0;
+	m_attributeBytes = 0;
+	m_positionBuffer = 0;
+	m_attributeBuffer = 0;
+	m_indexBuffer = 0;
+	m_meshBuffer = 0;
+	m_commandBuffer = 0;
+	m_emptyVAO = 0;
+}
+
+/***********************************************************
+ *  ~VertexPool()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+VertexPool::~VertexPool()
+{
+	GLuint buffers[5] = { m_positionBuffer, m_attributeBuffer, m_indexBuffer, m_meshBuffer, m_commandBuffer };
+	glDeleteBuffers(5, buffers);
+	m_positionBuffer = 0;
+	m_attributeBuffer = 0;
+	m_indexBuffer = 0;
+	m_meshBuffer = 0;
+	m_commandBuffer = 0;
+	if (m_emptyVAO != 0)
+	{
+		glDeleteVertexArrays(1, &m_emptyVAO);
+		m_emptyVAO = 0;
+	}
+}
+
+/***********************************************************
+ *  AddMesh()
+ *
+ *  This method is used for packing the vertices of a mesh
+ *  in the passed in format after the ones already added,
+ *  and its indices after theirs.  The positions go into
+ *  their own stream and the normals and uvs into another.
+ *  The indices stay relative to the mesh; the shader adds
+ *  the first words of the mesh record to them.
+ ***********************************************************/
+int VertexPool::AddMesh(
+	const std::vector<GLfloat>& verts,
+	const std::vector<GLuint>& indices,
+	VERTEX_FORMAT format)
+{
+	size_t vertexCount = verts.size() / g_FloatsPerVertex;
+	size_t indexCount = indices.size() - indices.size() % 3;
+	if ((m_bUploaded == true) || (vertexCount == 0) || (indexCount == 0))
+	{
+		return(-1);
+	}
+
+	glm::vec3 boundsMin = glm::vec3(verts[0], verts[1], verts[2]);
+	glm::vec3 boundsMax = boundsMin;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		glm::vec3 position = glm::vec3(verts[i * g_FloatsPerVertex], verts[i * g_FloatsPerVertex + 1], verts[i * g_FloatsPerVertex + 2]);
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+	// a flat axis still needs a scale to decode with
+	glm::vec3 boundsExtent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+
+	POOL_MESH_BLOCK mesh;
+	mesh.boundsMin = glm::vec4(boundsMin, 0.0f);
+	mesh.boundsExtent = glm::vec4(boundsExtent, 0.0f);
+	mesh.firstPositionWord = (GLuint)m_positionWords.size();
+	mesh.firstAttributeWord = (GLuint)m_attributeWords.size();
+	mesh.format = (GLuint)format;
+	mesh.firstIndex = (GLuint)m_indices.size();
+	mesh.indexCount = (GLuint)indexCount;
+	mesh.padding0[0] = mesh.padding0[1] = mesh.padding0[2] = 0;
+
+	bool bFull = (format == FORMAT_FULL);
+	m_positionWords.reserve(m_positionWords.size() + vertexCount * (bFull ? g_FullPositionWords : g_CompressedPositionWords));
+	m_attributeWords.reserve(m_attributeWords.size() + vertexCount * (bFull ? g_FullAttributeWords : g_CompressedAttributeWords));
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const GLfloat* vertex = &verts[i * g_FloatsPerVertex];
+		if (bFull == true)
+		{
+			for (GLuint word = 0; word < g_FullPositionWords; word++)
+			{
+				m_positionWords.push_back(FloatBits(vertex[word]));
+			}
+			for (GLuint word = 0; word < g_FullAttributeWords; word++)
+			{
+				m_attributeWords.push_back(FloatBits(vertex[g_FullPositionWords + word]));
+			}
+			continue;
+		}
+
+		glm::vec3 position = (glm::vec3(vertex[0], vertex[1], vertex[2]) - boundsMin) / boundsExtent;
+		glm::vec3 normal = glm::vec3(vertex[3], vertex[4], vertex[5]);
+		m_positionWords.push_back(glm::packUnorm2x16(glm::vec2(position.x, position.y)));
+		m_positionWords.push_back(glm::packUnorm2x16(glm::vec2(position.z, 0.0f)));
+		m_attributeWords.push_back(glm::packSnorm2x16(OctahedralEncode(normal)));
+		m_attributeWords.push_back(glm::packHalf2x16(glm::vec2(vertex[6], vertex[7])));
+	}
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		// an index past the mesh would read another mesh's vertices
+		m_indices.push_back(std::min(indices[i], (GLuint)(vertexCount - 1)));
+	}
+
+	m_meshes.push_back(mesh);
+	return((int)m_meshes.size() - 1);
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for creating the immutable position,
+ *  attribute, index and mesh buffers from the added meshes.
+ *  The packed data is not needed after that.
+ ***********************************************************/
+bool VertexPool::Upload()
+{
+	if ((m_bUploaded == true) || (m_meshes.size() == 0))
+	{
+		return(m_bUploaded);
+	}
+	m_bUploaded = true;
+
+	glCreateBuffers(1, &m_positionBuffer);
+	glNamedBufferStorage(m_positionBuffer, m_positionWords.size() * sizeof(GLuint), m_positionWords.data(), 0);
+	glCreateBuffers(1, &m_attributeBuffer);
+	glNamedBufferStorage(m_attributeBuffer, m_attributeWords.size() * sizeof(GLuint), m_attributeWords.data(), 0);
+	glCreateBuffers(1, &m_indexBuffer);
+	glNamedBufferStorage(m_indexBuffer, m_indices.size() * sizeof(GLuint), m_indices.data(), 0);
+	glCreateBuffers(1, &m_meshBuffer);
+	glNamedBufferStorage(m_meshBuffer, m_meshes.size() * sizeof(POOL_MESH_BLOCK), m_meshes.data(), 0);
+	glCreateBuffers(1, &m_commandBuffer);
+
+	// the vertex array has no attributes, only the indices
+	glCreateVertexArrays(1, &m_emptyVAO);
+	glVertexArrayElementBuffer(m_emptyVAO, m_indexBuffer);
+
+	m_positionBytes = m_positionWords.size() * sizeof(GLuint);
+	m_attributeBytes = m_attributeWords.size() * sizeof(GLuint);
+	std::cout << "Vertex pool: " << m_meshes.size() << " meshes, " << m_positionBytes / 1024 << " KB of positions, "
+		<< m_attributeBytes / 1024 << " KB of other attributes" << std::endl;
+	m_positionWords = std::vector<GLuint>();
+	m_attributeWords = std::vector<GLuint>();
+	m_indices = std::vector<GLuint>();
+	return(true);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding the pool buffers to
+ *  their storage block binding points and the vertex
+ *  array every pool draw uses.  Passes that only need the
+ *  positions read only that stream, through
+ *  FetchPulledPosition(); the attribute stream is bound
+ *  for the shaders that need the rest.
+ ***********************************************************/
+void VertexPool::Bind()
+{
+	if (m_bUploaded == false)
+	{
+		return;
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VERTEX_POOL_POSITION_BINDING, m_positionBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VERTEX_POOL_ATTRIBUTE_BINDING, m_attributeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VERTEX_POOL_INDEX_BINDING, m_indexBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VERTEX_POOL_MESH_BINDING, m_meshBuffer);
+	glBindVertexArray(m_emptyVAO);
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method is used for drawing one mesh after Bind().
+ *  The base instance carries the mesh to the shader.
+ ***********************************************************/
+void VertexPool::DrawMesh(int mesh)
+{
+	if ((m_bUploaded == false) || (mesh < 0) || (mesh >= (int)m_meshes.size()))
+	{
+		return;
+	}
+	const POOL_MESH_BLOCK& record = m_meshes[mesh];
+	glDrawElementsInstancedBaseInstance(
+		GL_TRIANGLES,
+		record.indexCount,
+		GL_UNSIGNED_INT,
+		(const void*)(record.firstIndex * sizeof(GLuint)),
+		1,
+		(GLuint)mesh);
+}
+
+/***********************************************************
+ *  MultiDrawMeshes()
+ *
+ *  This method is used for drawing a list of meshes after
+ *  Bind() with one indirect draw, whatever format each one
+ *  is stored in.
+ ***********************************************************/
+void VertexPool::MultiDrawMeshes(const std::vector<GLuint>& meshes)
+{
+	if ((m_bUploaded == false) || (meshes.size() == 0))
+	{
+		return;
+	}
+
+	m_commands.clear();
+	for (GLuint mesh : meshes)
+	{
+		DRAW_ELEMENTS_COMMAND command;
+		command.count = (mesh < m_meshes.size()) ? m_meshes[mesh].indexCount : 0;
+		command.instanceCount = 1;
+		command.firstIndex = (mesh < m_meshes.size()) ? m_meshes[mesh].firstIndex : 0;
+		command.baseVertex = 0;
+		command.baseInstance = mesh;
+		m_commands.push_back(command);
+	}
+
+	glNamedBufferData(m_commandBuffer, m_commands.size() * sizeof(DRAW_ELEMENTS_COMMAND), m_commands.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)0, (GLsizei)m_commands.size(), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/***********************************************************
+ *  GetIndexCount()
+ ***********************************************************/
+GLuint VertexPool::GetIndexCount(int mesh) const
+{
+	if ((mesh < 0) || (mesh >= (int)m_meshes.size()))
+	{
+		return(0);
+	}
+	return(m_meshes[mesh].indexCount);
+}
+
+/***********************************************************
+ *  GetMeshBounds()
+ ***********************************************************/
+bool VertexPool::GetMeshBounds(int mesh, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+	if ((mesh < 0) || (mesh >= (int)m_meshes.size()))
+	{
+		return(false);
+	}
+	boundsMin = glm::vec3(m_meshes[mesh].boundsMin);
+	boundsMax = boundsMin + glm::vec3(m_meshes[mesh].boundsExtent);
+	return(true);
+}
+
+/***********************************************************
+ *  GLSLDeclaration()
+ ***********************************************************/
+const char* VertexPool::GLSLDeclaration()
+{
+	return(g_PoolDeclaration);
+}
@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+// vertexpool.h
+// ============
+// one storage buffer of packed vertices, read by the vertex shader
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "UniformBlocks.h"
+
+#include <vector>
+
+/***********************************************************
+ *  VertexPool
+ *
+ *  This class packs the vertices of many meshes one after
+ *  another into storage buffers, and their indices into a
+ *  single index buffer.  The positions are a stream of
+ *  their own, apart from the normals and uvs, so passes
+ *  that only need depth fetch a third of the data.  Nothing is described with
+ *  vertex attributes: the vertex shader fetches and decodes
+ *  its vertex from the buffer with gl_VertexID and the mesh
+ *  record picked by gl_BaseInstance, using the functions of
+ *  GLSLDeclaration().  Every mesh is drawn with the same
+ *  empty vertex array, so meshes stored in different
+ *  formats can go into one indirect draw.
+ *
+ *  A mesh is stored either as the full 8 floats of the
+ *  shape meshes (12 bytes of position and 20 of the rest a
+ *  vertex) or compressed to 8 and 8 bytes: the position in
+ *  16 bits an axis within the mesh bounds, an octahedral
+ *  normal and a half float uv.
+ ***********************************************************/
+class VertexPool
+{
+public:
+	// constructor
+	VertexPool();
+	// destructor
+	~VertexPool();
+
+	// how the vertices of a mesh are stored
+	enum VERTEX_FORMAT
+	{
+		FORMAT_FULL = 0,
+		FORMAT_COMPRESSED = 1
+	};
+
+	// add a mesh of interleaved position, normal and uv vertices
+	// and triangle list indices before Upload(), returns its
+	// index or -1 when it is empty or the pool was uploaded
+	int AddMesh(
+		const std::vector<GLfloat>& verts,
+		const std::vector<GLuint>& indices,
+		VERTEX_FORMAT format);
+	// create the buffers from the added meshes, false when there
+	// are none
+	bool Upload();
+
+	// bind the storage buffers and the empty vertex array for
+	// the draws below, and for shaders reading the meshes later
+	void Bind();
+	// draw one mesh with the program in use
+	void DrawMesh(int mesh);
+	// draw the meshes with one indirect draw, gl_DrawID is the
+	// position of the mesh in the list
+	void MultiDrawMeshes(const std::vector<GLuint>& meshes);
+
+	int GetMeshCount() const { return((int)m_meshes.size()); }
+	GLuint GetIndexCount(int mesh) const;
+	// object space bounds of a mesh, false for no mesh
+	bool GetMeshBounds(int mesh, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+	// bytes of the position stream and of the other attributes
+	size_t GetPositionBytes() const { return(m_positionBytes); }
+	size_t GetAttributeBytes() const { return(m_attributeBytes); }
+
+	// GLSL of the pool buffers and of
+	//   vec3 FetchPulledPosition(uint mesh, uint vertex)
+	//   PulledVertex FetchPulledVertex(uint mesh, uint vertex)
+	// to be added to the shaders that read the pool
+	static const char* GLSLDeclaration();
+
+private:
+	// glMultiDrawElementsIndirect command
+	struct DRAW_ELEMENTS_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// the packed data until it is uploaded
+	std::vector<GLuint> m_positionWords;
+	std::vector<GLuint> m_attributeWords;
+	std::vector<GLuint> m_indices;
+	std::vector<POOL_MESH_BLOCK> m_meshes;
+	bool m_bUploaded;
+	size_t m_positionBytes;
+	size_t m_attributeBytes;
+
+	GLuint m_positionBuffer;
+	GLuint m_attributeBuffer;
+	GLuint m_indexBuffer;
+	GLuint m_meshBuffer;
+	GLuint m_commandBuffer;
+	GLuint m_emptyVAO;
+	std::vector<DRAW_ELEMENTS_COMMAND> m_commands;
+};
@@ -14,6 +14,8 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>    
 
+#include <algorithm>
+
 // declaration of the global variables and defines
 namespace
 {
@@ -37,6 +39,9 @@ namespace
 	float gLastFrame = 0.0f;
 	float gCameraSpeed = 5.0f;  // default movement speed adjusted by scroll
 
+	// smoothed camera velocity, used to prefetch streamed cells
+	glm::vec3 gCameraVelocity = glm::vec3(0.0f);
+
 	// the following variable is false when orthographic projection
 	// is off and true when it is on
 	bool bOrthographicProjection = false;
@@ -53,6 +58,17 @@ ViewManager::ViewManager(
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	m_sceneFramebuffer = 0;
+	m_sceneColor = 0;
+	m_sceneDepth = 0;
+	m_sceneSurface = 0;
+	m_resolveFramebuffer = 0;
+	m_resolveColor = 0;
+	m_sceneWidth = WINDOW_WIDTH;
+	m_sceneHeight = WINDOW_HEIGHT;
+	m_msaaSamples = 1;
+	m_view = glm::mat4(1.0f);
+	m_projection = glm::mat4(1.0f);
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(0.0f, 5.0f, 12.0f);
@@ -69,6 +85,7 @@ ViewManager::ViewManager(
 ViewManager::~ViewManager()
 {
 	// free up allocated memory
+	DestroySceneTargets();
 	m_pShaderManager = NULL;
 	m_pWindow = NULL;
 	if (NULL != g_pCamera)
@@ -326,8 +343,20 @@ void ViewManager::PrepareSceneView()
 
 	// process any keyboard events that may be waiting in the 
 	// event queue
+	glm::vec3 lastPosition = g_pCamera->Position;
 	ProcessKeyboardEvents();
 
+	// track the camera velocity, ignoring the jumps of the preset views
+	if (gDeltaTime > 0.0f)
+	{
+		glm::vec3 frameVelocity = (g_pCamera->Position - lastPosition) / gDeltaTime;
+		if (glm::length(frameVelocity) > 100.0f)
+		{
+			frameVelocity = glm::vec3(0.0f);
+		}
+		gCameraVelocity = glm::mix(gCameraVelocity, frameVelocity, 0.2f);
+	}
+
 	// get the current view matrix from the camera
 	view = g_pCamera->GetViewMatrix();
 
@@ -347,6 +376,9 @@ void ViewManager::PrepareSceneView()
 			0.1f, 100.0f);
 	}
 
+	m_view = view;
+	m_projection = projection;
+
 	// if the shader manager object is valid
 	if (NULL != m_pShaderManager)
 	{
@@ -357,4 +389,226 @@ void ViewManager::PrepareSceneView()
 		// set the view position of the camera into the shader for proper rendering
 		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
 	}
+}
+
+/***********************************************************
+ *  GetCameraPosition()
+ *
+ *  This method is used for getting the current position of
+ *  the camera in world space.
+ ***********************************************************/
+glm::vec3 ViewManager::GetCameraPosition()
+{
+	return(g_pCamera->Position);
+}
+
+/***********************************************************
+ *  GetCameraVelocity()
+ *
+ *  This method is used for getting the smoothed velocity of
+ *  the camera in world units per second.
+ ***********************************************************/
+glm::vec3 ViewManager::GetCameraVelocity()
+{
+	return(gCameraVelocity);
+}
+
+/***********************************************************
+ *  GetFrameDeltaTime()
+ *
+ *  This method is used for getting the seconds between the
+ *  start of the last frame and the start of this one.
+ ***********************************************************/
+float ViewManager::GetFrameDeltaTime()
+{
+	return(gDeltaTime);
+}
+
+/***********************************************************
+ *  GetProjectedSize()
+ *
+ *  This method is used for getting the number of pixels that
+ *  a world space length covers on screen when it is seen at
+ *  the passed in distance from the camera.
+ ***********************************************************/
+float ViewManager::GetProjectedSize(float worldSize, float distance)
+{
+	if (bOrthographicProjection)
+	{
+		float orthoSize = 10.0f;
+		return(worldSize * WINDOW_HEIGHT / (2.0f * orthoSize));
+	}
+
+	distance = std::max(distance, 0.1f);
+	return(worldSize * WINDOW_HEIGHT / (2.0f * distance * tan(glm::radians(g_pCamera->Zoom) * 0.5f)));
+}
+
+/***********************************************************
+ *  GetWindowWidth()
+ *
+ *  This method is used for getting the width of the display
+ *  window in pixels.
+ ***********************************************************/
+int ViewManager::GetWindowWidth()
+{
+	return(WINDOW_WIDTH);
+}
+
+/***********************************************************
+ *  GetWindowHeight()
+ *
+ *  This method is used for getting the height of the display
+ *  window in pixels.
+ ***********************************************************/
+int ViewManager::GetWindowHeight()
+{
+	return(WINDOW_HEIGHT);
+}
+
+/***********************************************************
+ *  SetRenderQuality()
+ *
+ *  This method is used for creating the offscreen target
+ *  the scene is drawn into, at a fraction of the window
+ *  size and with multisampling.  Its color and depth are
+ *  textures, so later passes can attach or read them.  A
+ *  multisampled target that is also scaled is resolved into
+ *  a second, single sampled target first, since a blit
+ *  cannot resolve and scale at once.  If the target cannot
+ *  be created the scene is drawn straight into the window.
+ ***********************************************************/
+void ViewManager::SetRenderQuality(float renderScale, int msaaSamples)
+{
+	DestroySceneTargets();
+
+	GLint maxSamples = 1;
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+	m_msaaSamples = std::max(1, std::min(msaaSamples, (int)maxSamples));
+	m_sceneWidth = std::max(1, (int)(WINDOW_WIDTH * renderScale + 0.5f));
+	m_sceneHeight = std::max(1, (int)(WINDOW_HEIGHT * renderScale + 0.5f));
+	bool bScaled = (m_sceneWidth != WINDOW_WIDTH) || (m_sceneHeight != WINDOW_HEIGHT);
+
+	if (m_msaaSamples > 1)
+	{
+		glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &m_sceneColor);
+		glTextureStorage2DMultisample(m_sceneColor, m_msaaSamples, GL_RGBA8, m_sceneWidth, m_sceneHeight, GL_TRUE);
+		glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &m_sceneDepth);
+		glTextureStorage2DMultisample(m_sceneDepth, m_msaaSamples, GL_DEPTH_COMPONENT24, m_sceneWidth, m_sceneHeight, GL_TRUE);
+		glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &m_sceneSurface);
+		glTextureStorage2DMultisample(m_sceneSurface, m_msaaSamples, GL_RGBA16F, m_sceneWidth, m_sceneHeight, GL_TRUE);
+	}
+	else
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_sceneColor);
+		glTextureStorage2D(m_sceneColor, 1, GL_RGBA8, m_sceneWidth, m_sceneHeight);
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_sceneDepth);
+		glTextureStorage2D(m_sceneDepth, 1, GL_DEPTH_COMPONENT24, m_sceneWidth, m_sceneHeight);
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_sceneSurface);
+		glTextureStorage2D(m_sceneSurface, 1, GL_RGBA16F, m_sceneWidth, m_sceneHeight);
+	}
+	glCreateFramebuffers(1, &m_sceneFramebuffer);
+	glNamedFramebufferTexture(m_sceneFramebuffer, GL_COLOR_ATTACHMENT0, m_sceneColor, 0);
+	glNamedFramebufferTexture(m_sceneFramebuffer, GL_COLOR_ATTACHMENT1, m_sceneSurface, 0);
+	glNamedFramebufferTexture(m_sceneFramebuffer, GL_DEPTH_ATTACHMENT, m_sceneDepth, 0);
+	// the scene shader writes the surface at location 2, location 1
+	// is the revealage of the transparency pass
+	const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_NONE, GL_COLOR_ATTACHMENT1 };
+	glNamedFramebufferDrawBuffers(m_sceneFramebuffer, 3, drawBuffers);
+
+	bool bComplete = (glCheckNamedFramebufferStatus(m_sceneFramebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	if ((bComplete == true) && (bScaled == true) && (m_msaaSamples > 1))
+	{
+		glCreateRenderbuffers(1, &m_resolveColor);
+		glNamedRenderbufferStorage(m_resolveColor, GL_RGBA8, m_sceneWidth, m_sceneHeight);
+		glCreateFramebuffers(1, &m_resolveFramebuffer);
+		glNamedFramebufferRenderbuffer(m_resolveFramebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_resolveColor);
+		bComplete = (glCheckNamedFramebufferStatus(m_resolveFramebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	}
+
+	if (bComplete == false)
+	{
+		std::cout << "Could not create the " << m_sceneWidth << "x" << m_sceneHeight << " scene target, drawing to the window" << std::endl;
+		DestroySceneTargets();
+		return;
+	}
+
+	std::cout << "Scene target: " << m_sceneWidth << "x" << m_sceneHeight << ", " << m_msaaSamples << " samples" << std::endl;
+}
+
+/***********************************************************
+ *  DestroySceneTargets()
+ *
+ *  This method is used for freeing the offscreen scene
+ *  target, so the scene is drawn straight into the window.
+ ***********************************************************/
+void ViewManager::DestroySceneTargets()
+{
+	if (m_sceneFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_sceneFramebuffer);
+		m_sceneFramebuffer = 0;
+	}
+	if (m_resolveFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_resolveFramebuffer);
+		m_resolveFramebuffer = 0;
+	}
+	GLuint textures[3] = { m_sceneColor, m_sceneDepth, m_sceneSurface };
+	glDeleteTextures(3, textures);
+	glDeleteRenderbuffers(1, &m_resolveColor);
+	m_sceneColor = 0;
+	m_sceneDepth = 0;
+	m_sceneSurface = 0;
+	m_resolveColor = 0;
+	m_sceneWidth = WINDOW_WIDTH;
+	m_sceneHeight = WINDOW_HEIGHT;
+}
+
+/***********************************************************
+ *  BeginSceneFrame()
+ *
+ *  This method is used for binding the scene target and
+ *  its viewport before the frame is cleared and drawn.  The
+ *  surface buffer holds data rather than a color, so it is
+ *  never blended.
+ ***********************************************************/
+void ViewManager::BeginSceneFrame()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFramebuffer);
+	glViewport(0, 0, m_sceneWidth, m_sceneHeight);
+	glDisablei(GL_BLEND, 2);
+}
+
+/***********************************************************
+ *  EndSceneFrame()
+ *
+ *  This method is used for copying the drawn frame into the
+ *  window, resolving the samples and scaling it up with
+ *  bilinear filtering.
+ ***********************************************************/
+void ViewManager::EndSceneFrame()
+{
+	if (m_sceneFramebuffer == 0)
+	{
+		return;
+	}
+
+	GLuint source = m_sceneFramebuffer;
+	if (m_resolveFramebuffer != 0)
+	{
+		glBlitNamedFramebuffer(m_sceneFramebuffer, m_resolveFramebuffer,
+			0, 0, m_sceneWidth, m_sceneHeight,
+			0, 0, m_sceneWidth, m_sceneHeight,
+			GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		source = m_resolveFramebuffer;
+	}
+
+	bool bScaled = (m_sceneWidth != WINDOW_WIDTH) || (m_sceneHeight != WINDOW_HEIGHT);
+	glBlitNamedFramebuffer(source, 0,
+		0, 0, m_sceneWidth, m_sceneHeight,
+		0, 0, WINDOW_WIDTH, WINDOW_HEIGHT,
+		GL_COLOR_BUFFER_BIT, bScaled ? GL_LINEAR : GL_NEAREST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 }
\ No newline at end of file
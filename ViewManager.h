@@ -35,6 +35,27 @@ private:
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
 
+	// offscreen target the scene is drawn into, 0 to draw
+	// straight to the window
+	GLuint m_sceneFramebuffer;
+	GLuint m_sceneColor;
+	GLuint m_sceneDepth;
+	// normal, reflectance and roughness of the opaque surfaces
+	GLuint m_sceneSurface;
+	// single sampled copy of a multisampled scene, for scaling
+	GLuint m_resolveFramebuffer;
+	GLuint m_resolveColor;
+	int m_sceneWidth;
+	int m_sceneHeight;
+	int m_msaaSamples;
+
+	// view and projection of the current frame
+	glm::mat4 m_view;
+	glm::mat4 m_projection;
+
+	// free the offscreen scene target
+	void DestroySceneTargets();
+
 	// process keyboard events for interaction with the 3D scene
 	void ProcessKeyboardEvents();
 
@@ -44,4 +65,41 @@ public:
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+
+	// get the current position of the camera in world space
+	glm::vec3 GetCameraPosition();
+	// get the smoothed camera velocity in world units per second
+	glm::vec3 GetCameraVelocity();
+	// get the seconds since the last frame
+	float GetFrameDeltaTime();
+	// get the size in pixels of a world space length seen
+	// at the passed in distance from the camera
+	float GetProjectedSize(float worldSize, float distance);
+
+	// get the view and projection matrices of the current frame
+	glm::mat4 GetViewMatrix() { return(m_view); }
+	glm::mat4 GetProjectionMatrix() { return(m_projection); }
+
+	// get the size of the display window in pixels
+	int GetWindowWidth();
+	int GetWindowHeight();
+
+	// draw the scene at renderScale times the window size, with
+	// msaaSamples samples per pixel
+	void SetRenderQuality(float renderScale, int msaaSamples);
+	// bind the scene target before drawing a frame
+	void BeginSceneFrame();
+	// resolve and scale the drawn frame into the window
+	void EndSceneFrame();
+
+	// the scene target and its textures, 0 when drawing straight
+	// to the window; the textures are multisampled when
+	// GetSceneSamples() is more than 1
+	GLuint GetSceneFramebuffer() { return(m_sceneFramebuffer); }
+	GLuint GetSceneColorTexture() { return(m_sceneColor); }
+	GLuint GetSceneDepthTexture() { return(m_sceneDepth); }
+	GLuint GetSceneSurfaceTexture() { return(m_sceneSurface); }
+	int GetSceneWidth() { return(m_sceneWidth); }
+	int GetSceneHeight() { return(m_sceneHeight); }
+	int GetSceneSamples() { return(m_msaaSamples); }
 };
\ No newline at end of file
@@ -0,0 +1,376 @@
+///////////////////////////////////////////////////////////////////////////////
+// visibilitymanager.cpp
+// ============
+// visibility buffer: rasterize triangle ids, then shade every pixel once
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VisibilityManager.h"
+
+#include <iostream>
+#include <string>
+
+// declaration of global variables
+namespace
+{
+	const char* g_VisibilityVertexShader = "../../Utilities/shaders/visibilityVertexShader.glsl";
+	const char* g_VisibilityFragmentShader = "../../Utilities/shaders/visibilityFragmentShader.glsl";
+	const char* g_FullscreenVertexShader = "../../Utilities/shaders/fullscreenVertexShader.glsl";
+	// the resolve pass is the scene fragment shader, compiled to
+	// read its surface from the visibility target
+	const char* g_ResolveFragmentShader = "../../Utilities/shaders/fragmentShader.glsl";
+	const char* g_ResolveDefines = "#define VISIBILITY_RESOLVE\n";
+
+	// the visibility target uses the unit after the reflections
+	const GLuint g_VisibilityTextureUnit = 30;
+	const int g_SceneTextureSlots = 16;
+
+	// a pixel holds the draw in the high bits and its triangle in
+	// the low bits; all bits set is a pixel no draw covers
+	const int g_TriangleBits = 20;
+	const GLuint g_MaxTriangles = 1u << g_TriangleBits;
+	const GLuint g_MaxDraws = (1u << (32 - g_TriangleBits)) - 1;
+	const GLuint g_EmptyVisibility = 0xFFFFFFFFu;
+
+	// the lighting settings the resolve program takes from the scene program
+	const char* g_SharedIntUniforms[] = { "bUseLighting", "lightCount", "ltcMatrixTexture", "ltcAmplitudeTexture",
+		"voxelClipmap[0]", "voxelClipmap[1]", "voxelClipmap[2]", "voxelClipmap[3]", "bRayShadows", "rayShadowTexture" };
+	const char* g_SharedFloatUniforms[] = { "textureMipBias" };
+}
+
+/***********************************************************
+ *  VisibilityManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+VisibilityManager::VisibilityManager(ShapeMeshes* pShapeMeshes, DerivedDataCache* pDerivedDataCache)
+{
+	m_pShapeMeshes = pShapeMeshes;
+	m_pVisibilityShader = new ShaderManager();
+	m_pVisibilityShader->m_programID = 0;
+	m_pVisibilityShader->m_pDerivedDataCache = pDerivedDataCache;
+	m_pResolveShader = new ShaderManager();
+	m_pResolveShader->m_programID = 0;
+	m_pResolveShader->m_pDerivedDataCache = pDerivedDataCache;
+	m_emptyVAO = 0;
+	m_bShadersLoaded = false;
+	m_pShadingCache = new ShadingCacheManager(pShapeMeshes, pDerivedDataCache);
+	m_drawBuffer = 0;
+	m_framebuffer = 0;
+	m_visibilityTexture = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  ~VisibilityManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+VisibilityManager::~VisibilityManager()
+{
+	DestroyTargets();
+	glDeleteBuffers(1, &m_drawBuffer);
+	m_drawBuffer = 0;
+	if (m_emptyVAO != 0)
+	{
+		glDeleteVertexArrays(1, &m_emptyVAO);
+		m_emptyVAO = 0;
+	}
+	if (m_pVisibilityShader->m_programID != 0)
+	{
+		glDeleteProgram(m_pVisibilityShader->m_programID);
+	}
+	if (m_pResolveShader->m_programID != 0)
+	{
+		glDeleteProgram(m_pResolveShader->m_programID);
+	}
+	delete m_pVisibilityShader;
+	delete m_pResolveShader;
+	delete m_pShadingCache;
+	m_pVisibilityShader = NULL;
+	m_pResolveShader = NULL;
+	m_pShadingCache = NULL;
+	m_pShapeMeshes = NULL;
+}
+
+/***********************************************************
+ *  LoadShaders()
+ *
+ *  This method is used for loading the programs of the two
+ *  passes the first time the visibility buffer is used.  If
+ *  either fails the objects are drawn the usual way.  The
+ *  scene texture units never change, so the resolve
+ *  program's samplers are set once here.  Both read the
+ *  vertex pool, whose declarations are added to them, and
+ *  the resolve program the shading cache as well.
+ ***********************************************************/
+bool VisibilityManager::LoadShaders()
+{
+	if (m_bShadersLoaded == false)
+	{
+		m_bShadersLoaded = true;
+		std::string resolveDefines = std::string(g_ResolveDefines) + VertexPool::GLSLDeclaration() + ShadingCacheManager::GLSLDeclaration();
+		m_pVisibilityShader->LoadShaders(g_VisibilityVertexShader, g_VisibilityFragmentShader, VertexPool::GLSLDeclaration());
+		m_pResolveShader->LoadShaders(g_FullscreenVertexShader, g_ResolveFragmentShader, NULL, resolveDefines.c_str());
+		if ((m_pVisibilityShader->m_programID == 0) || (m_pResolveShader->m_programID == 0))
+		{
+			std::cout << "Could not load the visibility buffer shaders, shading objects as they are drawn" << std::endl;
+			glDeleteProgram(m_pResolveShader->m_programID);
+			m_pResolveShader->m_programID = 0;
+		}
+		else
+		{
+			GLint slots[g_SceneTextureSlots];
+			for (int i = 0; i < g_SceneTextureSlots; i++)
+			{
+				slots[i] = i;
+			}
+			m_pResolveShader->use();
+			glUniform1iv(glGetUniformLocation(m_pResolveShader->m_programID, "sceneTextures"), g_SceneTextureSlots, slots);
+			m_pResolveShader->setSampler2DValue("visibilityTexture", g_VisibilityTextureUnit);
+		}
+		glCreateBuffers(1, &m_drawBuffer);
+		glCreateVertexArrays(1, &m_emptyVAO);
+	}
+	return(m_pResolveShader->m_programID != 0);
+}
+
+/***********************************************************
+ *  CreateTargets()
+ *
+ *  This method is used for creating the 32 bit visibility
+ *  target.  The scene depth is attached every frame, since
+ *  the scene target is recreated when the render scale
+ *  changes.
+ ***********************************************************/
+void VisibilityManager::CreateTargets(int width, int height)
+{
+	DestroyTargets();
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_visibilityTexture);
+	glTextureStorage2D(m_visibilityTexture, 1, GL_R32UI, width, height);
+	glCreateFramebuffers(1, &m_framebuffer);
+	glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_visibilityTexture, 0);
+
+	m_width = width;
+	m_height = height;
+}
+
+/***********************************************************
+ *  DestroyTargets()
+ ***********************************************************/
+void VisibilityManager::DestroyTargets()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	glDeleteTextures(1, &m_visibilityTexture);
+	m_visibilityTexture = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for checking that this frame can be
+ *  drawn through the visibility buffer and clearing the
+ *  draws of the last one.  The programs are created on the
+ *  first frame.
+ ***********************************************************/
+bool VisibilityManager::BeginFrame(ViewManager* pViewManager)
+{
+	m_draws.clear();
+	m_drawMeshes.clear();
+	m_pShadingCache->BeginFrame();
+
+	if ((NULL == pViewManager) || (pViewManager->GetSceneFramebuffer() == 0) || (pViewManager->GetSceneSamples() > 1))
+	{
+		return(false);
+	}
+	if (LoadShaders() == false)
+	{
+		return(false);
+	}
+	if (m_pShapeMeshes->GetVertexPool() == NULL)
+	{
+		return(false);
+	}
+
+	int width = pViewManager->GetSceneWidth();
+	int height = pViewManager->GetSceneHeight();
+	if ((m_framebuffer == 0) || (width != m_width) || (height != m_height))
+	{
+		CreateTargets(width, height);
+	}
+	glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_ATTACHMENT, pViewManager->GetSceneDepthTexture(), 0);
+	if (glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Could not create the visibility target, shading objects as they are drawn" << std::endl;
+		DestroyTargets();
+		glDeleteProgram(m_pResolveShader->m_programID);
+		m_pResolveShader->m_programID = 0;
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  AddDraw()
+ *
+ *  This method is used for keeping an object for the
+ *  visibility pass with the pool mesh it is drawn from.
+ *  Meshes with more triangles than a pixel id can tell
+ *  apart are drawn the usual way.  The shading cache is
+ *  asked for the object's triangles here.
+ ***********************************************************/
+bool VisibilityManager::AddDraw(int poolMesh, const VISIBILITY_DRAW_BLOCK& draw)
+{
+	VertexPool* pVertexPool = m_pShapeMeshes->GetVertexPool();
+	if ((NULL == pVertexPool) || (poolMesh < 0))
+	{
+		return(false);
+	}
+	GLuint indexCount = pVertexPool->GetIndexCount(poolMesh);
+	if ((indexCount == 0) || (indexCount / 3 > g_MaxTriangles) || (m_draws.size() >= g_MaxDraws))
+	{
+		return(false);
+	}
+
+	m_draws.push_back(draw);
+	m_draws.back().mesh = (GLuint)poolMesh;
+	m_draws.back().cacheTriangles = m_pShadingCache->FindTriangles(poolMesh, draw);
+	m_drawMeshes.push_back((GLuint)poolMesh);
+	return(true);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for drawing the kept objects.  The
+ *  visibility pass tests and writes the scene depth, so
+ *  objects drawn the usual way before it hide them and are
+ *  hidden by them.  The resolve pass is one full screen
+ *  triangle over the scene target without depth; pixels no
+ *  kept object won keep what is already there.
+ ***********************************************************/
+void VisibilityManager::EndFrame(ViewManager* pViewManager, ShaderManager* pSceneShader)
+{
+	if (DrawVisibilityPass(pViewManager) == true)
+	{
+		ResolvePass(pViewManager, pSceneShader);
+	}
+}
+
+/***********************************************************
+ *  DrawVisibilityPass()
+ *
+ *  This method is used for drawing the kept objects into
+ *  the visibility target and the scene depth, the first
+ *  half of EndFrame().
+ ***********************************************************/
+bool VisibilityManager::DrawVisibilityPass(ViewManager* pViewManager)
+{
+	if (m_draws.size() == 0)
+	{
+		return(false);
+	}
+
+	glNamedBufferData(m_drawBuffer, m_draws.size() * sizeof(VISIBILITY_DRAW_BLOCK), m_draws.data(), GL_STREAM_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBILITY_DRAW_BINDING, m_drawBuffer);
+
+	glm::mat4 viewProjection = pViewManager->GetProjectionMatrix() * pViewManager->GetViewMatrix();
+
+	// visibility pass
+	const GLuint emptyClear[4] = { g_EmptyVisibility, 0, 0, 0 };
+	glClearNamedFramebufferuiv(m_framebuffer, GL_COLOR, 0, emptyClear);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	m_pVisibilityShader->use();
+	m_pVisibilityShader->setMat4Value("viewProjection", viewProjection);
+	m_pShapeMeshes->GetVertexPool()->Bind();
+	m_pShapeMeshes->GetVertexPool()->MultiDrawMeshes(m_drawMeshes);
+	return(true);
+}
+
+/***********************************************************
+ *  ResolvePass()
+ *
+ *  This method is used for shading the pixels the
+ *  visibility pass covered, the second half of EndFrame(),
+ *  and then the shading cache texels it asked for.
+ ***********************************************************/
+void VisibilityManager::ResolvePass(ViewManager* pViewManager, ShaderManager* pSceneShader)
+{
+	if (m_draws.size() == 0)
+	{
+		return;
+	}
+
+	glm::mat4 viewProjection = pViewManager->GetProjectionMatrix() * pViewManager->GetViewMatrix();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, pViewManager->GetSceneFramebuffer());
+	glDisable(GL_DEPTH_TEST);
+	m_pResolveShader->use();
+	CopySceneUniforms(pSceneShader, m_pResolveShader);
+	m_pShadingCache->SetResolveUniforms(m_pResolveShader);
+	m_pResolveShader->setVec3Value("viewPosition", pViewManager->GetCameraPosition());
+	m_pResolveShader->setMat4Value("inverseViewProjection", glm::inverse(viewProjection));
+	m_pResolveShader->setVec2Value("sceneSize", (float)m_width, (float)m_height);
+	glBindTextureUnit(g_VisibilityTextureUnit, m_visibilityTexture);
+	glBindVertexArray(m_emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glEnable(GL_DEPTH_TEST);
+
+	ShaderManager* pShadingShader = m_pShadingCache->GetShadingShader();
+	if (pShadingShader != NULL)
+	{
+		pShadingShader->use();
+		CopySceneUniforms(pSceneShader, pShadingShader);
+		m_pShadingCache->Shade(pViewManager);
+	}
+
+	m_draws.clear();
+	m_drawMeshes.clear();
+}
+
+/***********************************************************
+ *  CopySceneUniforms()
+ *
+ *  This method is used for reading the lighting settings
+ *  the scene program was given, the light count, mip bias
+ *  and table units, and setting them on the resolve or
+ *  shading cache program, so they shade alike.  The lights
+ *  themselves are in uniform blocks the programs share.
+ ***********************************************************/
+void VisibilityManager::CopySceneUniforms(ShaderManager* pSceneShader, ShaderManager* pShader)
+{
+	if (NULL == pSceneShader)
+	{
+		return;
+	}
+
+	for (const char* name : g_SharedIntUniforms)
+	{
+		GLint location = glGetUniformLocation(pSceneShader->m_programID, name);
+		if (location >= 0)
+		{
+			GLint value = 0;
+			glGetUniformiv(pSceneShader->m_programID, location, &value);
+			pShader->setIntValue(name, value);
+		}
+	}
+	for (const char* name : g_SharedFloatUniforms)
+	{
+		GLint location = glGetUniformLocation(pSceneShader->m_programID, name);
+		if (location >= 0)
+		{
+			GLfloat value = 0.0f;
+			glGetUniformfv(pSceneShader->m_programID, location, &value);
+			pShader->setFloatValue(name, value);
+		}
+	}
+}
@@ -0,0 +1,118 @@
+///////////////////////////////////////////////////////////////////////////////
+// visibilitymanager.h
+// ============
+// visibility buffer: rasterize triangle ids, then shade every pixel once
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "ShaderManager.h"
+#include "ShadingCacheManager.h"
+#include "ShapeMeshes.h"
+#include "VertexPool.h"
+#include "ViewManager.h"
+#include "UniformBlocks.h"
+
+#include <vector>
+
+/***********************************************************
+ *  VisibilityManager
+ *
+ *  This class draws the opaque objects of a frame in two
+ *  passes instead of shading them as they are rasterized.
+ *  The meshes are read from the vertex pool of the shapes,
+ *  whatever format they are stored in, and the objects of
+ *  the frame are kept as records of their transform,
+ *  material and texture.  The visibility pass draws all of
+ *  them with one indirect draw, pulling the vertices by
+ *  gl_VertexID, and only writes which draw and triangle is
+ *  nearest in each pixel into a 32 bit target over the
+ *  scene depth.  The resolve pass then runs the scene
+ *  fragment shader once per covered pixel: it fetches the
+ *  three vertices of the triangle, intersects the
+ *  pixel's ray with it for the attributes, and takes the
+ *  texture gradients from the rays of the neighbouring
+ *  pixels.  Small and overlapping triangles are then never
+ *  shaded more than once per pixel.
+ *
+ *  The target holds one id per pixel, so multisampled scene
+ *  targets are drawn the usual way.
+ *
+ *  The objects that stay put can have the shading that does
+ *  not depend on the view cached per triangle, see
+ *  ShadingCacheManager.h; the resolve pass reads it and
+ *  asks for what is missing, which is shaded after it.
+ ***********************************************************/
+class VisibilityManager
+{
+public:
+	// constructor, the meshes are read from the vertex pool of
+	// pShapeMeshes and the program binaries are cached in
+	// pDerivedDataCache when passed
+	VisibilityManager(ShapeMeshes* pShapeMeshes, DerivedDataCache* pDerivedDataCache = NULL);
+	// destructor
+	~VisibilityManager();
+
+	// start collecting the opaque draws of a frame; false when the
+	// scene target is multisampled or missing, the programs cannot
+	// be created or there is no vertex pool, and the objects must
+	// be drawn the usual way
+	bool BeginFrame(ViewManager* pViewManager);
+	// add an object drawn from a vertex pool mesh for this frame;
+	// false when the mesh is not in the pool or the frame is full.
+	// The mesh of the record is filled in here
+	bool AddDraw(int poolMesh, const VISIBILITY_DRAW_BLOCK& draw);
+	// rasterize the draws into the visibility target and shade
+	// the pixels they cover into the scene target, with the
+	// lighting settings of pSceneShader; the caller makes its
+	// own shader program current again afterwards
+	void EndFrame(ViewManager* pViewManager, ShaderManager* pSceneShader);
+	// the two halves of EndFrame(), for work that needs the
+	// depth of the frame before it is shaded: the visibility
+	// pass, false when there is nothing to draw, and then the
+	// resolve pass
+	bool DrawVisibilityPass(ViewManager* pViewManager);
+	void ResolvePass(ViewManager* pViewManager, ShaderManager* pSceneShader);
+
+	// turn the shading cache on or off
+	void SetShadingCache(bool bEnabled) { m_pShadingCache->SetEnabled(bEnabled); }
+	// the lighting changed, the cached shading is shaded again
+	void InvalidateShadingCache() { m_pShadingCache->Invalidate(); }
+
+private:
+	ShapeMeshes* m_pShapeMeshes;
+
+	// pass programs and the empty vertex array they draw with
+	ShaderManager* m_pVisibilityShader;
+	ShaderManager* m_pResolveShader;
+	GLuint m_emptyVAO;
+	bool m_bShadersLoaded;
+
+	ShadingCacheManager* m_pShadingCache;
+
+	// records and pool meshes of this frame's draws
+	std::vector<VISIBILITY_DRAW_BLOCK> m_draws;
+	std::vector<GLuint> m_drawMeshes;
+	GLuint m_drawBuffer;
+
+	// target of the draw and triangle ids
+	GLuint m_framebuffer;
+	GLuint m_visibilityTexture;
+	int m_width;
+	int m_height;
+
+	// load the pass programs, false if either failed
+	bool LoadShaders();
+	// create the visibility target at the scene target size
+	void CreateTargets(int width, int height);
+	// free the visibility target
+	void DestroyTargets();
+	// give the resolve or shading cache program, which must be
+	// current, the lighting settings the scene program shades with
+	void CopySceneUniforms(ShaderManager* pSceneShader, ShaderManager* pShader);
+};
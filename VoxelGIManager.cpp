@@ -0,0 +1,859 @@
+///////////////////////////////////////////////////////////////////////////////
+// voxelgimanager.cpp
+// ============
+// voxel cone traced indirect lighting from a clipmap of the scene
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VoxelGIManager.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	const char* g_VoxelizeVertexShader = "../../Utilities/shaders/voxelizeVertexShader.glsl";
+	const char* g_VoxelizeFragmentShader = "../../Utilities/shaders/voxelizeFragmentShader.glsl";
+	const char* g_FullscreenVertexShader = "../../Utilities/shaders/fullscreenVertexShader.glsl";
+	const char* g_FilterFragmentShader = "../../Utilities/shaders/voxelFilterFragmentShader.glsl";
+
+	// voxels along each side of a clip level, a power of two so the
+	// toroidal address is a mask, and the voxel size of the finest
+	// level in world units; the levels cover 8, 16, 32 and 64 units
+	const int g_VoxelResolution = 64;
+	const float g_BaseVoxelSize = 0.125f;
+
+	// the clip levels use the units after the visibility target,
+	// and the voxelization and filter passes write image unit 0
+	const GLuint g_ClipmapTextureUnit = 31;
+	const GLuint g_VoxelImageUnit = 0;
+	const char* g_ClipmapName = "voxelClipmap";
+
+	// voxels voxelized again per frame, a quarter of a level, and
+	// the dirty regions taken per frame.  Half the budget is split
+	// between the levels so the coarser ones are never starved by
+	// the finer ones.  A level with g_MaxQueuedRegions queued
+	// merges new regions into the last one
+	const size_t g_VoxelBudget = g_VoxelResolution * g_VoxelResolution * 16;
+	const size_t g_LevelShare = g_VoxelBudget / 2 / VOXEL_CLIP_LEVELS;
+	const int g_MaxRegionsPerFrame = 8;
+	const size_t g_MaxQueuedRegions = 16;
+
+	// moved objects are marked with a voxel of margin, since their
+	// triangles are rasterized at the voxel centers only
+	const int g_MarkMargin = 1;
+
+	// strength of the indirect light in the scene shader
+	const float g_DiffuseStrength = 1.0f;
+	const float g_SpecularStrength = 0.5f;
+
+	// division rounding toward negative infinity, for the world
+	// voxel indices below zero
+	int FloorDiv(int value, int divisor)
+	{
+		int quotient = value / divisor;
+		if (((value % divisor) != 0) && ((value < 0) != (divisor < 0)))
+		{
+			quotient--;
+		}
+		return(quotient);
+	}
+
+	glm::ivec3 FloorDiv(glm::ivec3 value, int divisor)
+	{
+		return(glm::ivec3(FloorDiv(value.x, divisor), FloorDiv(value.y, divisor), FloorDiv(value.z, divisor)));
+	}
+
+	float LevelVoxelSize(int level)
+	{
+		return(g_BaseVoxelSize * (float)(1 << level));
+	}
+
+	bool IsEmptyBox(glm::ivec3 boxMin, glm::ivec3 boxMax)
+	{
+		return((boxMin.x >= boxMax.x) || (boxMin.y >= boxMax.y) || (boxMin.z >= boxMax.z));
+	}
+
+	size_t BoxVoxels(glm::ivec3 boxMin, glm::ivec3 boxMax)
+	{
+		glm::ivec3 extent = boxMax - boxMin;
+		return((size_t)extent.x * (size_t)extent.y * (size_t)extent.z);
+	}
+
+	// the part of box a outside box b, as up to six boxes
+	void SubtractBox(
+		glm::ivec3 aMin, glm::ivec3 aMax,
+		glm::ivec3 bMin, glm::ivec3 bMax,
+		std::vector<std::pair<glm::ivec3, glm::ivec3>>& pieces)
+	{
+		if (IsEmptyBox(glm::max(aMin, bMin), glm::min(aMax, bMax)) == true)
+		{
+			pieces.push_back(std::make_pair(aMin, aMax));
+			return;
+		}
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (aMin[axis] < bMin[axis])
+			{
+				glm::ivec3 pieceMax = aMax;
+				pieceMax[axis] = bMin[axis];
+				pieces.push_back(std::make_pair(aMin, pieceMax));
+				aMin[axis] = bMin[axis];
+			}
+			if (aMax[axis] > bMax[axis])
+			{
+				glm::ivec3 pieceMin = aMin;
+				pieceMin[axis] = bMax[axis];
+				pieces.push_back(std::make_pair(pieceMin, aMax));
+				aMax[axis] = bMax[axis];
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  VoxelGIManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+VoxelGIManager::VoxelGIManager(ShapeMeshes* pShapeMeshes, DerivedDataCache* pDerivedDataCache)
+{
+	m_pShapeMeshes = pShapeMeshes;
+	m_pVoxelizeShader = new ShaderManager();
+	m_pVoxelizeShader->m_programID = 0;
+	m_pVoxelizeShader->m_pDerivedDataCache = pDerivedDataCache;
+	m_pFilterShader = new ShaderManager();
+	m_pFilterShader->m_programID = 0;
+	m_pFilterShader->m_pDerivedDataCache = pDerivedDataCache;
+	m_emptyVAO = 0;
+	m_bShadersLoaded = false;
+	for (int level = 0; level < VOXEL_CLIP_LEVELS; level++)
+	{
+		m_clipmapTextures[level] = 0;
+		m_levelOrigins[level] = glm::ivec3(0);
+		m_bLevelPlaced[level] = false;
+		m_sweepCursors[level] = 0;
+		m_sweepSlabs[level] = 0;
+	}
+	m_framebuffer = 0;
+	m_drawBuffer = 0;
+	m_giUBO = 0;
+	m_block = VOXEL_GI_BLOCK();
+	m_block.voxelResolution = g_VoxelResolution;
+	m_block.voxelDiffuseStrength = g_DiffuseStrength;
+	m_block.voxelSpecularStrength = g_SpecularStrength;
+	m_bEnabled = false;
+	m_lighting = LIGHTING_BLOCK();
+	m_areaLighting = AREA_LIGHTING_BLOCK();
+}
+
+/***********************************************************
+ *  ~VoxelGIManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+VoxelGIManager::~VoxelGIManager()
+{
+	glDeleteTextures(VOXEL_CLIP_LEVELS, m_clipmapTextures);
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	glDeleteBuffers(1, &m_drawBuffer);
+	m_drawBuffer = 0;
+	glDeleteBuffers(1, &m_giUBO);
+	m_giUBO = 0;
+	if (m_emptyVAO != 0)
+	{
+		glDeleteVertexArrays(1, &m_emptyVAO);
+		m_emptyVAO = 0;
+	}
+	if (m_pVoxelizeShader->m_programID != 0)
+	{
+		glDeleteProgram(m_pVoxelizeShader->m_programID);
+	}
+	if (m_pFilterShader->m_programID != 0)
+	{
+		glDeleteProgram(m_pFilterShader->m_programID);
+	}
+	delete m_pVoxelizeShader;
+	delete m_pFilterShader;
+	m_pVoxelizeShader = NULL;
+	m_pFilterShader = NULL;
+	m_pShapeMeshes = NULL;
+}
+
+/***********************************************************
+ *  CreateUniformBlock()
+ *
+ *  This method is used for creating the uniform buffer of
+ *  the clipmap placement and attaching it to its binding
+ *  point.  It starts with the indirect light off, so the
+ *  scene shader reads a valid block before the clipmap
+ *  exists.
+ ***********************************************************/
+void VoxelGIManager::CreateUniformBlock()
+{
+	if (m_giUBO == 0)
+	{
+		glCreateBuffers(1, &m_giUBO);
+		glNamedBufferStorage(m_giUBO, sizeof(VOXEL_GI_BLOCK), &m_block, GL_DYNAMIC_STORAGE_BIT);
+		glBindBufferBase(GL_UNIFORM_BUFFER, VOXEL_GI_BLOCK_BINDING, m_giUBO);
+	}
+}
+
+/***********************************************************
+ *  SetSamplers()
+ *
+ *  This method is used for pointing the clipmap samplers of
+ *  the program in use at their units.  A 3D sampler left on
+ *  unit 0 with the 2D scene textures would fail every draw,
+ *  so this is done whether the indirect light is on or not.
+ ***********************************************************/
+void VoxelGIManager::SetSamplers(ShaderManager* pShader)
+{
+	GLint units[VOXEL_CLIP_LEVELS];
+	for (int level = 0; level < VOXEL_CLIP_LEVELS; level++)
+	{
+		units[level] = (GLint)(g_ClipmapTextureUnit + level);
+	}
+	glUniform1iv(glGetUniformLocation(pShader->m_programID, g_ClipmapName), VOXEL_CLIP_LEVELS, units);
+}
+
+/***********************************************************
+ *  SetEnabled()
+ ***********************************************************/
+void VoxelGIManager::SetEnabled(bool bEnabled)
+{
+	m_bEnabled = bEnabled;
+	UploadBlock();
+}
+
+/***********************************************************
+ *  LoadShaders()
+ *
+ *  This method is used for loading the voxelization and
+ *  filter programs and creating the clipmap the first time
+ *  the indirect light is on.  If either program fails the
+ *  indirect light stays off.
+ ***********************************************************/
+bool VoxelGIManager::LoadShaders()
+{
+	if (m_bShadersLoaded == false)
+	{
+		m_bShadersLoaded = true;
+		m_pVoxelizeShader->LoadShaders(g_VoxelizeVertexShader, g_VoxelizeFragmentShader, VertexPool::GLSLDeclaration());
+		m_pFilterShader->LoadShaders(g_FullscreenVertexShader, g_FilterFragmentShader);
+		if ((m_pVoxelizeShader->m_programID == 0) || (m_pFilterShader->m_programID == 0))
+		{
+			std::cout << "Could not load the voxelization shaders, indirect light is off" << std::endl;
+			glDeleteProgram(m_pVoxelizeShader->m_programID);
+			m_pVoxelizeShader->m_programID = 0;
+		}
+		else
+		{
+			CreateTextures();
+			glCreateBuffers(1, &m_drawBuffer);
+			glCreateVertexArrays(1, &m_emptyVAO);
+		}
+	}
+	return(m_pVoxelizeShader->m_programID != 0);
+}
+
+/***********************************************************
+ *  CreateTextures()
+ *
+ *  This method is used for creating the clip levels.  They
+ *  repeat, so a voxel's world index wrapped at the
+ *  resolution is its texel and filtering across the wrap
+ *  reads the right neighbours.  The voxelization draws
+ *  into a framebuffer without attachments, the size of a
+ *  level's side.
+ ***********************************************************/
+void VoxelGIManager::CreateTextures()
+{
+	glCreateTextures(GL_TEXTURE_3D, VOXEL_CLIP_LEVELS, m_clipmapTextures);
+	for (int level = 0; level < VOXEL_CLIP_LEVELS; level++)
+	{
+		GLuint texture = m_clipmapTextures[level];
+		glTextureStorage3D(texture, 1, GL_RGBA16F, g_VoxelResolution, g_VoxelResolution, g_VoxelResolution);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_R, GL_REPEAT);
+		glClearTexImage(texture, 0, GL_RGBA, GL_FLOAT, NULL);
+		glBindTextureUnit(g_ClipmapTextureUnit + level, texture);
+	}
+
+	glCreateFramebuffers(1, &m_framebuffer);
+	glNamedFramebufferParameteri(m_framebuffer, GL_FRAMEBUFFER_DEFAULT_WIDTH, g_VoxelResolution);
+	glNamedFramebufferParameteri(m_framebuffer, GL_FRAMEBUFFER_DEFAULT_HEIGHT, g_VoxelResolution);
+}
+
+/***********************************************************
+ *  UploadBlock()
+ *
+ *  This method is used for copying where the clip levels
+ *  are into the uniform buffer.  The indirect light is only
+ *  on once every level has been placed.
+ ***********************************************************/
+void VoxelGIManager::UploadBlock()
+{
+	bool bPlaced = true;
+	for (int level = 0; level < VOXEL_CLIP_LEVELS; level++)
+	{
+		float voxelSize = LevelVoxelSize(level);
+		m_block.voxelLevelOrigins[level] = glm::vec4(glm::vec3(m_levelOrigins[level]) * voxelSize, voxelSize);
+		bPlaced = bPlaced && m_bLevelPlaced[level];
+	}
+	m_block.bVoxelGI = (m_bEnabled == true) && (bPlaced == true) && (m_pVoxelizeShader->m_programID != 0);
+	if (m_giUBO != 0)
+	{
+		glNamedBufferSubData(m_giUBO, 0, sizeof(VOXEL_GI_BLOCK), &m_block);
+	}
+}
+
+/***********************************************************
+ *  GetPendingVoxels()
+ ***********************************************************/
+size_t VoxelGIManager::GetPendingVoxels() const
+{
+	size_t voxels = 0;
+	for (int level = 0; level < VOXEL_CLIP_LEVELS; level++)
+	{
+		for (const DIRTY_REGION& region : m_dirtyRegions[level])
+		{
+			voxels += BoxVoxels(region.min, region.max);
+		}
+		voxels += (size_t)m_sweepSlabs[level] * g_VoxelResolution * g_VoxelResolution;
+	}
+	return(voxels);
+}
+
+/***********************************************************
+ *  FollowCamera()
+ *
+ *  This method is used for centering every level on the
+ *  camera.  The origins move in steps of two voxels, so a
+ *  level's window always starts on a voxel of the next
+ *  coarser one.  Only the slabs a level moved into are
+ *  marked, and on the coarser level the voxels the finer
+ *  one moved into or out of, whose filtered values change.
+ ***********************************************************/
+void VoxelGIManager::FollowCamera(glm::vec3 position)
+{
+	glm::ivec3 origins[VOXEL_CLIP_LEVELS];
+	for (int level = 0; level < VOXEL_CLIP_LEVELS; level++)
+	{
+		glm::ivec3 center = glm::ivec3(glm::floor(position / LevelVoxelSize(level)));
+		origins[level] = FloorDiv(center - glm::ivec3(g_VoxelResolution / 2), 2) * 2;
+	}
+
+	bool bMoved = false;
+	glm::ivec3 side = glm::ivec3(g_VoxelResolution);
+	std::vector<std::pair<glm::ivec3, glm::ivec3>> pieces;
+	for (int level = 0; level < VOXEL_CLIP_LEVELS; level++)
+	{
+		glm::ivec3 oldOrigin = m_levelOrigins[level];
+		glm::ivec3 newOrigin = origins[level];
+		if ((m_bLevelPlaced[level] == true) && (oldOrigin == newOrigin))
+		{
+			continue;
+		}
+		bMoved = true;
+
+		pieces.clear();
+		if (m_bLevelPlaced[level] == false)
+		{
+			pieces.push_back(std::make_pair(newOrigin, newOrigin + side));
+		}
+		else
+		{
+			SubtractBox(newOrigin, newOrigin + side, oldOrigin, oldOrigin + side, pieces);
+		}
+		for (const auto& piece : pieces)
+		{
+			QueueRegion({ level, piece.first, piece.second });
+		}
+
+		if ((m_bLevelPlaced[level] == true) && (level + 1 < VOXEL_CLIP_LEVELS))
+		{
+			SubtractBox(oldOrigin, oldOrigin + side, newOrigin, newOrigin + side, pieces);
+			for (const auto& piece : pieces)
+			{
+				QueueRegion({ level + 1, FloorDiv(piece.first, 2), FloorDiv(piece.second + glm::ivec3(1), 2) });
+			}
+		}
+
+		m_levelOrigins[level] = newOrigin;
+		m_bLevelPlaced[level] = true;
+	}
+
+	if (bMoved == true)
+	{
+		UploadBlock();
+	}
+}
+
+/***********************************************************
+ *  MarkBox()
+ *
+ *  This method is used for marking the voxels a world box
+ *  touches on every level, finer levels first.  Parts
+ *  outside a level's window are dropped when the region
+ *  is taken.
+ ***********************************************************/
+void VoxelGIManager::MarkBox(glm::vec3 boxMin, glm::vec3 boxMax)
+{
+	for (int level = 0; level < VOXEL_CLIP_LEVELS; level++)
+	{
+		float voxelSize = LevelVoxelSize(level);
+		DIRTY_REGION region;
+		region.level = level;
+		region.min = glm::ivec3(glm::floor(boxMin / voxelSize)) - glm::ivec3(g_MarkMargin);
+		region.max = glm::ivec3(glm::floor(boxMax / voxelSize)) + glm::ivec3(1 + g_MarkMargin);
+		QueueRegion(region);
+	}
+}
+
+/***********************************************************
+ *  QueueRegion()
+ *
+ *  This method is used for adding a region to the queue of
+ *  its level.  A region that overlaps or touches the last
+ *  queued one is merged into it, as is any region once the
+ *  level has g_MaxQueuedRegions queued, so the queue stays
+ *  short however many objects move.  The rest of a region
+ *  that was cut by the budget is never merged into, or the
+ *  slices already done would be queued again every frame;
+ *  new regions wait behind it.
+ ***********************************************************/
+void VoxelGIManager::QueueRegion(const DIRTY_REGION& region)
+{
+	std::deque<DIRTY_REGION>& queue = m_dirtyRegions[region.level];
+	if (queue.empty() == false)
+	{
+		DIRTY_REGION& last = queue.back();
+		if (last.bStarted == true)
+		{
+			queue.push_back(region);
+			return;
+		}
+		bool bTouches = (glm::any(glm::lessThan(region.max, last.min)) == false)
+			&& (glm::any(glm::lessThan(last.max, region.min)) == false);
+		if ((bTouches == true) || (queue.size() >= g_MaxQueuedRegions))
+		{
+			last.min = glm::min(last.min, region.min);
+			last.max = glm::max(last.max, region.max);
+			return;
+		}
+	}
+	queue.push_back(region);
+}
+
+/***********************************************************
+ *  MarkAll()
+ *
+ *  This method is used for voxelizing every level again.
+ *  Each level is swept slab by slab from where its last
+ *  sweep stopped, for a whole window's worth of slabs, so
+ *  marking everything again before a sweep finished does
+ *  not throw away what it already did.  The queued regions
+ *  are covered by the sweep and dropped.
+ ***********************************************************/
+void VoxelGIManager::MarkAll()
+{
+	for (int level = 0; level < VOXEL_CLIP_LEVELS; level++)
+	{
+		m_dirtyRegions[level].clear();
+		if (m_bLevelPlaced[level] == true)
+		{
+			m_sweepSlabs[level] = g_VoxelResolution;
+		}
+	}
+}
+
+/***********************************************************
+ *  CompareObjects()
+ *
+ *  This method is used for finding the objects that changed
+ *  since the clipmap was voxelized with them.  The scene
+ *  draws its objects in the same order every frame, so
+ *  they are compared by position in the list: where an
+ *  object moved, both where it was and where it is now
+ *  are marked, and when the list grew or shrank so are the
+ *  objects past the end of the shorter one.  The boxes of
+ *  a frame are marked as one box around all of them.
+ ***********************************************************/
+void VoxelGIManager::CompareObjects(const std::vector<VOXEL_OBJECT>& objects)
+{
+	VertexPool* pVertexPool = m_pShapeMeshes->GetVertexPool();
+	size_t oldCount = m_objects.size();
+	size_t newCount = objects.size();
+
+	std::vector<glm::vec3> mins(newCount);
+	std::vector<glm::vec3> maxs(newCount);
+	for (size_t i = 0; i < newCount; i++)
+	{
+		// the world box around the transformed corners of the mesh
+		glm::vec3 meshMin(0.0f);
+		glm::vec3 meshMax(0.0f);
+		pVertexPool->GetMeshBounds(objects[i].poolMesh, meshMin, meshMax);
+		mins[i] = glm::vec3(FLT_MAX);
+		maxs[i] = glm::vec3(-FLT_MAX);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 point(
+				(corner & 1) ? meshMax.x : meshMin.x,
+				(corner & 2) ? meshMax.y : meshMin.y,
+				(corner & 4) ? meshMax.z : meshMin.z);
+			point = glm::vec3(objects[i].model * glm::vec4(point, 1.0f));
+			mins[i] = glm::min(mins[i], point);
+			maxs[i] = glm::max(maxs[i], point);
+		}
+	}
+
+	glm::vec3 changedMin = glm::vec3(FLT_MAX);
+	glm::vec3 changedMax = glm::vec3(-FLT_MAX);
+	for (size_t i = 0; i < std::max(oldCount, newCount); i++)
+	{
+		bool bOld = (i < oldCount);
+		bool bNew = (i < newCount);
+		if ((bOld == true) && (bNew == true)
+			&& (m_objects[i].poolMesh == objects[i].poolMesh)
+			&& (m_objects[i].model == objects[i].model)
+			&& (m_objects[i].albedo == objects[i].albedo))
+		{
+			continue;
+		}
+		if (bOld == true)
+		{
+			changedMin = glm::min(changedMin, m_objectMins[i]);
+			changedMax = glm::max(changedMax, m_objectMaxs[i]);
+		}
+		if (bNew == true)
+		{
+			changedMin = glm::min(changedMin, mins[i]);
+			changedMax = glm::max(changedMax, maxs[i]);
+		}
+	}
+	if (glm::any(glm::greaterThan(changedMin, changedMax)) == false)
+	{
+		MarkBox(changedMin, changedMax);
+	}
+
+	m_objects = objects;
+	m_objectMins.swap(mins);
+	m_objectMaxs.swap(maxs);
+}
+
+/***********************************************************
+ *  AddObject()
+ ***********************************************************/
+void VoxelGIManager::AddObject(const VOXEL_OBJECT& object)
+{
+	if ((m_bEnabled == true) && (object.poolMesh >= 0))
+	{
+		m_frameObjects.push_back(object);
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for bringing the clipmap up to date
+ *  with the objects added since the last update, the ones
+ *  of the last frame, and the lights.  A change
+ *  of any light relights every voxel, otherwise only the
+ *  voxels around the objects that changed are voxelized
+ *  again.  Every level first gets its share of the voxel
+ *  budget, finer levels first, then the rest of the budget
+ *  goes to the finer levels that still have work.
+ ***********************************************************/
+void VoxelGIManager::Update(
+	ViewManager* pViewManager,
+	const LIGHTING_BLOCK& lighting,
+	const AREA_LIGHTING_BLOCK& areaLighting)
+{
+	if ((m_bEnabled == false) || (NULL == pViewManager) || (m_pShapeMeshes->GetVertexPool() == NULL)
+		|| (LoadShaders() == false))
+	{
+		m_frameObjects.clear();
+		return;
+	}
+
+	FollowCamera(pViewManager->GetCameraPosition());
+	CompareObjects(m_frameObjects);
+	m_frameObjects.clear();
+	if ((memcmp(&lighting, &m_lighting, sizeof(LIGHTING_BLOCK)) != 0)
+		|| (memcmp(&areaLighting, &m_areaLighting, sizeof(AREA_LIGHTING_BLOCK)) != 0))
+	{
+		m_lighting = lighting;
+		m_areaLighting = areaLighting;
+		MarkAll();
+	}
+
+	size_t budget = g_VoxelBudget;
+	int regions = 0;
+	for (int level = 0; level < VOXEL_CLIP_LEVELS; level++)
+	{
+		budget -= std::min(budget, UpdateLevel(level, g_LevelShare, regions + 1, regions));
+	}
+	for (int level = 0; (level < VOXEL_CLIP_LEVELS) && (budget > 0); level++)
+	{
+		budget -= std::min(budget, UpdateLevel(level, budget, g_MaxRegionsPerFrame, regions));
+	}
+}
+
+/***********************************************************
+ *  UpdateLevel()
+ *
+ *  This method is used for voxelizing the queued regions of
+ *  a level, then the slabs of its sweep, until the budget
+ *  is spent.  A region larger than what is left is cut into
+ *  slices along its longest side, and the rest waits for
+ *  the next frame at the front of the queue.  The voxels of the next coarser level
+ *  over a voxelized region are filtered from it, so they
+ *  are queued again.
+ ***********************************************************/
+size_t VoxelGIManager::UpdateLevel(int level, size_t budget, int maxRegions, int& regions)
+{
+	std::deque<DIRTY_REGION>& queue = m_dirtyRegions[level];
+	glm::ivec3 origin = m_levelOrigins[level];
+	size_t spent = 0;
+	while ((regions < maxRegions) && (spent < budget))
+	{
+		DIRTY_REGION region;
+		size_t voxels = 0;
+		if (queue.empty() == false)
+		{
+			region = queue.front();
+			queue.pop_front();
+
+			// only the voxels inside the level's window are stored
+			region.min = glm::max(region.min, origin);
+			region.max = glm::min(region.max, origin + glm::ivec3(g_VoxelResolution));
+			if (IsEmptyBox(region.min, region.max) == true)
+			{
+				continue;
+			}
+
+			voxels = BoxVoxels(region.min, region.max);
+			if (voxels > budget - spent)
+			{
+				glm::ivec3 extent = region.max - region.min;
+				int axis = (extent.x >= extent.y) ? ((extent.x >= extent.z) ? 0 : 2) : ((extent.y >= extent.z) ? 1 : 2);
+				size_t sliceVoxels = voxels / (size_t)extent[axis];
+				int slices = std::max(1, (int)((budget - spent) / sliceVoxels));
+				if (slices < extent[axis])
+				{
+					DIRTY_REGION rest = region;
+					rest.min[axis] += slices;
+					rest.bStarted = true;
+					region.max[axis] = region.min[axis] + slices;
+					queue.push_front(rest);
+					voxels = BoxVoxels(region.min, region.max);
+				}
+			}
+		}
+		else if (m_sweepSlabs[level] > 0)
+		{
+			// the next slabs along z, up to the edge of the window
+			size_t slabVoxels = (size_t)g_VoxelResolution * g_VoxelResolution;
+			int slabs = std::max(1, (int)((budget - spent) / slabVoxels));
+			slabs = std::min(slabs, std::min(m_sweepSlabs[level], g_VoxelResolution - m_sweepCursors[level]));
+			region.level = level;
+			region.min = origin;
+			region.max = origin + glm::ivec3(g_VoxelResolution);
+			region.min.z += m_sweepCursors[level];
+			region.max.z = region.min.z + slabs;
+			m_sweepCursors[level] = (m_sweepCursors[level] + slabs) % g_VoxelResolution;
+			m_sweepSlabs[level] -= slabs;
+			voxels = BoxVoxels(region.min, region.max);
+		}
+		else
+		{
+			break;
+		}
+
+		VoxelizeRegion(region);
+		spent += voxels;
+		regions++;
+
+		if (level + 1 < VOXEL_CLIP_LEVELS)
+		{
+			QueueRegion({ level + 1, FloorDiv(region.min, 2), FloorDiv(region.max + glm::ivec3(1), 2) });
+		}
+	}
+	return(spent);
+}
+
+/***********************************************************
+ *  ClearRegion()
+ *
+ *  This method is used for clearing the voxels of a region
+ *  before it is voxelized.  Where the region wraps around
+ *  the edge of the texture it is cleared in pieces.
+ ***********************************************************/
+void VoxelGIManager::ClearRegion(const DIRTY_REGION& region)
+{
+	glm::ivec3 start = region.min & glm::ivec3(g_VoxelResolution - 1);
+	glm::ivec3 extent = region.max - region.min;
+
+	// the first and second piece along each axis
+	glm::ivec3 firstSize = glm::min(extent, glm::ivec3(g_VoxelResolution) - start);
+	for (int piece = 0; piece < 8; piece++)
+	{
+		glm::ivec3 offset;
+		glm::ivec3 size;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			bool bSecond = ((piece >> axis) & 1) != 0;
+			offset[axis] = bSecond ? 0 : start[axis];
+			size[axis] = bSecond ? (extent[axis] - firstSize[axis]) : firstSize[axis];
+		}
+		if ((size.x > 0) && (size.y > 0) && (size.z > 0))
+		{
+			glClearTexSubImage(m_clipmapTextures[region.level], 0,
+				offset.x, offset.y, offset.z, size.x, size.y, size.z,
+				GL_RGBA, GL_FLOAT, NULL);
+		}
+	}
+}
+
+/***********************************************************
+ *  VoxelizeRegion()
+ *
+ *  This method is used for voxelizing the objects that
+ *  overlap a region into it.  Without a geometry shader to
+ *  pick each triangle's dominant axis, the objects are
+ *  drawn three times, projected along x, y and z onto the
+ *  region, so no triangle is seen edge on in all of them.
+ *  The region's depth along the axis is the clip volume,
+ *  and each fragment stores its lit albedo into its voxel.
+ *  A coarser level is then filtered from the finer one
+ *  where it covers the region.
+ ***********************************************************/
+void VoxelGIManager::VoxelizeRegion(const DIRTY_REGION& region)
+{
+	ClearRegion(region);
+
+	float voxelSize = LevelVoxelSize(region.level);
+	glm::vec3 worldMin = glm::vec3(region.min) * voxelSize;
+	glm::vec3 worldMax = glm::vec3(region.max) * voxelSize;
+
+	std::vector<VOXEL_DRAW_BLOCK> draws;
+	std::vector<GLuint> meshes;
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		if ((glm::any(glm::lessThan(m_objectMaxs[i], worldMin)) == true)
+			|| (glm::any(glm::greaterThan(m_objectMins[i], worldMax)) == true))
+		{
+			continue;
+		}
+		VOXEL_DRAW_BLOCK draw = VOXEL_DRAW_BLOCK();
+		draw.model = m_objects[i].model;
+		draw.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(m_objects[i].model))));
+		draw.albedo = glm::vec4(m_objects[i].albedo, 1.0f);
+		draws.push_back(draw);
+		meshes.push_back((GLuint)m_objects[i].poolMesh);
+	}
+
+	if (draws.size() > 0)
+	{
+		glNamedBufferData(m_drawBuffer, draws.size() * sizeof(VOXEL_DRAW_BLOCK), draws.data(), GL_STREAM_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VOXEL_DRAW_BINDING, m_drawBuffer);
+
+		GLboolean bCullFace = glIsEnabled(GL_CULL_FACE);
+		glDisable(GL_CULL_FACE);
+		glDisable(GL_DEPTH_TEST);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		glBindImageTexture(g_VoxelImageUnit, m_clipmapTextures[region.level], 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+		m_pVoxelizeShader->use();
+		m_pVoxelizeShader->setFloatValue("voxelSize", voxelSize);
+		m_pVoxelizeShader->setIntValue("voxelResolution", g_VoxelResolution);
+		m_pVoxelizeShader->setIVec3Value("regionMin", region.min);
+		m_pVoxelizeShader->setIVec3Value("regionMax", region.max);
+		m_pShapeMeshes->GetVertexPool()->Bind();
+
+		glm::vec3 extent = worldMax - worldMin;
+		glm::ivec3 voxelExtent = region.max - region.min;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			// the other two axes across the viewport, this one
+			// through the clip depth
+			int u = (axis + 1) % 3;
+			int v = (axis + 2) % 3;
+			glm::mat4 projection(0.0f);
+			projection[u][0] = 2.0f / extent[u];
+			projection[3][0] = -2.0f * worldMin[u] / extent[u] - 1.0f;
+			projection[v][1] = 2.0f / extent[v];
+			projection[3][1] = -2.0f * worldMin[v] / extent[v] - 1.0f;
+			projection[axis][2] = 2.0f / extent[axis];
+			projection[3][2] = -2.0f * worldMin[axis] / extent[axis] - 1.0f;
+			projection[3][3] = 1.0f;
+
+			glViewport(0, 0, voxelExtent[u], voxelExtent[v]);
+			m_pVoxelizeShader->setMat4Value("voxelProjection", projection);
+			m_pShapeMeshes->GetVertexPool()->MultiDrawMeshes(meshes);
+		}
+
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+		glEnable(GL_DEPTH_TEST);
+		if (bCullFace == GL_TRUE)
+		{
+			glEnable(GL_CULL_FACE);
+		}
+	}
+
+	if (region.level > 0)
+	{
+		FilterRegion(region);
+	}
+}
+
+/***********************************************************
+ *  FilterRegion()
+ *
+ *  This method is used for replacing the voxels of a region
+ *  that the next finer level covers with the average of its
+ *  2x2x2 voxels, as the mip of a 3D texture would be.  Wide
+ *  cones then see partly covered voxels there instead of
+ *  the solid ones the rasterizer stored.  Each fragment of
+ *  a full screen triangle the size of the region's x and y
+ *  fills a column of voxels along z.
+ ***********************************************************/
+void VoxelGIManager::FilterRegion(const DIRTY_REGION& region)
+{
+	glm::ivec3 finerOrigin = m_levelOrigins[region.level - 1];
+	glm::ivec3 filterMin = glm::max(region.min, FloorDiv(finerOrigin, 2));
+	glm::ivec3 filterMax = glm::min(region.max, FloorDiv(finerOrigin + glm::ivec3(g_VoxelResolution), 2));
+	if (IsEmptyBox(filterMin, filterMax) == true)
+	{
+		return;
+	}
+
+	glDisable(GL_DEPTH_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, filterMax.x - filterMin.x, filterMax.y - filterMin.y);
+	glBindImageTexture(g_VoxelImageUnit, m_clipmapTextures[region.level], 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+	m_pFilterShader->use();
+	m_pFilterShader->setIntValue("finerLevel", (int)(g_ClipmapTextureUnit + region.level - 1));
+	m_pFilterShader->setIntValue("voxelResolution", g_VoxelResolution);
+	m_pFilterShader->setIVec3Value("filterMin", filterMin);
+	m_pFilterShader->setIntValue("filterDepth", filterMax.z - filterMin.z);
+	glBindVertexArray(m_emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+	glEnable(GL_DEPTH_TEST);
+}
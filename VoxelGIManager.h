@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+// voxelgimanager.h
+// ============
+// voxel cone traced indirect lighting from a clipmap of the scene
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "ShaderManager.h"
+#include "ShapeMeshes.h"
+#include "VertexPool.h"
+#include "ViewManager.h"
+#include "UniformBlocks.h"
+
+#include <deque>
+#include <vector>
+
+/***********************************************************
+ *  VoxelGIManager
+ *
+ *  This class keeps the lit scene around the camera as a
+ *  clipmap: VOXEL_CLIP_LEVELS 3D textures of the same
+ *  resolution, each with voxels twice the size of the one
+ *  before.  Every voxel holds the light its surfaces
+ *  reflect from the light sources, and how much of it is
+ *  covered.  The scene fragment shader traces a few wide
+ *  cones over the hemisphere for the diffuse light and one
+ *  along the reflection for the specular light, reading a
+ *  coarser level the wider the cone gets.
+ *
+ *  The levels are addressed toroidally: a voxel is stored
+ *  at its world index wrapped at the resolution, so when a
+ *  level follows the camera only the slab it moved into is
+ *  voxelized again.  Objects are voxelized by drawing them
+ *  from the vertex pool along the three axes and storing
+ *  each fragment into its voxel, and a level's voxels
+ *  inside the next finer level are then filtered down from
+ *  it, like a mip.  Only the regions around objects that
+ *  moved are voxelized again, or all of them when a light
+ *  changed, and at most a fixed number of voxels a frame,
+ *  so the rest waits for the next frames.
+ ***********************************************************/
+class VoxelGIManager
+{
+public:
+	// constructor, the meshes are read from the vertex pool of
+	// pShapeMeshes and the program binaries are cached in
+	// pDerivedDataCache when passed
+	VoxelGIManager(ShapeMeshes* pShapeMeshes, DerivedDataCache* pDerivedDataCache = NULL);
+	// destructor
+	~VoxelGIManager();
+
+	// an opaque object of the scene as it is voxelized
+	struct VOXEL_OBJECT
+	{
+		glm::mat4 model;
+		glm::vec3 albedo;
+		int poolMesh;
+	};
+
+	// create the uniform buffer the scene shader reads the
+	// clipmap placement from, with the indirect light off
+	void CreateUniformBlock();
+	// point the clipmap samplers of a program at their units
+	void SetSamplers(ShaderManager* pShader);
+
+	// turn the indirect light on or off; the clipmap is kept
+	// and brought up to date again when it comes back on
+	void SetEnabled(bool bEnabled);
+	bool GetEnabled() const { return(m_bEnabled); }
+
+	// add an opaque object drawn this frame; objects without a
+	// vertex pool mesh are left out
+	void AddObject(const VOXEL_OBJECT& object);
+	// follow the camera, find what the objects added since the
+	// last update and the lights changed, and voxelize the dirty
+	// regions within the budget; the caller restores its
+	// framebuffer, viewport and program afterwards
+	void Update(
+		ViewManager* pViewManager,
+		const LIGHTING_BLOCK& lighting,
+		const AREA_LIGHTING_BLOCK& areaLighting);
+
+	// voxels still waiting to be voxelized again
+	size_t GetPendingVoxels() const;
+
+private:
+	// a box of voxels of one level, in world voxel indices
+	struct DIRTY_REGION
+	{
+		int level;
+		glm::ivec3 min;
+		glm::ivec3 max;
+		// the rest of a region cut by the budget, never grown
+		bool bStarted = false;
+	};
+
+	ShapeMeshes* m_pShapeMeshes;
+
+	// voxelization and filter programs and the empty vertex array
+	// of the filter pass
+	ShaderManager* m_pVoxelizeShader;
+	ShaderManager* m_pFilterShader;
+	GLuint m_emptyVAO;
+	bool m_bShadersLoaded;
+
+	// the clip levels, a framebuffer without attachments to
+	// rasterize into them, and the records of the voxelized draws
+	GLuint m_clipmapTextures[VOXEL_CLIP_LEVELS];
+	GLuint m_framebuffer;
+	GLuint m_drawBuffer;
+	GLuint m_giUBO;
+	VOXEL_GI_BLOCK m_block;
+	bool m_bEnabled;
+
+	// lowest voxel of each level, and whether it was placed yet
+	glm::ivec3 m_levelOrigins[VOXEL_CLIP_LEVELS];
+	bool m_bLevelPlaced[VOXEL_CLIP_LEVELS];
+
+	// the objects added for the next update, and the objects and
+	// lights the clipmap was voxelized with
+	std::vector<VOXEL_OBJECT> m_frameObjects;
+	std::vector<VOXEL_OBJECT> m_objects;
+	std::vector<glm::vec3> m_objectMins;
+	std::vector<glm::vec3> m_objectMaxs;
+	LIGHTING_BLOCK m_lighting;
+	AREA_LIGHTING_BLOCK m_areaLighting;
+
+	// regions of each level to voxelize again
+	std::deque<DIRTY_REGION> m_dirtyRegions[VOXEL_CLIP_LEVELS];
+	// the slab of each level's window the relight sweep takes
+	// next, and the slabs left before it covered the whole window
+	int m_sweepCursors[VOXEL_CLIP_LEVELS];
+	int m_sweepSlabs[VOXEL_CLIP_LEVELS];
+
+	// load the programs, false if either failed
+	bool LoadShaders();
+	// create the clip level textures
+	void CreateTextures();
+	// move the levels with the camera, marking the slabs they
+	// moved into
+	void FollowCamera(glm::vec3 position);
+	// mark the regions around the objects that changed
+	void CompareObjects(const std::vector<VOXEL_OBJECT>& objects);
+	// mark a world box on every level
+	void MarkBox(glm::vec3 boxMin, glm::vec3 boxMax);
+	// queue a region on its level, merged into a queued one it
+	// touches
+	void QueueRegion(const DIRTY_REGION& region);
+	// mark every voxel of every level
+	void MarkAll();
+	// voxelize the queued regions and then the sweep of a level
+	// within a voxel budget, returns the voxels spent
+	size_t UpdateLevel(int level, size_t budget, int maxRegions, int& regions);
+	// voxelize a region after clearing it
+	void VoxelizeRegion(const DIRTY_REGION& region);
+	// average the finer level into the part of a region it covers
+	void FilterRegion(const DIRTY_REGION& region);
+	// clear a region, in up to eight pieces where it wraps
+	void ClearRegion(const DIRTY_REGION& region);
+	// copy the level placement into the uniform buffer
+	void UploadBlock();
+};
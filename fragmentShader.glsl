@@ -5,6 +5,8 @@ struct Material
     vec3 ambientColor;
     float ambientStrength;
     vec3 diffuseColor;
+    // roughest surface that still gets screen space reflections, 0 for none
+    float reflectionCutoff;
     vec3 specularColor;
     float shininess;
 }; 
@@ -19,43 +21,313 @@ struct LightSource
     float specularIntensity;
 };
 
+struct AreaLight
+{
+    vec3 center;
+    int type;
+    vec3 right;
+    bool bTwoSided;
+    vec3 up;
+    vec3 color;
+    float intensity;
+};
+
 #define TOTAL_LIGHTS 4
+#define TOTAL_AREA_LIGHTS 4
+#define AREA_LIGHT_RECT 0
+#define AREA_LIGHT_DISK 1
+// a disk is integrated as a polygon of the same area
+#define AREA_LIGHT_DISK_EDGES 8
+#define VOXEL_CLIP_LEVELS 4
+// how the draw is lit, picked per draw from its size on the screen, see
+// ShadingLODManager.h
+#define SHADING_LEVEL_FULL 0
+#define SHADING_LEVEL_VERTEX 1
+#define SHADING_LEVEL_FLAT 2
 
+// the resolve pass of the visibility buffer compiles this shader with
+// VISIBILITY_RESOLVE defined: it draws one full screen triangle and
+// rebuilds the inputs and per draw settings of the surface in every
+// pixel before shading it, see VisibilityManager.h.  the shading cache
+// compiles it with SHADING_CACHE defined to shade the texels of its
+// atlas from the triangles they lie on, see ShadingCacheManager.h
+#if defined(VISIBILITY_RESOLVE) || defined(SHADING_CACHE)
+#define PER_DRAW
+vec3 fragmentPosition;
+vec3 fragmentVertexNormal;
+vec2 fragmentTextureCoordinate;
+// screen space derivatives of fragmentTextureCoordinate, x then y
+vec4 fragmentTextureGradient;
+int objectTextureSlot;
+vec3 fragmentVertexLight;
+#else
+#define PER_DRAW uniform
 in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
+in vec3 fragmentVertexLight;
+#endif
 
-out vec4 outFragmentColor;
+layout(location = 0) out vec4 outFragmentColor;
+#ifdef SHADING_CACHE
+// the shading cache keeps the visibility of the lights beside the light
+// that does not depend on the view
+layout(location = 1) out vec4 outLightVisibility;
+#else
+// revealage target of the weighted blended transparency pass
+layout(location = 1) out vec4 outRevealage;
+// surface of the opaque pass for the reflections: the octahedral
+// normal, the reflectance (0 for none) and the roughness
+layout(location = 2) out vec4 outSurface;
+#endif
 
-uniform bool bUseTexture=false;
+PER_DRAW bool bUseTexture=false;
 uniform bool bUseLighting=false;
-uniform vec4 objectColor = vec4(1.0f);
+PER_DRAW vec4 objectColor = vec4(1.0f);
+#ifndef VISIBILITY_RESOLVE
 uniform sampler2D objectTexture;
+#endif
 uniform vec3 viewPosition;
-uniform vec2 UVscale = vec2(1.0f, 1.0f);
-uniform LightSource lightSources[TOTAL_LIGHTS];
-uniform Material material;
+PER_DRAW vec2 UVscale = vec2(1.0f, 1.0f);
+// offset and size of the image when objectTexture is an atlas
+PER_DRAW vec4 atlasRect = vec4(0.0f, 0.0f, 1.0f, 1.0f);
+PER_DRAW bool bAtlasRepeat = true;
+// set by the quality tier
+uniform float textureMipBias = 0.0f;
+uniform int lightCount = TOTAL_LIGHTS;
+// write weighted premultiplied color and revealage instead of the color
+uniform bool bWeightedBlend = false;
+// the same for every pixel of a draw; the vertex level takes the light
+// of the vertices and the flat level flatLight
+uniform int shadingLevel = SHADING_LEVEL_FULL;
+uniform vec3 flatLight;
+
+// the C++ mirrors of these blocks are in UniformBlocks.h
+#if defined(VISIBILITY_RESOLVE) || defined(SHADING_CACHE)
+Material material;
+#else
+layout(std140, binding = 1) uniform MaterialBlock
+{
+    Material material;
+};
+#endif
+
+layout(std140, binding = 2) uniform LightingBlock
+{
+    LightSource lightSources[TOTAL_LIGHTS];
+};
+
+layout(std140, binding = 3) uniform AreaLightingBlock
+{
+    AreaLight areaLights[TOTAL_AREA_LIGHTS];
+    int areaLightCount;
+};
+
+// linearly transformed cosine tables of the GGX lobe, see LTCTable.h
+uniform sampler2D ltcMatrixTexture;
+uniform sampler2D ltcAmplitudeTexture;
+const float LTC_TABLE_SIZE = 64.0;
+
+// where the clip levels of the voxelized scene are, see VoxelGIManager.h:
+// the world position of the lowest corner of each in xyz, its voxel size
+// in w.  the levels repeat, a voxel is stored at its world index wrapped
+// at the resolution
+layout(std140, binding = 4) uniform VoxelGIBlock
+{
+    vec4 voxelLevelOrigins[VOXEL_CLIP_LEVELS];
+    bool bVoxelGI;
+    int voxelResolution;
+    float voxelDiffuseStrength;
+    float voxelSpecularStrength;
+};
+uniform sampler3D voxelClipmap[VOXEL_CLIP_LEVELS];
+// samples along a cone before it gives up
+#define VOXEL_CONE_STEPS 32
+
+// how much of each of the first lights reaches the surface in this pixel,
+// one per channel, ray traced from the depth of the frame before it is
+// shaded, see RayShadowManager.h.  only the surfaces that depth holds may
+// read it, which are the ones of the visibility buffer resolve
+uniform bool bRayShadows = false;
+uniform sampler2D rayShadowTexture;
+
+// the opaque primitive shapes as analytic distance fields, see
+// SDFShadowManager.h.  a grid over them lists in each cell the primitives
+// nearer than sdfReach to it: the first word and count of each cell's
+// list come first in sdfGrid, then the lists
+layout(std140, binding = 5) uniform SDFShadowBlock
+{
+    vec3 sdfGridOrigin;
+    float sdfCellSize;
+    ivec3 sdfGridSize;
+    float sdfReach;
+    bool bSDFShadows;
+    bool bSDFOcclusion;
+    float sdfShadowSoftness;
+    float sdfShadowDistance;
+    float sdfOcclusionDistance;
+};
+
+// the shape is a ShapeMeshes::ShapeType, in the local space of its mesh
+struct SDFPrimitive
+{
+    mat4 worldToLocal;
+    uint shape;
+    float scale;
+    float parameter;
+};
+
+layout(std430, binding = 10) readonly buffer SDFPrimitiveBuffer
+{
+    SDFPrimitive sdfPrimitives[];
+};
+
+layout(std430, binding = 11) readonly buffer SDFGridBuffer
+{
+    uint sdfGrid[];
+};
+
+#define SDF_BOX 0u
+#define SDF_CONE 1u
+#define SDF_CYLINDER 2u
+#define SDF_PLANE 3u
+#define SDF_PRISM 4u
+#define SDF_PYRAMID3 5u
+#define SDF_PYRAMID4 6u
+#define SDF_SPHERE 7u
+#define SDF_TAPERED_CYLINDER 8u
+#define SDF_TORUS 9u
+// steps of a shadow ray, samples of the occlusion, and how far off the
+// surface both start, past the facets of the curved meshes
+#define SDF_SHADOW_STEPS 32
+#define SDF_OCCLUSION_SAMPLES 5
+#define SDF_SURFACE_OFFSET 0.02
 
 // function prototypes
-vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection, float visibility, float occlusion);
+vec3 CalcAreaLights(vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection, bool bDiffuse, bool bSpecular);
+vec3 CalcVoxelIndirect(vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection, bool bDiffuse, bool bSpecular);
+float TraceSDFShadow(vec3 origin, vec3 lightPosition);
+float CalcSDFOcclusion(vec3 vertexPosition, vec3 lightNormal);
+vec4 CalcSDFLightVisibility(vec3 vertexPosition, vec3 lightNormal);
+vec4 SampleObjectTexture(vec2 textureCoordinate);
+vec4 CalcReflectionSurface(vec3 lightNormal, vec3 viewDirection);
+float MaterialRoughness();
+#ifdef VISIBILITY_RESOLVE
+bool LoadVisibleSurface();
+bool LoadCachedShading(out vec3 cachedLight, out vec4 cachedVisibility);
+vec4 SampleSceneTexture(int slot, vec2 textureCoordinate, vec2 gradientX, vec2 gradientY);
+#endif
+#ifdef SHADING_CACHE
+bool LoadCacheSurface();
+#endif
+
+#ifdef SHADING_CACHE
+// shades one texel of the shading cache: the ambient light, the diffuse
+// light of the area lights and the voxels, and how much of each light
+// reaches the surface, none of which depend on the view.  the resolve
+// pass adds the rest
+void main()
+{
+   if(LoadCacheSurface() == false)
+   {
+      discard;
+   }
 
+   vec3 lightNormal = normalize(fragmentVertexNormal);
+   float occlusion = (bSDFOcclusion == true) ? CalcSDFOcclusion(fragmentPosition, lightNormal) : 1.0;
+   vec3 cachedLight = vec3(0.0);
+   for(int i = 0; i < min(lightCount, TOTAL_LIGHTS); i++)
+   {
+      // with no visibility only the ambient part is left
+      cachedLight += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, lightNormal, 0.0, occlusion);
+   }
+   cachedLight += CalcAreaLights(lightNormal, fragmentPosition, lightNormal, true, false);
+   if(bVoxelGI == true)
+   {
+      cachedLight += CalcVoxelIndirect(lightNormal, fragmentPosition, lightNormal, true, false);
+   }
+   outFragmentColor = vec4(cachedLight, 1.0);
+   outLightVisibility = (bSDFShadows == true) ? CalcSDFLightVisibility(fragmentPosition, lightNormal) : vec4(1.0);
+}
+#else
 void main()
 {
+#ifdef VISIBILITY_RESOLVE
+   if(LoadVisibleSurface() == false)
+   {
+      discard;
+   }
+#endif
+
    if(bUseLighting == true)
    {
-      // properties
-      vec3 lightNormal = normalize(fragmentVertexNormal);
-      vec3 viewDirection = normalize(viewPosition - fragmentPosition);
       vec3 phongResult = vec3(0.0f);
-
-      for(int i = 0; i < TOTAL_LIGHTS; i++)
+      if(shadingLevel == SHADING_LEVEL_VERTEX)
+      {
+         phongResult = fragmentVertexLight;
+         outSurface = vec4(0.0);
+      }
+      else if(shadingLevel == SHADING_LEVEL_FLAT)
+      {
+         phongResult = flatLight;
+         outSurface = vec4(0.0);
+      }
+      else
       {
-         phongResult += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, viewDirection); 
-      }   
+         // properties
+         vec3 lightNormal = normalize(fragmentVertexNormal);
+         vec3 viewDirection = normalize(viewPosition - fragmentPosition);
+
+         // a cached surface only adds what depends on the view to the
+         // light of its texels
+         vec3 cachedLight = vec3(0.0);
+         vec4 cachedVisibility = vec4(1.0);
+         bool bCached = false;
+#ifdef VISIBILITY_RESOLVE
+         bCached = LoadCachedShading(cachedLight, cachedVisibility);
+#endif
+
+         vec4 lightVisibility = vec4(1.0);
+         if((bRayShadows == true) && (bWeightedBlend == false))
+         {
+            lightVisibility = texelFetch(rayShadowTexture, ivec2(gl_FragCoord.xy), 0);
+         }
+         else if(bCached == true)
+         {
+            lightVisibility = cachedVisibility;
+         }
+         else if(bSDFShadows == true)
+         {
+            lightVisibility = CalcSDFLightVisibility(fragmentPosition, lightNormal);
+         }
+         float occlusion = 1.0;
+         if(bCached == true)
+         {
+            // the ambient light is in the cached light
+            occlusion = 0.0;
+         }
+         else if(bSDFOcclusion == true)
+         {
+            occlusion = CalcSDFOcclusion(fragmentPosition, lightNormal);
+         }
+
+         phongResult += cachedLight;
+         for(int i = 0; i < min(lightCount, TOTAL_LIGHTS); i++)
+         {
+            phongResult += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, viewDirection, lightVisibility[i], occlusion); 
+         }   
+         phongResult += CalcAreaLights(lightNormal, fragmentPosition, viewDirection, !bCached, true);
+         if(bVoxelGI == true)
+         {
+            phongResult += CalcVoxelIndirect(lightNormal, fragmentPosition, viewDirection, !bCached, true);
+         }
+         outSurface = CalcReflectionSurface(lightNormal, viewDirection);
+      }
     
       if(bUseTexture == true)
       {
-         vec4 textureColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+         vec4 textureColor = SampleObjectTexture(fragmentTextureCoordinate * UVscale);
          outFragmentColor = vec4(phongResult * textureColor.xyz, 1.0);
       }
       else
@@ -65,19 +337,34 @@ void main()
    }
    else 
    {
+      outSurface = vec4(0.0);
       if(bUseTexture == true)
       {
-         outFragmentColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+         outFragmentColor = SampleObjectTexture(fragmentTextureCoordinate * UVscale);
       }
       else
       {
          outFragmentColor = objectColor;
       }
    }
+
+   if(bWeightedBlend == true)
+   {
+      // weighted blended order-independent transparency (McGuire and
+      // Bavoil 2013): nearer surfaces get a larger weight, so the
+      // accumulated average does not depend on the draw order
+      float alpha = outFragmentColor.a;
+      float weight = alpha * clamp(3.0e3 * pow(1.0 - gl_FragCoord.z, 3.0), 1.0e-2, 3.0e3);
+      outRevealage = vec4(alpha);
+      outFragmentColor = vec4(outFragmentColor.rgb * alpha, alpha) * weight;
+   }
 }
+#endif
 
-// calculates the color when using a directional light.
-vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+// calculates the color when using a directional light.  visibility is the
+// share of the light that is not shadowed, occlusion the share of the
+// ambient light
+vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection, float visibility, float occlusion)
 {
    vec3 ambient;
    vec3 diffuse;
@@ -104,5 +391,705 @@ vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, v
    float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), 32.0); //light.focalStrength);
    specular = (light.specularIntensity * material.shininess) * specularComponent * material.specularColor;
   
-   return(ambient + diffuse + specular);
+   return(ambient * occlusion + (diffuse + specular) * visibility);
+}
+
+// the signed distance to a capped cone along y, h half its height and r1,
+// r2 the radii of its bottom and top (Quilez)
+float ConeDistance(vec3 position, float h, float r1, float r2)
+{
+   vec2 q = vec2(length(position.xz), position.y);
+   vec2 k1 = vec2(r2, h);
+   vec2 k2 = vec2(r2 - r1, 2.0 * h);
+   vec2 ca = vec2(q.x - min(q.x, (q.y < 0.0) ? r1 : r2), abs(q.y) - h);
+   vec2 cb = q - k1 + k2 * clamp(dot(k1 - q, k2) / dot(k2, k2), 0.0, 1.0);
+   float s = ((cb.x < 0.0) && (ca.y < 0.0)) ? -1.0 : 1.0;
+   return s * sqrt(min(dot(ca, ca), dot(cb, cb)));
+}
+
+// the signed distance to a box around the origin with the given half size
+float BoxDistance(vec3 position, vec3 halfSize)
+{
+   vec3 q = abs(position) - halfSize;
+   return length(max(q, 0.0)) + min(max(q.x, max(q.y, q.z)), 0.0);
+}
+
+// the distance from a world position to one primitive.  the shapes are
+// measured in the space of their mesh, as ShapeMeshes builds them, and
+// scaled back by the shortest axis of the model, which never overstates
+// the world distance.  the prism and pyramids take the farthest of their
+// face planes, exact inside and near the faces and short of the corners
+float SDFPrimitiveDistance(SDFPrimitive primitive, vec3 position)
+{
+   vec3 p = vec3(primitive.worldToLocal * vec4(position, 1.0));
+   float nearest;
+   switch(primitive.shape)
+   {
+      case SDF_BOX:
+         nearest = BoxDistance(p, vec3(0.5));
+         break;
+      case SDF_CONE:
+         nearest = ConeDistance(p - vec3(0.0, 0.5, 0.0), 0.5, 1.0, 0.0);
+         break;
+      case SDF_CYLINDER:
+      {
+         vec2 d = abs(vec2(length(p.xz), p.y - 0.5)) - vec2(1.0, 0.5);
+         nearest = min(max(d.x, d.y), 0.0) + length(max(d, 0.0));
+         break;
+      }
+      case SDF_PLANE:
+         nearest = BoxDistance(p, vec3(1.0, 0.0, 1.0));
+         break;
+      case SDF_PRISM:
+         nearest = max(max(abs(p.y) - 0.5, -p.z - 0.5), (abs(p.x) + 0.5 * p.z - 0.25) * 0.894427);
+         break;
+      case SDF_PYRAMID3:
+         nearest = max(max(-p.y - 0.5, (0.5 * p.y + p.z - 0.25) * 0.894427), (abs(p.x) + 0.25 * (p.y - 0.5) - 0.5 * p.z) * 0.872872);
+         break;
+      case SDF_PYRAMID4:
+         nearest = max(-p.y - 0.5, (max(abs(p.x), abs(p.z)) + 0.5 * (p.y - 0.5)) * 0.894427);
+         break;
+      case SDF_SPHERE:
+         nearest = length(p) - 1.0;
+         break;
+      case SDF_TAPERED_CYLINDER:
+         nearest = ConeDistance(p - vec3(0.0, 0.5, 0.0), 0.5, 1.0, 0.5);
+         break;
+      case SDF_TORUS:
+         nearest = length(vec2(length(p.xy) - 1.0, p.z)) - primitive.parameter;
+         break;
+      default:
+         nearest = sdfReach;
+         break;
+   }
+   return nearest * primitive.scale;
+}
+
+// the distance from a world position to the nearest primitive, up to
+// sdfReach.  the cell of the position lists every primitive that near, and
+// outside the grid all of them are farther than the reach past its edge
+float SDFSceneDistance(vec3 position)
+{
+   vec3 local = (position - sdfGridOrigin) / sdfCellSize;
+   vec3 gridSize = vec3(sdfGridSize);
+   if(any(lessThan(local, vec3(0.0))) || any(greaterThanEqual(local, gridSize)))
+   {
+      vec3 outside = max(max(-local, local - gridSize), 0.0);
+      return length(outside) * sdfCellSize + sdfReach;
+   }
+
+   ivec3 cell = ivec3(local);
+   uint cellIndex = uint(cell.x + sdfGridSize.x * (cell.y + sdfGridSize.y * cell.z));
+   uint first = sdfGrid[cellIndex * 2u];
+   uint count = sdfGrid[cellIndex * 2u + 1u];
+   float nearest = sdfReach;
+   for(uint i = 0u; i < count; i++)
+   {
+      nearest = min(nearest, SDFPrimitiveDistance(sdfPrimitives[sdfGrid[first + i]], position));
+   }
+   return nearest;
+}
+
+// marches toward a light through the distance field, keeping the
+// narrowest cone around the ray that the primitives leave clear: the
+// distance over the length travelled is the cone's width, and
+// sdfShadowSoftness how wide a cone still counts as fully lit (Quilez)
+float TraceSDFShadow(vec3 origin, vec3 lightPosition)
+{
+   vec3 toLight = lightPosition - origin;
+   float lightDistance = length(toLight);
+   vec3 direction = toLight / lightDistance;
+   float maxDistance = min(lightDistance, sdfShadowDistance);
+   float visibility = 1.0;
+   float travelled = SDF_SURFACE_OFFSET;
+   for(int i = 0; (i < SDF_SHADOW_STEPS) && (travelled < maxDistance); i++)
+   {
+      float nearest = SDFSceneDistance(origin + direction * travelled);
+      visibility = min(visibility, sdfShadowSoftness * nearest / travelled);
+      if(visibility <= 0.0)
+      {
+         break;
+      }
+      travelled += clamp(nearest, SDF_SURFACE_OFFSET, sdfReach);
+   }
+   visibility = clamp(visibility, 0.0, 1.0);
+   return visibility * visibility * (3.0 - 2.0 * visibility);
+}
+
+// traces the shadow of each light from just off the surface, one per
+// channel.  the lights behind the surface light none of it anyway
+vec4 CalcSDFLightVisibility(vec3 vertexPosition, vec3 lightNormal)
+{
+   vec4 lightVisibility = vec4(1.0);
+   vec3 shadowOrigin = vertexPosition + lightNormal * SDF_SURFACE_OFFSET;
+   for(int i = 0; i < min(lightCount, TOTAL_LIGHTS); i++)
+   {
+      if(dot(lightNormal, lightSources[i].position - vertexPosition) > 0.0)
+      {
+         lightVisibility[i] = TraceSDFShadow(shadowOrigin, lightSources[i].position);
+      }
+   }
+   return lightVisibility;
+}
+
+// samples the distance field along the normal: where the nearest
+// primitive is closer than how far out a sample is, something other than
+// the surface itself is near and hides part of the ambient light.  the
+// nearer samples count more
+float CalcSDFOcclusion(vec3 vertexPosition, vec3 lightNormal)
+{
+   float occluded = 0.0;
+   float weight = 1.0;
+   float totalWeight = 0.0;
+   for(int i = 1; i <= SDF_OCCLUSION_SAMPLES; i++)
+   {
+      float sampleDistance = SDF_SURFACE_OFFSET + sdfOcclusionDistance * float(i) / float(SDF_OCCLUSION_SAMPLES);
+      float nearest = SDFSceneDistance(vertexPosition + lightNormal * sampleDistance);
+      occluded += weight * clamp((sampleDistance - nearest) / sampleDistance, 0.0, 1.0);
+      totalWeight += weight;
+      weight *= 0.5;
+   }
+   return 1.0 - occluded / totalWeight;
+}
+
+// integrates a cosine over one edge of a polygon on the unit sphere, as a
+// vector whose length is the edge's share of the form factor.  the
+// rational fit of theta / sin(theta) avoids the acos
+vec3 IntegrateEdge(vec3 v1, vec3 v2)
+{
+   float x = dot(v1, v2);
+   float y = abs(x);
+   float a = 0.8543985 + (0.4965155 + 0.0145206 * y) * y;
+   float b = 3.4175940 + (4.1616724 + y) * y;
+   float v = a / b;
+   float thetaSinTheta = (x > 0.0) ? v : 0.5 * inversesqrt(max(1.0 - x * x, 1e-7)) - v;
+   return cross(v1, v2) * thetaSinTheta;
+}
+
+// integrates the cosine distribution transformed by ltcInverse over an
+// area light.  the edges give the vector form factor, and the horizon is
+// clipped by treating the light as the sphere with the same vector
+// (Heitz and Hill 2017), so no polygon clipping is needed
+float IntegrateAreaLight(AreaLight light, mat3 ltcInverse, vec3 vertexPosition)
+{
+   // the light shines toward cross(right, up), the side facing away is dark
+   vec3 lightNormal = cross(light.right, light.up);
+   bool bBehind = dot(lightNormal, vertexPosition - light.center) < 0.0;
+   if(bBehind && !light.bTwoSided)
+   {
+      return 0.0;
+   }
+
+   // corners are walked clockwise as seen from the lit side
+   int corners = (light.type == AREA_LIGHT_DISK) ? AREA_LIGHT_DISK_EDGES : 4;
+   float radiusScale = sqrt(6.2831853 / (float(AREA_LIGHT_DISK_EDGES) * sin(6.2831853 / float(AREA_LIGHT_DISK_EDGES))));
+   vec3 formFactor = vec3(0.0);
+   vec3 previous = vec3(0.0);
+   vec3 first = vec3(0.0);
+   for(int i = 0; i < corners; i++)
+   {
+      vec2 corner;
+      if(light.type == AREA_LIGHT_DISK)
+      {
+         float angle = -6.2831853 * float(i) / float(corners);
+         corner = vec2(cos(angle), sin(angle)) * radiusScale;
+      }
+      else
+      {
+         corner = vec2((i < 2) ? -1.0 : 1.0, (i == 1 || i == 2) ? 1.0 : -1.0);
+      }
+      vec3 current = normalize(ltcInverse * (light.center + corner.x * light.right + corner.y * light.up - vertexPosition));
+      if(i == 0)
+      {
+         first = current;
+      }
+      else
+      {
+         formFactor += IntegrateEdge(previous, current);
+      }
+      previous = current;
+   }
+   formFactor += IntegrateEdge(previous, first);
+   formFactor = bBehind ? -formFactor : formFactor;
+
+   float formFactorLength = length(formFactor);
+   return max((formFactorLength * formFactorLength + formFactor.z) / (formFactorLength + 1.0), 0.0);
+}
+
+// the GGX roughness with about the highlight of the Phong exponent
+float MaterialRoughness()
+{
+   return pow(2.0 / (material.shininess + 2.0), 0.25);
+}
+
+// calculates the light of the area lights with linearly transformed cosines:
+// the diffuse part integrates a plain cosine, the specular part the GGX lobe
+// looked up for the material's roughness and the view angle, with the
+// Fresnel of the specular color split over the two amplitude channels.
+// bDiffuse and bSpecular pick the parts that are added
+vec3 CalcAreaLights(vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection, bool bDiffuse, bool bSpecular)
+{
+   int count = min(areaLightCount, TOTAL_AREA_LIGHTS);
+   if(count <= 0)
+   {
+      return vec3(0.0);
+   }
+
+   float roughness = MaterialRoughness();
+   float cosTheta = clamp(dot(lightNormal, viewDirection), 0.0, 1.0);
+   vec2 tableCoordinate = vec2(roughness, sqrt(1.0 - cosTheta));
+   tableCoordinate = tableCoordinate * ((LTC_TABLE_SIZE - 1.0) / LTC_TABLE_SIZE) + 0.5 / LTC_TABLE_SIZE;
+   vec4 matrix = texture(ltcMatrixTexture, tableCoordinate);
+   vec2 amplitude = texture(ltcAmplitudeTexture, tableCoordinate).xy;
+
+   // the tables are in a frame around the normal with the view in the xz plane
+   vec3 tangent = viewDirection - lightNormal * dot(viewDirection, lightNormal);
+   tangent = (dot(tangent, tangent) > 1e-8) ? normalize(tangent) : normalize(cross(lightNormal, abs(lightNormal.x) < 0.9 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0)));
+   mat3 toSurface = transpose(mat3(tangent, cross(lightNormal, tangent), lightNormal));
+   mat3 specularInverse = mat3(vec3(matrix.x, 0.0, matrix.y), vec3(0.0, 1.0, 0.0), vec3(matrix.z, 0.0, matrix.w)) * toSurface;
+   vec3 fresnel = material.specularColor * amplitude.x + (vec3(1.0) - material.specularColor) * amplitude.y;
+
+   vec3 result = vec3(0.0);
+   for(int i = 0; i < count; i++)
+   {
+      float diffuse = bDiffuse ? IntegrateAreaLight(areaLights[i], toSurface, vertexPosition) : 0.0;
+      float specular = bSpecular ? IntegrateAreaLight(areaLights[i], specularInverse, vertexPosition) : 0.0;
+      result += areaLights[i].color * areaLights[i].intensity * (material.diffuseColor * diffuse + fresnel * specular);
+   }
+   return result;
+}
+
+// samples one clip level, with an alpha of -1 where the position is not
+// at least half a voxel inside its window, where the filtering would
+// reach the other side.  samplers can only be picked by a constant index
+// when the level may differ between neighbouring pixels
+vec4 SampleVoxelLevel(int level, vec3 position)
+{
+   vec4 origin = voxelLevelOrigins[level];
+   vec3 local = (position - origin.xyz) / origin.w;
+   float resolution = float(voxelResolution);
+   if(any(lessThan(local, vec3(0.5))) || any(greaterThan(local, vec3(resolution - 0.5))))
+   {
+      return vec4(-1.0);
+   }
+
+   vec3 coordinate = position / (origin.w * resolution);
+   switch(level)
+   {
+      case 0: return textureLod(voxelClipmap[0], coordinate, 0.0);
+      case 1: return textureLod(voxelClipmap[1], coordinate, 0.0);
+      case 2: return textureLod(voxelClipmap[2], coordinate, 0.0);
+      case 3: return textureLod(voxelClipmap[3], coordinate, 0.0);
+   }
+   return vec4(-1.0);
+}
+
+// samples the clipmap at a fractional level, blending the two levels
+// around it like the mips of a texture.  a position the finer level does
+// not reach is read from the first coarser one that does
+vec4 SampleVoxelClipmap(vec3 position, float level)
+{
+   int finer = int(floor(level));
+   for(int i = finer; i < VOXEL_CLIP_LEVELS; i++)
+   {
+      vec4 sampled = SampleVoxelLevel(i, position);
+      if(sampled.a >= 0.0)
+      {
+         if((i == finer) && (i + 1 < VOXEL_CLIP_LEVELS))
+         {
+            vec4 coarser = SampleVoxelLevel(i + 1, position);
+            sampled = (coarser.a >= 0.0) ? mix(sampled, coarser, fract(level)) : sampled;
+         }
+         return sampled;
+      }
+   }
+   return vec4(0.0);
+}
+
+// marches a cone through the clipmap front to back, reading the level
+// whose voxels are as wide as the cone, until it is covered or leaves
+// the coarsest level.  it starts a voxel off the surface so it does not
+// see the surface's own voxel
+vec3 TraceVoxelCone(vec3 origin, vec3 direction, float aperture)
+{
+   float voxelSize = voxelLevelOrigins[0].w;
+   float maxDistance = voxelLevelOrigins[VOXEL_CLIP_LEVELS - 1].w * float(voxelResolution) * 0.5;
+   float travelled = voxelSize;
+   vec4 accumulated = vec4(0.0);
+   for(int i = 0; i < VOXEL_CONE_STEPS; i++)
+   {
+      float diameter = max(voxelSize, 2.0 * aperture * travelled);
+      float level = log2(diameter / voxelSize);
+      if((accumulated.a >= 0.95) || (travelled >= maxDistance) || (level >= float(VOXEL_CLIP_LEVELS)))
+      {
+         break;
+      }
+      // the voxels hold premultiplied light and coverage
+      vec4 sampled = SampleVoxelClipmap(origin + direction * travelled, level);
+      accumulated += (1.0 - accumulated.a) * sampled;
+      travelled += diameter * 0.5;
+   }
+   return accumulated.rgb;
+}
+
+// calculates the light bounced off the voxelized scene: six 60 degree
+// cones cover the hemisphere for the diffuse part, weighted by their
+// cosine, and one along the reflection as wide as the material's lobe
+// for the specular part.  bDiffuse and bSpecular pick the parts that are
+// traced
+vec3 CalcVoxelIndirect(vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection, bool bDiffuse, bool bSpecular)
+{
+   vec3 origin = vertexPosition + lightNormal * voxelLevelOrigins[0].w;
+   // tan(30 degrees), the cones just touch
+   const float diffuseAperture = 0.577;
+
+   vec3 diffuse = vec3(0.0);
+   if(bDiffuse == true)
+   {
+      vec3 tangent = normalize(cross(lightNormal, abs(lightNormal.y) < 0.9 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+      vec3 bitangent = cross(lightNormal, tangent);
+      diffuse = TraceVoxelCone(origin, lightNormal, diffuseAperture) * 0.25;
+      for(int i = 0; i < 5; i++)
+      {
+         float angle = 6.2831853 * float(i) / 5.0;
+         vec3 side = cos(angle) * tangent + sin(angle) * bitangent;
+         diffuse += TraceVoxelCone(origin, normalize(lightNormal * 0.5 + side * 0.866), diffuseAperture) * 0.15;
+      }
+   }
+
+   vec3 specular = vec3(0.0);
+   if(bSpecular == true)
+   {
+      float roughness = MaterialRoughness();
+      float specularAperture = clamp(roughness * roughness, 0.05, diffuseAperture);
+      specular = TraceVoxelCone(origin, reflect(-viewDirection, lightNormal), specularAperture);
+   }
+
+   return material.diffuseColor * diffuse * voxelDiffuseStrength + material.specularColor * specular * voxelSpecularStrength;
+}
+
+// the surface the reflection passes read: surfaces rougher than the
+// material's cutoff are left out, so they cost nothing there.  the
+// reflectance is the Schlick Fresnel of half the specular color (the
+// Phong specular color is brighter than a reflectance), fading out
+// over the last quarter before the cutoff
+vec4 CalcReflectionSurface(vec3 lightNormal, vec3 viewDirection)
+{
+   float roughness = MaterialRoughness();
+   if(roughness >= material.reflectionCutoff)
+   {
+      return vec4(0.0);
+   }
+
+   float f0 = dot(material.specularColor, vec3(1.0 / 3.0)) * 0.5;
+   float fresnel = f0 + (1.0 - f0) * pow(1.0 - clamp(dot(lightNormal, viewDirection), 0.0, 1.0), 5.0);
+   float fade = 1.0 - smoothstep(0.75 * material.reflectionCutoff, material.reflectionCutoff, roughness);
+
+   // octahedral encoding of the normal
+   vec3 octahedron = lightNormal / (abs(lightNormal.x) + abs(lightNormal.y) + abs(lightNormal.z));
+   vec2 encoded = (octahedron.z >= 0.0) ? octahedron.xy : (1.0 - abs(octahedron.yx)) * vec2(octahedron.x >= 0.0 ? 1.0 : -1.0, octahedron.y >= 0.0 ? 1.0 : -1.0);
+   return vec4(encoded, fresnel * fade, roughness);
+}
+
+// samples the object texture, wrapping or clamping the coordinate inside
+// its atlas region.  the gradients come from the unwrapped coordinate so
+// the jump of fract() at the region edge does not select the smallest mip,
+// and are scaled to apply the mip bias
+vec4 SampleObjectTexture(vec2 textureCoordinate)
+{
+   vec2 regionCoordinate = bAtlasRepeat ? fract(textureCoordinate) : clamp(textureCoordinate, 0.0, 1.0);
+   vec2 atlasCoordinate = atlasRect.xy + regionCoordinate * atlasRect.zw;
+   vec2 gradientScale = atlasRect.zw * exp2(textureMipBias);
+#ifdef VISIBILITY_RESOLVE
+   vec2 gradientX = fragmentTextureGradient.xy * UVscale * gradientScale;
+   vec2 gradientY = fragmentTextureGradient.zw * UVscale * gradientScale;
+   return SampleSceneTexture(objectTextureSlot, atlasCoordinate, gradientX, gradientY);
+#else
+   return textureGrad(objectTexture, atlasCoordinate, dFdx(textureCoordinate) * gradientScale, dFdy(textureCoordinate) * gradientScale);
+#endif
+}
+
+#ifdef VISIBILITY_RESOLVE
+// the visibility pass writes the draw in the high bits of every pixel
+// and the triangle of the draw in the low bits, see VisibilityManager.h.
+// the vertex pool declarations are added with VISIBILITY_RESOLVE
+#define VISIBILITY_EMPTY 0xFFFFFFFFu
+#define VISIBILITY_TRIANGLE_BITS 20u
+#define TOTAL_SCENE_TEXTURES 16
+
+struct VisibilityDraw
+{
+    mat4 model;
+    mat4 normalMatrix;
+    Material material;
+    vec4 color;
+    vec4 atlasRect;
+    vec2 UVscale;
+    int textureSlot;
+    int bAtlasRepeat;
+    uint mesh;
+    int cacheTriangles;
+};
+
+// every shape as a triangle list of position, normal and uv
+layout(std430, binding = 1) readonly buffer VisibilityDrawBuffer
+{
+    VisibilityDraw visibilityDraws[];
+};
+
+uniform usampler2D visibilityTexture;
+uniform mat4 inverseViewProjection;
+uniform vec2 sceneSize;
+// the scene texture units, in place of objectTexture
+uniform sampler2D sceneTextures[TOTAL_SCENE_TEXTURES];
+
+// the shading cache, see ShadingCacheManager.h: its declarations are
+// added with VISIBILITY_RESOLVE.  texels shaded before
+// shadingCacheValidFrame were shaded with other lights
+uniform bool bShadingCache = false;
+uniform uint shadingCacheFrame;
+uniform uint shadingCacheValidFrame;
+uniform sampler2D shadingCacheLight;
+uniform sampler2D shadingCacheVisibility;
+
+// the shading cache record of the triangle in this pixel, -1 for none,
+// and the barycentric coordinates of the pixel on it
+int surfaceCacheTriangle;
+vec3 surfaceWeights;
+
+// barycentric coordinates of the point a pixel's ray hits the plane of a
+// triangle.  the point may be outside the triangle, which is what the
+// neighbouring pixels need for the gradients
+vec3 VisibilityBarycentrics(vec2 pixel, vec3 p0, vec3 p1, vec3 p2)
+{
+   vec2 device = pixel / sceneSize * 2.0 - 1.0;
+   vec4 nearPoint = inverseViewProjection * vec4(device, -1.0, 1.0);
+   vec4 farPoint = inverseViewProjection * vec4(device, 1.0, 1.0);
+   vec3 origin = nearPoint.xyz / nearPoint.w;
+   vec3 direction = farPoint.xyz / farPoint.w - origin;
+
+   vec3 edge1 = p1 - p0;
+   vec3 edge2 = p2 - p0;
+   vec3 normal = cross(edge1, edge2);
+   float facing = dot(direction, normal);
+   if(abs(facing) < 1e-20)
+   {
+      return vec3(1.0 / 3.0);
+   }
+   vec3 hit = origin + direction * (dot(p0 - origin, normal) / facing);
+   vec3 toHit = hit - p0;
+   float inverseArea = 1.0 / dot(normal, normal);
+   float u = dot(cross(toHit, edge2), normal) * inverseArea;
+   float v = dot(cross(edge1, toHit), normal) * inverseArea;
+   return vec3(1.0 - u - v, u, v);
+}
+
+// fills the inputs and per draw settings of the surface seen in this
+// pixel from its triangle, false when no object covers the pixel
+bool LoadVisibleSurface()
+{
+   uint visibility = texelFetch(visibilityTexture, ivec2(gl_FragCoord.xy), 0).r;
+   if(visibility == VISIBILITY_EMPTY)
+   {
+      return false;
+   }
+
+   VisibilityDraw draw = visibilityDraws[visibility >> VISIBILITY_TRIANGLE_BITS];
+   uint triangle = visibility & ((1u << VISIBILITY_TRIANGLE_BITS) - 1u);
+   uint firstIndex = poolMeshes[draw.mesh].firstIndex + triangle * 3u;
+
+   vec3 positions[3];
+   vec3 normals[3];
+   vec2 coordinates[3];
+   for(int i = 0; i < 3; i++)
+   {
+      PulledVertex pulled = FetchPulledVertex(draw.mesh, poolIndices[firstIndex + uint(i)]);
+      positions[i] = vec3(draw.model * vec4(pulled.position, 1.0));
+      normals[i] = pulled.normal;
+      coordinates[i] = pulled.textureCoordinate;
+   }
+
+   // the texture gradients are the change of the coordinate to the
+   // neighbouring pixels, found on the same triangle's plane
+   vec3 weights = VisibilityBarycentrics(gl_FragCoord.xy, positions[0], positions[1], positions[2]);
+   vec3 weightsX = VisibilityBarycentrics(gl_FragCoord.xy + vec2(1.0, 0.0), positions[0], positions[1], positions[2]);
+   vec3 weightsY = VisibilityBarycentrics(gl_FragCoord.xy + vec2(0.0, 1.0), positions[0], positions[1], positions[2]);
+   mat3x2 coordinateMatrix = mat3x2(coordinates[0], coordinates[1], coordinates[2]);
+
+   fragmentPosition = mat3(positions[0], positions[1], positions[2]) * weights;
+   fragmentVertexNormal = mat3(draw.normalMatrix) * (mat3(normals[0], normals[1], normals[2]) * weights);
+   fragmentTextureCoordinate = coordinateMatrix * weights;
+   fragmentTextureGradient = vec4(coordinateMatrix * weightsX - fragmentTextureCoordinate, coordinateMatrix * weightsY - fragmentTextureCoordinate);
+   surfaceCacheTriangle = (draw.cacheTriangles >= 0) ? draw.cacheTriangles + int(triangle) : -1;
+   surfaceWeights = weights;
+
+   material = draw.material;
+   objectColor = draw.color;
+   objectTextureSlot = draw.textureSlot;
+   bUseTexture = (draw.textureSlot >= 0);
+   UVscale = draw.UVscale;
+   atlasRect = draw.atlasRect;
+   bAtlasRepeat = (draw.bAtlasRepeat != 0);
+   return true;
+}
+
+// asks the shading pass for the texels of a cache triangle, once: the
+// first pixel to ask puts it in the request list, which the pass draws
+// after this one.  a full list drops the request for the next frame
+void RequestCacheTriangle(uint triangle)
+{
+   if(shadingCacheCommand[1] >= uint(SHADING_CACHE_MAX_REQUESTS))
+   {
+      return;
+   }
+   if(atomicCompSwap(shadingCacheTriangles[triangle].requested, 0u, 1u) != 0u)
+   {
+      return;
+   }
+   uint request = atomicAdd(shadingCacheCommand[1], 1u);
+   if(request < uint(SHADING_CACHE_MAX_REQUESTS))
+   {
+      shadingCacheRequests[request] = triangle;
+   }
+   else
+   {
+      shadingCacheTriangles[triangle].requested = 0u;
+   }
+}
+
+// reads the cached light and light visibility of the surface in this
+// pixel, false when it has none that is current and it is shaded in full.
+// the texels are the points of a lattice over the triangle, and the pixel
+// blends the three around it.  a triangle whose texels are missing or old
+// is requested, an old one is still used until they are shaded again
+bool LoadCachedShading(out vec3 cachedLight, out vec4 cachedVisibility)
+{
+   cachedLight = vec3(0.0);
+   cachedVisibility = vec4(1.0);
+   if((bShadingCache == false) || (surfaceCacheTriangle < 0))
+   {
+      return false;
+   }
+
+   uint triangle = uint(surfaceCacheTriangle);
+   ShadingCacheTriangle cached = shadingCacheTriangles[triangle];
+   bool bValid = (cached.stamp != 0u) && (cached.stamp >= shadingCacheValidFrame);
+   if((bValid == false) || (shadingCacheFrame - cached.stamp >= SHADING_CACHE_REFRESH_FRAMES))
+   {
+      RequestCacheTriangle(triangle);
+   }
+   if(bValid == false)
+   {
+      return false;
+   }
+
+   // lattice point (i, j) is at weights (n - i - j, i, j) / n; the cell
+   // around the pixel is the lower or upper triangle of a square
+   float divisions = float(cached.divisions);
+   vec3 weights = max(surfaceWeights, vec3(0.0));
+   weights /= max(weights.x + weights.y + weights.z, 1e-6);
+   vec2 lattice = weights.yz * divisions;
+   vec2 base = min(floor(lattice), vec2(divisions - 1.0));
+   base.y = min(base.y, divisions - 1.0 - base.x);
+   vec2 offset = lattice - base;
+   ivec2 corners[3];
+   vec3 cornerWeights;
+   if((offset.x + offset.y <= 1.0) || (base.x + base.y >= divisions - 1.0))
+   {
+      corners = ivec2[3](ivec2(base), ivec2(base) + ivec2(1, 0), ivec2(base) + ivec2(0, 1));
+      cornerWeights = vec3(1.0 - offset.x - offset.y, offset.x, offset.y);
+   }
+   else
+   {
+      corners = ivec2[3](ivec2(base) + ivec2(1, 1), ivec2(base) + ivec2(0, 1), ivec2(base) + ivec2(1, 0));
+      cornerWeights = vec3(offset.x + offset.y - 1.0, 1.0 - offset.x, 1.0 - offset.y);
+   }
+   cornerWeights = max(cornerWeights, vec3(0.0));
+   cornerWeights /= max(cornerWeights.x + cornerWeights.y + cornerWeights.z, 1e-6);
+
+   ivec2 origin = ivec2(int(cached.origin & 0xFFFFu), int(cached.origin >> 16));
+   cachedVisibility = vec4(0.0);
+   for(int i = 0; i < 3; i++)
+   {
+      ivec2 texel = origin + corners[i];
+      cachedLight += cornerWeights[i] * texelFetch(shadingCacheLight, texel, 0).rgb;
+      cachedVisibility += cornerWeights[i] * texelFetch(shadingCacheVisibility, texel, 0);
+   }
+   return true;
+}
+
+// samplers can only be picked by a constant index when the slot may
+// differ between neighbouring pixels
+vec4 SampleSceneTexture(int slot, vec2 textureCoordinate, vec2 gradientX, vec2 gradientY)
+{
+   switch(slot)
+   {
+      case 0: return textureGrad(sceneTextures[0], textureCoordinate, gradientX, gradientY);
+      case 1: return textureGrad(sceneTextures[1], textureCoordinate, gradientX, gradientY);
+      case 2: return textureGrad(sceneTextures[2], textureCoordinate, gradientX, gradientY);
+      case 3: return textureGrad(sceneTextures[3], textureCoordinate, gradientX, gradientY);
+      case 4: return textureGrad(sceneTextures[4], textureCoordinate, gradientX, gradientY);
+      case 5: return textureGrad(sceneTextures[5], textureCoordinate, gradientX, gradientY);
+      case 6: return textureGrad(sceneTextures[6], textureCoordinate, gradientX, gradientY);
+      case 7: return textureGrad(sceneTextures[7], textureCoordinate, gradientX, gradientY);
+      case 8: return textureGrad(sceneTextures[8], textureCoordinate, gradientX, gradientY);
+      case 9: return textureGrad(sceneTextures[9], textureCoordinate, gradientX, gradientY);
+      case 10: return textureGrad(sceneTextures[10], textureCoordinate, gradientX, gradientY);
+      case 11: return textureGrad(sceneTextures[11], textureCoordinate, gradientX, gradientY);
+      case 12: return textureGrad(sceneTextures[12], textureCoordinate, gradientX, gradientY);
+      case 13: return textureGrad(sceneTextures[13], textureCoordinate, gradientX, gradientY);
+      case 14: return textureGrad(sceneTextures[14], textureCoordinate, gradientX, gradientY);
+      case 15: return textureGrad(sceneTextures[15], textureCoordinate, gradientX, gradientY);
+   }
+   return vec4(1.0);
+}
+#endif
+
+#ifdef SHADING_CACHE
+// the objects of the shading cache; the vertex pool and cache
+// declarations are added with SHADING_CACHE
+struct ShadingCacheObject
+{
+    mat4 model;
+    mat4 normalMatrix;
+    Material material;
+    uint mesh;
+};
+
+layout(std430, binding = 12) readonly buffer ShadingCacheObjectBuffer
+{
+    ShadingCacheObject shadingCacheObjects[];
+};
+
+// the triangle whose block this texel is in
+flat in uint cacheTriangle;
+
+// fills the inputs of the surface point of this texel from the lattice
+// over its triangle, false for the texels of the block past the triangle
+bool LoadCacheSurface()
+{
+   ShadingCacheTriangle cached = shadingCacheTriangles[cacheTriangle];
+   ivec2 lattice = ivec2(gl_FragCoord.xy) - ivec2(int(cached.origin & 0xFFFFu), int(cached.origin >> 16));
+   int divisions = int(cached.divisions);
+   if(lattice.x + lattice.y > divisions)
+   {
+      return false;
+   }
+
+   ShadingCacheObject object = shadingCacheObjects[cached.object];
+   uint firstIndex = poolMeshes[object.mesh].firstIndex + cached.meshTriangle * 3u;
+   vec3 positions[3];
+   vec3 normals[3];
+   for(int i = 0; i < 3; i++)
+   {
+      PulledVertex pulled = FetchPulledVertex(object.mesh, poolIndices[firstIndex + uint(i)]);
+      positions[i] = vec3(object.model * vec4(pulled.position, 1.0));
+      normals[i] = pulled.normal;
+   }
+
+   vec3 weights = vec3(float(divisions - lattice.x - lattice.y), float(lattice.x), float(lattice.y)) / float(divisions);
+   fragmentPosition = mat3(positions[0], positions[1], positions[2]) * weights;
+   fragmentVertexNormal = mat3(object.normalMatrix) * (mat3(normals[0], normals[1], normals[2]) * weights);
+   material = object.material;
+   return true;
 }
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 440 core
+// one triangle that covers the screen, drawn with three vertices
+// and no vertex buffer
+
+out vec2 fragmentTextureCoordinate;
+
+void main()
+{
+   vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+   fragmentTextureCoordinate = position;
+   gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,54 @@
+#version 440 core
+// one level of the hierarchical depth pyramid: every texel keeps the
+// nearest depth of the 2x2 texels below it, or 3 wide along an odd
+// edge so no source texel is left out
+
+out float outDepth;
+
+// level 0 reads the scene depth, multisampled when the scene is,
+// the others read the level above, which is the only level of
+// hiZTexture visible while this one is drawn
+uniform bool bFromScene = true;
+uniform bool bMultisample = false;
+uniform sampler2D depthTexture;
+uniform sampler2DMS depthTextureMS;
+uniform sampler2D hiZTexture;
+uniform vec2 sourceSize;
+uniform vec2 targetSize;
+
+float FetchDepth(ivec2 texel)
+{
+   texel = min(texel, ivec2(sourceSize) - 1);
+   if(bFromScene == false)
+   {
+      return texelFetch(hiZTexture, texel, 0).r;
+   }
+   if(bMultisample == true)
+   {
+      return texelFetch(depthTextureMS, texel, 0).r;
+   }
+   return texelFetch(depthTexture, texel, 0).r;
+}
+
+void main()
+{
+   ivec2 texel = ivec2(gl_FragCoord.xy);
+   ivec2 source = texel * 2;
+
+   // the last texel takes the third row or column of an odd source
+   ivec2 extent = ivec2(2);
+   ivec2 sourceTexels = ivec2(sourceSize);
+   ivec2 targetTexels = ivec2(targetSize);
+   extent.x += ((texel.x == targetTexels.x - 1) && ((sourceTexels.x & 1) == 1)) ? 1 : 0;
+   extent.y += ((texel.y == targetTexels.y - 1) && ((sourceTexels.y & 1) == 1)) ? 1 : 0;
+
+   float depth = 1.0;
+   for(int y = 0; y < extent.y; y++)
+   {
+      for(int x = 0; x < extent.x; x++)
+      {
+         depth = min(depth, FetchDepth(source + ivec2(x, y)));
+      }
+   }
+   outDepth = depth;
+}
@@ -0,0 +1,40 @@
+#version 440 core
+// blend the weighted blended transparency targets over the scene,
+// with glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA)
+
+out vec4 outFragmentColor;
+
+// the targets are multisampled when the scene is; each type has its
+// own texture units, only the pair matching bMultisample is bound
+uniform bool bMultisample = false;
+uniform sampler2D accumTexture;
+uniform sampler2D revealTexture;
+uniform sampler2DMS accumTextureMS;
+uniform sampler2DMS revealTextureMS;
+
+void main()
+{
+   ivec2 texel = ivec2(gl_FragCoord.xy);
+   vec4 accum;
+   float revealage;
+   if(bMultisample == true)
+   {
+      // reading gl_SampleID composites every sample on its own
+      accum = texelFetch(accumTextureMS, texel, gl_SampleID);
+      revealage = texelFetch(revealTextureMS, texel, gl_SampleID).r;
+   }
+   else
+   {
+      accum = texelFetch(accumTexture, texel, 0);
+      revealage = texelFetch(revealTexture, texel, 0).r;
+   }
+
+   // nothing transparent was drawn here
+   if(revealage >= 1.0)
+   {
+      discard;
+   }
+
+   // the weighted average color, covering 1 - revealage of the scene
+   outFragmentColor = vec4(accum.rgb / max(accum.a, 1.0e-5), revealage);
+}
@@ -0,0 +1,67 @@
+#version 460 core
+// ray traced shadows: one level of the BVH fitted around its children, or
+// around its triangles for the leaves.  the levels are fitted from the
+// deepest up, one dispatch each, see RayShadowManager.h
+
+layout(local_size_x = 64) in;
+
+struct BVHNode
+{
+    vec3 boundsMin;
+    uint first;
+    vec3 boundsMax;
+    uint count;
+};
+
+layout(std430, binding = 7) readonly buffer ShadowTriangleBuffer
+{
+    float shadowTriangles[];
+};
+
+layout(std430, binding = 8) buffer ShadowNodeBuffer
+{
+    BVHNode shadowNodes[];
+};
+
+// the nodes of the level
+uniform uint levelFirst;
+uniform uint levelCount;
+
+vec3 ShadowCorner(uint triangle, uint corner)
+{
+   uint base = (triangle * 3u + corner) * 3u;
+   return vec3(shadowTriangles[base], shadowTriangles[base + 1u], shadowTriangles[base + 2u]);
+}
+
+void main()
+{
+   if(gl_GlobalInvocationID.x >= levelCount)
+   {
+      return;
+   }
+   uint index = levelFirst + gl_GlobalInvocationID.x;
+   BVHNode node = shadowNodes[index];
+
+   vec3 boundsMin = vec3(3.0e38);
+   vec3 boundsMax = vec3(-3.0e38);
+   if(node.count > 0u)
+   {
+      for(uint triangle = node.first; triangle < node.first + node.count; triangle++)
+      {
+         for(uint corner = 0u; corner < 3u; corner++)
+         {
+            vec3 position = ShadowCorner(triangle, corner);
+            boundsMin = min(boundsMin, position);
+            boundsMax = max(boundsMax, position);
+         }
+      }
+   }
+   else
+   {
+      // the children are on the level below, fitted by the dispatch before
+      boundsMin = min(shadowNodes[node.first].boundsMin, shadowNodes[node.first + 1u].boundsMin);
+      boundsMax = max(shadowNodes[node.first].boundsMax, shadowNodes[node.first + 1u].boundsMax);
+   }
+   shadowNodes[index].boundsMin = boundsMin;
+   shadowNodes[index].boundsMax = boundsMax;
+}
@@ -0,0 +1,232 @@
+#version 460 core
+// ray traced shadows: one ray per pixel toward each of the first lights,
+// from the surface in the scene depth through the BVH of the shadow
+// casters.  every frame the ray aims at another point of a disk around
+// the light, and the result is blended into the reprojected history,
+// which averages the rays into a soft shadow, see RayShadowManager.h
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#define TOTAL_LIGHTS 4
+// the deepest BVH the traversal stack holds, RayShadowManager builds
+// none deeper
+#define SHADOW_STACK_SIZE 32
+
+struct LightSource 
+{
+    vec3 position;	
+    vec3 ambientColor;
+    vec3 diffuseColor;
+    vec3 specularColor;
+    float focalStrength;
+    float specularIntensity;
+};
+
+layout(std140, binding = 2) uniform LightingBlock
+{
+    LightSource lightSources[TOTAL_LIGHTS];
+};
+
+struct BVHNode
+{
+    vec3 boundsMin;
+    uint first;
+    vec3 boundsMax;
+    uint count;
+};
+
+layout(std430, binding = 7) readonly buffer ShadowTriangleBuffer
+{
+    float shadowTriangles[];
+};
+
+layout(std430, binding = 8) readonly buffer ShadowNodeBuffer
+{
+    BVHNode shadowNodes[];
+};
+
+uniform sampler2D sceneDepth;
+// the result of the last frame, and the distance from its camera to
+// the surface of every pixel
+uniform sampler2D historyShadow;
+uniform sampler2D historyDistance;
+layout(rgba16f, binding = 0) uniform writeonly image2D outShadow;
+layout(r32f, binding = 1) uniform writeonly image2D outDistance;
+
+uniform ivec2 sceneSize;
+uniform mat4 inverseViewProjection;
+uniform vec3 cameraPosition;
+uniform mat4 previousViewProjection;
+uniform vec3 previousCameraPosition;
+uniform bool bHistoryValid;
+// weight of this frame's rays where the history is kept, and how far
+// the surface may have moved, relative to its distance, to keep it
+uniform float historyBlend;
+uniform float historyTolerance;
+
+uniform int shadowLightCount;
+uniform float lightRadius;
+uniform uint frameIndex;
+
+uint Hash(uint value)
+{
+   value ^= value >> 16;
+   value *= 0x7feb352du;
+   value ^= value >> 15;
+   value *= 0x846ca68bu;
+   value ^= value >> 16;
+   return value;
+}
+
+// uniform in [0, 1)
+float Random(inout uint state)
+{
+   state = Hash(state);
+   return float(state >> 8) * (1.0 / 16777216.0);
+}
+
+vec3 ShadowCorner(uint triangle, uint corner)
+{
+   uint base = (triangle * 3u + corner) * 3u;
+   return vec3(shadowTriangles[base], shadowTriangles[base + 1u], shadowTriangles[base + 2u]);
+}
+
+bool HitsBox(vec3 origin, vec3 inverseDirection, float maxDistance, vec3 boundsMin, vec3 boundsMax)
+{
+   vec3 t0 = (boundsMin - origin) * inverseDirection;
+   vec3 t1 = (boundsMax - origin) * inverseDirection;
+   vec3 tNear = min(t0, t1);
+   vec3 tFar = max(t0, t1);
+   float enter = max(max(tNear.x, tNear.y), max(tNear.z, 0.0));
+   float leave = min(min(tFar.x, tFar.y), min(tFar.z, maxDistance));
+   return enter <= leave;
+}
+
+// Moller and Trumbore, from either side
+bool HitsTriangle(vec3 origin, vec3 direction, float maxDistance, uint triangle)
+{
+   vec3 p0 = ShadowCorner(triangle, 0u);
+   vec3 edge1 = ShadowCorner(triangle, 1u) - p0;
+   vec3 edge2 = ShadowCorner(triangle, 2u) - p0;
+   vec3 p = cross(direction, edge2);
+   float determinant = dot(edge1, p);
+   if(abs(determinant) < 1e-20)
+   {
+      return false;
+   }
+   float inverseDeterminant = 1.0 / determinant;
+   vec3 toOrigin = origin - p0;
+   float u = dot(toOrigin, p) * inverseDeterminant;
+   if((u < 0.0) || (u > 1.0))
+   {
+      return false;
+   }
+   vec3 q = cross(toOrigin, edge1);
+   float v = dot(direction, q) * inverseDeterminant;
+   if((v < 0.0) || (u + v > 1.0))
+   {
+      return false;
+   }
+   float t = dot(edge2, q) * inverseDeterminant;
+   return (t > 0.0) && (t < maxDistance);
+}
+
+// any triangle between the origin and maxDistance along the ray; a
+// shadow ray stops at the first one it finds
+bool Occluded(vec3 origin, vec3 direction, float maxDistance)
+{
+   vec3 inverseDirection = 1.0 / direction;
+   uint stack[SHADOW_STACK_SIZE];
+   int depth = 0;
+   stack[depth++] = 0u;
+   while(depth > 0)
+   {
+      BVHNode node = shadowNodes[stack[--depth]];
+      if(HitsBox(origin, inverseDirection, maxDistance, node.boundsMin, node.boundsMax) == false)
+      {
+         continue;
+      }
+      if(node.count > 0u)
+      {
+         for(uint triangle = node.first; triangle < node.first + node.count; triangle++)
+         {
+            if(HitsTriangle(origin, direction, maxDistance, triangle) == true)
+            {
+               return true;
+            }
+         }
+      }
+      else if(depth + 2 <= SHADOW_STACK_SIZE)
+      {
+         stack[depth++] = node.first;
+         stack[depth++] = node.first + 1u;
+      }
+   }
+   return false;
+}
+
+void main()
+{
+   ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+   if(any(greaterThanEqual(pixel, sceneSize)))
+   {
+      return;
+   }
+
+   // nothing was drawn here, and nothing to keep for the next frame
+   float depth = texelFetch(sceneDepth, pixel, 0).r;
+   if(depth >= 1.0)
+   {
+      imageStore(outShadow, pixel, vec4(1.0));
+      imageStore(outDistance, pixel, vec4(0.0));
+      return;
+   }
+
+   vec2 device = (vec2(pixel) + 0.5) / vec2(sceneSize) * 2.0 - 1.0;
+   vec4 world = inverseViewProjection * vec4(device, depth * 2.0 - 1.0, 1.0);
+   vec3 position = world.xyz / world.w;
+   float cameraDistance = length(position - cameraPosition);
+   // the rays start and end off the surfaces by more the farther the
+   // depth is, as it gets less precise
+   float bias = 0.002 + 0.002 * cameraDistance;
+
+   uint state = Hash(uint(pixel.x) + uint(pixel.y) * uint(sceneSize.x)) ^ Hash(frameIndex);
+   vec4 visibility = vec4(1.0);
+   for(int i = 0; i < min(shadowLightCount, TOTAL_LIGHTS); i++)
+   {
+      // a random point of the disk around the light that faces the surface
+      vec3 axis = normalize(lightSources[i].position - position);
+      vec3 tangent = normalize(cross(axis, (abs(axis.y) < 0.99) ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+      vec3 bitangent = cross(axis, tangent);
+      float radius = lightRadius * sqrt(Random(state));
+      float angle = 6.2831853 * Random(state);
+      vec3 target = lightSources[i].position + (tangent * cos(angle) + bitangent * sin(angle)) * radius;
+
+      vec3 ray = target - position;
+      float rayLength = length(ray);
+      vec3 direction = ray / rayLength;
+      if(Occluded(position + direction * bias, direction, rayLength - 2.0 * bias) == true)
+      {
+         visibility[i] = 0.0;
+      }
+   }
+
+   // keep the history where the same surface was seen last frame
+   if(bHistoryValid == true)
+   {
+      vec4 previous = previousViewProjection * vec4(position, 1.0);
+      ivec2 historyPixel = ivec2(floor((previous.xy / previous.w * 0.5 + 0.5) * vec2(sceneSize)));
+      if((previous.w > 0.0) && all(greaterThanEqual(historyPixel, ivec2(0))) && all(lessThan(historyPixel, sceneSize)))
+      {
+         float expected = length(position - previousCameraPosition);
+         float historyDepth = texelFetch(historyDistance, historyPixel, 0).r;
+         if(abs(historyDepth - expected) < historyTolerance * expected)
+         {
+            visibility = mix(texelFetch(historyShadow, historyPixel, 0), visibility, historyBlend);
+         }
+      }
+   }
+
+   imageStore(outShadow, pixel, visibility);
+   imageStore(outDistance, pixel, vec4(cameraDistance));
+}
@@ -0,0 +1,53 @@
+#version 460 core
+// ray traced shadows: the triangles of the shadow casters pulled from the
+// vertex pool into world space, in the order of the BVH leaves; the pool
+// declarations are added before this, see RayShadowManager.h
+
+layout(local_size_x = 64) in;
+
+struct ShadowObject
+{
+    mat4 model;
+    uint poolMesh;
+};
+
+layout(std430, binding = 6) readonly buffer ShadowObjectBuffer
+{
+    ShadowObject shadowObjects[];
+};
+
+// the three corners of every triangle, nine floats so nothing is padded
+layout(std430, binding = 7) writeonly buffer ShadowTriangleBuffer
+{
+    float shadowTriangles[];
+};
+
+// the object, and the triangle of its mesh, of every triangle
+layout(std430, binding = 9) readonly buffer ShadowSourceBuffer
+{
+    uvec2 shadowSources[];
+};
+
+uniform uint triangleCount;
+
+void main()
+{
+   uint triangle = gl_GlobalInvocationID.x;
+   if(triangle >= triangleCount)
+   {
+      return;
+   }
+
+   uvec2 source = shadowSources[triangle];
+   ShadowObject object = shadowObjects[source.x];
+   uint firstIndex = poolMeshes[object.poolMesh].firstIndex + source.y * 3u;
+   for(uint i = 0u; i < 3u; i++)
+   {
+      vec3 position = FetchPulledPosition(object.poolMesh, poolIndices[firstIndex + i]);
+      position = vec3(object.model * vec4(position, 1.0));
+      uint base = (triangle * 3u + i) * 3u;
+      shadowTriangles[base] = position.x;
+      shadowTriangles[base + 1u] = position.y;
+      shadowTriangles[base + 2u] = position.z;
+   }
+}
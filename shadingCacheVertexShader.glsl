@@ -0,0 +1,42 @@
+#version 460 core
+// the shading pass of the shading cache: one instance per triangle the
+// resolve pass requested, covering the block of the atlas its texels are
+// in; the cache declarations are added before this, see
+// ShadingCacheManager.h
+
+uniform vec2 atlasSize;
+uniform uint shadingCacheFrame;
+
+// the requested triangle, for the fragment shader to find its texel in
+flat out uint cacheTriangle;
+
+const vec2 blockCorners[6] = vec2[6](
+   vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+   vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+void main()
+{
+   // requests past the end of the list were not kept
+   if(gl_InstanceID >= SHADING_CACHE_MAX_REQUESTS)
+   {
+      cacheTriangle = 0u;
+      gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+      return;
+   }
+
+   uint triangle = shadingCacheRequests[gl_InstanceID];
+   cacheTriangle = triangle;
+   // the texels are current from this frame on, and the triangle may
+   // be requested again
+   if(gl_VertexID == 0)
+   {
+      shadingCacheTriangles[triangle].stamp = shadingCacheFrame;
+      shadingCacheTriangles[triangle].requested = 0u;
+   }
+
+   uint origin = shadingCacheTriangles[triangle].origin;
+   vec2 blockOrigin = vec2(float(origin & 0xFFFFu), float(origin >> 16));
+   float blockSize = float(shadingCacheTriangles[triangle].divisions + 1u);
+   vec2 position = (blockOrigin + blockCorners[gl_VertexID] * blockSize) / atlasSize;
+   gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
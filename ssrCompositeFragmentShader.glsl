@@ -0,0 +1,18 @@
+#version 440 core
+// adds the half resolution reflections over the scene, with
+// glBlendFunc(GL_ONE, GL_ONE); they already carry the reflectance
+
+out vec4 outFragmentColor;
+
+uniform sampler2D reflectionTexture;
+uniform vec2 sceneSize;
+
+void main()
+{
+   vec4 reflection = textureLod(reflectionTexture, gl_FragCoord.xy / sceneSize, 0.0);
+   if(reflection.a <= 0.0)
+   {
+      discard;
+   }
+   outFragmentColor = vec4(reflection.rgb, 0.0);
+}
@@ -0,0 +1,67 @@
+#version 440 core
+// accumulates the reflection rays over the frames: the history is
+// reprojected with the depth of the surface and clamped to the colors
+// around the pixel this frame, so what it remembers cannot ghost
+
+out vec4 outReflection;
+
+uniform sampler2D traceTexture;
+uniform sampler2D historyTexture;
+uniform sampler2D hiZTexture;
+uniform bool bHistoryValid = false;
+uniform mat4 inverseViewProjection;
+uniform mat4 previousViewProjection;
+
+// share of the new frame in the average
+const float CURRENT_WEIGHT = 0.1;
+
+void main()
+{
+   ivec2 texel = ivec2(gl_FragCoord.xy);
+   ivec2 size = textureSize(traceTexture, 0);
+   vec4 current = texelFetch(traceTexture, texel, 0);
+   if(current.a <= 0.0)
+   {
+      outReflection = vec4(0.0);
+      return;
+   }
+
+   vec3 minColor = current.rgb;
+   vec3 maxColor = current.rgb;
+   for(int y = -1; y <= 1; y++)
+   {
+      for(int x = -1; x <= 1; x++)
+      {
+         vec4 neighbor = texelFetch(traceTexture, clamp(texel + ivec2(x, y), ivec2(0), size - 1), 0);
+         if(neighbor.a > 0.0)
+         {
+            minColor = min(minColor, neighbor.rgb);
+            maxColor = max(maxColor, neighbor.rgb);
+         }
+      }
+   }
+
+   outReflection = current;
+   if(bHistoryValid == false)
+   {
+      return;
+   }
+
+   // where the surface was on screen last frame
+   vec2 uv = (vec2(texel) + 0.5) / vec2(size);
+   float depth = texelFetch(hiZTexture, texel, 0).r;
+   vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+   vec4 previous = previousViewProjection * vec4(world.xyz / world.w, 1.0);
+   vec2 previousUV = (previous.xy / previous.w) * 0.5 + 0.5;
+   if((previous.w <= 0.0) || any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0))))
+   {
+      return;
+   }
+
+   vec4 history = textureLod(historyTexture, previousUV, 0.0);
+   if(history.a <= 0.0)
+   {
+      return;
+   }
+   outReflection = vec4(mix(clamp(history.rgb, minColor, maxColor), current.rgb, CURRENT_WEIGHT), 1.0);
+}
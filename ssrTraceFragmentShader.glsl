@@ -0,0 +1,228 @@
+#version 440 core
+// traces one glossy reflection ray per half resolution pixel through
+// the hierarchical depth pyramid, and falls back to the environment
+// probe where it leaves the screen or finds nothing
+
+out vec4 outReflection;
+
+// nearest depth pyramid, level 0 is half the scene size
+uniform sampler2D hiZTexture;
+uniform vec2 hiZSize;
+uniform int hiZLevels;
+
+// the scene targets are multisampled when the scene is; each type has
+// its own texture units, only the ones matching bMultisample are bound
+uniform bool bMultisample = false;
+uniform sampler2D surfaceTexture;
+uniform sampler2DMS surfaceTextureMS;
+uniform sampler2D sceneColorTexture;
+uniform sampler2DMS sceneColorTextureMS;
+uniform vec2 sceneSize;
+
+uniform samplerCube probeTexture;
+uniform float probeLevels;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 inverseView;
+uniform mat4 inverseProjection;
+// changes the ray directions every frame, for the temporal accumulation
+uniform int frameIndex = 0;
+
+const int MAX_ITERATIONS = 64;
+// world units
+const float MAX_RAY_LENGTH = 30.0;
+const float HIT_THICKNESS = 0.5;
+const float ORIGIN_OFFSET = 0.02;
+
+// the first sample of a scene target texel
+vec4 FetchScene(sampler2D singleSampled, sampler2DMS multisampled, vec2 uv)
+{
+   ivec2 texel = clamp(ivec2(uv * sceneSize), ivec2(0), ivec2(sceneSize) - 1);
+   if(bMultisample == true)
+   {
+      return texelFetch(multisampled, texel, 0);
+   }
+   return texelFetch(singleSampled, texel, 0);
+}
+
+vec3 DecodeNormal(vec2 encoded)
+{
+   vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+   if(normal.z < 0.0)
+   {
+      normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+   }
+   return normalize(normal);
+}
+
+vec3 ViewPosition(vec2 uv, float depth)
+{
+   vec4 position = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+   return position.xyz / position.w;
+}
+
+// pixels of pyramid level 0, and the window depth
+vec3 ScreenPosition(vec3 viewPosition)
+{
+   vec4 clip = projection * vec4(viewPosition, 1.0);
+   vec3 ndc = clip.xyz / clip.w;
+   return vec3((ndc.xy * 0.5 + 0.5) * hiZSize, ndc.z * 0.5 + 0.5);
+}
+
+// interleaved gradient noise (Jimenez 2014), moved every frame
+float Noise(vec2 pixel)
+{
+   pixel += 5.588238 * float(frameIndex & 63);
+   return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+// a GGX half vector around the normal; the tail of the lobe is
+// trimmed, since its rare far rays are most of the noise
+vec3 SampleGGX(vec3 normal, float roughness, vec2 random)
+{
+   float alpha = roughness * roughness;
+   float u = random.y * 0.8;
+   float phi = 6.2831853 * random.x;
+   float cosTheta = sqrt((1.0 - u) / (1.0 + (alpha * alpha - 1.0) * u));
+   float sinTheta = sqrt(max(1.0 - cosTheta * cosTheta, 0.0));
+   vec3 tangent = normalize(cross(abs(normal.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0), normal));
+   vec3 bitangent = cross(normal, tangent);
+   return normalize(tangent * (sinTheta * cos(phi)) + bitangent * (sinTheta * sin(phi)) + normal * cosTheta);
+}
+
+// walks the ray origin + direction * t, t from 0 to 1, in level 0
+// pixels and window depth (Uludag 2014).  while the ray is in front
+// of the nearest depth of a cell it skips the whole cell and climbs
+// a level, otherwise it descends, until it is behind a level 0 texel
+bool TraceHiZ(vec3 origin, vec3 direction, out vec3 hit, out float t)
+{
+   // rays that stay inside their own texel see nothing but it
+   t = 1.5 / max(length(direction.xy), 1.0e-6);
+   hit = origin;
+   if(t >= 1.0)
+   {
+      return false;
+   }
+
+   vec2 stepDirection = vec2(direction.x >= 0.0 ? 1.0 : -1.0, direction.y >= 0.0 ? 1.0 : -1.0);
+   vec2 safeDirection = stepDirection * max(abs(direction.xy), vec2(1.0e-6));
+   int maxLevel = hiZLevels - 1;
+   int level = 0;
+   for(int i = 0; (i < MAX_ITERATIONS) && (t < 1.0); i++)
+   {
+      vec3 position = origin + direction * t;
+      if(any(lessThan(position.xy, vec2(0.0))) || any(greaterThanEqual(position.xy, hiZSize)))
+      {
+         return false;
+      }
+      float cellSize = exp2(float(level));
+      vec2 cell = floor(position.xy / cellSize);
+      // the last texel of a level rounded down also covers the rest
+      ivec2 cellTexel = min(ivec2(cell), textureSize(hiZTexture, level) - 1);
+      float cellDepth = texelFetch(hiZTexture, cellTexel, level).r;
+
+      // where the ray crosses into the next cell, just past the edge
+      vec2 boundary = (cell + max(stepDirection, 0.0)) * cellSize + stepDirection * 0.01;
+      vec2 boundaryT = (boundary - origin.xy) / safeDirection;
+      float cellT = min(boundaryT.x, boundaryT.y);
+
+      if(position.z < cellDepth)
+      {
+         // in front: moving away, the ray may reach the depth inside the cell
+         float depthT = (direction.z > 0.0) ? (cellDepth - origin.z) / direction.z : 2.0;
+         if(depthT < cellT)
+         {
+            t = max(depthT, t);
+            if(level == 0)
+            {
+               hit = origin + direction * t;
+               return true;
+            }
+            level--;
+         }
+         else
+         {
+            t = cellT;
+            level = min(level + 1, maxLevel);
+         }
+      }
+      else if(level == 0)
+      {
+         // behind the surface; a hit unless it passed behind an object
+         float behind = ViewPosition(position.xy / hiZSize, cellDepth).z - ViewPosition(position.xy / hiZSize, position.z).z;
+         hit = position;
+         return (behind < HIT_THICKNESS);
+      }
+      else
+      {
+         level--;
+      }
+   }
+   return false;
+}
+
+void main()
+{
+   ivec2 texel = ivec2(gl_FragCoord.xy);
+   vec2 uv = (vec2(texel) + 0.5) / hiZSize;
+   vec4 surface = FetchScene(surfaceTexture, surfaceTextureMS, uv);
+   float depth = texelFetch(hiZTexture, texel, 0).r;
+
+   // surfaces without reflections were written with no reflectance
+   if((surface.b <= 0.0) || (depth >= 1.0))
+   {
+      outReflection = vec4(0.0);
+      return;
+   }
+
+   float roughness = surface.a;
+   vec3 viewPosition = ViewPosition(uv, depth);
+   vec3 viewNormal = normalize(mat3(view) * DecodeNormal(surface.rg));
+   vec3 viewDirection = normalize(viewPosition);
+
+   // the probe takes the mirror direction, blurred by the roughness
+   vec3 mirror = reflect(viewDirection, viewNormal);
+   vec3 probeDirection = mat3(inverseView) * mirror;
+   vec3 reflection = textureLod(probeTexture, probeDirection, roughness * (probeLevels - 1.0)).rgb;
+
+   // the ray samples the lobe, averaged over the frames
+   vec3 halfVector = SampleGGX(viewNormal, roughness, vec2(Noise(gl_FragCoord.xy), Noise(gl_FragCoord.xy + vec2(47.0, 17.0))));
+   vec3 rayDirection = reflect(viewDirection, halfVector);
+   if(dot(rayDirection, viewNormal) <= 0.0)
+   {
+      rayDirection = mirror;
+   }
+
+   // stop the ray in front of the near plane
+   vec3 rayOrigin = viewPosition + viewNormal * ORIGIN_OFFSET;
+   float rayLength = MAX_RAY_LENGTH;
+   float nearZ = ViewPosition(vec2(0.5), 0.0).z;
+   if(rayDirection.z > 0.0)
+   {
+      rayLength = min(rayLength, 0.99 * (nearZ - rayOrigin.z) / rayDirection.z);
+   }
+
+   vec3 origin = ScreenPosition(rayOrigin);
+   vec3 direction = ScreenPosition(rayOrigin + rayDirection * rayLength) - origin;
+
+   // and at the edges of the screen
+   vec2 exitT = vec2(
+      (direction.x > 0.0) ? (hiZSize.x - origin.x) / direction.x : ((direction.x < 0.0) ? -origin.x / direction.x : 1.0),
+      (direction.y > 0.0) ? (hiZSize.y - origin.y) / direction.y : ((direction.y < 0.0) ? -origin.y / direction.y : 1.0));
+   direction *= clamp(min(exitT.x, exitT.y), 0.0, 1.0);
+
+   vec3 hit;
+   float hitT;
+   if(TraceHiZ(origin, direction, hit, hitT) == true)
+   {
+      // fade out toward the screen edges and the end of the ray,
+      // where the probe takes over
+      vec2 hitUV = hit.xy / hiZSize;
+      vec2 edge = min(hitUV, 1.0 - hitUV);
+      float confidence = smoothstep(0.0, 0.08, min(edge.x, edge.y)) * (1.0 - smoothstep(0.7, 1.0, hitT));
+      reflection = mix(reflection, FetchScene(sceneColorTexture, sceneColorTextureMS, hitUV).rgb, confidence);
+   }
+
+   outReflection = vec4(reflection * surface.b, 1.0);
+}
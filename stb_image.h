@@ -515,6 +515,12 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// decode JPEGs at 1/denominator of their size (1, 2, 4 or 8). The scaling is
+// done in the DCT domain, so the full-size planes are never built and the
+// inverse DCT and color conversion shrink with the output. stbi_info still
+// reports the full size. (local addition, not part of upstream stb_image)
+STBIDEF void stbi_set_jpeg_scale_denominator(int denominator);
+
 // as above, but only applies to images loaded on the thread that calls the function
 // this function is only available if your compiler supports thread-local variables;
 // calling it will fail to link if your compiler doesn't
@@ -1116,6 +1122,13 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
    stbi__vertically_flip_on_load_global = flag_true_if_should_flip;
 }
 
+static int stbi__jpeg_scale_shift_global = 0;
+
+STBIDEF void stbi_set_jpeg_scale_denominator(int denominator)
+{
+   stbi__jpeg_scale_shift_global = denominator >= 8 ? 3 : denominator >= 4 ? 2 : denominator >= 2 ? 1 : 0;
+}
+
 #ifndef STBI_THREAD_LOCAL
 #define stbi__vertically_flip_on_load  stbi__vertically_flip_on_load_global
 #else
@@ -1988,6 +2001,7 @@ typedef struct
    int            jfif;
    int            app14_color_transform; // Adobe APP14 tag
    int            rgb;
+   int            scale_shift; // log2 of the DCT-domain downscale (local addition)
 
    int scan_n, order[4];
    int restart_interval, todo;
@@ -2944,6 +2958,68 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// reduced-size inverse DCTs (local addition): the 8x8 block is evaluated at
+// the centers of its 2x2, 4x4 or 8x8 pixel groups, keeping the lowest
+// n x n coefficients. row m of a table holds C(u)/2 * cos((2m+1)u*pi/2n)
+static const float stbi__idct_scaled_1[1][1] = { { 0.35355339f } };
+static const float stbi__idct_scaled_2[2][2] = {
+   { 0.35355339f,  0.35355339f },
+   { 0.35355339f, -0.35355339f } };
+static const float stbi__idct_scaled_4[4][4] = {
+   { 0.35355339f,  0.46193977f,  0.35355339f,  0.19134172f },
+   { 0.35355339f,  0.19134172f, -0.35355339f, -0.46193977f },
+   { 0.35355339f, -0.19134172f, -0.35355339f,  0.46193977f },
+   { 0.35355339f, -0.46193977f,  0.35355339f, -0.19134172f } };
+
+static void stbi__idct_scaled(stbi_uc *out, int out_stride, short data[64], int n)
+{
+   const float *table = n == 4 ? &stbi__idct_scaled_4[0][0] : n == 2 ? &stbi__idct_scaled_2[0][0] : &stbi__idct_scaled_1[0][0];
+   float tmp[4][4];
+   int m,k,u,v;
+   // rows
+   for (v=0; v < n; ++v)
+      for (m=0; m < n; ++m) {
+         float sum = 0;
+         for (u=0; u < n; ++u)
+            sum += table[m*n+u] * data[v*8+u];
+         tmp[v][m] = sum;
+      }
+   // columns, then level shift and clamp
+   for (k=0; k < n; ++k, out += out_stride)
+      for (m=0; m < n; ++m) {
+         float sum = 128.5f;
+         for (v=0; v < n; ++v)
+            sum += table[k*n+v] * tmp[v][m];
+         out[m] = stbi__clamp((int) floor(sum));
+      }
+}
+
+// store the decoded block at pixel (x,y) of the full-size plane of component n
+static void stbi__jpeg_idct_store(stbi__jpeg *z, int n, int x, int y, short data[64])
+{
+   int shift = z->scale_shift;
+   int stride = z->img_comp[n].w2 >> shift;
+   stbi_uc *out = z->img_comp[n].data + stride*(y >> shift) + (x >> shift);
+   if (shift == 0)
+      z->idct_block_kernel(out, stride, data);
+   else
+      stbi__idct_scaled(out, stride, data, 8 >> shift);
+}
+
+// shrink the image and plane sizes to the scaled decode (local addition)
+static void stbi__jpeg_apply_scale(stbi__jpeg *z)
+{
+   int i, shift = z->scale_shift, round = (1 << shift) - 1;
+   z->s->img_x = (z->s->img_x + round) >> shift;
+   z->s->img_y = (z->s->img_y + round) >> shift;
+   for (i=0; i < z->s->img_n; ++i) {
+      z->img_comp[i].x = (z->img_comp[i].x + round) >> shift;
+      z->img_comp[i].y = (z->img_comp[i].y + round) >> shift;
+      z->img_comp[i].w2 >>= shift;
+      z->img_comp[i].h2 >>= shift;
+   }
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
@@ -2962,7 +3038,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct_store(z, n, i*8, j*8, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2990,7 +3066,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        stbi__jpeg_idct_store(z, n, x2, y2, data);
                      }
                   }
                }
@@ -3087,7 +3163,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct_store(z, n, i*8, j*8, data);
             }
          }
       }
@@ -3293,6 +3369,8 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
 
    if (scan != STBI__SCAN_load) return 1;
 
+   z->scale_shift = stbi__jpeg_scale_shift_global;
+
    if (!stbi__mad3sizes_valid(s->img_x, s->img_y, s->img_n, 0)) return stbi__err("too large", "Image too large to decode");
 
    for (i=0; i < s->img_n; ++i) {
@@ -3332,7 +3410,7 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
-      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
+      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2 >> z->scale_shift, z->img_comp[i].h2 >> z->scale_shift, 15);
       if (z->img_comp[i].raw_data == NULL)
          return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
       // align blocks for idct using mmx/sse
@@ -3870,6 +3948,7 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
 
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
+   if (z->scale_shift) stbi__jpeg_apply_scale(z);
 
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
@@ -1,20 +1,87 @@
-#version 330 core
-layout (location = 0) in vec3 inVertexPosition;
-layout (location = 1) in vec3 inVertexNormal;
-layout (location = 2) in vec2 inTextureCoordinate;
+#version 440 core
+// the inputs inVertexPosition, inVertexNormal and inTextureCoordinate
+// are declared from ShapeMeshes::VertexLayout when the shader is loaded
+
+struct Material 
+{
+    vec3 ambientColor;
+    float ambientStrength;
+    vec3 diffuseColor;
+    float reflectionCutoff;
+    vec3 specularColor;
+    float shininess;
+}; 
+
+struct LightSource 
+{
+    vec3 position;	
+    vec3 ambientColor;
+    vec3 diffuseColor;
+    vec3 specularColor;
+    float focalStrength;
+    float specularIntensity;
+};
+
+#define TOTAL_LIGHTS 4
+// how the fragment shader lights the draw, see ShadingLODManager.h
+#define SHADING_LEVEL_FULL 0
+#define SHADING_LEVEL_VERTEX 1
+#define SHADING_LEVEL_FLAT 2
 
 out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
+// the Phong lighting of the vertex for SHADING_LEVEL_VERTEX
+out vec3 fragmentVertexLight;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform vec3 viewPosition;
+uniform int lightCount = TOTAL_LIGHTS;
+uniform int shadingLevel = SHADING_LEVEL_FULL;
+
+// the same blocks as the fragment shader's
+layout(std140, binding = 1) uniform MaterialBlock
+{
+    Material material;
+};
+
+layout(std140, binding = 2) uniform LightingBlock
+{
+    LightSource lightSources[TOTAL_LIGHTS];
+};
+
+// the lighting of CalcLightSource() in the fragment shader, unshadowed
+vec3 CalcVertexLight(vec3 position, vec3 normal)
+{
+   vec3 viewDirection = normalize(viewPosition - position);
+   vec3 result = vec3(0.0);
+   for(int i = 0; i < min(lightCount, TOTAL_LIGHTS); i++)
+   {
+      vec3 ambient = lightSources[i].ambientColor + (material.ambientColor * material.ambientStrength);
+      vec3 lightDirection = normalize(lightSources[i].position - position);
+      float impact = max(dot(normal, lightDirection), 0.0);
+      vec3 reflectDir = reflect(-lightDirection, normal);
+      float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), 32.0);
+      vec3 specular = (lightSources[i].specularIntensity * material.shininess) * specularComponent * material.specularColor;
+      result += ambient + impact * material.diffuseColor + specular;
+   }
+   return(result);
+}
 
 void main()
 {
    fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
    gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
-   fragmentVertexNormal = inVertexNormal;
+   // world space, like the position; the inverse transpose keeps
+   // the normals of non-uniformly scaled shapes perpendicular
+   fragmentVertexNormal = transpose(inverse(mat3(model))) * inVertexNormal;
    fragmentTextureCoordinate = inTextureCoordinate;
+
+   fragmentVertexLight = vec3(0.0);
+   if(shadingLevel == SHADING_LEVEL_VERTEX)
+   {
+      fragmentVertexLight = CalcVertexLight(fragmentPosition, normalize(fragmentVertexNormal));
+   }
 }
\ No newline at end of file
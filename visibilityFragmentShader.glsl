@@ -0,0 +1,15 @@
+#version 460 core
+// writes the draw and triangle seen in every pixel, nothing is shaded
+
+#define VISIBILITY_TRIANGLE_BITS 20u
+
+flat in uint visibilityDraw;
+
+layout(location = 0) out uint outVisibility;
+
+void main()
+{
+   // gl_PrimitiveID counts the triangles of each draw of the
+   // indirect draw from zero
+   outVisibility = (visibilityDraw << VISIBILITY_TRIANGLE_BITS) | uint(gl_PrimitiveID);
+}
@@ -0,0 +1,48 @@
+#version 460 core
+// the visibility pass: every opaque object of the frame in one
+// indirect draw, with the vertices pulled from the vertex pool by
+// gl_VertexID and the mesh in gl_BaseInstance instead of vertex
+// attributes; the pool declarations are added before this, see
+// VertexPool.h
+
+struct Material
+{
+    vec3 ambientColor;
+    float ambientStrength;
+    vec3 diffuseColor;
+    float reflectionCutoff;
+    vec3 specularColor;
+    float shininess;
+};
+
+struct VisibilityDraw
+{
+    mat4 model;
+    mat4 normalMatrix;
+    Material material;
+    vec4 color;
+    vec4 atlasRect;
+    vec2 UVscale;
+    int textureSlot;
+    int bAtlasRepeat;
+    uint mesh;
+    int cacheTriangles;
+};
+
+layout(std430, binding = 1) readonly buffer VisibilityDrawBuffer
+{
+    VisibilityDraw visibilityDraws[];
+};
+
+uniform mat4 viewProjection;
+
+// the draw, the fragment shader adds the triangle
+flat out uint visibilityDraw;
+
+void main()
+{
+   // only the position stream is read, the pass writes no attributes
+   vec3 position = FetchPulledPosition(uint(gl_BaseInstance), uint(gl_VertexID));
+   gl_Position = viewProjection * visibilityDraws[gl_DrawID].model * vec4(position, 1.0);
+   visibilityDraw = uint(gl_DrawID);
+}
@@ -0,0 +1,28 @@
+#version 440 core
+// averages the 2x2x2 voxels of the finer clip level into each voxel of
+// a box of the coarser one, a column along z per fragment; both levels
+// are addressed toroidally, see VoxelGIManager.h
+
+layout(rgba16f, binding = 0) uniform writeonly image3D voxelLevel;
+uniform sampler3D finerLevel;
+
+// the box in world voxel indices of the coarser level
+uniform ivec3 filterMin;
+uniform int filterDepth;
+uniform int voxelResolution;
+
+void main()
+{
+   ivec3 wrap = ivec3(voxelResolution - 1);
+   for(int z = 0; z < filterDepth; z++)
+   {
+      ivec3 voxel = filterMin + ivec3(ivec2(gl_FragCoord.xy), z);
+      vec4 sum = vec4(0.0);
+      for(int i = 0; i < 8; i++)
+      {
+         ivec3 finer = voxel * 2 + ivec3(i & 1, (i >> 1) & 1, i >> 2);
+         sum += texelFetch(finerLevel, finer & wrap, 0);
+      }
+      imageStore(voxelLevel, voxel & wrap, sum * 0.125);
+   }
+}
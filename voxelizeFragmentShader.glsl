@@ -0,0 +1,88 @@
+#version 460 core
+// stores the light a surface reflects into the voxel of the clip level
+// it falls in; nothing is written to the framebuffer
+
+struct LightSource 
+{
+    vec3 position;	
+    vec3 ambientColor;
+    vec3 diffuseColor;
+    vec3 specularColor;
+    float focalStrength;
+    float specularIntensity;
+};
+
+struct AreaLight
+{
+    vec3 center;
+    int type;
+    vec3 right;
+    bool bTwoSided;
+    vec3 up;
+    vec3 color;
+    float intensity;
+};
+
+#define TOTAL_LIGHTS 4
+#define TOTAL_AREA_LIGHTS 4
+#define AREA_LIGHT_DISK 1
+
+// the same blocks the scene shader lights with, see UniformBlocks.h
+layout(std140, binding = 2) uniform LightingBlock
+{
+    LightSource lightSources[TOTAL_LIGHTS];
+};
+
+layout(std140, binding = 3) uniform AreaLightingBlock
+{
+    AreaLight areaLights[TOTAL_AREA_LIGHTS];
+    int areaLightCount;
+};
+
+layout(rgba16f, binding = 0) uniform writeonly image3D voxelLevel;
+
+// the region in world voxel indices of the level, maximum excluded
+uniform ivec3 regionMin;
+uniform ivec3 regionMax;
+uniform float voxelSize;
+uniform int voxelResolution;
+
+in vec3 voxelPosition;
+in vec3 voxelNormal;
+flat in vec3 voxelAlbedo;
+
+void main()
+{
+   ivec3 voxel = ivec3(floor(voxelPosition / voxelSize));
+   if(any(lessThan(voxel, regionMin)) || any(greaterThanEqual(voxel, regionMax)))
+   {
+      discard;
+   }
+
+   // the diffuse light only, a voxel is seen from every side
+   vec3 normal = normalize(voxelNormal);
+   vec3 light = vec3(0.0);
+   for(int i = 0; i < TOTAL_LIGHTS; i++)
+   {
+      vec3 lightDirection = normalize(lightSources[i].position - voxelPosition);
+      light += lightSources[i].diffuseColor * max(dot(normal, lightDirection), 0.0);
+   }
+
+   // an area light as a small one at its center: the cosines at both
+   // ends over the squared distance, capped near the light
+   for(int i = 0; i < min(areaLightCount, TOTAL_AREA_LIGHTS); i++)
+   {
+      AreaLight areaLight = areaLights[i];
+      vec3 toLight = areaLight.center - voxelPosition;
+      float distanceSquared = max(dot(toLight, toLight), 1e-4);
+      vec3 lightDirection = toLight * inversesqrt(distanceSquared);
+      float facing = -dot(normalize(cross(areaLight.right, areaLight.up)), lightDirection);
+      facing = areaLight.bTwoSided ? abs(facing) : max(facing, 0.0);
+      float area = length(areaLight.right) * length(areaLight.up) * ((areaLight.type == AREA_LIGHT_DISK) ? 3.1415927 : 4.0);
+      float formFactor = area / (3.1415927 * distanceSquared + area);
+      light += areaLight.color * areaLight.intensity * max(dot(normal, lightDirection), 0.0) * facing * formFactor;
+   }
+
+   // toroidal address: the world index wrapped at the resolution
+   imageStore(voxelLevel, voxel & ivec3(voxelResolution - 1), vec4(voxelAlbedo * light, 1.0));
+}
@@ -0,0 +1,35 @@
+#version 460 core
+// voxelization: the objects around a dirty region of a clip level,
+// pulled from the vertex pool and projected onto the region along one
+// axis; the pool declarations are added before this, see
+// VoxelGIManager.h
+
+struct VoxelDraw
+{
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 albedo;
+};
+
+layout(std430, binding = 5) readonly buffer VoxelDrawBuffer
+{
+    VoxelDraw voxelDraws[];
+};
+
+// world space onto the region, the projection axis through the depth
+uniform mat4 voxelProjection;
+
+out vec3 voxelPosition;
+out vec3 voxelNormal;
+flat out vec3 voxelAlbedo;
+
+void main()
+{
+   VoxelDraw draw = voxelDraws[gl_DrawID];
+   PulledVertex pulled = FetchPulledVertex(uint(gl_BaseInstance), uint(gl_VertexID));
+   vec4 position = draw.model * vec4(pulled.position, 1.0);
+   voxelPosition = position.xyz;
+   voxelNormal = mat3(draw.normalMatrix) * pulled.normal;
+   voxelAlbedo = draw.albedo.rgb;
+   gl_Position = voxelProjection * position;
+}